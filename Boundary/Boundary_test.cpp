@@ -1,4 +1,5 @@
 #include "Boundary.hpp"
+#include "WallMobility.hpp"
 #include "Util/EigenDef.hpp"
 
 #include <iostream>
@@ -102,6 +103,45 @@ int main() {
         }
     }
 
+    {
+        std::cout << "test wall mobility" << std::endl;
+        double origin[3] = {0, 0, 0};
+        double zaxis[3] = {0, 0, 1};
+        std::vector<std::shared_ptr<Boundary>> boundaryPtr;
+        boundaryPtr.push_back(std::make_shared<Wall>(origin, zaxis));
+        const double radius = 0.5;
+        Emat3 transSqrt, rotSqrt;
+
+        // a sphere at h = 2a, Faxen and Brenner factors in the wall frame
+        WallMobility::getFactorSqrt(boundaryPtr, Evec3(1, 2, 2 * radius), Evec3(0, 0, 1), 0, radius, transSqrt,
+                                    rotSqrt);
+        double para, perp, rotPara, rotPerp;
+        WallMobility::getPointFactor(radius, 2 * radius, para, perp, rotPara, rotPerp);
+        const Emat3 trans = transSqrt * transSqrt;
+        const Emat3 rot = rotSqrt * rotSqrt;
+        printf("h = 2a, para %g, perp %g, rotPara %g, rotPerp %g\n", para, perp, rotPara, rotPerp);
+        pass = pass && fabs(para - 0.7214355) < 1e-6 && fabs(perp - 0.4705882) < 1e-6;
+        pass = pass && (trans - Evec3(para, para, perp).asDiagonal().toDenseMatrix()).norm() < 1e-12;
+        pass = pass && (rot - Evec3(rotPara, rotPara, rotPerp).asDiagonal().toDenseMatrix()).norm() < 1e-12;
+
+        // far from the wall, no correction
+        WallMobility::getFactorSqrt(boundaryPtr, Evec3(0, 0, 1e8), Evec3(0, 0, 1), 0, radius, transSqrt, rotSqrt);
+        pass = pass && (transSqrt - Emat3::Identity()).norm() < 1e-6 && (rotSqrt - Emat3::Identity()).norm() < 1e-6;
+
+        // a rod tilted toward the wall is hindered more than at its center height, and stays SPD
+        WallMobility::getFactorSqrt(boundaryPtr, Evec3(0, 0, 3), Evec3(0.6, 0, 0.8), 6, radius, transSqrt,
+                                    rotSqrt);
+        Eigen::SelfAdjointEigenSolver<Emat3> solver(transSqrt * transSqrt);
+        WallMobility::getPointFactor(radius, 3, para, perp, rotPara, rotPerp);
+        pass = pass && solver.eigenvalues().minCoeff() > 0 && solver.eigenvalues().maxCoeff() < 1;
+        pass = pass && (transSqrt * transSqrt)(2, 2) < perp;
+
+        if (!pass) {
+            printf("Error\n");
+            std::exit(1);
+        }
+    }
+
     if (pass) {
         printf("TestPassed\n");
     }
@@ -0,0 +1,119 @@
+/**
+ * @file WallMobility.hpp
+ * @brief Near-wall correction of the single-body mobility
+ *
+ */
+#ifndef WALLMOBILITY_HPP_
+#define WALLMOBILITY_HPP_
+
+#include "Boundary.hpp"
+
+#include "Util/EigenDef.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <memory>
+#include <vector>
+
+/**
+ * @brief local hindrance of a body near boundaries
+ *
+ * Points along the body axis are treated as spheres of the body radius near a plane wall, at the distance h to the
+ * nearest boundary given by Boundary::project(). With x = a/h and gap g = h - a, the mobility of a point is scaled by
+ *   translation parallel to the wall, Faxen: 1 - 9/16 x + 1/8 x^3 - 45/256 x^4 - 1/16 x^5
+ *   translation normal to the wall, Bevan & Prieve 2000 fit of Brenner 1961: (6g^2 + 2ag) / (6g^2 + 9ag + 2a^2)
+ *   rotation about axes parallel to the wall: 1 - 5/16 x^3
+ *   rotation about the wall normal: 1 - 1/8 x^3
+ * The drag of the points adds along the body, so the factor tensor F of the body is the harmonic mean over points.
+ * The corrected mobility F^{1/2} M F^{1/2} is SPD, and is the scalar factor times M for spheres.
+ * The gap is clamped to minGap * a. Points overlapping a boundary get the largest hindrance.
+ */
+class WallMobility {
+  public:
+    static constexpr double minGap = 0.01; ///< minimum gap relative to the radius
+    static constexpr int maxPoint = 16;    ///< max number of points along a body
+
+    /**
+     * @brief square roots of the translational and rotational factor tensors of a body
+     *
+     * @param boundaryPtr all boundaries, the nearest one is used for each point
+     * @param center
+     * @param direction unit vector of the body axis
+     * @param length length of the body axis, 0 for spheres
+     * @param radius
+     * @param transSqrt [out] identity if there is no boundary
+     * @param rotSqrt [out] identity if there is no boundary
+     */
+    static void getFactorSqrt(const std::vector<std::shared_ptr<Boundary>> &boundaryPtr, const Evec3 &center,
+                              const Evec3 &direction, const double length, const double radius, Emat3 &transSqrt,
+                              Emat3 &rotSqrt) {
+        transSqrt = Emat3::Identity();
+        rotSqrt = Emat3::Identity();
+        if (boundaryPtr.empty()) {
+            return;
+        }
+
+        // one point per diameter along the axis, including both ends
+        const int nPoint =
+            length > 0 ? std::min(static_cast<int>(maxPoint), 2 + static_cast<int>(length / (2 * radius))) : 1;
+        Emat3 transInv = Emat3::Zero();
+        Emat3 rotInv = Emat3::Zero();
+        for (int k = 0; k < nPoint; k++) {
+            const double s = nPoint > 1 ? length * (-0.5 + k / (nPoint - 1.0)) : 0;
+            const Evec3 query = center + s * direction;
+
+            // the nearest boundary
+            double dist = std::numeric_limits<double>::max();
+            Evec3 norm(0, 0, 1);
+            for (const auto &bPtr : boundaryPtr) {
+                double proj[3], delta[3];
+                bPtr->project(query.data(), proj, delta);
+                const double deltaNorm = ECmap3(delta).norm();
+                const bool outside = (query - ECmap3(proj)).dot(ECmap3(delta)) < 0;
+                const double h = outside ? 0 : deltaNorm;
+                if (h < dist) {
+                    dist = h;
+                    if (deltaNorm > 0) {
+                        norm = ECmap3(delta) * (1 / deltaNorm);
+                    }
+                }
+            }
+
+            double para, perp, rotPara, rotPerp;
+            getPointFactor(radius, dist, para, perp, rotPara, rotPerp);
+            const Emat3 nn = norm * norm.transpose();
+            const Emat3 Imnn = Emat3::Identity() - nn;
+            transInv += (1 / para) * Imnn + (1 / perp) * nn;
+            rotInv += (1 / rotPara) * Imnn + (1 / rotPerp) * nn;
+        }
+
+        Eigen::SelfAdjointEigenSolver<Emat3> transSolver((transInv * (1.0 / nPoint)).inverse());
+        Eigen::SelfAdjointEigenSolver<Emat3> rotSolver((rotInv * (1.0 / nPoint)).inverse());
+        transSqrt = transSolver.operatorSqrt();
+        rotSqrt = rotSolver.operatorSqrt();
+    }
+
+    /**
+     * @brief mobility factors of a sphere near a plane wall
+     *
+     * @param radius
+     * @param h distance from the center to the wall
+     * @param para [out] translation parallel to the wall
+     * @param perp [out] translation normal to the wall
+     * @param rotPara [out] rotation about axes parallel to the wall
+     * @param rotPerp [out] rotation about the wall normal
+     */
+    static void getPointFactor(const double radius, const double h, double &para, double &perp, double &rotPara,
+                               double &rotPerp) {
+        const double gap = std::max(h - radius, minGap * radius);
+        const double x = radius / (radius + gap);
+        const double x3 = x * x * x;
+        para = 1 - 9.0 / 16 * x + 1.0 / 8 * x3 - 45.0 / 256 * x3 * x - 1.0 / 16 * x3 * x * x;
+        perp = (6 * gap * gap + 2 * radius * gap) / (6 * gap * gap + 9 * radius * gap + 2 * radius * radius);
+        rotPara = 1 - 5.0 / 16 * x3;
+        rotPerp = 1 - 1.0 / 8 * x3;
+    }
+};
+
+#endif
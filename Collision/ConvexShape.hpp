@@ -0,0 +1,185 @@
+/**
+ * @file ConvexShape.hpp
+ * @brief Convex collision shapes defined by support functions
+ *
+ */
+#ifndef CONVEXSHAPE_HPP_
+#define CONVEXSHAPE_HPP_
+
+#include "Util/EigenDef.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <istream>
+#include <type_traits>
+
+/**
+ * @brief a convex body in its body frame, for collision detection with GJK/EPA
+ *
+ * The body frame is centered at the particle position, with z along the particle direction.
+ * The shape is the core given by type and parameters, rounded by margin.
+ * Ellipsoid: param = semi-axes along x, y, z
+ * Tapered capsule: the convex hull of two spheres at z = -param[0]/2 and +param[0]/2, with radius param[1] and param[2]
+ * Polyhedron: the convex hull of vertex[0, nVertex)
+ */
+struct ConvexShape {
+    enum class Type : int { Ellipsoid = 0, TaperedCapsule = 1, Polyhedron = 2 };
+    static constexpr int maxVertex = 32; ///< max number of vertices of a polyhedron
+
+    Type type = Type::Ellipsoid;
+    double margin = 0;                 ///< rounding radius added to the core in every direction
+    double param[3] = {0, 0, 0};       ///< ellipsoid semi-axes, or tapered capsule length, radius minus, radius plus
+    int nVertex = 0;                   ///< number of polyhedron vertices
+    double vertex[maxVertex][3] = {};  ///< polyhedron vertices in body frame
+
+    /**
+     * @brief support point of the core in the body frame, the farthest point along d
+     *
+     * @param d direction, does not need to be normalized
+     * @return Evec3
+     */
+    Evec3 support(const Evec3 &d) const {
+        switch (type) {
+        case Type::Ellipsoid: {
+            const Evec3 a2d(param[0] * param[0] * d[0], param[1] * param[1] * d[1], param[2] * param[2] * d[2]);
+            const double norm = std::sqrt(a2d.dot(d));
+            return norm > 0 ? Evec3(a2d / norm) : Evec3(0, 0, param[2]);
+        }
+        case Type::TaperedCapsule: {
+            const double dnorm = d.norm();
+            const double sMinus = -0.5 * param[0] * d[2] + param[1] * dnorm;
+            const double sPlus = 0.5 * param[0] * d[2] + param[2] * dnorm;
+            const double z = (sPlus >= sMinus ? 0.5 : -0.5) * param[0];
+            const double r = sPlus >= sMinus ? param[2] : param[1];
+            return dnorm > 0 ? Evec3(Evec3(0, 0, z) + d * (r / dnorm)) : Evec3(0, 0, z);
+        }
+        default: {
+            int best = 0;
+            double sBest = ECmap3(vertex[0]).dot(d);
+            for (int i = 1; i < nVertex; i++) {
+                const double s = ECmap3(vertex[i]).dot(d);
+                if (s > sBest) {
+                    sBest = s;
+                    best = i;
+                }
+            }
+            return ECmap3(vertex[best]);
+        }
+        }
+    }
+
+    /**
+     * @brief a spherocylinder along z centered at origin enclosing the shape, including margin
+     *
+     * @param radius [out]
+     * @param length [out] distance between the centers of the two end caps
+     */
+    void getBoundingCapsule(double &radius, double &length) const {
+        double halfLength = 0;
+        switch (type) {
+        case Type::Ellipsoid:
+            // x^2+y^2 <= rho^2 (1-z^2/c^2) with rho = max(a,b), so |z| - h <= sqrt(rho^2 - x^2 - y^2) if h = c - rho
+            radius = std::max(param[0], param[1]);
+            halfLength = std::max(0.0, param[2] - radius);
+            break;
+        case Type::TaperedCapsule:
+            radius = std::max(param[1], param[2]);
+            halfLength = 0.5 * param[0];
+            break;
+        default:
+            radius = 0;
+            for (int i = 0; i < nVertex; i++) {
+                radius = std::max(radius, std::hypot(vertex[i][0], vertex[i][1]));
+            }
+            for (int i = 0; i < nVertex; i++) {
+                const double lateral2 = vertex[i][0] * vertex[i][0] + vertex[i][1] * vertex[i][1];
+                const double capHeight = std::sqrt(std::max(0.0, radius * radius - lateral2));
+                halfLength = std::max(halfLength, std::fabs(vertex[i][2]) - capHeight);
+            }
+            break;
+        }
+        radius += margin;
+        length = 2 * halfLength;
+    }
+
+    /**
+     * @brief check parameters
+     *
+     * @return true if the shape has positive size
+     */
+    bool isValid() const {
+        switch (type) {
+        case Type::Ellipsoid:
+            return param[0] > 0 && param[1] > 0 && param[2] > 0 && margin >= 0;
+        case Type::TaperedCapsule:
+            return param[0] >= 0 && param[1] >= 0 && param[2] >= 0 && margin >= 0 &&
+                   std::max(param[1], param[2]) + margin > 0;
+        default:
+            return nVertex > 0 && nVertex <= maxVertex && margin >= 0;
+        }
+    }
+
+    /**
+     * @brief read the parameters after the 'H index' header of a shape line
+     *
+     * E a b c [margin]
+     * T length radiusMinus radiusPlus [margin]
+     * P n x0 y0 z0 ... [margin]
+     * @param is
+     * @return true if read successfully
+     */
+    bool readAscii(std::istream &is) {
+        char typeChar = 0;
+        is >> typeChar;
+        if (typeChar == 'E' || typeChar == 'T') {
+            type = typeChar == 'E' ? Type::Ellipsoid : Type::TaperedCapsule;
+            is >> param[0] >> param[1] >> param[2];
+        } else if (typeChar == 'P') {
+            type = Type::Polyhedron;
+            is >> nVertex;
+            if (!is || nVertex <= 0 || nVertex > maxVertex) {
+                return false;
+            }
+            for (int i = 0; i < nVertex; i++) {
+                is >> vertex[i][0] >> vertex[i][1] >> vertex[i][2];
+            }
+        } else {
+            return false;
+        }
+        if (!is) {
+            return false;
+        }
+        margin = 0;
+        is >> margin; // optional
+        return isValid();
+    }
+
+    /**
+     * @brief write a shape line readable by readAscii()
+     *
+     * @param fptr
+     * @param index
+     */
+    void writeAscii(FILE *fptr, const int index) const {
+        switch (type) {
+        case Type::Ellipsoid:
+        case Type::TaperedCapsule:
+            fprintf(fptr, "H %d %c %.8g %.8g %.8g", index, type == Type::Ellipsoid ? 'E' : 'T', param[0], param[1],
+                    param[2]);
+            break;
+        default:
+            fprintf(fptr, "H %d P %d", index, nVertex);
+            for (int i = 0; i < nVertex; i++) {
+                fprintf(fptr, " %.8g %.8g %.8g", vertex[i][0], vertex[i][1], vertex[i][2]);
+            }
+            break;
+        }
+        fprintf(fptr, " %.8g\n", margin);
+    }
+};
+
+static_assert(std::is_trivially_copyable<ConvexShape>::value, "");
+static_assert(std::is_default_constructible<ConvexShape>::value, "");
+
+#endif
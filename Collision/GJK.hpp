@@ -0,0 +1,505 @@
+/**
+ * @file GJK.hpp
+ * @brief GJK distance and EPA penetration queries for general convex bodies
+ *
+ */
+#ifndef GJK_HPP_
+#define GJK_HPP_
+
+#include "Util/EigenDef.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <vector>
+
+/**
+ * @brief result of a convex-convex query
+ *
+ * distance is negative for overlapping bodies, then pointA is the deepest point of A in B and vice versa.
+ * normal points from B to A, i.e., A moves along normal by -distance to separate.
+ */
+struct ResultGJK {
+    double distance = 0; ///< signed distance between the surfaces
+    Evec3 pointA;        ///< witness point on the surface of A
+    Evec3 pointB;        ///< witness point on the surface of B
+    Evec3 normal;        ///< unit normal from B to A
+};
+
+/**
+ * @brief closest points and penetration of two convex bodies given by support functions
+ *
+ * A Body type has:
+ *   Evec3 support(const Evec3 &d) const; farthest point of the core along d, in the lab frame
+ *   double getMargin() const; rounding radius of the core, the body is core + ball(margin)
+ * GJK runs on the cores, so rounded bodies in contact are resolved without EPA.
+ * EPA runs on the full bodies when the cores overlap.
+ */
+class GJKQuery {
+  public:
+    /**
+     * @brief query the signed distance
+     *
+     * @tparam BodyA
+     * @tparam BodyB
+     * @param A
+     * @param B
+     * @param guess initial search direction, usually centerA - centerB
+     * @param cutoff stop early if the distance is larger than this
+     * @param result [out] valid if returns true
+     * @return true if distance <= cutoff
+     */
+    template <class BodyA, class BodyB>
+    static bool query(const BodyA &A, const BodyB &B, const Evec3 &guess, const double cutoff, ResultGJK &result) {
+        const double margin = A.getMargin() + B.getMargin();
+        Simplex simplex;
+        Evec3 v;
+        const Status status = runGJK(Minkowski<BodyA, BodyB>{A, B, false}, guess, cutoff + margin, simplex, v);
+        if (status == Status::Far) {
+            return false;
+        }
+        if (status == Status::Separated && v.squaredNorm() > 0) {
+            Evec3 pA = Evec3::Zero(), pB = Evec3::Zero();
+            for (int i = 0; i < simplex.size; i++) {
+                pA += simplex.lambda[i] * simplex.a[i];
+                pB += simplex.lambda[i] * simplex.b[i];
+            }
+            const double dist = v.norm();
+            result.normal = v / dist;
+            result.distance = dist - margin;
+            result.pointA = pA - A.getMargin() * result.normal;
+            result.pointB = pB + B.getMargin() * result.normal;
+            return result.distance <= cutoff;
+        }
+
+        // cores overlap, run EPA on the full bodies
+        const Minkowski<BodyA, BodyB> full{A, B, true};
+        runGJK(full, guess, std::numeric_limits<double>::max(), simplex, v);
+        if (!runEPA(full, simplex, result)) {
+            // flat bodies. no penetration direction, fall back to the direction between cores
+            const Evec3 p = 0.5 * (A.support(-guess) + B.support(guess));
+            result.normal = guess.norm() > 0 ? Evec3(guess.normalized()) : Evec3(0, 0, 1);
+            result.distance = -margin;
+            result.pointA = p - A.getMargin() * result.normal;
+            result.pointB = p + B.getMargin() * result.normal;
+        }
+        return true;
+    }
+
+  private:
+    static constexpr int maxIterGJK = 64;
+    static constexpr int maxIterEPA = 64;
+    static constexpr double relTol = 1e-10;
+
+    enum class Status { Separated, Far, Overlap };
+
+    /**
+     * @brief support points on the Minkowski difference A - B
+     */
+    template <class BodyA, class BodyB>
+    struct Minkowski {
+        const BodyA &A;
+        const BodyB &B;
+        bool withMargin; ///< include the margins, for EPA
+
+        void support(const Evec3 &d, Evec3 &w, Evec3 &a, Evec3 &b) const {
+            a = A.support(d);
+            b = B.support(-d);
+            if (withMargin) {
+                const double dnorm = d.norm();
+                if (dnorm > 0) {
+                    a += d * (A.getMargin() / dnorm);
+                    b -= d * (B.getMargin() / dnorm);
+                }
+            }
+            w = a - b;
+        }
+    };
+
+    /**
+     * @brief vertices of the Minkowski difference w = a - b, with barycentric coordinates of the closest point
+     */
+    struct Simplex {
+        int size = 0;
+        Evec3 w[4], a[4], b[4];
+        double lambda[4];
+
+        void keep(const int i0, const int i1 = -1, const int i2 = -1) {
+            const int index[3] = {i0, i1, i2};
+            Evec3 w_[3], a_[3], b_[3];
+            int n = 0;
+            for (int k = 0; k < 3 && index[k] >= 0; k++, n++) {
+                w_[k] = w[index[k]];
+                a_[k] = a[index[k]];
+                b_[k] = b[index[k]];
+            }
+            for (int k = 0; k < n; k++) {
+                w[k] = w_[k];
+                a[k] = a_[k];
+                b[k] = b_[k];
+            }
+            size = n;
+        }
+    };
+
+    template <class Mink>
+    static Status runGJK(const Mink &mink, const Evec3 &guess, const double cutoff, Simplex &simplex, Evec3 &v) {
+        Evec3 w, a, b;
+        mink.support(guess.squaredNorm() > 0 ? Evec3(-guess) : Evec3(1, 0, 0), w, a, b);
+        simplex.size = 1;
+        simplex.w[0] = w;
+        simplex.a[0] = a;
+        simplex.b[0] = b;
+        simplex.lambda[0] = 1;
+        v = w;
+        double scale2 = w.squaredNorm();
+        for (int iter = 0; iter < maxIterGJK; iter++) {
+            const double vv = v.squaredNorm();
+            if (vv <= relTol * relTol * scale2) {
+                return Status::Overlap;
+            }
+            mink.support(-v, w, a, b);
+            scale2 = std::max(scale2, w.squaredNorm());
+            const double vw = v.dot(w);
+            if (vw > 0 && vw * vw > vv * cutoff * cutoff) {
+                return Status::Far; // separating plane beyond cutoff
+            }
+            bool duplicate = false;
+            for (int i = 0; i < simplex.size; i++) {
+                duplicate = duplicate || (simplex.w[i] - w).squaredNorm() <= relTol * relTol * scale2;
+            }
+            if (duplicate || vv - vw <= relTol * vv) {
+                break; // converged
+            }
+            simplex.w[simplex.size] = w;
+            simplex.a[simplex.size] = a;
+            simplex.b[simplex.size] = b;
+            simplex.size++;
+            const Evec3 vNew = closestOnSimplex(simplex);
+            if (simplex.size == 4) {
+                return Status::Overlap;
+            }
+            if (vNew.squaredNorm() >= vv) {
+                v = vNew;
+                break; // no progress due to round off
+            }
+            v = vNew;
+        }
+        return Status::Separated;
+    }
+
+    /**
+     * @brief reduce the simplex to the smallest subset containing the point closest to the origin
+     *
+     * Size 4 is kept only if the origin is inside the tetrahedron
+     * @param s
+     * @return Evec3 the closest point
+     */
+    static Evec3 closestOnSimplex(Simplex &s) {
+        switch (s.size) {
+        case 1:
+            s.lambda[0] = 1;
+            return s.w[0];
+        case 2:
+            return closestOnSegment(s, 0, 1);
+        case 3:
+            return closestOnTriangle(s, 0, 1, 2);
+        default:
+            return closestOnTetrahedron(s);
+        }
+    }
+
+    static Evec3 closestOnSegment(Simplex &s, const int i0, const int i1) {
+        const Evec3 ab = s.w[i1] - s.w[i0];
+        const double ab2 = ab.squaredNorm();
+        const double t = ab2 > 0 ? -s.w[i0].dot(ab) / ab2 : 0;
+        if (t <= 0) {
+            s.keep(i0);
+            s.lambda[0] = 1;
+            return s.w[0];
+        }
+        if (t >= 1) {
+            s.keep(i1);
+            s.lambda[0] = 1;
+            return s.w[0];
+        }
+        s.keep(i0, i1);
+        s.lambda[0] = 1 - t;
+        s.lambda[1] = t;
+        return s.w[0] + t * ab;
+    }
+
+    // Ericson, Real-Time Collision Detection, 5.1.5
+    static Evec3 closestOnTriangle(Simplex &s, const int i0, const int i1, const int i2) {
+        const Evec3 a = s.w[i0], b = s.w[i1], c = s.w[i2];
+        const Evec3 ab = b - a, ac = c - a;
+        const double d1 = -ab.dot(a), d2 = -ac.dot(a);
+        if (d1 <= 0 && d2 <= 0) {
+            s.keep(i0);
+            s.lambda[0] = 1;
+            return a;
+        }
+        const double d3 = -ab.dot(b), d4 = -ac.dot(b);
+        if (d3 >= 0 && d4 <= d3) {
+            s.keep(i1);
+            s.lambda[0] = 1;
+            return b;
+        }
+        const double vc = d1 * d4 - d3 * d2;
+        if (vc <= 0 && d1 >= 0 && d3 <= 0) {
+            const double t = d1 / (d1 - d3);
+            s.keep(i0, i1);
+            s.lambda[0] = 1 - t;
+            s.lambda[1] = t;
+            return a + t * ab;
+        }
+        const double d5 = -ab.dot(c), d6 = -ac.dot(c);
+        if (d6 >= 0 && d5 <= d6) {
+            s.keep(i2);
+            s.lambda[0] = 1;
+            return c;
+        }
+        const double vb = d5 * d2 - d1 * d6;
+        if (vb <= 0 && d2 >= 0 && d6 <= 0) {
+            const double t = d2 / (d2 - d6);
+            s.keep(i0, i2);
+            s.lambda[0] = 1 - t;
+            s.lambda[1] = t;
+            return a + t * ac;
+        }
+        const double va = d3 * d6 - d5 * d4;
+        if (va <= 0 && (d4 - d3) >= 0 && (d5 - d6) >= 0) {
+            const double t = (d4 - d3) / ((d4 - d3) + (d5 - d6));
+            s.keep(i1, i2);
+            s.lambda[0] = 1 - t;
+            s.lambda[1] = t;
+            return b + t * (c - b);
+        }
+        const double denom = va + vb + vc;
+        if (!(denom > 0)) { // degenerate triangle
+            return closestOnSegment(s, i0, (ab.squaredNorm() > ac.squaredNorm()) ? i1 : i2);
+        }
+        const double v = vb / denom, w = vc / denom;
+        s.keep(i0, i1, i2);
+        s.lambda[0] = 1 - v - w;
+        s.lambda[1] = v;
+        s.lambda[2] = w;
+        return a + ab * v + ac * w;
+    }
+
+    static Evec3 closestOnTetrahedron(Simplex &s) {
+        static const int face[4][4] = {{0, 1, 2, 3}, {0, 2, 3, 1}, {0, 3, 1, 2}, {1, 3, 2, 0}}; // 3 on face, opposite
+        double best = std::numeric_limits<double>::max();
+        Simplex sBest;
+        Evec3 vBest = Evec3::Zero();
+        bool outside = false;
+        for (int f = 0; f < 4; f++) {
+            const Evec3 &p0 = s.w[face[f][0]];
+            const Evec3 n = (s.w[face[f][1]] - p0).cross(s.w[face[f][2]] - p0);
+            const double signOrigin = -n.dot(p0);
+            const double signOpposite = n.dot(s.w[face[f][3]] - p0);
+            const bool flat = std::fabs(signOpposite) <= relTol * n.norm() * (s.w[face[f][3]] - p0).norm();
+            if (signOrigin * signOpposite < 0 || flat) {
+                outside = true;
+                Simplex sFace = s;
+                const Evec3 v = closestOnTriangle(sFace, face[f][0], face[f][1], face[f][2]);
+                if (v.squaredNorm() < best) {
+                    best = v.squaredNorm();
+                    sBest = sFace;
+                    vBest = v;
+                }
+            }
+        }
+        if (!outside) {
+            return Evec3::Zero();
+        }
+        s = sBest;
+        return vBest;
+    }
+
+    struct Face {
+        int v[3];
+        Evec3 n;
+        double d;
+        bool alive;
+    };
+
+    struct Polytope {
+        std::vector<Evec3> w, a, b;
+        std::vector<Face> faces;
+        Evec3 interior;
+
+        bool addFace(const int i0, const int i1, const int i2) {
+            Face f{{i0, i1, i2}, Evec3::Zero(), 0, true};
+            Evec3 n = (w[i1] - w[i0]).cross(w[i2] - w[i0]);
+            const double nnorm = n.norm();
+            if (!(nnorm > 0)) {
+                return false;
+            }
+            n /= nnorm;
+            if (n.dot(w[i0] - interior) < 0) {
+                n = -n;
+                std::swap(f.v[1], f.v[2]);
+            }
+            f.n = n;
+            f.d = n.dot(w[i0]);
+            faces.push_back(f);
+            return true;
+        }
+    };
+
+    /**
+     * @brief blow up a simplex containing the origin to a tetrahedron
+     */
+    template <class Mink>
+    static bool makeTetrahedron(const Mink &mink, Simplex &s) {
+        double scale = 0;
+        for (int i = 0; i < s.size; i++) {
+            scale = std::max(scale, s.w[i].norm());
+        }
+        auto tryAdd = [&](const Evec3 &d) {
+            Evec3 w, a, b;
+            mink.support(d, w, a, b);
+            scale = std::max(scale, w.norm());
+            bool newPoint = false;
+            const double eps = std::sqrt(relTol) * scale;
+            switch (s.size) {
+            case 1:
+                newPoint = (w - s.w[0]).norm() > eps;
+                break;
+            case 2: {
+                const Evec3 axis = (s.w[1] - s.w[0]).normalized();
+                const Evec3 r = w - s.w[0];
+                newPoint = (r - axis * axis.dot(r)).norm() > eps;
+                break;
+            }
+            default: {
+                const Evec3 n = (s.w[1] - s.w[0]).cross(s.w[2] - s.w[0]).normalized();
+                newPoint = std::fabs(n.dot(w - s.w[0])) > eps;
+                break;
+            }
+            }
+            if (newPoint) {
+                s.w[s.size] = w;
+                s.a[s.size] = a;
+                s.b[s.size] = b;
+                s.size++;
+            }
+            return newPoint;
+        };
+
+        if (s.size == 1) {
+            const Evec3 axes[6] = {Evec3(1, 0, 0), Evec3(-1, 0, 0), Evec3(0, 1, 0),
+                                   Evec3(0, -1, 0), Evec3(0, 0, 1), Evec3(0, 0, -1)};
+            for (int i = 0; i < 6 && s.size == 1; i++) {
+                tryAdd(axes[i]);
+            }
+            if (s.size == 1) {
+                return false;
+            }
+        }
+        if (s.size == 2) {
+            const Evec3 axis = (s.w[1] - s.w[0]).normalized();
+            int k = 0;
+            axis.cwiseAbs().minCoeff(&k);
+            const Evec3 e = axis.cross(Evec3::Unit(k)).normalized();
+            for (int i = 0; i < 6 && s.size == 2; i++) {
+                tryAdd(Eigen::AngleAxisd(i * Pi / 3, axis) * e);
+            }
+            if (s.size == 2) {
+                return false;
+            }
+        }
+        if (s.size == 3) {
+            const Evec3 n = (s.w[1] - s.w[0]).cross(s.w[2] - s.w[0]);
+            if (!tryAdd(n) && !tryAdd(-n)) {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    template <class Mink>
+    static bool runEPA(const Mink &mink, Simplex &simplex, ResultGJK &result) {
+        if (!makeTetrahedron(mink, simplex)) {
+            return false;
+        }
+        Polytope poly;
+        for (int i = 0; i < 4; i++) {
+            poly.w.push_back(simplex.w[i]);
+            poly.a.push_back(simplex.a[i]);
+            poly.b.push_back(simplex.b[i]);
+        }
+        poly.interior = 0.25 * (poly.w[0] + poly.w[1] + poly.w[2] + poly.w[3]);
+        if (!(poly.addFace(0, 1, 2) && poly.addFace(0, 3, 1) && poly.addFace(0, 2, 3) && poly.addFace(1, 3, 2))) {
+            return false;
+        }
+
+        double scale = 0;
+        for (const auto &w : poly.w) {
+            scale = std::max(scale, w.norm());
+        }
+        int closest = 0;
+        std::vector<std::pair<int, int>> horizon;
+        for (int iter = 0; iter < maxIterEPA; iter++) {
+            closest = -1;
+            const int nFace = poly.faces.size();
+            for (int f = 0; f < nFace; f++) {
+                if (poly.faces[f].alive && (closest < 0 || poly.faces[f].d < poly.faces[closest].d)) {
+                    closest = f;
+                }
+            }
+            const Face face = poly.faces[closest];
+            Evec3 w, a, b;
+            mink.support(face.n, w, a, b);
+            scale = std::max(scale, w.norm());
+            if (w.dot(face.n) - face.d <= std::sqrt(relTol) * scale) {
+                break;
+            }
+
+            // remove faces visible from w, keep the horizon edges
+            horizon.clear();
+            for (auto &f : poly.faces) {
+                if (!f.alive || f.n.dot(w - poly.w[f.v[0]]) <= 0) {
+                    continue;
+                }
+                f.alive = false;
+                for (int e = 0; e < 3; e++) {
+                    const std::pair<int, int> edge(f.v[e], f.v[(e + 1) % 3]);
+                    auto it = std::find(horizon.begin(), horizon.end(), std::make_pair(edge.second, edge.first));
+                    if (it != horizon.end()) {
+                        horizon.erase(it);
+                    } else {
+                        horizon.push_back(edge);
+                    }
+                }
+            }
+            const int iw = poly.w.size();
+            poly.w.push_back(w);
+            poly.a.push_back(a);
+            poly.b.push_back(b);
+            for (const auto &edge : horizon) {
+                poly.addFace(edge.first, edge.second, iw);
+            }
+        }
+
+        // the origin projected on the closest face
+        const Face &face = poly.faces[closest];
+        const Evec3 p = face.n * face.d;
+        const Evec3 &w0 = poly.w[face.v[0]], &w1 = poly.w[face.v[1]], &w2 = poly.w[face.v[2]];
+        const Evec3 e1 = w1 - w0, e2 = w2 - w0, ep = p - w0;
+        const double d11 = e1.dot(e1), d12 = e1.dot(e2), d22 = e2.dot(e2);
+        const double dp1 = ep.dot(e1), dp2 = ep.dot(e2);
+        const double denom = d11 * d22 - d12 * d12;
+        const double l1 = denom > 0 ? (d22 * dp1 - d12 * dp2) / denom : 0;
+        const double l2 = denom > 0 ? (d11 * dp2 - d12 * dp1) / denom : 0;
+        const double l0 = 1 - l1 - l2;
+        result.pointA = l0 * poly.a[face.v[0]] + l1 * poly.a[face.v[1]] + l2 * poly.a[face.v[2]];
+        result.pointB = l0 * poly.b[face.v[0]] + l1 * poly.b[face.v[1]] + l2 * poly.b[face.v[2]];
+        result.normal = -face.n;
+        result.distance = -std::max(face.d, 0.0);
+        return true;
+    }
+};
+
+#endif
@@ -0,0 +1,201 @@
+#include "ConvexShape.hpp"
+#include "DCPQuery.hpp"
+#include "GJK.hpp"
+
+#include <cstdio>
+#include <cstdlib>
+#include <random>
+
+// a spherocylinder, the core is the center segment
+struct CapsuleBody {
+    Evec3 center, direction;
+    double halfLength, radius;
+    Evec3 support(const Evec3 &d) const {
+        return center + (direction.dot(d) >= 0 ? halfLength : -halfLength) * direction;
+    }
+    double getMargin() const { return radius; }
+};
+
+// a ConvexShape placed in the lab frame
+struct ShapeBody {
+    const ConvexShape *shape;
+    Evec3 center;
+    Equatn orientation;
+    Evec3 support(const Evec3 &d) const {
+        return center + orientation * shape->support(orientation.inverse() * d);
+    }
+    double getMargin() const { return shape->margin; }
+};
+
+bool check(bool pass, const char *name, double value, double expect) {
+    if (!pass) {
+        printf("Error: %s %g, expect %g\n", name, value, expect);
+    }
+    return pass;
+}
+
+void testCapsule() {
+    std::mt19937 gen(0);
+    std::uniform_real_distribution<double> u(-1, 1);
+    DCPQuery<3, double, Evec3> DistSegSeg3;
+    bool pass = true;
+    for (int n = 0; n < 1000; n++) {
+        CapsuleBody A{Evec3(u(gen), u(gen), u(gen)), Evec3(u(gen), u(gen), u(gen)).normalized(), 1, 0.3};
+        CapsuleBody B{Evec3(u(gen), u(gen), u(gen)), Evec3(u(gen), u(gen), u(gen)).normalized(), 0.5, 0.2};
+        Evec3 Ploc, Qloc;
+        double s, t;
+        const double dist = DistSegSeg3(A.center - A.direction, A.center + A.direction, B.center - B.direction * 0.5,
+                                        B.center + B.direction * 0.5, Ploc, Qloc, s, t);
+        if (dist < 1e-3) {
+            continue; // cores cross, EPA gives the true penetration instead
+        }
+        ResultGJK result;
+        const bool found = GJKQuery::query(A, B, A.center - B.center, 10, result);
+        const double expect = dist - 0.5;
+        pass = pass &&
+               check(found && fabs(result.distance - expect) < 1e-8, "capsule distance", result.distance, expect);
+        pass = pass && check((result.normal - (Ploc - Qloc) / dist).norm() < 1e-6, "capsule normal", result.normal[0],
+                             (Ploc - Qloc)[0] / dist);
+        pass = pass && check(fabs((result.pointA - result.pointB).dot(result.normal) - expect) < 1e-8,
+                             "capsule points distance", (result.pointA - result.pointB).dot(result.normal), expect);
+    }
+
+    // crossing cores, separated along z by the sum of radii
+    CapsuleBody A{Evec3::Zero(), Evec3(1, 0, 0), 1, 0.5};
+    CapsuleBody B{Evec3(0, 0, 0.2), Evec3(0, 1, 0), 1, 0.5};
+    ResultGJK result;
+    GJKQuery::query(A, B, A.center - B.center, 10, result);
+    pass = pass && check(fabs(result.distance + 0.8) < 1e-6, "crossing capsule", result.distance, -0.8);
+    pass = pass && check((result.normal - Evec3(0, 0, -1)).norm() < 1e-6, "crossing normal", result.normal[2], -1);
+    if (!pass) {
+        std::exit(1);
+    }
+}
+
+void testSphere() {
+    ConvexShape ball;
+    ball.type = ConvexShape::Type::Ellipsoid;
+    ball.param[0] = ball.param[1] = ball.param[2] = 1.0;
+    bool pass = true;
+    const double gap[4] = {0.5, 0.01, -0.2, -1.5};
+    for (int k = 0; k < 4; k++) {
+        const Evec3 rIJ = Evec3(1, 2, -0.5).normalized() * (2 + gap[k]);
+        ShapeBody A{&ball, rIJ, Equatn::Identity()};
+        ShapeBody B{&ball, Evec3::Zero(), Equatn(Eigen::AngleAxisd(0.3, Evec3(0, 1, 1).normalized()))};
+        ResultGJK result;
+        GJKQuery::query(A, B, A.center - B.center, 10, result);
+        const double tol = gap[k] > 0 ? 1e-6 : 1e-3; // EPA approximates the sphere with a polytope
+        pass = pass && check(fabs(result.distance - gap[k]) < tol, "sphere distance", result.distance, gap[k]);
+        pass = pass && check((result.normal - rIJ.normalized()).norm() < 0.05, "sphere normal", result.normal[0],
+                             rIJ.normalized()[0]);
+    }
+    if (!pass) {
+        std::exit(1);
+    }
+}
+
+void testCube() {
+    ConvexShape cube;
+    cube.type = ConvexShape::Type::Polyhedron;
+    cube.nVertex = 8;
+    for (int i = 0; i < 8; i++) {
+        cube.vertex[i][0] = (i & 1) ? 0.5 : -0.5;
+        cube.vertex[i][1] = (i & 2) ? 0.5 : -0.5;
+        cube.vertex[i][2] = (i & 4) ? 0.5 : -0.5;
+    }
+    bool pass = true;
+    // face to face, shifted laterally
+    const double gap[3] = {0.3, 0, -0.25};
+    for (int k = 0; k < 3; k++) {
+        ShapeBody A{&cube, Evec3(1 + gap[k], 0.2, 0.1), Equatn::Identity()};
+        ShapeBody B{&cube, Evec3::Zero(), Equatn::Identity()};
+        ResultGJK result;
+        GJKQuery::query(A, B, A.center - B.center, 10, result);
+        pass = pass && check(fabs(result.distance - gap[k]) < 1e-8, "cube distance", result.distance, gap[k]);
+        pass = pass && check((result.normal - Evec3(1, 0, 0)).norm() < 1e-8, "cube normal", result.normal[0], 1);
+    }
+    // rounded cube, vertex to face
+    cube.margin = 0.1;
+    ShapeBody A{&cube, Evec3(0, 0, 2), Equatn(Eigen::AngleAxisd(atan(sqrt(2.0)), Evec3(1, -1, 0).normalized()))};
+    ShapeBody B{&cube, Evec3::Zero(), Equatn::Identity()};
+    ResultGJK result;
+    GJKQuery::query(A, B, A.center - B.center, 10, result);
+    const double expect = 2 - 0.5 - 0.5 * sqrt(3.0) - 0.2;
+    pass = pass && check(fabs(result.distance - expect) < 1e-8, "rounded cube distance", result.distance, expect);
+
+    // cutoff
+    pass = pass && !GJKQuery::query(A, B, A.center - B.center, 0.1, result);
+    if (!pass) {
+        std::exit(1);
+    }
+}
+
+void testTaperedCapsule() {
+    ConvexShape cone;
+    cone.type = ConvexShape::Type::TaperedCapsule;
+    cone.param[0] = 2;
+    cone.param[1] = 0.2;
+    cone.param[2] = 0.6;
+    double radius, length;
+    cone.getBoundingCapsule(radius, length);
+    bool pass = check(radius == 0.6 && length == 2, "bounding capsule", radius, 0.6);
+
+    // plus end sphere against a sphere on the axis, and the side against a sphere off the axis
+    ShapeBody A{&cone, Evec3::Zero(), Equatn::Identity()};
+    CapsuleBody B{Evec3(0, 0, 3), Evec3(1, 0, 0), 0, 0.5};
+    ResultGJK result;
+    GJKQuery::query(A, B, A.center - B.center, 10, result);
+    pass = pass && check(fabs(result.distance - (3 - 1 - 0.6 - 0.5)) < 1e-8, "cone end", result.distance, 0.9);
+    // the hull of two spheres is the union of spheres on the axis with linearly interpolated radius
+    B.center = Evec3(2, 0, 0.3);
+    GJKQuery::query(A, B, A.center - B.center, 10, result);
+    auto gap = [&](double t) { return (B.center - Evec3(0, 0, 2 * t - 1)).norm() - (0.2 + 0.4 * t) - 0.5; };
+    double t0 = 0, t1 = 1;
+    for (int i = 0; i < 200; i++) { // the gap is convex in t
+        const double ta = t0 + (t1 - t0) / 3, tb = t1 - (t1 - t0) / 3;
+        if (gap(ta) < gap(tb)) {
+            t1 = tb;
+        } else {
+            t0 = ta;
+        }
+    }
+    pass = pass && check(fabs(result.distance - gap(t0)) < 1e-8, "cone side", result.distance, gap(t0));
+    if (!pass) {
+        std::exit(1);
+    }
+}
+
+void testEllipsoid() {
+    ConvexShape ell;
+    ell.type = ConvexShape::Type::Ellipsoid;
+    ell.param[0] = 1;
+    ell.param[1] = 2;
+    ell.param[2] = 3;
+    double radius, length;
+    ell.getBoundingCapsule(radius, length);
+    bool pass = check(radius == 2 && length == 2, "bounding capsule", radius, 2);
+
+    // rotated such that the longest axis is along x, against a sphere on the x axis
+    ShapeBody A{&ell, Evec3::Zero(), Equatn(Eigen::AngleAxisd(Pi / 2, Evec3(0, 1, 0)))};
+    CapsuleBody B{Evec3(4, 0, 0), Evec3(1, 0, 0), 0, 0.5};
+    ResultGJK result;
+    GJKQuery::query(A, B, A.center - B.center, 10, result);
+    pass = pass && check(fabs(result.distance - 0.5) < 1e-6, "ellipsoid distance", result.distance, 0.5);
+    B.center = Evec3(3.2, 0, 0);
+    GJKQuery::query(A, B, A.center - B.center, 10, result);
+    pass = pass && check(fabs(result.distance + 0.3) < 1e-3, "ellipsoid overlap", result.distance, -0.3);
+    pass = pass && check(result.normal[0] < -0.99, "ellipsoid normal", result.normal[0], -1);
+    if (!pass) {
+        std::exit(1);
+    }
+}
+
+int main() {
+    testCapsule();
+    testSphere();
+    testCube();
+    testTaperedCapsule();
+    testEllipsoid();
+    printf("GJK test passed\n");
+    return 0;
+}
@@ -0,0 +1,91 @@
+#include "AMGPreconditioner.hpp"
+
+#ifdef SIMTOOLBOX_MUELU
+
+#include "Util/Logger.hpp"
+
+#include <TpetraExt_MatrixMatrix.hpp>
+
+#include <algorithm>
+
+void AMGPreconditioner::update(const ConstraintOperator &AOp, const Teuchos::RCP<const TV> &biFlagRcp) {
+    auto mobMatRcp = Teuchos::rcp_dynamic_cast<const TCMAT>(AOp.getMobility());
+    TEUCHOS_TEST_FOR_EXCEPTION(mobMatRcp.is_null(), std::invalid_argument,
+                               "AMGPreconditioner requires an explicit mobility matrix.");
+    auto DTRcp = AOp.getDMatTrans();
+    auto invKappaRcp = AOp.getInvKappa();
+    TEUCHOS_TEST_FOR_EXCEPTION(!DTRcp->getRangeMap()->isSameAs(*(biFlagRcp->getMap())), std::invalid_argument,
+                               "A and biFlag do not have the same Map.");
+
+    // step 1, D^T M D
+    Teuchos::RCP<TCMAT> MDRcp = Teuchos::rcp(new TCMAT(mobMatRcp->getRowMap(), 0));
+    Tpetra::MatrixMatrix::Multiply(*mobMatRcp, false, *DTRcp, true, *MDRcp);
+    Teuchos::RCP<TCMAT> DTMDRcp = Teuchos::rcp(new TCMAT(DTRcp->getRowMap(), 0));
+    Tpetra::MatrixMatrix::Multiply(*DTRcp, false, *MDRcp, false, *DTMDRcp);
+
+    // step 2, keep the bilateral block only
+    DTMDRcp->leftScale(*biFlagRcp);
+    DTMDRcp->rightScale(*biFlagRcp);
+
+    // step 3, diagonal F K^{-1} + (I - F)
+    auto biFlagPtr = biFlagRcp->getLocalView<Kokkos::HostSpace>();
+    auto invKappaPtr = invKappaRcp->getLocalView<Kokkos::HostSpace>();
+    const int localSize = biFlagPtr.dimension_0();
+    Kokkos::View<size_t *> rowPointers("rowPointers", localSize + 1);
+    Kokkos::View<int *> columnIndices("columnIndices", localSize);
+    Kokkos::View<double *> values("values", localSize);
+    rowPointers[0] = 0;
+    for (int i = 0; i < localSize; i++) {
+        rowPointers[i + 1] = i + 1;
+        columnIndices[i] = i;
+        values[i] = biFlagPtr(i, 0) > 0.5 ? invKappaPtr(i, 0) : 1.0;
+    }
+    auto gammaMapRcp = DTRcp->getRangeMap();
+    Teuchos::RCP<TCMAT> diagRcp =
+        Teuchos::rcp(new TCMAT(gammaMapRcp, gammaMapRcp, rowPointers, columnIndices, values));
+    diagRcp->fillComplete(gammaMapRcp, gammaMapRcp);
+
+    Teuchos::RCP<TCMAT> ARcp = Tpetra::MatrixMatrix::add(1.0, false, *DTMDRcp, 1.0, false, *diagRcp);
+
+    // step 4, reuse the hierarchy if the constraint graph is unchanged
+    std::vector<size_t> rowPtr;
+    std::vector<int> colGid;
+    getGraph(*ARcp, rowPtr, colGid);
+    const bool sameMap = !precRcp.is_null() && mapRcp->isSameAs(*gammaMapRcp);
+    int sameLocal = sameMap && rowPtr == graphRowPtr && colGid == graphColGid;
+    int sameGlobal = 0;
+    Teuchos::reduceAll(*(gammaMapRcp->getComm()), Teuchos::REDUCE_MIN, 1, &sameLocal, &sameGlobal);
+    if (sameGlobal) {
+        PrecondUtil::reuseMueLuPreconditioner(ARcp, *precRcp);
+        reuseCount++;
+    } else {
+        precRcp = PrecondUtil::createMueLuPreconditioner(ARcp);
+        buildCount++;
+    }
+    mapRcp = gammaMapRcp;
+    graphRowPtr.swap(rowPtr);
+    graphColGid.swap(colGid);
+    spdlog::debug("AMG preconditioner, {} builds, {} reuses", buildCount, reuseCount);
+}
+
+void AMGPreconditioner::getGraph(const TCMAT &A, std::vector<size_t> &rowPtr, std::vector<int> &colGid) {
+    auto colMapRcp = A.getColMap();
+    const int localSize = A.getNodeNumRows();
+    rowPtr.resize(localSize + 1);
+    rowPtr[0] = 0;
+    colGid.clear();
+    colGid.reserve(A.getNodeNumEntries());
+    for (int i = 0; i < localSize; i++) {
+        Teuchos::ArrayView<const int> cols;
+        Teuchos::ArrayView<const double> vals;
+        A.getLocalRowView(i, cols, vals);
+        for (int k = 0; k < cols.size(); k++) {
+            colGid.push_back(colMapRcp->getGlobalElement(cols[k]));
+        }
+        // the order of entries in a row is not part of the graph
+        std::sort(colGid.begin() + rowPtr[i], colGid.end());
+        rowPtr[i + 1] = colGid.size();
+    }
+}
+
+#endif
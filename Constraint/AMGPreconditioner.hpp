@@ -0,0 +1,78 @@
+/**
+ * @file AMGPreconditioner.hpp
+ * @brief Smoothed aggregation AMG for the bilateral block of the constraint problem
+ *
+ */
+#ifndef AMGPRECONDITIONER_HPP_
+#define AMGPRECONDITIONER_HPP_
+
+#include "ConstraintOperator.hpp"
+
+#include "Trilinos/Preconditioner.hpp"
+#include "Trilinos/TpetraUtil.hpp"
+
+#include <vector>
+
+#ifdef SIMTOOLBOX_MUELU
+
+/**
+ * @brief approximate inverse of the bilateral block of ConstraintOperator by MueLu
+ *
+ * The matrix \f$F (D^T M D + K^{-1}) F + (I - F)\f$ is assembled explicitly, with F the diagonal bilateral flag,
+ * so the preconditioner is identity on unilateral entries as required by BilateralSolver.
+ * The multigrid hierarchy is kept across update() calls. If the constraint map and the graph of the matrix are
+ * unchanged, only the matrix values are refreshed with the previous aggregates and tentative prolongator.
+ */
+class AMGPreconditioner : public TOP {
+  public:
+    AMGPreconditioner() = default;
+
+    ~AMGPreconditioner() = default;
+
+    /**
+     * @brief assemble the matrix of this step and rebuild or reuse the hierarchy
+     *
+     * @param AOp the constraint operator, the mobility must be a TCMAT
+     * @param biFlagRcp 1 for bilateral, 0 for unilateral
+     */
+    void update(const ConstraintOperator &AOp, const Teuchos::RCP<const TV> &biFlagRcp);
+
+    Teuchos::RCP<const TMAP> getDomainMap() const { return mapRcp; }
+    Teuchos::RCP<const TMAP> getRangeMap() const { return mapRcp; }
+
+    bool hasTransposeApply() const { return true; }
+
+    /**
+     * @brief Y := alpha Op^{-1} X + beta Y, Op is symmetric
+     *
+     */
+    void apply(const TMV &X, TMV &Y, Teuchos::ETransp mode = Teuchos::NO_TRANS,
+               scalar_type alpha = Teuchos::ScalarTraits<scalar_type>::one(),
+               scalar_type beta = Teuchos::ScalarTraits<scalar_type>::zero()) const {
+        precRcp->apply(X, Y, Teuchos::NO_TRANS, alpha, beta);
+    }
+
+    int getBuildCount() const { return buildCount; }
+    int getReuseCount() const { return reuseCount; }
+
+  private:
+    Teuchos::RCP<const TMAP> mapRcp; ///< map of the constraint vector
+    Teuchos::RCP<TAMG> precRcp;      ///< multigrid hierarchy
+    std::vector<size_t> graphRowPtr; ///< local row pointers of the matrix the hierarchy is built for
+    std::vector<int> graphColGid;    ///< global column indices of each local row, sorted, same matrix
+    int buildCount = 0;              ///< number of hierarchies built
+    int reuseCount = 0;              ///< number of updates reusing the hierarchy
+
+    /**
+     * @brief the graph of the local rows of A
+     *
+     * @param A
+     * @param rowPtr [out] row pointers
+     * @param colGid [out] global column indices, sorted in each row
+     */
+    static void getGraph(const TCMAT &A, std::vector<size_t> &rowPtr, std::vector<int> &colGid);
+};
+
+#endif
+
+#endif
@@ -1,5 +1,6 @@
 #include "BCQPSolver.hpp"
 #include "Trilinos/TpetraUtil.hpp"
+#include "Util/Trace.hpp"
 #include "spdlog/spdlog.h"
 
 #include <mpi.h>
@@ -186,6 +187,7 @@ int BCQPSolver::solveBBPGD(Teuchos::RCP<TV> &xsolRcp, const double tol, const in
 
     while (iteCount < iteMax) {
         iteCount++;
+        TraceScope trace("BCQPSolver::BBPGDIteration", "SimToolbox", iteCount);
 
         // update xk
         xkRcp->update(-alpha, *gradkm1Rcp, 1.0, *xkm1Rcp, 0.0); // xk = xkm1 - alpha*gkm1
@@ -212,12 +214,12 @@ int BCQPSolver::solveBBPGD(Teuchos::RCP<TV> &xsolRcp, const double tol, const in
         // alternating bb1 and bb2 methods
         if (iteCount % 2 == 0) {
             // Barzilai-Borwein step size Choice 1
-            a = pow(xkdiffRcp->norm2(), 2);
-            b = xkdiffRcp->dot(*gkdiffRcp);
+            a = pow(norm2(*xkdiffRcp), 2);
+            b = dot(*xkdiffRcp, *gkdiffRcp);
         } else {
             // Barzilai-Borwein step size Choice 2
-            a = xkdiffRcp->dot(*gkdiffRcp);
-            b = pow(gkdiffRcp->norm2(), 2);
+            a = dot(*xkdiffRcp, *gkdiffRcp);
+            b = pow(norm2(*gkdiffRcp), 2);
         }
 
         if (fabs(b) < 10 * std::numeric_limits<double>::epsilon()) {
@@ -278,8 +280,8 @@ int BCQPSolver::solveAPGD(Teuchos::RCP<TV> &xsolRcp, const double tol, const int
     ARcp->apply(*xkdiffRcp, *tempVecRcp);
     mvCount++;
 
-    const double tempNorm2 = tempVecRcp->norm2();
-    const double xkdiffNorm2 = xkdiffRcp->norm2();
+    const double tempNorm2 = norm2(*tempVecRcp);
+    const double xkdiffNorm2 = norm2(*xkdiffRcp);
     double Lk = (tempNorm2 / xkdiffNorm2);
     double tk = 1.0 / Lk;
 
@@ -295,6 +297,7 @@ int BCQPSolver::solveAPGD(Teuchos::RCP<TV> &xsolRcp, const double tol, const int
 
     while (iteCount < iteMax) {
         iteCount++;
+        TraceScope trace("BCQPSolver::APGDIteration", "SimToolbox", iteCount);
 
         // line 7 of Mazhar, 2015, g=A.dot(yk)+b
         ARcp->apply(*ykRcp, *AxbRcp); // Axb = A yk, this does not change in the following Lifshitz loop
@@ -304,8 +307,8 @@ int BCQPSolver::solveAPGD(Teuchos::RCP<TV> &xsolRcp, const double tol, const int
         xkp1Rcp->update(1.0, *ykRcp, -tk, *gVecRcp, 0);
         boundProjection(xkp1Rcp);
 
-        double rightTerm1 = ykRcp->dot(*AxbRcp) * 0.5; // yk.dot(A.dot(yk))*0.5
-        double rightTerm2 = ykRcp->dot(*bRcp);         // yk.dot(b)
+        double rightTerm1 = dot(*ykRcp, *AxbRcp) * 0.5; // yk.dot(A.dot(yk))*0.5
+        double rightTerm2 = dot(*ykRcp, *bRcp);          // yk.dot(b)
 
         while (1) {
             //  xkdiff=xkp1-yk
@@ -314,11 +317,11 @@ int BCQPSolver::solveAPGD(Teuchos::RCP<TV> &xsolRcp, const double tol, const int
             //  calc Lifshitz condition
             ARcp->apply(*xkp1Rcp, *Axbkp1Rcp);
             mvCount++;
-            double leftTerm1 = xkp1Rcp->dot(*Axbkp1Rcp) * 0.5; // xkp1.dot(A.dot(xkp1))*0.5
-            double leftTerm2 = xkp1Rcp->dot(*bRcp);            // xkp1.dot(b)
+            double leftTerm1 = dot(*xkp1Rcp, *Axbkp1Rcp) * 0.5; // xkp1.dot(A.dot(xkp1))*0.5
+            double leftTerm2 = dot(*xkp1Rcp, *bRcp);             // xkp1.dot(b)
 
-            double rightTerm3 = gVecRcp->dot(*xkdiffRcp);              // g.dot(xkdiff)
-            double rightTerm4 = 0.5 * Lk * pow(xkdiffRcp->norm2(), 2); // 0.5*Lk*(xkdiff).dot(xkdiff)
+            double rightTerm3 = dot(*gVecRcp, *xkdiffRcp);             // g.dot(xkdiff)
+            double rightTerm4 = 0.5 * Lk * pow(norm2(*xkdiffRcp), 2); // 0.5*Lk*(xkdiff).dot(xkdiff)
             if ((leftTerm1 + leftTerm2) <= (rightTerm1 + rightTerm2 + rightTerm3 + rightTerm4)) {
                 break;
             }
@@ -365,7 +368,7 @@ int BCQPSolver::solveAPGD(Teuchos::RCP<TV> &xsolRcp, const double tol, const int
 
         // line 25-28, Mazhar, 2015
         tempVecRcp->update(1.0, *xkp1Rcp, -1.0, *xkRcp, 0.0);
-        if (gVecRcp->dot(*tempVecRcp) > 0) {
+        if (dot(*gVecRcp, *tempVecRcp) > 0) {
             ykp1Rcp->scale(1.0, *xkp1Rcp); // ykp1=xkp1
             thetakp1 = 1;
         }
@@ -428,6 +431,24 @@ int BCQPSolver::selfTest(double tol, int maxIte, int solverChoice) {
     return 0;
 }
 
+void BCQPSolver::setFriction(const Teuchos::RCP<const TV> &muRcp) {
+    TEUCHOS_TEST_FOR_EXCEPTION(!(mapRcp->isSameAs(*(muRcp->getMap()))), std::invalid_argument,
+                               "map and mu do not have the same Map.");
+    coneRow.clear();
+    coneMu.clear();
+    auto muPtr = muRcp->getLocalView<Kokkos::HostSpace>();
+    const int ibound = muPtr.dimension_0();
+    for (int i = 0; i < ibound; i++) {
+        if (muPtr(i, 0) > 0) {
+            TEUCHOS_TEST_FOR_EXCEPTION(i + 2 >= ibound, std::invalid_argument,
+                                       "tangential rows of a friction cone are not on this rank.");
+            coneRow.push_back(i);
+            coneMu.push_back(muPtr(i, 0));
+            i += 2;
+        }
+    }
+}
+
 void BCQPSolver::boundProjection(Teuchos::RCP<TV> &vecRcp) const {
 
     auto vecPtr = vecRcp->getLocalView<Kokkos::HostSpace>(); // LeftLayout
@@ -435,6 +456,18 @@ void BCQPSolver::boundProjection(Teuchos::RCP<TV> &vecRcp) const {
     const int ibound = vecPtr.dimension_0();
     const int c = 0; // vecRcp, lbRcp, ubRcp have only 1 column
 
+    // project to friction cones, the results are inside [lb,ub] of the normal and tangential rows
+    const int nCone = coneRow.size();
+#pragma omp parallel for
+    for (int k = 0; k < nCone; k++) {
+        const int i = coneRow[k];
+        double x[3] = {vecPtr(i, c), vecPtr(i + 1, c), vecPtr(i + 2, c)};
+        coneProjection(coneMu[k], x);
+        for (int d = 0; d < 3; d++) {
+            vecPtr(i + d, c) = x[d];
+        }
+    }
+
     // project to lb
     TEUCHOS_TEST_FOR_EXCEPTION(!(vecRcp->getMap()->isSameAs(*(lbRcp->getMap()))), std::invalid_argument,
                                "vec and lb do not have the same Map.");
@@ -486,6 +519,21 @@ double BCQPSolver::checkProjectionResidual(const Teuchos::RCP<const TV> &XRcp, c
         }
     }
 
+    // natural residual of friction cones
+    const int nCone = coneRow.size();
+#pragma omp parallel for
+    for (int k = 0; k < nCone; k++) {
+        const int i = coneRow[k];
+        double x[3];
+        for (int d = 0; d < 3; d++) {
+            x[d] = xPtr(i + d, c) - yPtr(i + d, c);
+        }
+        coneProjection(coneMu[k], x);
+        for (int d = 0; d < 3; d++) {
+            qPtr(i + d, c) = xPtr(i + d, c) - x[d];
+        }
+    }
+
     if (projectionError) {
         dumpTV(XRcp, "XRcp");
         dumpTV(YRcp, "YRcp");
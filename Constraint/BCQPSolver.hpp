@@ -15,6 +15,7 @@
 #include "Trilinos/TpetraUtil.hpp"
 
 #include <array>
+#include <cmath>
 #include <deque>
 #include <vector>
 
@@ -72,6 +73,23 @@ class BCQPSolver {
       return ubRcp;
     }
 
+    /**
+     * @brief Set the Coulomb friction cones of the problem
+     *
+     * A row i with mu_i > 0 and the next two rows are (n, t1, t2) of a frictional contact, on the same rank.
+     * They are projected to the second order cone |t| <= mu n instead of [lb,ub].
+     * The tangential rows should have unbounded lb and ub.
+     * @param muRcp friction coefficient, must have compatible map to A & b
+     */
+    void setFriction(const Teuchos::RCP<const TV> &muRcp);
+
+    /**
+     * @brief use dot products and norms independent of the distribution and the number of threads
+     *
+     * @param reproducible_
+     */
+    void setReproducible(bool reproducible_) { reproducible = reproducible_; }
+
     /**
      * @brief call this before any solve() functions
      *
@@ -119,6 +137,12 @@ class BCQPSolver {
     Teuchos::RCP<TV> ubRcp;      ///< upper bound
     bool lbSet = false;
     bool ubSet = false;
+    bool reproducible = false;  ///< see setReproducible()
+    std::vector<int> coneRow;   ///< local index of the normal row of each friction cone
+    std::vector<double> coneMu; ///< friction coefficient of each friction cone
+
+    double dot(const TV &x, const TV &y) const { return reproducible ? dotReproducible(x, y) : x.dot(y); }
+    double norm2(const TV &x) const { return reproducible ? norm2Reproducible(x) : x.norm2(); }
 
     /**
      * @brief Set default bounds (infinity) if no bounds set
@@ -127,15 +151,40 @@ class BCQPSolver {
     void setDefaultBounds();
 
     /**
-     * @brief project the vector to [lb,ub]
+     * @brief project the vector to the friction cones, then to [lb,ub]
      *
      * @param vecRcp
      */
     void boundProjection(Teuchos::RCP<TV> &vecRcp) const;
 
+    /**
+     * @brief project (n, t1, t2) to the second order cone |t| <= mu n
+     *
+     * @param mu
+     * @param x [in,out] 3 values (n, t1, t2)
+     */
+    static void coneProjection(const double mu, double x[3]) {
+        const double n = x[0];
+        const double t = std::sqrt(x[1] * x[1] + x[2] * x[2]);
+        if (t <= mu * n) {
+            return; // inside the cone
+        }
+        if (mu * t <= -n) {
+            x[0] = x[1] = x[2] = 0; // inside the polar cone
+            return;
+        }
+        const double nProj = (n + mu * t) / (1 + mu * mu);
+        const double scale = mu * nProj / t;
+        x[0] = nProj;
+        x[1] *= scale;
+        x[2] *= scale;
+    }
+
     /**
      * @brief check the residual with EQ 2.2 of Dai & Fletcher 2005
      *
+     * rows of friction cones use the natural residual X - P(X - Y), with P the cone projection
+     *
      * @param XRcp X
      * @param YRcp Y=AX+b
      * @param QRcp temporary working space
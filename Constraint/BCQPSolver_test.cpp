@@ -10,12 +10,229 @@
  */
 
 #include "BCQPSolver.hpp"
+#include "ConstraintOperator.hpp"
+#include "SchwarzSolver.hpp"
 #include "Util/Logger.hpp"
 
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <random>
+#include <utility>
 #include <vector>
 
 #include <mpi.h>
 
+using RowEntries = std::vector<std::vector<std::pair<int, double>>>; ///< global column index and value of each row
+
+/**
+ * @brief min 1/2 x^T A x + b^T x with friction cones, one sticking, one sliding, and one separating contact per rank
+ *
+ * @param coupled false for A = 2I, where the solution is the projection of -b/2.
+ *                true for a random SPD local block, checked for feasibility and convergence
+ * @return true
+ * @return false
+ */
+bool testFriction(bool coupled) {
+    Teuchos::RCP<const TCOMM> commRcp = getMPIWORLDTCOMM();
+    const int nCone = 3;
+    const int localSize = 3 * nCone;
+    const double mu = 0.5;
+    Teuchos::RCP<const TMAP> mapRcp = getTMAPFromLocalSize(localSize, commRcp);
+    const int offset = mapRcp->getMinGlobalIndex();
+
+    // A = 2I + B^T B, B random for the coupled case
+    std::vector<double> dense(localSize * localSize, 0);
+    for (int i = 0; i < localSize; i++) {
+        dense[i * localSize + i] = 2;
+    }
+    if (coupled) {
+        std::mt19937 gen(commRcp->getRank());
+        std::uniform_real_distribution<double> dis(-1, 1);
+        std::vector<double> B(localSize * localSize);
+        for (auto &v : B) {
+            v = dis(gen);
+        }
+        for (int i = 0; i < localSize; i++) {
+            for (int j = 0; j < localSize; j++) {
+                for (int k = 0; k < localSize; k++) {
+                    dense[i * localSize + j] += B[k * localSize + i] * B[k * localSize + j];
+                }
+            }
+        }
+    }
+    RowEntries rows(localSize);
+    for (int i = 0; i < localSize; i++) {
+        for (int j = 0; j < localSize; j++) {
+            rows[i].emplace_back(offset + j, dense[i * localSize + j]);
+        }
+    }
+    Teuchos::RCP<const TOP> ARcp = getTCMATFromRowEntries(rows, mapRcp, mapRcp);
+
+    // (n, t1, t2) of each contact
+    const double bLocal[localSize] = {-2, 0.4, 0,  // sticking, -b/2 = (1, -0.2, 0) inside the cone
+                                      -2, 4, 0,    // sliding, -b/2 = (1, -2, 0) projected to the cone surface
+                                      2, 0.2, 0.2}; // separating, -b/2 inside the polar cone
+    const double xExact[localSize] = {1, -0.2, 0, 1.6, -0.8, 0, 0, 0, 0};
+    Teuchos::RCP<TV> bRcp = Teuchos::rcp(new TV(mapRcp, false));
+    Teuchos::RCP<TV> muRcp = Teuchos::rcp(new TV(mapRcp, true));
+    Teuchos::RCP<TV> lbRcp = Teuchos::rcp(new TV(mapRcp, false));
+    auto bPtr = bRcp->getLocalView<Kokkos::HostSpace>();
+    auto muPtr = muRcp->getLocalView<Kokkos::HostSpace>();
+    auto lbPtr = lbRcp->getLocalView<Kokkos::HostSpace>();
+    bRcp->modify<Kokkos::HostSpace>();
+    muRcp->modify<Kokkos::HostSpace>();
+    lbRcp->modify<Kokkos::HostSpace>();
+    for (int i = 0; i < localSize; i++) {
+        bPtr(i, 0) = bLocal[i];
+        muPtr(i, 0) = i % 3 == 0 ? mu : 0;
+        lbPtr(i, 0) = i % 3 == 0 ? 0 : -std::numeric_limits<double>::max() * 0.1;
+    }
+
+    BCQPSolver solver(ARcp, bRcp);
+    solver.setLowerBound(lbRcp);
+    solver.setFriction(muRcp);
+    solver.prepareSolver();
+
+    const double tol = 1e-8;
+    bool pass = true;
+    for (int choice = 0; choice < 2; choice++) {
+        IteHistory history;
+        Teuchos::RCP<TV> xsolRcp = Teuchos::rcp(new TV(mapRcp, true));
+        if (choice == 0) {
+            solver.solveBBPGD(xsolRcp, tol, 1000, history);
+        } else {
+            solver.solveAPGD(xsolRcp, tol, 1000, history);
+        }
+        bool converged = history.back()[4] < tol;
+
+        auto xPtr = xsolRcp->getLocalView<Kokkos::HostSpace>();
+        bool correct = true;
+        for (int k = 0; k < nCone; k++) {
+            const double n = xPtr(3 * k, 0);
+            const double t = std::hypot(xPtr(3 * k + 1, 0), xPtr(3 * k + 2, 0));
+            correct = correct && n >= 0 && t <= mu * n * (1 + 1e-6) + 1e-10;
+        }
+        if (!coupled) {
+            for (int i = 0; i < localSize; i++) {
+                correct = correct && fabs(xPtr(i, 0) - xExact[i]) < 1e-6;
+            }
+            // the sliding contact is on the cone surface
+            correct = correct && fabs(std::hypot(xPtr(4, 0), xPtr(5, 0)) - mu * xPtr(3, 0)) < 1e-6;
+        }
+
+        int passLocal = converged && correct, passGlobal = 0;
+        MPI_Allreduce(&passLocal, &passGlobal, 1, MPI_INT, MPI_MIN, MPI_COMM_WORLD);
+        spdlog::info("friction cone, coupled {}, solver {}, residual {}, iterations {}, pass {}", coupled, choice,
+                     history.back()[4], history.back()[0], passGlobal);
+        pass = pass && passGlobal;
+    }
+    return pass;
+}
+
+/**
+ * @brief the Schwarz solver converges to the BBPGD solution
+ *
+ * Random objects with block diagonal mobility, and constraints between a local object and a random object on any
+ * rank. Every 4th constraint is bilateral with a finite stiffness.
+ * @param coarse setCoarseCorrection()
+ * @return true
+ * @return false
+ */
+bool testSchwarz(bool coarse) {
+    Teuchos::RCP<const TCOMM> commRcp = getMPIWORLDTCOMM();
+    const int nObjLocal = 8;
+    const int nConLocal = 12;
+    const int nObjGlobal = nObjLocal * commRcp->getSize();
+    Teuchos::RCP<const TMAP> mobMapRcp = getTMAPFromLocalSize(6 * nObjLocal, commRcp);
+    Teuchos::RCP<const TMAP> gammaMapRcp = getTMAPFromLocalSize(nConLocal, commRcp);
+    const int mobOffset = mobMapRcp->getMinGlobalIndex();
+
+    std::mt19937 gen(commRcp->getRank());
+    std::uniform_real_distribution<double> dis(-1, 1);
+    std::uniform_int_distribution<int> objDis(0, nObjGlobal - 1);
+
+    // mobility, a random SPD 6x6 block per object
+    RowEntries mobRows(6 * nObjLocal);
+    for (int obj = 0; obj < nObjLocal; obj++) {
+        double B[36];
+        for (auto &v : B) {
+            v = dis(gen);
+        }
+        for (int a = 0; a < 6; a++) {
+            for (int b = 0; b < 6; b++) {
+                double value = a == b ? 1 : 0;
+                for (int k = 0; k < 6; k++) {
+                    value += 0.2 * B[6 * k + a] * B[6 * k + b];
+                }
+                mobRows[6 * obj + a].emplace_back(mobOffset + 6 * obj + b, value);
+            }
+        }
+    }
+    Teuchos::RCP<TOP> mobOpRcp = getTCMATFromRowEntries(mobRows, mobMapRcp, mobMapRcp);
+
+    // D^T, 6 entries for each of the two objects
+    RowEntries DTRows(nConLocal);
+    for (int i = 0; i < nConLocal; i++) {
+        const int objI = mobOffset / 6 + i % nObjLocal;
+        int objJ = objDis(gen);
+        while (objJ == objI) {
+            objJ = objDis(gen);
+        }
+        for (int d = 0; d < 6; d++) {
+            const double value = dis(gen);
+            DTRows[i].emplace_back(6 * objI + d, value);
+            DTRows[i].emplace_back(6 * objJ + d, -value);
+        }
+    }
+    Teuchos::RCP<TCMAT> DTRcp = getTCMATFromRowEntries(DTRows, gammaMapRcp, mobMapRcp);
+
+    Teuchos::RCP<TV> invKappaRcp = Teuchos::rcp(new TV(gammaMapRcp, true));
+    Teuchos::RCP<TV> lbRcp = Teuchos::rcp(new TV(gammaMapRcp, false));
+    Teuchos::RCP<TV> qRcp = Teuchos::rcp(new TV(gammaMapRcp, false));
+    auto invKappaPtr = invKappaRcp->getLocalView<Kokkos::HostSpace>();
+    auto lbPtr = lbRcp->getLocalView<Kokkos::HostSpace>();
+    auto qPtr = qRcp->getLocalView<Kokkos::HostSpace>();
+    invKappaRcp->modify<Kokkos::HostSpace>();
+    lbRcp->modify<Kokkos::HostSpace>();
+    qRcp->modify<Kokkos::HostSpace>();
+    for (int i = 0; i < nConLocal; i++) {
+        const bool bilateral = i % 4 == 3;
+        invKappaPtr(i, 0) = bilateral ? 1.0 : 0;
+        lbPtr(i, 0) = bilateral ? -std::numeric_limits<double>::max() * 0.1 : 0;
+        qPtr(i, 0) = dis(gen);
+    }
+
+    Teuchos::RCP<const ConstraintOperator> AOpRcp =
+        Teuchos::rcp(new ConstraintOperator(mobOpRcp, DTRcp, invKappaRcp));
+
+    // reference
+    const double tol = 1e-8;
+    const int iteMax = 10000;
+    BCQPSolver bbpgd(AOpRcp, qRcp);
+    bbpgd.setLowerBound(lbRcp);
+    bbpgd.prepareSolver();
+    IteHistory bbHistory;
+    Teuchos::RCP<TV> xRefRcp = Teuchos::rcp(new TV(gammaMapRcp, true));
+    bbpgd.solveBBPGD(xRefRcp, tol, iteMax, bbHistory);
+
+    SchwarzSolver schwarz(AOpRcp, qRcp, lbRcp);
+    schwarz.setCoarseCorrection(coarse);
+    IteHistory history;
+    Teuchos::RCP<TV> xsolRcp = Teuchos::rcp(new TV(gammaMapRcp, true));
+    schwarz.solve(xsolRcp, tol, iteMax, history);
+
+    Teuchos::RCP<TV> errorRcp = Teuchos::rcp(new TV(*xsolRcp, Teuchos::Copy));
+    errorRcp->update(-1.0, *xRefRcp, 1.0);
+    const double error = errorRcp->normInf();
+    const double scale = 1 + xRefRcp->normInf();
+    const bool pass = bbHistory.back()[4] < tol && history.back()[4] < tol && error < 1e-5 * scale;
+    spdlog::info("Schwarz, {} ranks, coarse {}, outer iterations {}, residual {}, error {}, BBPGD iterations {}, "
+                 "pass {}",
+                 commRcp->getSize(), coarse, history.back()[0], history.back()[4], error, bbHistory.back()[0], pass);
+    return pass;
+}
+
 int main(int argc, char **argv) {
     MPI_Init(&argc, &argv);
     int nprocs = 0;
@@ -32,7 +249,10 @@ int main(int argc, char **argv) {
 
         test.selfTest(tol, maxIte, 0); // BBPGD
         test.selfTest(tol, maxIte, 1); // APGD
+
+        const bool pass = testFriction(false) && testFriction(true) && testSchwarz(true) && testSchwarz(false);
+        spdlog::info(pass ? "TestPassed" : "Error in friction cone or Schwarz test");
     }
     MPI_Finalize();
     return 0;
-}
\ No newline at end of file
+}
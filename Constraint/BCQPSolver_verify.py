@@ -17,11 +17,26 @@ if len(sys.argv) > 2:
 if len(sys.argv) > 3:
     maxIte = sys.argv[3]
 
+# friction cone and Schwarz tests of BCQPSolver_test, on 1 and 4 ranks
+for nprocs in [1, 4]:
+    logName = './testLog'+str(nprocs)
+    os.system('mpirun -n '+str(nprocs)+' ./BCQPSolver_test 50 > '+logName)
+    with open(logName) as log:
+        if 'TestPassed' not in log.read():
+            print('Error in BCQPSolver_test on '+str(nprocs)+' ranks')
+            sys.exit(1)
+
 print('mpirun -n 2 --map-by numa ./BCQPSolver_test ' +
       str(localSize)+' '+str(diagAdd)+' > ./testLog')
 os.system('mpirun -n 2 --map-by numa ./BCQPSolver_test ' +
           str(localSize)+' '+str(diagAdd)+' > ./testLog')
 
+# friction cone and Schwarz tests of BCQPSolver_test, on 2 ranks
+with open('./testLog') as log:
+    testLog = log.read()
+if 'TestPassed' not in testLog:
+    print('Error in BCQPSolver_test')
+    sys.exit(1)
 
 Amat = sio.mmread('Amat_TCMAT.mtx')
 bvec = sio.mmread('bvec_TV.mtx').flatten()
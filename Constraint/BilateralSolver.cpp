@@ -0,0 +1,178 @@
+#include "BilateralSolver.hpp"
+
+#include "Util/Logger.hpp"
+#include "Util/Trace.hpp"
+
+/**
+ * @brief the operator restricted to the bilateral block, identity for unilateral entries
+ *   Y = F .* (A (F .* X)) + (1-F) .* X
+ */
+class BilateralOperator : public TOP {
+  private:
+    Teuchos::RCP<const TOP> AopRcp;
+    Teuchos::RCP<const TV> maskRcp;
+
+  public:
+    BilateralOperator(const Teuchos::RCP<const TOP> &AopRcp_, const Teuchos::RCP<const TV> &maskRcp_)
+        : AopRcp(AopRcp_), maskRcp(maskRcp_) {}
+
+    ~BilateralOperator() = default;
+
+    Teuchos::RCP<const TMAP> getDomainMap() const { return AopRcp->getDomainMap(); }
+    Teuchos::RCP<const TMAP> getRangeMap() const { return AopRcp->getRangeMap(); }
+
+    bool hasTransposeApply() const { return false; }
+
+    // Compute Y := alpha Op X + beta Y.
+    void apply(const TMV &X, TMV &Y, Teuchos::ETransp mode = Teuchos::NO_TRANS,
+               scalar_type alpha = Teuchos::ScalarTraits<scalar_type>::one(),
+               scalar_type beta = Teuchos::ScalarTraits<scalar_type>::zero()) const {
+        TEUCHOS_TEST_FOR_EXCEPTION(X.getNumVectors() != Y.getNumVectors(), std::invalid_argument,
+                                   "X and Y do not have the same numbers of vectors (columns).");
+        TMV maskedX(X.getMap(), X.getNumVectors(), false);
+        maskedX.elementWiseMultiply(1.0, *maskRcp, X, 0.0);
+        TMV AX(Y.getMap(), Y.getNumVectors(), false);
+        AopRcp->apply(maskedX, AX);
+
+        auto xView = X.getLocalView<Kokkos::HostSpace>();
+        auto yView = Y.getLocalView<Kokkos::HostSpace>();
+        auto axView = AX.getLocalView<Kokkos::HostSpace>();
+        auto maskView = maskRcp->getLocalView<Kokkos::HostSpace>();
+        Y.modify<Kokkos::HostSpace>();
+        for (int c = 0; c < xView.dimension_1(); c++) {
+#pragma omp parallel for
+            for (int i = 0; i < xView.dimension_0(); i++) {
+                const double opX = maskView(i, 0) > 0.5 ? axView(i, c) : xView(i, c);
+                yView(i, c) = alpha * opX + (beta == 0 ? 0 : beta * yView(i, c));
+            }
+        }
+    }
+};
+
+/**
+ * @brief Jacobi preconditioner Y = X ./ diag for bilateral entries, Y = X for unilateral entries
+ *
+ */
+class BilateralJacobiOperator : public TOP {
+  private:
+    Teuchos::RCP<TV> invDiagRcp;
+
+  public:
+    BilateralJacobiOperator(const Teuchos::RCP<const TV> &diagRcp, const Teuchos::RCP<const TV> &maskRcp) {
+        invDiagRcp = Teuchos::rcp(new TV(diagRcp->getMap(), false));
+        auto invView = invDiagRcp->getLocalView<Kokkos::HostSpace>();
+        auto diagView = diagRcp->getLocalView<Kokkos::HostSpace>();
+        auto maskView = maskRcp->getLocalView<Kokkos::HostSpace>();
+        invDiagRcp->modify<Kokkos::HostSpace>();
+        const int localSize = invView.dimension_0();
+#pragma omp parallel for
+        for (int i = 0; i < localSize; i++) {
+            const bool valid = maskView(i, 0) > 0.5 && diagView(i, 0) > 0;
+            invView(i, 0) = valid ? 1.0 / diagView(i, 0) : 1.0;
+        }
+    }
+
+    ~BilateralJacobiOperator() = default;
+
+    Teuchos::RCP<const TMAP> getDomainMap() const { return invDiagRcp->getMap(); }
+    Teuchos::RCP<const TMAP> getRangeMap() const { return invDiagRcp->getMap(); }
+
+    bool hasTransposeApply() const { return true; }
+
+    void apply(const TMV &X, TMV &Y, Teuchos::ETransp mode = Teuchos::NO_TRANS,
+               scalar_type alpha = Teuchos::ScalarTraits<scalar_type>::one(),
+               scalar_type beta = Teuchos::ScalarTraits<scalar_type>::zero()) const {
+        Y.elementWiseMultiply(alpha, *invDiagRcp, X, beta);
+    }
+};
+
+BilateralSolver::BilateralSolver(const Teuchos::RCP<const TOP> &ARcp_, const Teuchos::RCP<const TV> &bRcp_,
+                                 const Teuchos::RCP<const TV> &biFlagRcp_, const Teuchos::RCP<const TV> &diagRcp_)
+    : ARcp(ARcp_), bRcp(bRcp_), biFlagRcp(biFlagRcp_), diagRcp(diagRcp_) {
+    mapRcp = ARcp->getDomainMap();
+    commRcp = mapRcp->getComm();
+    TEUCHOS_TEST_FOR_EXCEPTION(!mapRcp->isSameAs(*(bRcp->getMap())), std::invalid_argument,
+                               "A and b do not have the same Map.");
+    TEUCHOS_TEST_FOR_EXCEPTION(!mapRcp->isSameAs(*(biFlagRcp->getMap())), std::invalid_argument,
+                               "A and biFlag do not have the same Map.");
+}
+
+int BilateralSolver::solveCG(Teuchos::RCP<TV> &xsolRcp, const double tol, const int iteMax,
+                             IteHistory &history) const {
+    TEUCHOS_TEST_FOR_EXCEPTION(!mapRcp->isSameAs(*(xsolRcp->getMap())), std::invalid_argument,
+                               "xsolrcp and A operator do not have the same Map.");
+    TraceScope trace("BilateralSolver::SolveCG");
+
+    // rhs = F .* (-b - A (1-F) .* x) + (1-F) .* x
+    Teuchos::RCP<TV> uniFlagRcp = Teuchos::rcp(new TV(mapRcp, false));
+    uniFlagRcp->putScalar(1.0);
+    uniFlagRcp->update(-1.0, *biFlagRcp, 1.0);
+    Teuchos::RCP<TV> xuRcp = Teuchos::rcp(new TV(mapRcp, false));
+    xuRcp->elementWiseMultiply(1.0, *uniFlagRcp, *xsolRcp, 0.0);
+    Teuchos::RCP<TV> AxuRcp = Teuchos::rcp(new TV(mapRcp, false));
+    ARcp->apply(*xuRcp, *AxuRcp);
+    AxuRcp->update(-1.0, *bRcp, -1.0);
+    Teuchos::RCP<TV> rhsRcp = Teuchos::rcp(new TV(*xuRcp, Teuchos::Copy));
+    rhsRcp->elementWiseMultiply(1.0, *biFlagRcp, *AxuRcp, 1.0);
+    int mvCount = 1;
+
+    Teuchos::RCP<TOP> biOpRcp = Teuchos::rcp(new BilateralOperator(ARcp, biFlagRcp));
+    Teuchos::RCP<const TOP> precRcp = precOpRcp;
+    if (precRcp.is_null()) {
+        precRcp = Teuchos::rcp(new BilateralJacobiOperator(diagRcp, biFlagRcp));
+    }
+
+    // Belos uses a relative 2-norm residual, scaled by the 2-norm of rhs so that it bounds the max-norm by tol
+    const double rhsNorm = rhsRcp->norm2();
+    if (rhsNorm == 0) {
+        xsolRcp->putScalar(0.0);
+        history.push_back(std::array<double, 6>{{0, 0, 0, 0, 0, 1.0 * mvCount}});
+        return 0;
+    }
+
+    // the bilateral entries of previous solutions span a good initial guess if the constraints change slowly
+    const int recycleSize = recyclePtr ? recyclePtr->getSize() : 0;
+    if (recycleSize > 0) {
+        Teuchos::TimeMonitor mon(*Teuchos::TimeMonitor::getNewCounter("BilateralSolver::Recycle"));
+        mvCount += recyclePtr->project(*biOpRcp, *rhsRcp, *xsolRcp);
+    }
+
+    Belos::SolverFactory<TOP::scalar_type, TMV, TOP> factory;
+    Teuchos::RCP<Teuchos::ParameterList> solverParams = Teuchos::parameterList();
+    solverParams->set("Maximum Iterations", iteMax);
+    solverParams->set("Convergence Tolerance", tol / rhsNorm);
+    solverParams->set("Timer Label", "BilateralSolver");
+    solverParams->set("Verbosity", Belos::Errors + Belos::Warnings);
+    // the default scaling by the initial residual would depend on the initial guess,
+    // and cancel the gain of a projected initial guess
+    solverParams->set("Implicit Residual Scaling", "Norm of RHS");
+    solverParams->set("Explicit Residual Scaling", "Norm of RHS");
+    auto solverRCP = factory.create("CG", solverParams);
+    auto problemRCP = Teuchos::rcp(new Belos::LinearProblem<TOP::scalar_type, TMV, TOP>(biOpRcp, xsolRcp, rhsRcp));
+    problemRCP->setLeftPrec(precRcp);
+    problemRCP->setProblem();
+    solverRCP->setProblem(problemRCP);
+    Belos::ReturnType result = solverRCP->solve();
+    const int iteCount = solverRCP->getNumIters();
+    mvCount += iteCount + 1;
+
+    // true residual of bilateral rows, r = F .* (A x + b)
+    Teuchos::RCP<TV> resRcp = Teuchos::rcp(new TV(mapRcp, false));
+    ARcp->apply(*xsolRcp, *resRcp);
+    mvCount++;
+    resRcp->update(1.0, *bRcp, 1.0);
+    resRcp->elementWiseMultiply(1.0, *biFlagRcp, *resRcp, 0.0);
+    const double res = resRcp->normInf();
+    history.push_back(std::array<double, 6>{{1.0 * iteCount, 0, 0, 0, res, 1.0 * mvCount}});
+
+    if (recyclePtr) {
+        recyclePtr->add(*xsolRcp, biFlagRcp);
+        spdlog::info("RECORD: Bilateral CG recycle space {} iterations {}", recycleSize, iteCount);
+    }
+
+    if (result != Belos::Converged) {
+        spdlog::warn("BilateralSolver CG not converged, residual {:g}", res);
+        return 1;
+    }
+    return 0;
+}
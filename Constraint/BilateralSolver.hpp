@@ -0,0 +1,88 @@
+/**
+ * @file BilateralSolver.hpp
+ * @brief Preconditioned CG solver for the bilateral block of the constraint problem
+ *
+ */
+#ifndef BILATERALSOLVER_HPP_
+#define BILATERALSOLVER_HPP_
+
+#include "BCQPSolver.hpp"
+#include "RecycleSpace.hpp"
+
+#include "Trilinos/TpetraUtil.hpp"
+
+#include <memory>
+
+/**
+ * @brief solve the bilateral rows of \f$Ax+b=0\f$ with unilateral entries of \f$x\f$ held fixed
+ *
+ * Bilateral constraints have no bound, so the BCQP restricted to them is an SPD linear system:
+ *   \f$A_{bb} x_b = -b_b - A_{bu} x_u\f$
+ * This is solved with Belos CG, with a Jacobi preconditioner from the diagonal of \f$A\f$ unless
+ * another preconditioner is set.
+ * If all constraints are bilateral this is the exact solution of the BCQP problem.
+ */
+class BilateralSolver {
+  public:
+    /**
+     * @brief Construct a new BilateralSolver object
+     *
+     * @param ARcp_ the SPD operator \f$A\f$
+     * @param bRcp_ the vector \f$b\f$
+     * @param biFlagRcp_ 1 for bilateral, 0 for unilateral
+     * @param diagRcp_ diagonal of \f$A\f$
+     */
+    BilateralSolver(const Teuchos::RCP<const TOP> &ARcp_, const Teuchos::RCP<const TV> &bRcp_,
+                    const Teuchos::RCP<const TV> &biFlagRcp_, const Teuchos::RCP<const TV> &diagRcp_);
+
+    /**
+     * @brief replace the default Jacobi preconditioner
+     *
+     * @param precOpRcp_ approximate inverse of \f$A\f$ on bilateral entries, identity on unilateral entries
+     */
+    void setPreconditioner(const Teuchos::RCP<const TOP> &precOpRcp_) { precOpRcp = precOpRcp_; }
+
+    /**
+     * @brief project the initial guess onto a space of previous solutions, and add the solution to it
+     *
+     * @param recyclePtr_ rows already set to the map of \f$A\f$
+     */
+    void setRecycleSpace(const std::shared_ptr<RecycleSpace> &recyclePtr_) { recyclePtr = recyclePtr_; }
+
+    /**
+     * @brief preconditioned CG
+     *
+     * @param xsolRcp initial guess and result. unilateral entries are not modified
+     * @param tol residual tolerance, of the 2-norm and thus the max-norm of the bilateral residual
+     * @param iteMax max iteration number
+     * @param history iteration history, in the same format as BCQPSolver
+     * @return int return error code. 0 for normal execution.
+     */
+    int solveCG(Teuchos::RCP<TV> &xsolRcp, const double tol, const int iteMax, IteHistory &history) const;
+
+    /**
+     * @brief if there is at least one constraint and all constraints are bilateral, collective
+     *
+     * Then solveCG() gives the exact solution of the BCQP problem
+     * @param biFlag 1 for bilateral, 0 for unilateral
+     * @return true
+     * @return false
+     */
+    static bool isBilateralOnly(const TV &biFlag) {
+        const double nBiGlobal = biFlag.norm1();
+        const double nConGlobal = biFlag.getGlobalLength();
+        return nConGlobal > 0 && nBiGlobal == nConGlobal;
+    }
+
+  private:
+    Teuchos::RCP<const TOP> ARcp;      ///< linear operator \f$A\f$
+    Teuchos::RCP<const TV> bRcp;       ///< vector \f$b\f$
+    Teuchos::RCP<const TV> biFlagRcp;  ///< bilateral flag
+    Teuchos::RCP<const TV> diagRcp;    ///< diagonal of \f$A\f$
+    Teuchos::RCP<const TOP> precOpRcp; ///< preconditioner, Jacobi if null
+    Teuchos::RCP<const TMAP> mapRcp;   ///< map for the distribution of xsolRcp, bRcp, and ARcp->rowMap
+    Teuchos::RCP<const TCOMM> commRcp; ///< Teuchos::MpiComm
+    std::shared_ptr<RecycleSpace> recyclePtr; ///< previous solutions, not used if null
+};
+
+#endif
@@ -0,0 +1,293 @@
+/**
+ * @file BilateralSolver_test.cpp
+ * @brief test of the bilateral CG solver on a chain of springs
+ *
+ */
+
+#include "AMGPreconditioner.hpp"
+#include "BCQPSolver.hpp"
+#include "BilateralSolver.hpp"
+#include "ConstraintCollector.hpp"
+#include "ConstraintOperator.hpp"
+#include "RecycleSpace.hpp"
+#include "Util/Logger.hpp"
+
+#include <cmath>
+#include <limits>
+#include <memory>
+#include <random>
+#include <utility>
+#include <vector>
+
+#include <mpi.h>
+
+/**
+ * @brief a chain of spheres connected by springs, spanning all ranks
+ *
+ * Each rank has nObjLocal spheres, and the link from each sphere to the next one in the global chain.
+ * Link directions, mobilities and q depend on the global index only.
+ * swapLinks swaps local rows 1 and 2 on each rank, the same number of nonzeros in a different graph.
+ */
+struct ChainProblem {
+    Teuchos::RCP<ConstraintOperator> AOpRcp;
+    Teuchos::RCP<TV> qRcp;
+    Teuchos::RCP<TV> biFlagRcp;
+
+    ChainProblem(const int nObjLocal, const double invKappa, const bool swapLinks = false) {
+        Teuchos::RCP<const TCOMM> commRcp = getMPIWORLDTCOMM();
+        const bool last = commRcp->getRank() == commRcp->getSize() - 1;
+        const int nLinkLocal = last ? nObjLocal - 1 : nObjLocal;
+        Teuchos::RCP<const TMAP> mobMapRcp = getTMAPFromLocalSize(6 * nObjLocal, commRcp);
+        Teuchos::RCP<const TMAP> gammaMapRcp = getTMAPFromLocalSize(nLinkLocal, commRcp);
+        const int objOffset = mobMapRcp->getMinGlobalIndex() / 6;
+
+        // diagonal mobility, translation and rotation
+        std::vector<std::vector<std::pair<int, double>>> mobRows(6 * nObjLocal);
+        for (int i = 0; i < nObjLocal; i++) {
+            const int g = objOffset + i;
+            for (int d = 0; d < 6; d++) {
+                mobRows[6 * i + d].emplace_back(6 * g + d, d < 3 ? 1.0 + 0.5 * (g % 3) : 0.5);
+            }
+        }
+        Teuchos::RCP<TOP> mobOpRcp = getTCMATFromRowEntries(mobRows, mobMapRcp, mobMapRcp);
+
+        // link k between sphere k and k+1 along a perturbed x direction, with a lever arm
+        std::vector<std::vector<std::pair<int, double>>> DTRows(nLinkLocal);
+        qRcp = Teuchos::rcp(new TV(gammaMapRcp, false));
+        auto qPtr = qRcp->getLocalView<Kokkos::HostSpace>();
+        qRcp->modify<Kokkos::HostSpace>();
+        for (int k = 0; k < nLinkLocal; k++) {
+            const int g = objOffset + (swapLinks && (k == 1 || k == 2) ? 3 - k : k);
+            std::mt19937 gen(g);
+            std::uniform_real_distribution<double> dis(-1, 1);
+            double u[3] = {1, 0.3 * dis(gen), 0.3 * dis(gen)};
+            const double norm = std::sqrt(u[0] * u[0] + u[1] * u[1] + u[2] * u[2]);
+            for (auto &v : u) {
+                v /= norm;
+            }
+            // torque of a unit force u at the lever arm (0, 0.5, 0)
+            const double torque[3] = {0.5 * u[2], 0, -0.5 * u[0]};
+            for (int d = 0; d < 3; d++) {
+                DTRows[k].emplace_back(6 * g + d, u[d]);
+                DTRows[k].emplace_back(6 * g + 3 + d, torque[d]);
+                DTRows[k].emplace_back(6 * (g + 1) + d, -u[d]);
+            }
+            qPtr(k, 0) = dis(gen);
+        }
+        Teuchos::RCP<TCMAT> DTRcp = getTCMATFromRowEntries(DTRows, gammaMapRcp, mobMapRcp);
+
+        Teuchos::RCP<TV> invKappaRcp = Teuchos::rcp(new TV(gammaMapRcp, false));
+        invKappaRcp->putScalar(invKappa);
+        biFlagRcp = Teuchos::rcp(new TV(gammaMapRcp, false));
+        biFlagRcp->putScalar(1.0);
+        AOpRcp = Teuchos::rcp(new ConstraintOperator(mobOpRcp, DTRcp, invKappaRcp));
+    }
+};
+
+/**
+ * @brief max-norm of the residual Ax+b
+ *
+ */
+double getResidual(const TOP &A, const TV &x, const TV &b) {
+    TV res(b, Teuchos::Copy);
+    A.apply(x, res, Teuchos::NO_TRANS, 1.0, 1.0);
+    return res.normInf();
+}
+
+/**
+ * @brief CG solution of the chain agrees with BBPGD, and the residual is below tol
+ *
+ */
+bool testChainCG() {
+    ChainProblem chain(20, 0.1);
+    const double tol = 1e-9;
+    const int iteMax = 10000;
+    auto mapRcp = chain.qRcp->getMap();
+
+    Teuchos::RCP<TV> diagRcp;
+    chain.AOpRcp->getDiagonal(diagRcp);
+    BilateralSolver biSolver(chain.AOpRcp, chain.qRcp, chain.biFlagRcp, diagRcp);
+    IteHistory cgHistory;
+    Teuchos::RCP<TV> xCGRcp = Teuchos::rcp(new TV(mapRcp, true));
+    const int cgError = biSolver.solveCG(xCGRcp, tol, iteMax, cgHistory);
+
+    // all constraints are bilateral and unbound
+    BCQPSolver bcqp(chain.AOpRcp, chain.qRcp);
+    Teuchos::RCP<TV> lbRcp = bcqp.getLowerBound();
+    lbRcp->scale(-std::numeric_limits<double>::max() * .1, *chain.biFlagRcp);
+    IteHistory bbHistory;
+    Teuchos::RCP<TV> xBBRcp = Teuchos::rcp(new TV(mapRcp, true));
+    bcqp.solveBBPGD(xBBRcp, tol, iteMax, bbHistory);
+
+    const double resCG = getResidual(*chain.AOpRcp, *xCGRcp, *chain.qRcp);
+    Teuchos::RCP<TV> errorRcp = Teuchos::rcp(new TV(*xCGRcp, Teuchos::Copy));
+    errorRcp->update(-1.0, *xBBRcp, 1.0);
+    const double error = errorRcp->normInf() / (1 + xBBRcp->normInf());
+    spdlog::info("chain CG iterations {}, residual {}, BBPGD iterations {}, residual {}, relative difference {}",
+                 cgHistory.back()[0], resCG, bbHistory.back()[0], bbHistory.back()[4], error);
+    return cgError == 0 && resCG < tol && bbHistory.back()[4] < tol && error < 1e-6;
+}
+
+/**
+ * @brief CG is exact only if all constraints are bilateral
+ *
+ */
+bool testBilateralOnly() {
+    ChainProblem chain(5, 0.1);
+    bool pass = BilateralSolver::isBilateralOnly(*chain.biFlagRcp);
+
+    // one unilateral constraint on rank 0
+    Teuchos::RCP<TV> mixFlagRcp = Teuchos::rcp(new TV(*chain.biFlagRcp, Teuchos::Copy));
+    auto flagPtr = mixFlagRcp->getLocalView<Kokkos::HostSpace>();
+    mixFlagRcp->modify<Kokkos::HostSpace>();
+    if (mixFlagRcp->getMap()->getComm()->getRank() == 0) {
+        flagPtr(0, 0) = 0;
+    }
+    pass = pass && !BilateralSolver::isBilateralOnly(*mixFlagRcp);
+
+    // no constraint
+    Teuchos::RCP<const TCOMM> commRcp = getMPIWORLDTCOMM();
+    TV emptyFlag(getTMAPFromLocalSize(0, commRcp), true);
+    pass = pass && !BilateralSolver::isBilateralOnly(emptyFlag);
+    return pass;
+}
+
+/**
+ * @brief the second solve of the same problem with a recycle space converges in at most 1 iteration
+ *
+ */
+bool testRecycle() {
+    ChainProblem chain(20, 0.1);
+    auto mapRcp = chain.qRcp->getMap();
+    const int nLocal = mapRcp->getNodeNumElements();
+    const int offset = mapRcp->getMinGlobalIndex(); // link k connects sphere k and k+1
+    std::vector<RecycleSpace::RowKey> rowKey(nLocal);
+    for (int i = 0; i < nLocal; i++) {
+        rowKey[i] = RecycleSpace::RowKey{{offset + i, offset + i + 1, 0}};
+    }
+
+    Teuchos::RCP<TV> diagRcp;
+    chain.AOpRcp->getDiagonal(diagRcp);
+    BilateralSolver biSolver(chain.AOpRcp, chain.qRcp, chain.biFlagRcp, diagRcp);
+    auto recyclePtr = std::make_shared<RecycleSpace>(4);
+    biSolver.setRecycleSpace(recyclePtr);
+
+    const double tol = 1e-8;
+    int iteCount[2] = {0, 0};
+    for (int step = 0; step < 2; step++) {
+        recyclePtr->setRows(rowKey, mapRcp);
+        IteHistory history;
+        Teuchos::RCP<TV> xsolRcp = Teuchos::rcp(new TV(mapRcp, true));
+        biSolver.solveCG(xsolRcp, tol, 1000, history);
+        iteCount[step] = history.back()[0];
+    }
+    spdlog::info("recycle CG iterations {} and {}", iteCount[0], iteCount[1]);
+    return iteCount[0] > 1 && iteCount[1] <= 1 && recyclePtr->getSize() == 2;
+}
+
+/**
+ * @brief keys of bilateral rows do not depend on the order of queues and rows
+ *
+ */
+bool testRowKey() {
+    const double zero[3] = {0, 0, 0};
+    const double posA[3] = {0.5, 0, 0};
+    const double posB[3] = {0, 0.5, 0};
+    const double negA[3] = {-0.5, 0, 0};
+    const double negB[3] = {0, -0.5, 0};
+    // two links between sphere 1 and 2 recorded from different sides, a contact, and a link between 3 and 4
+    const ConstraintBlock linkA(0, 0, 1, 2, 1, 2, zero, zero, posA, negA, zero, zero, false, true, 1, 0);
+    const ConstraintBlock linkB(0, 0, 2, 1, 2, 1, zero, zero, posB, negB, zero, zero, false, true, 1, 0);
+    const ConstraintBlock contact(0, 0, 1, 2, 1, 2, zero, zero, posA, negA, zero, zero, false, false, 0, 0);
+    const ConstraintBlock linkC(0, 0, 3, 4, 3, 4, zero, zero, posA, negA, zero, zero, false, true, 1, 0);
+
+    ConstraintCollector collector;
+    auto &pool = *collector.constraintPoolPtr;
+    pool.resize(2);
+    for (auto &que : pool) {
+        que.clear();
+    }
+    pool[0].push_back(linkA);
+    pool[0].push_back(linkB);
+    pool[0].push_back(contact);
+    pool[1].push_back(linkC);
+    std::vector<RecycleSpace::RowKey> key1;
+    collector.buildRowKey(key1);
+
+    for (auto &que : pool) {
+        que.clear();
+    }
+    pool[0].push_back(linkC);
+    pool[0].push_back(contact);
+    pool[1].push_back(linkB);
+    pool[1].push_back(linkA);
+    std::vector<RecycleSpace::RowKey> key2;
+    collector.buildRowKey(key2);
+
+    // linkB is at (0,-0.5,0) on sphere 1, before linkA at (0.5,0,0)
+    using Key = RecycleSpace::RowKey;
+    return key1.size() == 4 && key2.size() == 4 &&                       //
+           key1[0] == Key{{1, 2, 1}} && key1[1] == Key{{1, 2, 0}} &&      //
+           key1[2] == Key{{1, 2, -1}} && key1[3] == Key{{3, 4, 0}} &&     //
+           key2[0] == key1[3] && key2[1] == key1[2] && key2[2] == key1[1] && key2[3] == key1[0];
+}
+
+#ifdef SIMTOOLBOX_MUELU
+/**
+ * @brief CG iterations of stiff chains grow with the length with Jacobi, but not with AMG,
+ * and the AMG hierarchy is reused only for the same graph
+ *
+ */
+bool testAMG() {
+    const double tol = 1e-8;
+    const int iteMax = 10000;
+    const int nLength = 3;
+    const int length[nLength] = {16, 64, 256};
+    int iteJacobi[nLength], iteAMG[nLength];
+    for (int l = 0; l < nLength; l++) {
+        ChainProblem chain(length[l], 1e-4);
+        auto mapRcp = chain.qRcp->getMap();
+        Teuchos::RCP<TV> diagRcp;
+        chain.AOpRcp->getDiagonal(diagRcp);
+        for (int amg = 0; amg < 2; amg++) {
+            BilateralSolver biSolver(chain.AOpRcp, chain.qRcp, chain.biFlagRcp, diagRcp);
+            if (amg) {
+                Teuchos::RCP<AMGPreconditioner> precRcp = Teuchos::rcp(new AMGPreconditioner());
+                precRcp->update(*chain.AOpRcp, chain.biFlagRcp);
+                biSolver.setPreconditioner(precRcp);
+            }
+            IteHistory history;
+            Teuchos::RCP<TV> xsolRcp = Teuchos::rcp(new TV(mapRcp, true));
+            biSolver.solveCG(xsolRcp, tol, iteMax, history);
+            (amg ? iteAMG : iteJacobi)[l] = history.back()[0];
+        }
+        spdlog::info("chain length {} per rank, CG iterations Jacobi {}, AMG {}", length[l], iteJacobi[l], iteAMG[l]);
+    }
+    bool pass = iteAMG[nLength - 1] < iteJacobi[nLength - 1] && iteAMG[nLength - 1] <= 2 * iteAMG[0] &&
+                iteJacobi[nLength - 1] > 4 * iteJacobi[0];
+
+    // new values with the same graph reuse the hierarchy, a different graph with the same nnz rebuilds it
+    AMGPreconditioner prec;
+    ChainProblem chainA(16, 1e-4), chainB(16, 1e-2), chainC(16, 1e-4, true);
+    prec.update(*chainA.AOpRcp, chainA.biFlagRcp);
+    prec.update(*chainB.AOpRcp, chainB.biFlagRcp);
+    pass = pass && prec.getBuildCount() == 1 && prec.getReuseCount() == 1;
+    prec.update(*chainC.AOpRcp, chainC.biFlagRcp);
+    pass = pass && prec.getBuildCount() == 2 && prec.getReuseCount() == 1;
+    return pass;
+}
+#endif
+
+int main(int argc, char **argv) {
+    MPI_Init(&argc, &argv);
+    {
+        Logger::setup_mpi_spdlog();
+        bool pass = testBilateralOnly() && testChainCG() && testRecycle() && testRowKey();
+#ifdef SIMTOOLBOX_MUELU
+        pass = pass && testAMG();
+#endif
+        spdlog::info(pass ? "TestPassed" : "Error");
+    }
+    MPI_Finalize();
+    return 0;
+}
@@ -0,0 +1,253 @@
+#include "ChainPreconditioner.hpp"
+
+#include "Util/Logger.hpp"
+
+#include <algorithm>
+#include <map>
+#include <unordered_map>
+#include <utility>
+
+ChainPreconditioner::ChainPreconditioner(const ConstraintOperator &AOp, const Teuchos::RCP<const TV> &biFlagRcp_) {
+    mapRcp = AOp.getDomainMap();
+    TEUCHOS_TEST_FOR_EXCEPTION(!mapRcp->isSameAs(*(biFlagRcp_->getMap())), std::invalid_argument,
+                               "A and biFlag do not have the same Map.");
+
+    auto DTRcp = AOp.getDMatTrans();
+    auto invKappaRcp = AOp.getInvKappa();
+    auto mobGhostRcp = AOp.getMobilityGhost();
+    TEUCHOS_TEST_FOR_EXCEPTION(mobGhostRcp.is_null(), std::invalid_argument,
+                               "ChainPreconditioner requires an explicit mobility matrix.");
+    auto colMapRcp = DTRcp->getColMap();
+    auto ghostColMapRcp = mobGhostRcp->getColMap();
+
+    auto biFlagPtr = biFlagRcp_->getLocalView<Kokkos::HostSpace>();
+    auto invKappaPtr = invKappaRcp->getLocalView<Kokkos::HostSpace>();
+    const int localSize = biFlagPtr.dimension_0();
+
+    // step 1, group local bilateral rows into links by the pair of objects they connect
+    // column gid / 6 is the object index in the mobility map
+    std::vector<std::vector<int>> linkRows;
+    std::vector<std::array<int, 2>> linkObjs;
+    std::map<std::pair<int, int>, int> pairToLink;
+    std::unordered_map<int, std::vector<int>> objToLinks;
+    for (int i = 0; i < localSize; i++) {
+        if (biFlagPtr(i, 0) < 0.5) {
+            continue;
+        }
+        Teuchos::ArrayView<const int> cols;
+        Teuchos::ArrayView<const double> vals;
+        DTRcp->getLocalRowView(i, cols, vals);
+        std::vector<int> objs;
+        for (int a = 0; a < cols.size(); a++) {
+            objs.push_back(colMapRcp->getGlobalElement(cols[a]) / 6);
+        }
+        std::sort(objs.begin(), objs.end());
+        objs.erase(std::unique(objs.begin(), objs.end()), objs.end());
+        if (objs.size() != 2) {
+            // not a pairwise link, a singleton block
+            linkRows.push_back(std::vector<int>{i});
+            linkObjs.push_back(std::array<int, 2>{{-1, -1}});
+            continue;
+        }
+        const auto key = std::make_pair(objs[0], objs[1]);
+        auto it = pairToLink.find(key);
+        if (it == pairToLink.end()) {
+            const int link = linkRows.size();
+            pairToLink[key] = link;
+            linkRows.push_back(std::vector<int>{i});
+            linkObjs.push_back(std::array<int, 2>{{objs[0], objs[1]}});
+            objToLinks[objs[0]].push_back(link);
+            objToLinks[objs[1]].push_back(link);
+        } else {
+            linkRows[it->second].push_back(i);
+        }
+    }
+
+    // step 2, walk through objects of degree 2 to form chains
+    const int nLink = linkRows.size();
+    std::vector<std::array<int, 2>> linkNbr(nLink, std::array<int, 2>{{-1, -1}});
+    for (int l = 0; l < nLink; l++) {
+        for (int e = 0; e < 2; e++) {
+            if (linkObjs[l][e] < 0) {
+                continue;
+            }
+            const auto &links = objToLinks[linkObjs[l][e]];
+            if (links.size() == 2) {
+                linkNbr[l][e] = links[0] == l ? links[1] : links[0];
+            }
+        }
+    }
+
+    std::vector<std::vector<int>> chainLinks;
+    std::vector<char> visited(nLink, 0);
+    auto walk = [&](int start) {
+        std::vector<int> chain;
+        int cur = start;
+        while (cur >= 0 && !visited[cur]) {
+            visited[cur] = 1;
+            chain.push_back(cur);
+            int next = -1;
+            for (int e = 0; e < 2; e++) {
+                if (linkNbr[cur][e] >= 0 && !visited[linkNbr[cur][e]]) {
+                    next = linkNbr[cur][e];
+                    break;
+                }
+            }
+            cur = next;
+        }
+        chainLinks.push_back(chain);
+    };
+    for (int l = 0; l < nLink; l++) { // chains with at least one open end
+        if (!visited[l] && (linkNbr[l][0] < 0 || linkNbr[l][1] < 0)) {
+            walk(l);
+        }
+    }
+    for (int l = 0; l < nLink; l++) { // rings
+        if (!visited[l]) {
+            walk(l);
+        }
+    }
+
+    // step 3, w_i = M d_i for each bilateral row, sparse over local columns of D^T
+    // then A(i,j) = d_j . w_i + delta_ij invKappa_i
+    std::vector<std::vector<std::pair<int, double>>> mobD(localSize);
+#pragma omp parallel for
+    for (int i = 0; i < localSize; i++) {
+        if (biFlagPtr(i, 0) < 0.5) {
+            continue;
+        }
+        Teuchos::ArrayView<const int> cols;
+        Teuchos::ArrayView<const double> vals;
+        DTRcp->getLocalRowView(i, cols, vals);
+        auto &w = mobD[i];
+        for (int a = 0; a < cols.size(); a++) {
+            Teuchos::ArrayView<const int> mobCols;
+            Teuchos::ArrayView<const double> mobVals;
+            mobGhostRcp->getLocalRowView(cols[a], mobCols, mobVals); // rowMap of mobGhost == colMap of D^T
+            for (int m = 0; m < mobCols.size(); m++) {
+                const int colDT = colMapRcp->getLocalElement(ghostColMapRcp->getGlobalElement(mobCols[m]));
+                if (colDT >= 0) { // columns not in D^T do not contribute
+                    w.emplace_back(colDT, vals[a] * mobVals[m]);
+                }
+            }
+        }
+        // merge duplicate columns
+        std::sort(w.begin(), w.end());
+        int last = -1;
+        for (int k = 0; k < w.size(); k++) {
+            if (last >= 0 && w[last].first == w[k].first) {
+                w[last].second += w[k].second;
+            } else {
+                w[++last] = w[k];
+            }
+        }
+        w.resize(last + 1);
+    }
+
+    auto entry = [&](int i, int j) {
+        Teuchos::ArrayView<const int> cols;
+        Teuchos::ArrayView<const double> vals;
+        DTRcp->getLocalRowView(j, cols, vals);
+        const auto &w = mobD[i];
+        double sum = 0;
+        for (int b = 0; b < cols.size(); b++) {
+            auto it = std::lower_bound(w.begin(), w.end(), cols[b],
+                                       [](const std::pair<int, double> &e, int col) { return e.first < col; });
+            if (it != w.end() && it->first == cols[b]) {
+                sum += it->second * vals[b];
+            }
+        }
+        return i == j ? sum + invKappaPtr(i, 0) : sum;
+    };
+
+    // step 4, assemble and factorize each chain
+    const int nChain = chainLinks.size();
+    chains.resize(nChain);
+    chainRows.resize(nChain);
+    chainDiag.resize(nChain);
+    chainSPD.resize(nChain, 0);
+#pragma omp parallel for schedule(dynamic)
+    for (int c = 0; c < nChain; c++) {
+        const auto &links = chainLinks[c];
+        const int n = links.size();
+        auto &chain = chains[c];
+        chain.diag.resize(n);
+        chain.offDiag.resize(n - 1);
+        for (int k = 0; k < n; k++) {
+            const auto &rows = linkRows[links[k]];
+            chainRows[c].insert(chainRows[c].end(), rows.begin(), rows.end());
+            chain.diag[k].resize(rows.size(), rows.size());
+            for (int p = 0; p < rows.size(); p++) {
+                for (int q = 0; q < rows.size(); q++) {
+                    chain.diag[k](p, q) = entry(rows[p], rows[q]);
+                }
+                chainDiag[c].push_back(chain.diag[k](p, p));
+            }
+            if (k < n - 1) {
+                const auto &rowsNext = linkRows[links[k + 1]];
+                chain.offDiag[k].resize(rows.size(), rowsNext.size());
+                for (int p = 0; p < rows.size(); p++) {
+                    for (int q = 0; q < rowsNext.size(); q++) {
+                        chain.offDiag[k](p, q) = entry(rows[p], rowsNext[q]);
+                    }
+                }
+            }
+        }
+        chainSPD[c] = chain.factorize() ? 1 : 0;
+    }
+
+    int nFail = 0;
+    for (int c = 0; c < nChain; c++) {
+        maxChainLength = std::max(maxChainLength, static_cast<int>(chainLinks[c].size()));
+        nFail += chainSPD[c] ? 0 : 1;
+    }
+    if (nFail > 0) {
+        spdlog::warn("ChainPreconditioner: {} chains not SPD, using Jacobi", nFail);
+    }
+}
+
+void ChainPreconditioner::apply(const TMV &X, TMV &Y, Teuchos::ETransp mode, scalar_type alpha,
+                                scalar_type beta) const {
+    TEUCHOS_TEST_FOR_EXCEPTION(X.getNumVectors() != Y.getNumVectors(), std::invalid_argument,
+                               "X and Y do not have the same numbers of vectors (columns).");
+
+    auto xView = X.getLocalView<Kokkos::HostSpace>();
+    auto yView = Y.getLocalView<Kokkos::HostSpace>();
+    Y.modify<Kokkos::HostSpace>();
+    const int localSize = xView.dimension_0();
+    const int nChain = chains.size();
+
+    for (int c = 0; c < xView.dimension_1(); c++) {
+        // identity for rows not in any chain
+        std::vector<double> z(localSize);
+#pragma omp parallel for
+        for (int i = 0; i < localSize; i++) {
+            z[i] = xView(i, c);
+        }
+
+#pragma omp parallel for schedule(dynamic)
+        for (int k = 0; k < nChain; k++) {
+            const auto &rows = chainRows[k];
+            const int n = rows.size();
+            Evec r(n);
+            for (int p = 0; p < n; p++) {
+                r[p] = xView(rows[p], c);
+            }
+            if (chainSPD[k]) {
+                chains[k].solve(r);
+            } else {
+                for (int p = 0; p < n; p++) {
+                    r[p] = chainDiag[k][p] > 0 ? r[p] / chainDiag[k][p] : r[p];
+                }
+            }
+            for (int p = 0; p < n; p++) {
+                z[rows[p]] = r[p];
+            }
+        }
+
+#pragma omp parallel for
+        for (int i = 0; i < localSize; i++) {
+            yView(i, c) = alpha * z[i] + (beta == 0 ? 0 : beta * yView(i, c));
+        }
+    }
+}
@@ -0,0 +1,64 @@
+/**
+ * @file ChainPreconditioner.hpp
+ * @brief Block tridiagonal solver for bilateral constraints along linear chains of objects
+ *
+ */
+#ifndef CHAINPRECONDITIONER_HPP_
+#define CHAINPRECONDITIONER_HPP_
+
+#include "ConstraintOperator.hpp"
+
+#include "Trilinos/TpetraUtil.hpp"
+#include "Util/BlockTriDiag.hpp"
+
+#include <vector>
+
+/**
+ * @brief approximate inverse of the bilateral block of ConstraintOperator, exact for linear chains
+ *
+ * Local bilateral rows are grouped into links by the pair of objects they connect.
+ * Links sharing an object of degree 2 are consecutive in a chain, so the bilateral block of
+ *   \f$D^T M D + K^{-1}\f$
+ * restricted to a chain is block tridiagonal, and is solved in O(n) with BlockTriDiag.
+ * Branch points and rank boundaries split chains, rings are cut at an arbitrary link.
+ * Unilateral rows are passed through unchanged.
+ * On a single rank and with a block diagonal mobility this is the exact inverse for unbranched filaments.
+ */
+class ChainPreconditioner : public TOP {
+  public:
+    /**
+     * @brief Construct a new ChainPreconditioner object
+     *
+     * @param AOp the constraint operator
+     * @param biFlagRcp_ 1 for bilateral, 0 for unilateral
+     */
+    ChainPreconditioner(const ConstraintOperator &AOp, const Teuchos::RCP<const TV> &biFlagRcp_);
+
+    ~ChainPreconditioner() = default;
+
+    Teuchos::RCP<const TMAP> getDomainMap() const { return mapRcp; }
+    Teuchos::RCP<const TMAP> getRangeMap() const { return mapRcp; }
+
+    bool hasTransposeApply() const { return true; }
+
+    /**
+     * @brief Y := alpha Op^{-1} X + beta Y, Op is symmetric
+     *
+     */
+    void apply(const TMV &X, TMV &Y, Teuchos::ETransp mode = Teuchos::NO_TRANS,
+               scalar_type alpha = Teuchos::ScalarTraits<scalar_type>::one(),
+               scalar_type beta = Teuchos::ScalarTraits<scalar_type>::zero()) const;
+
+    int getChainNumber() const { return chainRows.size(); }
+    int getMaxChainLength() const { return maxChainLength; }
+
+  private:
+    Teuchos::RCP<const TMAP> mapRcp;            ///< map of the constraint vector
+    std::vector<BlockTriDiag> chains;           ///< factorized block tridiagonal system of each chain
+    std::vector<std::vector<int>> chainRows;    ///< local row indices of each chain, in block order
+    std::vector<std::vector<double>> chainDiag; ///< diagonal of each chain, Jacobi fallback if not SPD
+    std::vector<char> chainSPD;                 ///< if the factorization of each chain succeeded
+    int maxChainLength = 0;                     ///< max number of links in a chain
+};
+
+#endif
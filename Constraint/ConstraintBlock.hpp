@@ -16,9 +16,11 @@
 #include "Util/IOHelper.hpp"
 
 #include <algorithm>
+#include <cassert>
 #include <cmath>
-#include <deque>
+#include <cstdint>
 #include <type_traits>
+#include <utility>
 #include <vector>
 
 /**
@@ -39,6 +41,8 @@ struct ConstraintBlock {
     bool oneSide = false;                 ///< flag for one side constraint. body J does not appear in mobility matrix
     bool bilateral = false;               ///< if this is a bilateral constraint or not
     double kappa = 0;                     ///< spring constant. =0 means no spring
+    double friction = 0;                  ///< Coulomb friction coefficient. >0 means two tangential blocks follow
+    bool tangent = false;                 ///< tangential block of a frictional contact, normI is the tangent
     double normI[3] = {0, 0, 0};
     double normJ[3] = {0, 0, 0}; ///< surface norm vector at the location of constraints (minimal separation).
     double posI[3] = {0, 0, 0};
@@ -71,15 +75,15 @@ struct ConstraintBlock {
      * @param labJ_
      * @param oneSide_ flag for one side constarint
      * @param bilateral_ flag for bilateral constraint
-     * @param kappa_ flag for kappa of bilateral constraint
+     * @param kappa_ spring constant of bilateral links and compliant unilateral contacts
      * @param gammaLB_ lower bound of gamma for unilateral constraints
      */
     ConstraintBlock(double delta0_, double gamma_, int gidI_, int gidJ_, int globalIndexI_, int globalIndexJ_,
                     const double normI_[3], const double normJ_[3], const double posI_[3], const double posJ_[3],
                     const double labI_[3], const double labJ_[3], bool oneSide_, bool bilateral_, double kappa_,
                     double gammaLB_)
-        : delta0(delta0_), gamma(gamma_), gidI(gidI_), gidJ(gidJ_), globalIndexI(globalIndexI_),
-          globalIndexJ(globalIndexJ_), oneSide(oneSide_), bilateral(bilateral_), kappa(kappa_), gammaLB(gammaLB_) {
+        : delta0(delta0_), gamma(gamma_), gammaLB(gammaLB_), gidI(gidI_), gidJ(gidJ_), globalIndexI(globalIndexI_),
+          globalIndexJ(globalIndexJ_), oneSide(oneSide_), bilateral(bilateral_), kappa(kappa_) {
         for (int d = 0; d < 3; d++) {
             normI[d] = normI_[d];
             normJ[d] = normJ_[d];
@@ -129,7 +133,190 @@ struct ConstraintBlock {
 static_assert(std::is_trivially_copyable<ConstraintBlock>::value, "");
 static_assert(std::is_default_constructible<ConstraintBlock>::value, "");
 
-using ConstraintBlockQue = std::deque<ConstraintBlock>;      ///< a queue contains blocks collected by one thread
+/**
+ * @brief a queue contains blocks collected by one thread, stored as structure of arrays
+ *
+ * Blocks are pushed as ConstraintBlock and stored in contiguous arrays.
+ * Only fields used by the constraint solver are always stored.
+ * gid, lab frame locations, and stress are only used for output, and are stored in side arrays if recordOutput.
+ * normJ is not stored. It is -normI for two-side constraints and normI for one-side constraints.
+ * A frictional contact is a unilateral block with friction > 0 followed by its two tangential blocks.
+ * The three blocks are always consecutive in one queue, so their gammas are consecutive rows for the solver.
+ * clear() keeps the capacity, so the arrays are not reallocated every timestep.
+ */
+class ConstraintBlockQue {
+  public:
+    static constexpr uint8_t ONESIDE = 1;   ///< flag bit for one side constraints
+    static constexpr uint8_t BILATERAL = 2; ///< flag bit for bilateral constraints
+    static constexpr uint8_t TANGENT = 4;   ///< flag bit for tangential blocks of frictional contacts
+
+    // solver data, one entry per block
+    std::vector<double> delta0;    ///< constraint initial value
+    std::vector<double> gamma;     ///< force magnitude, could be an initial guess
+    std::vector<double> gammaLB;   ///< lower bound of gamma for unilateral constraints
+    std::vector<double> kappa;     ///< spring constant. =0 means no spring
+    std::vector<double> friction;  ///< Coulomb friction coefficient, >0 only for the normal block of a contact
+    std::vector<int> globalIndexI; ///< global index of particle I
+    std::vector<int> globalIndexJ; ///< global index of particle J
+    std::vector<uint8_t> flag;     ///< ONESIDE | BILATERAL | TANGENT
+    std::vector<double> normI;     ///< 3 per block, surface norm vector on body I
+    std::vector<double> posI;      ///< 3 per block, constraint position relative to body I
+    std::vector<double> posJ;      ///< 3 per block, constraint position relative to body J
+
+    // output data, one entry per block if recordOutput
+    std::vector<int> gidI;      ///< unique global ID of particle I
+    std::vector<int> gidJ;      ///< unique global ID of particle J
+    std::vector<double> labI;   ///< 3 per block, labframe location on body I
+    std::vector<double> labJ;   ///< 3 per block, labframe location on body J
+    std::vector<double> stress; ///< 9 per block, stress for unit gamma, multiplied by gamma after writeBackGamma
+
+    ConstraintBlockQue() = default;
+    ~ConstraintBlockQue() = default;
+
+    int size() const { return delta0.size(); }
+    bool empty() const { return delta0.empty(); }
+    bool isOneSide(int i) const { return flag[i] & ONESIDE; }
+    bool isBilateral(int i) const { return flag[i] & BILATERAL; }
+    bool isTangent(int i) const { return flag[i] & TANGENT; }
+
+    /**
+     * @brief if output-only fields are stored for blocks pushed after this call
+     *
+     * @param recordOutput_
+     */
+    void setRecordOutput(bool recordOutput_) {
+        assert(empty());
+        recordOutput = recordOutput_;
+    }
+    bool hasOutput() const { return recordOutput; }
+
+    /**
+     * @brief remove all blocks, keep the capacity
+     *
+     */
+    void clear() {
+        for (auto vec : {&delta0, &gamma, &gammaLB, &kappa, &friction, &normI, &posI, &posJ, &labI, &labJ, &stress}) {
+            vec->clear();
+        }
+        for (auto vec : {&globalIndexI, &globalIndexJ, &gidI, &gidJ}) {
+            vec->clear();
+        }
+        flag.clear();
+    }
+
+    /**
+     * @brief bytes allocated by all arrays, including the reserved capacity
+     *
+     * @return size_t
+     */
+    size_t getMemoryBytes() const {
+        size_t bytes = flag.capacity() * sizeof(uint8_t);
+        for (auto vec : {&delta0, &gamma, &gammaLB, &kappa, &friction, &normI, &posI, &posJ, &labI, &labJ, &stress}) {
+            bytes += vec->capacity() * sizeof(double);
+        }
+        for (auto vec : {&globalIndexI, &globalIndexJ, &gidI, &gidJ}) {
+            bytes += vec->capacity() * sizeof(int);
+        }
+        return bytes;
+    }
+
+    void push_back(const ConstraintBlock &block) {
+        delta0.push_back(block.delta0);
+        gamma.push_back(block.gamma);
+        gammaLB.push_back(block.gammaLB);
+        kappa.push_back(block.kappa);
+        friction.push_back(block.friction);
+        globalIndexI.push_back(block.globalIndexI);
+        globalIndexJ.push_back(block.globalIndexJ);
+        flag.push_back((block.oneSide ? ONESIDE : 0) | (block.bilateral ? BILATERAL : 0) |
+                       (block.tangent ? TANGENT : 0));
+        normI.insert(normI.end(), block.normI, block.normI + 3);
+        posI.insert(posI.end(), block.posI, block.posI + 3);
+        posJ.insert(posJ.end(), block.posJ, block.posJ + 3);
+        if (recordOutput) {
+            gidI.push_back(block.gidI);
+            gidJ.push_back(block.gidJ);
+            labI.insert(labI.end(), block.labI, block.labI + 3);
+            labJ.insert(labJ.end(), block.labJ, block.labJ + 3);
+            stress.insert(stress.end(), block.stress, block.stress + 9);
+        }
+    }
+
+    /**
+     * @brief append all blocks of another queue
+     *
+     * @param other must have the same hasOutput()
+     */
+    void append(const ConstraintBlockQue &other) {
+        assert(recordOutput == other.recordOutput);
+        auto appendVec = [](auto &to, const auto &from) { to.insert(to.end(), from.begin(), from.end()); };
+        appendVec(delta0, other.delta0);
+        appendVec(gamma, other.gamma);
+        appendVec(gammaLB, other.gammaLB);
+        appendVec(kappa, other.kappa);
+        appendVec(friction, other.friction);
+        appendVec(globalIndexI, other.globalIndexI);
+        appendVec(globalIndexJ, other.globalIndexJ);
+        appendVec(flag, other.flag);
+        appendVec(normI, other.normI);
+        appendVec(posI, other.posI);
+        appendVec(posJ, other.posJ);
+        appendVec(gidI, other.gidI);
+        appendVec(gidJ, other.gidJ);
+        appendVec(labI, other.labI);
+        appendVec(labJ, other.labJ);
+        appendVec(stress, other.stress);
+    }
+
+    template <class... Args>
+    void emplace_back(Args &&... args) {
+        push_back(ConstraintBlock(std::forward<Args>(args)...));
+    }
+
+    /**
+     * @brief reconstruct block i, for testing and debugging
+     *
+     * output fields are zero if not recorded
+     * @param i
+     * @return ConstraintBlock
+     */
+    ConstraintBlock operator[](int i) const {
+        ConstraintBlock block;
+        block.delta0 = delta0[i];
+        block.gamma = gamma[i];
+        block.gammaLB = gammaLB[i];
+        block.kappa = kappa[i];
+        block.friction = friction[i];
+        block.globalIndexI = globalIndexI[i];
+        block.globalIndexJ = globalIndexJ[i];
+        block.oneSide = isOneSide(i);
+        block.bilateral = isBilateral(i);
+        block.tangent = isTangent(i);
+        for (int k = 0; k < 3; k++) {
+            block.normI[k] = normI[3 * i + k];
+            block.normJ[k] = block.oneSide ? normI[3 * i + k] : -normI[3 * i + k];
+            block.posI[k] = posI[3 * i + k];
+            block.posJ[k] = posJ[3 * i + k];
+        }
+        if (recordOutput) {
+            block.gidI = gidI[i];
+            block.gidJ = gidJ[i];
+            for (int k = 0; k < 3; k++) {
+                block.labI[k] = labI[3 * i + k];
+                block.labJ[k] = labJ[3 * i + k];
+            }
+            block.setStress(stress.data() + 9 * i);
+        }
+        return block;
+    }
+
+    ConstraintBlock front() const { return (*this)[0]; }
+    ConstraintBlock back() const { return (*this)[size() - 1]; }
+
+  private:
+    bool recordOutput = true; ///< if output-only fields are stored
+};
+
 using ConstraintBlockPool = std::vector<ConstraintBlockQue>; ///< a pool contains queues on different threads
 
 #endif
\ No newline at end of file
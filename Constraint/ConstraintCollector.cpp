@@ -1,7 +1,13 @@
 #include "ConstraintCollector.hpp"
+#include "Util/ReproSum.hpp"
 #include "spdlog/spdlog.h"
 
+#include <algorithm>
+#include <array>
 #include <cstdlib>
+#include <map>
+#include <numeric>
+#include <tuple>
 
 ConstraintCollector::ConstraintCollector() {
     const int totalThreads = omp_get_max_threads();
@@ -16,8 +22,9 @@ ConstraintCollector::ConstraintCollector() {
 
 bool ConstraintCollector::valid() const { return constraintPoolPtr->empty(); }
 
-void ConstraintCollector::clear() {
+void ConstraintCollector::clear(bool recordOutput) {
     assert(constraintPoolPtr);
+    // keep the capacity of each queue
     for (int i = 0; i < constraintPoolPtr->size(); i++) {
         (*constraintPoolPtr)[i].clear();
     }
@@ -25,6 +32,10 @@ void ConstraintCollector::clear() {
     // keep the total number of queues
     const int totalThreads = omp_get_max_threads();
     constraintPoolPtr->resize(totalThreads);
+
+    for (auto &queue : *constraintPoolPtr) {
+        queue.setRecordOutput(recordOutput);
+    }
 }
 
 int ConstraintCollector::getLocalNumberOfConstraints() {
@@ -35,6 +46,14 @@ int ConstraintCollector::getLocalNumberOfConstraints() {
     return sum;
 }
 
+size_t ConstraintCollector::getLocalMemoryBytes() const {
+    size_t bytes = 0;
+    for (const auto &que : *constraintPoolPtr) {
+        bytes += que.getMemoryBytes();
+    }
+    return bytes;
+}
+
 void ConstraintCollector::sumLocalConstraintStress(Emat3 &uniStress, Emat3 &biStress, bool withOneSide) const {
     const auto &cPool = *constraintPoolPtr;
     const int poolSize = cPool.size();
@@ -49,14 +68,16 @@ void ConstraintCollector::sumLocalConstraintStress(Emat3 &uniStress, Emat3 &biSt
         Emat3 uniStressSumQue = Emat3::Zero();
         Emat3 biStressSumQue = Emat3::Zero();
         const auto &conQue = cPool[que];
-        for (const auto &cBlock : conQue) {
-            if (cBlock.oneSide && !withOneSide) {
+        const int queSize = conQue.hasOutput() ? conQue.size() : 0;
+        for (int c = 0; c < queSize; c++) {
+            if (conQue.isOneSide(c) && !withOneSide) {
                 // skip counting oneside collision blocks
                 continue;
             } else {
-                Emat3 stressBlock;
-                cBlock.getStress(stressBlock);
-                if (cBlock.bilateral) {
+                // row-major 3x3
+                const Emat3 stressBlock = Eigen::Map<const Eigen::Matrix<double, 3, 3, Eigen::RowMajor>>(
+                    conQue.stress.data() + 9 * c);
+                if (conQue.isBilateral(c)) {
                     biStressSumQue = biStressSumQue + stressBlock;
                 } else {
                     uniStressSumQue = uniStressSumQue + stressBlock;
@@ -73,6 +94,96 @@ void ConstraintCollector::sumLocalConstraintStress(Emat3 &uniStress, Emat3 &biSt
     biStress = biStressTotal;
 }
 
+void ConstraintCollector::sumConstraintStressReproducible(Emat3 &uniStress, Emat3 &biStress,
+                                                          bool withOneSide) const {
+    const auto &cPool = *constraintPoolPtr;
+    std::vector<int> cQueSize;
+    std::vector<int> cQueIndex;
+    buildConIndex(cQueSize, cQueIndex);
+
+    // 9 components for uni and 9 for bi, one term for each block
+    double sum[18];
+    ReproSum::sum(
+        cQueIndex.back(), 18,
+        [&](int idx, double *value) {
+            std::fill(value, value + 18, 0);
+            const int q = std::upper_bound(cQueIndex.begin(), cQueIndex.end(), idx) - cQueIndex.begin() - 1;
+            const int c = idx - cQueIndex[q];
+            const auto &conQue = cPool[q];
+            if (!conQue.hasOutput() || (conQue.isOneSide(c) && !withOneSide)) {
+                return;
+            }
+            const int offset = conQue.isBilateral(c) ? 9 : 0;
+            std::copy(conQue.stress.data() + 9 * c, conQue.stress.data() + 9 * c + 9, value + offset);
+        },
+        sum);
+
+    // row-major 3x3
+    uniStress = Eigen::Map<const Eigen::Matrix<double, 3, 3, Eigen::RowMajor>>(sum);
+    biStress = Eigen::Map<const Eigen::Matrix<double, 3, 3, Eigen::RowMajor>>(sum + 9);
+}
+
+void ConstraintCollector::sortCanonical() {
+    auto &cPool = *constraintPoolPtr;
+    const int cQueNum = cPool.size();
+
+    ConstraintBlockQue all;
+    all.setRecordOutput(true);
+    for (const auto &que : cPool) {
+        if (!que.hasOutput()) {
+            spdlog::critical("canonical order of constraints requires gid, recordOutput must be true");
+            std::exit(1);
+        }
+        all.append(que);
+    }
+
+    // blocks of the same pair, e.g., two ends against a boundary, are ordered by geometry
+    const int nBlock = all.size();
+    auto key = [&](int b) {
+        return std::make_tuple(all.gidI[b], all.gidJ[b], all.flag[b],                         //
+                               all.posI[3 * b], all.posI[3 * b + 1], all.posI[3 * b + 2],      //
+                               all.posJ[3 * b], all.posJ[3 * b + 1], all.posJ[3 * b + 2],      //
+                               all.normI[3 * b], all.normI[3 * b + 1], all.normI[3 * b + 2],   //
+                               all.delta0[b], all.kappa[b]);
+    };
+    // tangential blocks follow their normal block, only the normal blocks are sorted
+    std::vector<int> head;
+    head.reserve(nBlock);
+    for (int b = 0; b < nBlock; b++) {
+        if (!all.isTangent(b)) {
+            head.push_back(b);
+        }
+    }
+    std::sort(head.begin(), head.end(), [&](int a, int b) { return key(a) < key(b); });
+    std::vector<int> order;
+    order.reserve(nBlock);
+    for (int b : head) {
+        order.push_back(b);
+        for (int t = b + 1; t < nBlock && all.isTangent(t); t++) {
+            order.push_back(t);
+        }
+    }
+
+    // contiguous and even split, so buildConstraintMatrixVector() is still parallel over queues
+    // a split point inside a frictional contact moves to its end
+    auto split = [&](int q) {
+        int k = static_cast<long>(nBlock) * q / cQueNum;
+        while (k < nBlock && all.isTangent(order[k])) {
+            k++;
+        }
+        return k;
+    };
+    for (int q = 0; q < cQueNum; q++) {
+        auto &que = cPool[q];
+        que.clear();
+        const int begin = split(q);
+        const int end = split(q + 1);
+        for (int k = begin; k < end; k++) {
+            que.push_back(all[order[k]]);
+        }
+    }
+}
+
 void ConstraintCollector::writePVTP(const std::string &folder, const std::string &prefix, const std::string &postfix,
                                     const int nProcs) const {
     std::vector<std::string> pieceNames;
@@ -86,9 +197,11 @@ void ConstraintCollector::writePVTP(const std::string &folder, const std::string
     std::vector<IOHelper::FieldVTU> cellDataFields;
     cellDataFields.emplace_back(1, IOHelper::IOTYPE::Int32, "oneSide");
     cellDataFields.emplace_back(1, IOHelper::IOTYPE::Int32, "bilateral");
+    cellDataFields.emplace_back(1, IOHelper::IOTYPE::Int32, "tangent");
     cellDataFields.emplace_back(1, IOHelper::IOTYPE::Float32, "delta0");
     cellDataFields.emplace_back(1, IOHelper::IOTYPE::Float32, "gamma");
     cellDataFields.emplace_back(1, IOHelper::IOTYPE::Float32, "kappa");
+    cellDataFields.emplace_back(1, IOHelper::IOTYPE::Float32, "friction");
     cellDataFields.emplace_back(9, IOHelper::IOTYPE::Float32, "Stress");
 
     for (int i = 0; i < nProcs; i++) {
@@ -126,9 +239,11 @@ void ConstraintCollector::writeVTP(const std::string &folder, const std::string
     // cell data for ColBlock
     std::vector<int32_t> oneSide(cBlockNum);
     std::vector<int32_t> bilateral(cBlockNum);
+    std::vector<int32_t> tangent(cBlockNum);
     std::vector<float> delta0(cBlockNum);
     std::vector<float> gamma(cBlockNum);
     std::vector<float> kappa(cBlockNum);
+    std::vector<float> friction(cBlockNum);
     std::vector<float> Stress(9 * cBlockNum);
 
 #pragma omp parallel for
@@ -144,41 +259,37 @@ void ConstraintCollector::writeVTP(const std::string &folder, const std::string
     for (int q = 0; q < cQueNum; q++) {
         const int queSize = cQueSize[q];
         const int queIndex = cQueIndex[q];
+        const auto &que = cPool[q];
         for (int c = 0; c < queSize; c++) {
             const int cIndex = queIndex + c;
-            const auto &block = cPool[q][c];
-            // point position
-            pos[6 * cIndex + 0] = block.labI[0];
-            pos[6 * cIndex + 1] = block.labI[1];
-            pos[6 * cIndex + 2] = block.labI[2];
-            pos[6 * cIndex + 3] = block.labJ[0];
-            pos[6 * cIndex + 4] = block.labJ[1];
-            pos[6 * cIndex + 5] = block.labJ[2];
-            // point data
-            gid[2 * cIndex + 0] = block.gidI;
-            gid[2 * cIndex + 1] = block.gidJ;
-            globalIndex[2 * cIndex + 0] = block.globalIndexI;
-            globalIndex[2 * cIndex + 1] = block.globalIndexJ;
-            posIJ[6 * cIndex + 0] = block.posI[0];
-            posIJ[6 * cIndex + 1] = block.posI[1];
-            posIJ[6 * cIndex + 2] = block.posI[2];
-            posIJ[6 * cIndex + 3] = block.posJ[0];
-            posIJ[6 * cIndex + 4] = block.posJ[1];
-            posIJ[6 * cIndex + 5] = block.posJ[2];
-            normIJ[6 * cIndex + 0] = block.normI[0];
-            normIJ[6 * cIndex + 1] = block.normI[1];
-            normIJ[6 * cIndex + 2] = block.normI[2];
-            normIJ[6 * cIndex + 3] = block.normJ[0];
-            normIJ[6 * cIndex + 4] = block.normJ[1];
-            normIJ[6 * cIndex + 5] = block.normJ[2];
+            const double normJSign = que.isOneSide(c) ? 1 : -1;
+            for (int k = 0; k < 3; k++) {
+                posIJ[6 * cIndex + k] = que.posI[3 * c + k];
+                posIJ[6 * cIndex + 3 + k] = que.posJ[3 * c + k];
+                normIJ[6 * cIndex + k] = que.normI[3 * c + k];
+                normIJ[6 * cIndex + 3 + k] = normJSign * que.normI[3 * c + k];
+            }
+            globalIndex[2 * cIndex + 0] = que.globalIndexI[c];
+            globalIndex[2 * cIndex + 1] = que.globalIndexJ[c];
             // cell data
-            oneSide[cIndex] = block.oneSide ? 1 : 0;
-            bilateral[cIndex] = block.bilateral ? 1 : 0;
-            delta0[cIndex] = block.delta0;
-            gamma[cIndex] = block.gamma;
-            kappa[cIndex] = block.kappa;
-            for (int kk = 0; kk < 9; kk++) {
-                Stress[9 * cIndex + kk] = block.stress[kk];
+            oneSide[cIndex] = que.isOneSide(c) ? 1 : 0;
+            bilateral[cIndex] = que.isBilateral(c) ? 1 : 0;
+            tangent[cIndex] = que.isTangent(c) ? 1 : 0;
+            delta0[cIndex] = que.delta0[c];
+            gamma[cIndex] = que.gamma[c];
+            kappa[cIndex] = que.kappa[c];
+            friction[cIndex] = que.friction[c];
+            // output-only data, zero if not recorded
+            if (que.hasOutput()) {
+                for (int k = 0; k < 3; k++) {
+                    pos[6 * cIndex + k] = que.labI[3 * c + k];
+                    pos[6 * cIndex + 3 + k] = que.labJ[3 * c + k];
+                }
+                gid[2 * cIndex + 0] = que.gidI[c];
+                gid[2 * cIndex + 1] = que.gidJ[c];
+                for (int kk = 0; kk < 9; kk++) {
+                    Stress[9 * cIndex + kk] = que.stress[9 * c + kk];
+                }
             }
         }
     }
@@ -211,9 +322,11 @@ void ConstraintCollector::writeVTP(const std::string &folder, const std::string
     file << "<CellData Scalars=\"scalars\">\n";
     IOHelper::writeDataArrayBase64(oneSide, "oneSide", 1, file);
     IOHelper::writeDataArrayBase64(bilateral, "bilateral", 1, file);
+    IOHelper::writeDataArrayBase64(tangent, "tangent", 1, file);
     IOHelper::writeDataArrayBase64(delta0, "delta0", 1, file);
     IOHelper::writeDataArrayBase64(gamma, "gamma", 1, file);
     IOHelper::writeDataArrayBase64(kappa, "kappa", 1, file);
+    IOHelper::writeDataArrayBase64(friction, "friction", 1, file);
     IOHelper::writeDataArrayBase64(Stress, "Stress", 9, file);
     file << "</CellData>\n";
     // Piece ends
@@ -228,8 +341,9 @@ void ConstraintCollector::dumpBlocks() const {
     // dump constraint blocks
     for (const auto &blockQue : (*constraintPoolPtr)) {
         std::cout << blockQue.size() << " constraints in this queue" << std::endl;
-        for (const auto &block : blockQue) {
-            std::cout << block.globalIndexI << " " << block.globalIndexJ << "  delta0:" << block.delta0 << std::endl;
+        for (int c = 0; c < blockQue.size(); c++) {
+            std::cout << blockQue.globalIndexI[c] << " " << blockQue.globalIndexJ[c] << "  delta0:" << blockQue.delta0[c]
+                      << std::endl;
         }
     }
 }
@@ -239,19 +353,32 @@ int ConstraintCollector::buildConstraintMatrixVector(const Teuchos::RCP<const TM
                                                      Teuchos::RCP<TV> &delta0Rcp,               //
                                                      Teuchos::RCP<TV> &invKappaRcp,             //
                                                      Teuchos::RCP<TV> &biFlagRcp,               //
-                                                     Teuchos::RCP<TV> &gammaGuessRcp) const {
+                                                     Teuchos::RCP<TV> &frictionRcp,             //
+                                                     Teuchos::RCP<TV> &gammaGuessRcp,           //
+                                                     const std::vector<char> &keep) const {
     Teuchos::RCP<const TCOMM> commRcp = mobMapRcp->getComm();
 
     const auto &cPool = *constraintPoolPtr; // the constraint pool
     const int cQueNum = cPool.size();
 
-    // prepare 1, build the index for block queue
+    // prepare 1, build the index for block queue, and the blocks of each queue kept as rows
     std::vector<int> cQueSize;
     std::vector<int> cQueIndex;
     buildConIndex(cQueSize, cQueIndex);
+    std::vector<std::vector<int>> queRow(cQueNum);
+    std::vector<int> rowIndex(cQueNum + 1, 0); // the first row of each queue
+    for (int i = 0; i < cQueNum; i++) {
+        queRow[i].reserve(cQueSize[i]);
+        for (int j = 0; j < cQueSize[i]; j++) {
+            if (keep.empty() || keep[cQueIndex[i] + j]) {
+                queRow[i].push_back(j);
+            }
+        }
+        rowIndex[i + 1] = rowIndex[i] + queRow[i].size();
+    }
 
     // prepare 2, allocate the map and vectors
-    const int localGammaSize = cQueIndex.back();
+    const int localGammaSize = rowIndex.back();
     Teuchos::RCP<const TMAP> gammaMapRcp = getTMAPFromLocalSize(localGammaSize, commRcp);
 
     // step 1, count the number of entries to each row
@@ -267,10 +394,9 @@ int ConstraintCollector::buildConstraintMatrixVector(const Teuchos::RCP<const TM
     int colIndexCount = 0;
     for (int i = 0; i < cQueNum; i++) {
         const auto &queue = cPool[i];
-        const int jsize = queue.size();
-        for (int j = 0; j < jsize; j++) {
+        for (const int j : queRow[i]) {
             rowPointerIndex++;
-            const int cBlockNNZ = (queue[j].oneSide ? 6 : 12);
+            const int cBlockNNZ = (queue.isOneSide(j) ? 6 : 12);
             rowPointers[rowPointerIndex] = rowPointers[rowPointerIndex - 1] + cBlockNNZ;
             colIndexCount += cBlockNNZ;
         }
@@ -291,25 +417,24 @@ int ConstraintCollector::buildConstraintMatrixVector(const Teuchos::RCP<const TM
     for (int threadId = 0; threadId < nThreads; threadId++) {
         // each thread process a queue
         const auto &cBlockQue = cPool[threadId];
-        const int cBlockNum = cBlockQue.size();
-        const int cBlockIndexBase = cQueSize[threadId];
         int kk = colIndexPool[threadId];
 
-        for (int j = 0; j < cBlockNum; j++) {
+        for (const int j : queRow[threadId]) {
             // each 6nnz for an object: gx.ux+gy.uy+gz.uz+(gzpy-gypz)wx+(gxpz-gzpx)wy+(gypx-gxpy)wz
             // 6 nnz for I
-            columnIndices[kk + 0] = 6 * cBlockQue[j].globalIndexI;
-            columnIndices[kk + 1] = 6 * cBlockQue[j].globalIndexI + 1;
-            columnIndices[kk + 2] = 6 * cBlockQue[j].globalIndexI + 2;
-            columnIndices[kk + 3] = 6 * cBlockQue[j].globalIndexI + 3;
-            columnIndices[kk + 4] = 6 * cBlockQue[j].globalIndexI + 4;
-            columnIndices[kk + 5] = 6 * cBlockQue[j].globalIndexI + 5;
-            const double &gx = cBlockQue[j].normI[0];
-            const double &gy = cBlockQue[j].normI[1];
-            const double &gz = cBlockQue[j].normI[2];
-            const double &px = cBlockQue[j].posI[0];
-            const double &py = cBlockQue[j].posI[1];
-            const double &pz = cBlockQue[j].posI[2];
+            const int gI = cBlockQue.globalIndexI[j];
+            columnIndices[kk + 0] = 6 * gI;
+            columnIndices[kk + 1] = 6 * gI + 1;
+            columnIndices[kk + 2] = 6 * gI + 2;
+            columnIndices[kk + 3] = 6 * gI + 3;
+            columnIndices[kk + 4] = 6 * gI + 4;
+            columnIndices[kk + 5] = 6 * gI + 5;
+            const double gx = cBlockQue.normI[3 * j + 0];
+            const double gy = cBlockQue.normI[3 * j + 1];
+            const double gz = cBlockQue.normI[3 * j + 2];
+            const double px = cBlockQue.posI[3 * j + 0];
+            const double py = cBlockQue.posI[3 * j + 1];
+            const double pz = cBlockQue.posI[3 * j + 2];
             values[kk + 0] = gx;
             values[kk + 1] = gy;
             values[kk + 2] = gz;
@@ -317,19 +442,21 @@ int ConstraintCollector::buildConstraintMatrixVector(const Teuchos::RCP<const TM
             values[kk + 4] = (gx * pz - gz * px);
             values[kk + 5] = (gy * px - gx * py);
             kk += 6;
-            if (!cBlockQue[j].oneSide) {
-                columnIndices[kk + 0] = 6 * cBlockQue[j].globalIndexJ;
-                columnIndices[kk + 1] = 6 * cBlockQue[j].globalIndexJ + 1;
-                columnIndices[kk + 2] = 6 * cBlockQue[j].globalIndexJ + 2;
-                columnIndices[kk + 3] = 6 * cBlockQue[j].globalIndexJ + 3;
-                columnIndices[kk + 4] = 6 * cBlockQue[j].globalIndexJ + 4;
-                columnIndices[kk + 5] = 6 * cBlockQue[j].globalIndexJ + 5;
-                const double &gx = cBlockQue[j].normJ[0];
-                const double &gy = cBlockQue[j].normJ[1];
-                const double &gz = cBlockQue[j].normJ[2];
-                const double &px = cBlockQue[j].posJ[0];
-                const double &py = cBlockQue[j].posJ[1];
-                const double &pz = cBlockQue[j].posJ[2];
+            if (!cBlockQue.isOneSide(j)) {
+                const int gJ = cBlockQue.globalIndexJ[j];
+                columnIndices[kk + 0] = 6 * gJ;
+                columnIndices[kk + 1] = 6 * gJ + 1;
+                columnIndices[kk + 2] = 6 * gJ + 2;
+                columnIndices[kk + 3] = 6 * gJ + 3;
+                columnIndices[kk + 4] = 6 * gJ + 4;
+                columnIndices[kk + 5] = 6 * gJ + 5;
+                // normJ = -normI for two side constraints
+                const double gx = -cBlockQue.normI[3 * j + 0];
+                const double gy = -cBlockQue.normI[3 * j + 1];
+                const double gz = -cBlockQue.normI[3 * j + 2];
+                const double px = cBlockQue.posJ[3 * j + 0];
+                const double py = cBlockQue.posJ[3 * j + 1];
+                const double pz = cBlockQue.posJ[3 * j + 2];
                 values[kk + 0] = gx;
                 values[kk + 1] = gy;
                 values[kk + 2] = gz;
@@ -388,34 +515,38 @@ int ConstraintCollector::buildConstraintMatrixVector(const Teuchos::RCP<const TM
     DMatTransRcp = Teuchos::rcp(new TCMAT(gammaMapRcp, colMapRcp, rowPointers, columnIndices, values));
     DMatTransRcp->fillComplete(mobMapRcp, gammaMapRcp); // domainMap, rangeMap
 
-    // step 5, fill the delta0, gammaGuess, invKappa, conFlag vectors
+    // step 5, fill the delta0, gammaGuess, invKappa, conFlag, friction vectors
     delta0Rcp = Teuchos::rcp(new TV(gammaMapRcp, true));
     invKappaRcp = Teuchos::rcp(new TV(gammaMapRcp, true));
     biFlagRcp = Teuchos::rcp(new TV(gammaMapRcp, true));
+    frictionRcp = Teuchos::rcp(new TV(gammaMapRcp, true));
     gammaGuessRcp = Teuchos::rcp(new TV(gammaMapRcp, true));
     auto delta0 = delta0Rcp->getLocalView<Kokkos::HostSpace>();
     auto gammaGuess = gammaGuessRcp->getLocalView<Kokkos::HostSpace>();
     auto invKappa = invKappaRcp->getLocalView<Kokkos::HostSpace>();
     auto biFlag = biFlagRcp->getLocalView<Kokkos::HostSpace>();
+    auto friction = frictionRcp->getLocalView<Kokkos::HostSpace>();
     delta0Rcp->modify<Kokkos::HostSpace>();
     gammaGuessRcp->modify<Kokkos::HostSpace>();
     invKappaRcp->modify<Kokkos::HostSpace>();
     biFlagRcp->modify<Kokkos::HostSpace>();
+    frictionRcp->modify<Kokkos::HostSpace>();
 
 #pragma omp parallel for num_threads(cQueNum)
     for (int que = 0; que < cQueNum; que++) {
         const auto &cQue = cPool[que];
-        const int cIndexBase = cQueIndex[que];
-        const int queSize = cQue.size();
-        for (int j = 0; j < queSize; j++) {
-            const auto &block = cQue[j];
-            const auto idx = cIndexBase + j;
-            delta0(idx, 0) = block.delta0;
-            gammaGuess(idx, 0) = block.gamma;
-            if (block.bilateral) {
-                invKappa(idx, 0) = block.kappa > 0 ? 1 / block.kappa : 0;
+        const int rowSize = queRow[que].size();
+        for (int r = 0; r < rowSize; r++) {
+            const int j = queRow[que][r];
+            const auto idx = rowIndex[que] + r;
+            delta0(idx, 0) = cQue.delta0[j];
+            gammaGuess(idx, 0) = cQue.gamma[j];
+            // springs of bilateral links and compliant unilateral contacts
+            invKappa(idx, 0) = cQue.kappa[j] > 0 ? 1 / cQue.kappa[j] : 0;
+            if (cQue.isBilateral(j)) {
                 biFlag(idx, 0) = 1;
             }
+            friction(idx, 0) = cQue.friction[j];
         }
     }
 
@@ -436,7 +567,104 @@ int ConstraintCollector::buildConIndex(std::vector<int> &cQueSize, std::vector<i
     return 0;
 }
 
-int ConstraintCollector::writeBackGamma(const Teuchos::RCP<const TV> &gammaRcp) {
+void ConstraintCollector::calcBlockRate(const Teuchos::RCP<const TMAP> &mobMapRcp, const TV &vel,
+                                        std::vector<double> &rate) const {
+    const auto &cPool = *constraintPoolPtr;
+    const int cQueNum = cPool.size();
+    std::vector<int> cQueSize;
+    std::vector<int> cQueIndex;
+    buildConIndex(cQueSize, cQueIndex);
+
+    // the 6 dofs of every object in some block, imported from the owner ranks
+    std::vector<int> dofIndex;
+    for (const auto &que : cPool) {
+        const int queSize = que.size();
+        for (int j = 0; j < queSize; j++) {
+            for (int k = 0; k < 6; k++) {
+                dofIndex.push_back(6 * que.globalIndexI[j] + k);
+            }
+            if (!que.isOneSide(j)) {
+                for (int k = 0; k < 6; k++) {
+                    dofIndex.push_back(6 * que.globalIndexJ[j] + k);
+                }
+            }
+        }
+    }
+    std::sort(dofIndex.begin(), dofIndex.end());
+    dofIndex.erase(std::unique(dofIndex.begin(), dofIndex.end()), dofIndex.end());
+    Teuchos::RCP<const TMAP> dofMapRcp = Teuchos::rcp(
+        new TMAP(Teuchos::OrdinalTraits<int>::invalid(), dofIndex.data(), dofIndex.size(), 0, mobMapRcp->getComm()));
+    Tpetra::Import<int, int> importer(mobMapRcp, dofMapRcp);
+    TV velDof(dofMapRcp, false);
+    velDof.doImport(vel, importer, Tpetra::INSERT);
+
+    // the same entries as a row of D^Trans, summed in the same order
+    auto velPtr = velDof.getLocalView<Kokkos::HostSpace>();
+    const auto &dofMap = *dofMapRcp;
+    rate.resize(cQueIndex.back());
+#pragma omp parallel for num_threads(cQueNum)
+    for (int que = 0; que < cQueNum; que++) {
+        const auto &cQue = cPool[que];
+        const int queSize = cQue.size();
+        for (int j = 0; j < queSize; j++) {
+            const double *g = &cQue.normI[3 * j];
+            double r = 0;
+            for (const int side : {0, 1}) {
+                if (side == 1 && cQue.isOneSide(j)) {
+                    break;
+                }
+                const double sign = side == 0 ? 1 : -1; // normJ = -normI for two side constraints
+                const double *p = side == 0 ? &cQue.posI[3 * j] : &cQue.posJ[3 * j];
+                const int gIndex = side == 0 ? cQue.globalIndexI[j] : cQue.globalIndexJ[j];
+                const int l = dofMap.getLocalElement(6 * gIndex);
+                const double gx = sign * g[0], gy = sign * g[1], gz = sign * g[2];
+                r += gx * velPtr(l + 0, 0);
+                r += gy * velPtr(l + 1, 0);
+                r += gz * velPtr(l + 2, 0);
+                r += (gz * p[1] - gy * p[2]) * velPtr(l + 3, 0);
+                r += (gx * p[2] - gz * p[0]) * velPtr(l + 4, 0);
+                r += (gy * p[0] - gx * p[1]) * velPtr(l + 5, 0);
+            }
+            rate[cQueIndex[que] + j] = r;
+        }
+    }
+}
+
+bool ConstraintCollector::buildRowKey(std::vector<std::array<int, 3>> &rowKey) const {
+    const auto &cPool = *constraintPoolPtr;
+    rowKey.clear();
+    for (const auto &que : cPool) {
+        if (!que.hasOutput() && que.size() > 0) {
+            return false;
+        }
+    }
+
+    // bilateral rows of each pair, ordered by the location relative to the body with the smaller gid
+    // so that the key does not depend on the order of queues and rows
+    using Location = std::tuple<double, double, double, int>; // location and row
+    std::map<std::pair<int, int>, std::vector<Location>> pairRows;
+    for (const auto &que : cPool) {
+        const int cQueSize = que.size();
+        for (int j = 0; j < cQueSize; j++) {
+            const auto pair = std::minmax(que.gidI[j], que.gidJ[j]);
+            rowKey.push_back(std::array<int, 3>{{pair.first, pair.second, -1}});
+            if (que.isBilateral(j)) {
+                const double *pos = que.gidI[j] <= que.gidJ[j] ? &que.posI[3 * j] : &que.posJ[3 * j];
+                pairRows[pair].emplace_back(pos[0], pos[1], pos[2], static_cast<int>(rowKey.size()) - 1);
+            }
+        }
+    }
+    for (auto &pr : pairRows) {
+        auto &rows = pr.second;
+        std::sort(rows.begin(), rows.end());
+        for (int index = 0; index < static_cast<int>(rows.size()); index++) {
+            rowKey[std::get<3>(rows[index])][2] = index;
+        }
+    }
+    return true;
+}
+
+int ConstraintCollector::writeBackGamma(const Teuchos::RCP<const TV> &gammaRcp, const std::vector<char> &keep) {
     auto &cPool = *constraintPoolPtr; // the constraint pool
     const int cQueNum = cPool.size();
 
@@ -444,15 +672,28 @@ int ConstraintCollector::writeBackGamma(const Teuchos::RCP<const TV> &gammaRcp)
     std::vector<int> cQueIndex;
     buildConIndex(cQueSize, cQueIndex);
 
+    // the row of each block, -1 if not kept
+    std::vector<int> blockRow(cQueIndex.back());
+    int nRow = 0;
+    for (int b = 0; b < cQueIndex.back(); b++) {
+        blockRow[b] = (keep.empty() || keep[b]) ? nRow++ : -1;
+    }
+
     auto gammaPtr = gammaRcp->getLocalView<Kokkos::HostSpace>();
 
 #pragma omp parallel for num_threads(cQueNum)
     for (int i = 0; i < cQueNum; i++) {
-        const int cQueSize = cPool[i].size();
+        auto &que = cPool[i];
+        const int cQueSize = que.size();
         for (int j = 0; j < cQueSize; j++) {
-            cPool[i][j].gamma = gammaPtr(cQueIndex[i] + j, 0);
-            for (int k = 0; k < 9; k++) {
-                cPool[i][j].stress[k] *= cPool[i][j].gamma;
+            const int row = blockRow[cQueIndex[i] + j];
+            que.gamma[j] = row < 0 ? 0 : gammaPtr(row, 0);
+        }
+        if (que.hasOutput()) {
+            for (int j = 0; j < cQueSize; j++) {
+                for (int k = 0; k < 9; k++) {
+                    que.stress[9 * j + k] *= que.gamma[j];
+                }
             }
         }
     }
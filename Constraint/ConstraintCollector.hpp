@@ -66,9 +66,10 @@ class ConstraintCollector {
      * @brief clear the blocks and get an empty collision pool
      *
      * The collision pool still contains (the number of openmp threads) queues
-     *
+     * The capacity of each queue is kept for the next timestep
+     * @param recordOutput if the output-only fields (gid, lab frame location, stress) of new blocks are stored
      */
-    void clear();
+    void clear(bool recordOutput = true);
 
     /**
      * @brief get the number of collision constraints on the local node
@@ -77,6 +78,13 @@ class ConstraintCollector {
      */
     int getLocalNumberOfConstraints();
 
+    /**
+     * @brief get the bytes allocated by the constraint pool on the local node
+     *
+     * @return size_t
+     */
+    size_t getLocalMemoryBytes() const;
+
     /**
      * @brief compute the total collision stress of all constraints (blocks)
      *
@@ -85,6 +93,25 @@ class ConstraintCollector {
      */
     void sumLocalConstraintStress(Emat3 &uniStress, Emat3 &biStress, bool withOneSide = false) const;
 
+    /**
+     * @brief compute the total collision stress of all constraints on all ranks with ReproSum
+     *
+     * collective. The result does not depend on the distribution of blocks over ranks, threads and queues
+     * @param uniStress
+     * @param biStress
+     * @param withOneSide include the stress (without proper definition) of one side collisions
+     */
+    void sumConstraintStressReproducible(Emat3 &uniStress, Emat3 &biStress, bool withOneSide = false) const;
+
+    /**
+     * @brief sort the blocks on the local rank in a canonical order, and split them evenly over the queues
+     *
+     * The order is by gidI, gidJ, then the geometry, so it does not depend on which thread collected a block.
+     * The tangential blocks of a frictional contact move with its normal block and are never split from it.
+     * The output-only fields must be recorded.
+     */
+    void sortCanonical();
+
     /**
      * @brief write VTK XML PVTP Header file from rank 0
      *
@@ -130,7 +157,10 @@ class ConstraintCollector {
      * @param delta0Rcp delta_0 vector
      * @param invKappaRcp K^{-1} vector
      * @param biFlagRcp 1 for bilateral, 1 for unilateral
+     * @param frictionRcp Coulomb friction coefficient on the normal row of a frictional contact, 0 otherwise.
+     *                    the next two rows are its tangential rows
      * @param gammaGuessRcp initial guess of gamma
+     * @param keep 1 for the blocks built as rows, in the order of buildConIndex(). all blocks if empty
      * @return int error code (TODO:)
      */
     int buildConstraintMatrixVector(const Teuchos::RCP<const TMAP> &mobMapRcp, //
@@ -138,7 +168,19 @@ class ConstraintCollector {
                                     Teuchos::RCP<TV> &delta0Rcp,               //
                                     Teuchos::RCP<TV> &invKappaRcp,             //
                                     Teuchos::RCP<TV> &biFlagRcp,               //
-                                    Teuchos::RCP<TV> &gammaGuessRcp) const;
+                                    Teuchos::RCP<TV> &frictionRcp,             //
+                                    Teuchos::RCP<TV> &gammaGuessRcp,           //
+                                    const std::vector<char> &keep = std::vector<char>()) const;
+
+    /**
+     * @brief compute D^Trans vel of every block without building D^Trans
+     *
+     * collective. vel is imported from the owner ranks of the objects in the blocks.
+     * @param mobMapRcp mobility map
+     * @param vel velocity, 6 dof per obj
+     * @param rate one per block, in the order of buildConIndex()
+     */
+    void calcBlockRate(const Teuchos::RCP<const TMAP> &mobMapRcp, const TV &vel, std::vector<double> &rate) const;
 
     // /**
     //  * @brief build the K^{-1} diagonal matrix
@@ -157,13 +199,25 @@ class ConstraintCollector {
      */
     int buildConIndex(std::vector<int> &cQueSize, std::vector<int> &cQueIndex) const;
 
+    /**
+     * @brief build a key identifying each constraint row across timesteps
+     *
+     * key = (smaller gid, larger gid, index), in the order of constraint rows.
+     * index orders the bilateral rows of the same pair by their location on the body with the smaller gid,
+     * so the key does not depend on the order of queues. It is -1 for other rows
+     * @param rowKey
+     * @return bool false if gids are not recorded
+     */
+    bool buildRowKey(std::vector<std::array<int, 3>> &rowKey) const;
+
     /**
      * @brief write back the solution gamma to the blocks
      *
      * @param gammaRcp solution
+     * @param keep the same as in buildConstraintMatrixVector(). gamma = 0 for the other blocks
      * @return int error code (future)
      */
-    int writeBackGamma(const Teuchos::RCP<const TV> &gammaRcp);
+    int writeBackGamma(const Teuchos::RCP<const TV> &gammaRcp, const std::vector<char> &keep = std::vector<char>());
 };
 
 #endif
\ No newline at end of file
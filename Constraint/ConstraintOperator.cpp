@@ -1,5 +1,6 @@
 #include "ConstraintOperator.hpp"
 #include "Util/Logger.hpp"
+#include "Util/Trace.hpp"
 
 ConstraintOperator::ConstraintOperator(Teuchos::RCP<TOP> &mobOp_, Teuchos::RCP<TCMAT> &DMatTransRcp_,
                                        Teuchos::RCP<TV> &invKappa_)
@@ -41,20 +42,36 @@ void ConstraintOperator::apply(const TMV &X, TMV &Y, Teuchos::ETransp mode, scal
         // step 1, D multiply X
         {
             Teuchos::TimeMonitor mon(*applyDMat);
-            DMatRcp->apply(*XcolRcp, *forceRcp); // Du gammac
+            TraceScope trace("ConstraintOperator::ApplyDMat");
+            if (reproducible) {
+                applyReproducible(*DMatRcp, *XcolRcp, *forceRcp);
+            } else {
+                DMatRcp->apply(*XcolRcp, *forceRcp); // Du gammac
+            }
         }
 
         // step 2, Vel = Mobility * FT
         {
             Teuchos::TimeMonitor mon(*applyMobMat);
-            mobOpRcp->apply(*forceRcp, *velRcp);
+            TraceScope trace("ConstraintOperator::ApplyMobility");
+            Teuchos::RCP<const TCMAT> mobMatRcp = Teuchos::rcp_dynamic_cast<const TCMAT>(mobOpRcp);
+            if (reproducible && !mobMatRcp.is_null()) {
+                applyReproducible(*mobMatRcp, *forceRcp, *velRcp);
+            } else {
+                mobOpRcp->apply(*forceRcp, *velRcp);
+            }
         }
 
         // step 3, D^T multiply velocity
         // Y = alpha * Op * X + beta * Y
         {
             Teuchos::TimeMonitor mon(*applyDTransMat);
-            DMatTransRcp->apply(*velRcp, *YcolRcp, Teuchos::NO_TRANS, alpha, beta);
+            TraceScope trace("ConstraintOperator::ApplyDMatTrans");
+            if (reproducible) {
+                applyReproducible(*DMatTransRcp, *velRcp, *YcolRcp, alpha, beta);
+            } else {
+                DMatTransRcp->apply(*velRcp, *YcolRcp, Teuchos::NO_TRANS, alpha, beta);
+            }
         }
 
         // step 4, add diagonal. Y += alpha * invK * X
@@ -70,6 +87,62 @@ void ConstraintOperator::apply(const TMV &X, TMV &Y, Teuchos::ETransp mode, scal
     }
 }
 
+Teuchos::RCP<const TCMAT> ConstraintOperator::getMobilityGhost() const {
+    Teuchos::RCP<const TCMAT> mobMatRcp = Teuchos::rcp_dynamic_cast<const TCMAT>(mobOpRcp);
+    if (mobMatRcp.is_null()) {
+        return Teuchos::null;
+    }
+
+    // mobility rows for all objects in the column map of D^T, including off-rank objects
+    auto colMapRcp = DMatTransRcp->getColMap();
+    Tpetra::Import<int, int> importer(mobMatRcp->getRowMap(), colMapRcp);
+    Teuchos::RCP<TCMAT> mobGhostRcp = Teuchos::rcp(new TCMAT(colMapRcp, 0));
+    mobGhostRcp->doImport(*mobMatRcp, importer, Tpetra::INSERT);
+    mobGhostRcp->fillComplete(mobMatRcp->getDomainMap(), mobMatRcp->getRangeMap());
+    return mobGhostRcp;
+}
+
+void ConstraintOperator::getDiagonal(Teuchos::RCP<TV> &diagRcp) const {
+    diagRcp = Teuchos::rcp(new TV(gammaMapRcp, false));
+    diagRcp->update(1.0, *invKappa, 0.0);
+
+    Teuchos::RCP<const TCMAT> mobGhostRcp = getMobilityGhost();
+    if (mobGhostRcp.is_null()) {
+        diagRcp->putScalar(1.0);
+        diagRcp->update(1.0, *invKappa, 1.0);
+        return;
+    }
+    const TCMAT &mobGhost = *mobGhostRcp;
+    auto colMapRcp = DMatTransRcp->getColMap();
+    auto ghostColMapRcp = mobGhost.getColMap();
+
+    // diag_i = sum_{j,k} D^T(i,j) M(j,k) D^T(i,k), at most 12 entries per row of D^T
+    auto diagPtr = diagRcp->getLocalView<Kokkos::HostSpace>();
+    diagRcp->modify<Kokkos::HostSpace>();
+    const int localSize = diagPtr.dimension_0();
+#pragma omp parallel for
+    for (int i = 0; i < localSize; i++) {
+        Teuchos::ArrayView<const int> cols;
+        Teuchos::ArrayView<const double> vals;
+        DMatTransRcp->getLocalRowView(i, cols, vals);
+        double sum = 0;
+        for (int a = 0; a < cols.size(); a++) {
+            Teuchos::ArrayView<const int> mobCols;
+            Teuchos::ArrayView<const double> mobVals;
+            mobGhost.getLocalRowView(cols[a], mobCols, mobVals); // rowMap of mobGhost == colMap of D^T
+            for (int m = 0; m < mobCols.size(); m++) {
+                const int colDT = colMapRcp->getLocalElement(ghostColMapRcp->getGlobalElement(mobCols[m]));
+                for (int b = 0; b < cols.size(); b++) {
+                    if (cols[b] == colDT) {
+                        sum += vals[a] * mobVals[m] * vals[b];
+                    }
+                }
+            }
+        }
+        diagPtr(i, 0) += sum;
+    }
+}
+
 Teuchos::RCP<const TMAP> ConstraintOperator::getDomainMap() const {
     TEUCHOS_TEST_FOR_EXCEPTION(!gammaMapRcp.is_valid_ptr(), std::invalid_argument, "gammaMap must be valid");
     return gammaMapRcp;
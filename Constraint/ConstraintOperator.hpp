@@ -71,12 +71,39 @@ class ConstraintOperator : public TOP {
      */
     bool hasTransposeApply() const { return false; }
 
+    /**
+     * @brief get the mobility rows of all objects referenced by D^T, including off-rank objects
+     *
+     * The row map of the returned matrix is the column map of D^T
+     * @return Teuchos::RCP<const TCMAT> null if the mobility operator is not a TCMAT
+     */
+    Teuchos::RCP<const TCMAT> getMobilityGhost() const;
+
+    /**
+     * @brief compute the diagonal of this operator, diag(D^T M D) + K^{-1}
+     *
+     * The mobility operator must be a TCMAT, with rows imported for all objects referenced by D^T.
+     * If it is not a TCMAT, the diagonal is approximated by 1 + K^{-1}
+     * @param diagRcp
+     */
+    void getDiagonal(Teuchos::RCP<TV> &diagRcp) const;
+
     void enableTimer();
     void disableTimer();
 
+    /**
+     * @brief apply D, D^T, and the mobility (if it is a TCMAT) with applyReproducible()
+     *
+     * @param reproducible_
+     */
+    void setReproducible(bool reproducible_) { reproducible = reproducible_; }
+
     Teuchos::RCP<TV> getForce() { return forceRcp; }
     Teuchos::RCP<TV> getVel() { return velRcp; }
     Teuchos::RCP<TCMAT> getDMat() { return DMatRcp; }
+    Teuchos::RCP<const TCMAT> getDMatTrans() const { return DMatTransRcp; }
+    Teuchos::RCP<const TV> getInvKappa() const { return invKappa; }
+    Teuchos::RCP<const TOP> getMobility() const { return mobOpRcp; }
 
   private:
     // comm
@@ -93,6 +120,8 @@ class ConstraintOperator : public TOP {
     Teuchos::RCP<TV> forceRcp; ///< force = D gamma
     Teuchos::RCP<TV> velRcp;   ///< vel = M force
 
+    bool reproducible = false; ///< see setReproducible()
+
     // time monitor
     Teuchos::RCP<Teuchos::Time> transposeDMat;
     Teuchos::RCP<Teuchos::Time> applyMobMat;
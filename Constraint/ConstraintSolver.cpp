@@ -13,18 +13,9 @@ void ConstraintSolver::setup(ConstraintCollector &conCollector_, Teuchos::RCP<TO
 
     mobMapRcp = mobOpRcp->getDomainMap();
 
-    conCollector.buildConstraintMatrixVector(mobMapRcp, DMatTransRcp, delta0Rcp, invKappaRcp, biFlagRcp, gammaRcp);
-
-    delta0Rcp->scale(1.0 / dt);
-    invKappaRcp->scale(1.0 / dt);
-
-    deltancRcp = Teuchos::rcp(new TV(delta0Rcp->getMap(), true));
-    DMatTransRcp->apply(*velncRcp, *deltancRcp);
-
-    // the BCQP problem
-    MOpRcp = Teuchos::rcp(new ConstraintOperator(mobOpRcp, DMatTransRcp, invKappaRcp));
-    qRcp = Teuchos::rcp(new TV(delta0Rcp->getMap(), true));
-    qRcp->update(1.0, *delta0Rcp, 1.0, *deltancRcp, 0.0);
+    // screen the blocks before building the matrix, so that removed rows are never assembled
+    screenConstraints();
+    buildProblem();
 
     // result
     forcebRcp = Teuchos::rcp(new TV(mobMapRcp, true));
@@ -48,6 +39,7 @@ void ConstraintSolver::reset() {
     DMatTransRcp.reset(); ///< D^Trans matrix
     invKappaRcp.reset();  ///< K^{-1} diagonal matrix
     biFlagRcp.reset();    ///< bilateral flag vector
+    frictionRcp.reset();  ///< friction coefficient
     delta0Rcp.reset();    ///< the current (geometric) delta vector delta_0 = [delta_0u ; delta_0b]
     deltancRcp.reset();   ///< delta_nc = [Du^Trans vel_nc,u ; Db^Trans vel_nc,b]
 
@@ -55,31 +47,234 @@ void ConstraintSolver::reset() {
     MOpRcp.reset();   ///< the operator of BCQP problem. M = [B,C;E,F]
     gammaRcp.reset(); ///< the unknown constraint force magnitude gamma = [gamma_u;gamma_b]
     qRcp.reset();     ///< the constant part of BCQP problem. q = delta_0 + delta_nc
+
+    screened = false;
+    nScreenedGlobal = 0;
+    screenViolated = false;
+    keepBlock.clear();
+    actRow.clear();
+    screenedRow.clear();
+    qBlock.clear();
+}
+
+void ConstraintSolver::screenConstraints() {
+    if (screenMargin < 0) {
+        return;
+    }
+    const auto &commRcp = mobMapRcp->getComm();
+    const auto &cPool = *conCollector.constraintPoolPtr;
+
+    // q dt = delta_0 + dt D^T vel_nc is the separation at the end of this step without any constraint force
+    // tangential blocks follow their normal block
+    conCollector.calcBlockRate(mobMapRcp, *velncRcp, qBlock);
+    const int nBlock = qBlock.size();
+    keepBlock.assign(nBlock, 1);
+    int b = 0;
+    int nTangential = 0;
+    for (const auto &que : cPool) {
+        const int queSize = que.size();
+        for (int j = 0; j < queSize; j++, b++) {
+            qBlock[b] += que.delta0[j] / dt;
+            if (nTangential > 0) {
+                keepBlock[b] = keepBlock[b - 1];
+                nTangential--;
+                continue;
+            }
+            keepBlock[b] = que.isBilateral(j) || qBlock[b] * dt <= screenMargin;
+            if (!keepBlock[b]) {
+                screenedRow.push_back(b);
+            }
+            nTangential = que.friction[j] > 0 ? 2 : 0;
+        }
+    }
+
+    const int nScreenedLocal = nBlock - std::count(keepBlock.begin(), keepBlock.end(), 1);
+    Teuchos::reduceAll(*commRcp, Teuchos::SumValueReductionOp<int, int>(), 1, &nScreenedLocal, &nScreenedGlobal);
+    screened = nScreenedGlobal > 0;
+    if (!screened) {
+        keepBlock.clear();
+        screenedRow.clear();
+    }
+}
+
+void ConstraintSolver::buildProblem() {
+    conCollector.buildConstraintMatrixVector(mobMapRcp, DMatTransRcp, delta0Rcp, invKappaRcp, biFlagRcp, frictionRcp,
+                                             gammaRcp, keepBlock);
+
+    // the block of each row
+    const int nBlock = conCollector.getLocalNumberOfConstraints();
+    actRow.clear();
+    for (int b = 0; b < nBlock; b++) {
+        if (keepBlock.empty() || keepBlock[b]) {
+            actRow.push_back(b);
+        }
+    }
+
+    delta0Rcp->scale(1.0 / dt);
+    invKappaRcp->scale(1.0 / dt);
+
+    deltancRcp = Teuchos::rcp(new TV(delta0Rcp->getMap(), true));
+    applyMatrix(*DMatTransRcp, *velncRcp, *deltancRcp);
+
+    // the BCQP problem
+    qRcp = Teuchos::rcp(new TV(delta0Rcp->getMap(), true));
+    qRcp->update(1.0, *delta0Rcp, 1.0, *deltancRcp, 0.0);
+    MOpRcp.reset();
+    if (gammaRcp->getGlobalLength() > 0) {
+        MOpRcp = Teuchos::rcp(new ConstraintOperator(mobOpRcp, DMatTransRcp, invKappaRcp));
+        MOpRcp->setReproducible(reproducible);
+    }
 }
 
 void ConstraintSolver::solveConstraints() {
-    const auto &commRcp = gammaRcp->getMap()->getComm();
+    const int nActGlobal = gammaRcp->getGlobalLength();
+    screenViolated = false;
+    spdlog::debug("Constraint screen {} removed, {} kept", nScreenedGlobal, nActGlobal);
+    if (nActGlobal == 0) {
+        // every constraint stays inactive, the constraint force and velocity are zero from setup()
+        spdlog::debug("BCQP skipped, no active constraint");
+        return;
+    }
+
+    solveActive();
+    if (!screened || checkScreened()) {
+        return;
+    }
+
+    // the solution of the kept rows is the initial guess of the full problem, removed rows have gamma = 0
+    spdlog::warn("removed constraints violated, solve again with all {} constraints", nActGlobal + nScreenedGlobal);
+    screenViolated = true;
+    Teuchos::RCP<const TV> gammaActRcp = gammaRcp;
+    const std::vector<int> actRowScreened = actRow;
+    screened = false;
+    keepBlock.clear();
+    buildProblem();
+    gammaRcp->putScalar(0);
+    auto gammaPtr = gammaRcp->getLocalView<Kokkos::HostSpace>();
+    auto gammaActPtr = gammaActRcp->getLocalView<Kokkos::HostSpace>();
+    gammaRcp->modify<Kokkos::HostSpace>();
+    const int nAct = actRowScreened.size();
+    for (int a = 0; a < nAct; a++) {
+        gammaPtr(actRowScreened[a], 0) = gammaActPtr(a, 0);
+    }
+    solveActive();
+}
+
+bool ConstraintSolver::checkScreened() const {
+    const auto &commRcp = mobMapRcp->getComm();
+
+    // delta/dt at the end of this step = q + D^T vel_c, on the removed normal rows
+    Teuchos::RCP<TV> velRcp = Teuchos::rcp(new TV(mobMapRcp, false));
+    velRcp->update(1.0, *veluRcp, 1.0, *velbRcp, 0.0);
+    std::vector<double> rate;
+    conCollector.calcBlockRate(mobMapRcp, *velRcp, rate);
+
+    int nViolatedLocal = 0;
+    for (auto b : screenedRow) {
+        if (qBlock[b] + rate[b] < -res / dt) {
+            nViolatedLocal++;
+        }
+    }
+    int nViolatedGlobal = 0;
+    Teuchos::reduceAll(*commRcp, Teuchos::SumValueReductionOp<int, int>(), 1, &nViolatedLocal, &nViolatedGlobal);
+    spdlog::debug("{} removed constraints violated", nViolatedGlobal);
+    return nViolatedGlobal == 0;
+}
+
+void ConstraintSolver::solveActive() {
     // solver
     BCQPSolver solver(MOpRcp, qRcp);
+    solver.setReproducible(reproducible);
     spdlog::debug("solver constructed");
 
     // the bound of BCQP. 0 for gammau, unbound for gammab.
     Teuchos::RCP<TV> lbRcp = solver.getLowerBound();
     lbRcp->scale(-std::numeric_limits<double>::max() * .1, *biFlagRcp); // 0 if biFlag=0, -inf if biFlag=1
+
+    // friction cones. the tangential rows are unbound, and projected with the normal row
+    const bool friction = frictionRcp->normInf() > 0;
+    if (friction) {
+        auto frictionPtr = frictionRcp->getLocalView<Kokkos::HostSpace>();
+        auto lbPtr = lbRcp->getLocalView<Kokkos::HostSpace>();
+        lbRcp->modify<Kokkos::HostSpace>();
+        const int nLocal = lbPtr.dimension_0();
+        for (int i = 0; i < nLocal; i++) {
+            if (frictionPtr(i, 0) > 0) {
+                lbPtr(i + 1, 0) = -std::numeric_limits<double>::max() * .1;
+                lbPtr(i + 2, 0) = -std::numeric_limits<double>::max() * .1;
+                i += 2;
+            }
+        }
+        solver.setFriction(frictionRcp);
+    }
     spdlog::debug("bound constructed");
 
     // solve
     IteHistory history;
-    switch (solverChoice) {
-    case 0:
-        solver.solveBBPGD(gammaRcp, res * (1.0/ dt), maxIte, history);
-        break;
-    case 1:
-        solver.solveAPGD(gammaRcp, res * (1.0/ dt), maxIte, history);
-        break;
-    default:
-        solver.solveBBPGD(gammaRcp, res * (1.0/ dt), maxIte, history);
-        break;
+
+    // bilateral constraints have no bound. the BCQP problem of these rows is an SPD linear system
+    const double nBiGlobal = biFlagRcp->norm1();
+    const double nConGlobal = gammaRcp->getGlobalLength();
+    const bool biOnly = BilateralSolver::isBilateralOnly(*biFlagRcp);
+    const bool biCG = biChoice > 0 && !reproducible && nBiGlobal > 0 && (biOnly || biChoice > 1);
+    if (biCG) {
+        Teuchos::RCP<TV> diagRcp;
+        MOpRcp->getDiagonal(diagRcp);
+        BilateralSolver biSolver(MOpRcp, qRcp, biFlagRcp, diagRcp);
+        const bool mobMat = !Teuchos::rcp_dynamic_cast<const TCMAT>(mobOpRcp).is_null();
+#ifdef SIMTOOLBOX_MUELU
+        const bool amgPrecond = !amgPrecRcp.is_null() && mobMat;
+        if (amgPrecond) {
+            amgPrecRcp->update(*MOpRcp, biFlagRcp);
+            biSolver.setPreconditioner(amgPrecRcp);
+        }
+#else
+        const bool amgPrecond = false;
+#endif
+        if (chainPrecond && mobMat && !amgPrecond) {
+            Teuchos::RCP<ChainPreconditioner> precRcp = Teuchos::rcp(new ChainPreconditioner(*MOpRcp, biFlagRcp));
+            spdlog::debug("chain preconditioner, {} chains, max length {}", precRcp->getChainNumber(),
+                          precRcp->getMaxChainLength());
+            biSolver.setPreconditioner(precRcp);
+        }
+        std::vector<RecycleSpace::RowKey> rowKey;
+        if (recyclePtr && conCollector.buildRowKey(rowKey)) {
+            std::vector<RecycleSpace::RowKey> actKey(actRow.size());
+            for (int a = 0; a < actRow.size(); a++) {
+                actKey[a] = rowKey[actRow[a]];
+            }
+            recyclePtr->setRows(actKey, gammaRcp->getMap());
+            biSolver.setRecycleSpace(recyclePtr);
+        }
+        biSolver.solveCG(gammaRcp, res * (1.0 / dt), maxIte, history);
+        spdlog::debug("bilateral CG, {:g} of {:g} constraints are bilateral", nBiGlobal, nConGlobal);
+    }
+
+    if (!(biOnly && biCG)) { // otherwise gamma is already the exact solution
+        switch (solverChoice) {
+        case 0:
+            solver.solveBBPGD(gammaRcp, res * (1.0 / dt), maxIte, history);
+            break;
+        case 1:
+            solver.solveAPGD(gammaRcp, res * (1.0 / dt), maxIte, history);
+            break;
+        case 2:
+            // local solves depend on the partition, and need the mobility rows of ghost objects
+            // the shifted bound of local solves is a box, which friction cones are not
+            if (reproducible || friction || Teuchos::rcp_dynamic_cast<const TCMAT>(mobOpRcp).is_null()) {
+                spdlog::warn("Schwarz solver requires an explicit mobility, no friction, and reproducible off, "
+                             "use BBPGD");
+                solver.solveBBPGD(gammaRcp, res * (1.0 / dt), maxIte, history);
+            } else {
+                SchwarzSolver schwarz(MOpRcp, qRcp, lbRcp);
+                schwarz.setCoarseCorrection(schwarzCoarse);
+                schwarz.solve(gammaRcp, res * (1.0 / dt), maxIte, history);
+            }
+            break;
+        default:
+            solver.solveBBPGD(gammaRcp, res * (1.0 / dt), maxIte, history);
+            break;
+        }
     }
 
     for (auto it = history.begin(); it != history.end() - 1; it++) {
@@ -97,8 +292,8 @@ void ConstraintSolver::solveConstraints() {
     // bilateral first
     Teuchos::RCP<TV> gammaBiRcp = Teuchos::rcp(new TV(gammaRcp->getMap(), true));
     gammaBiRcp->elementWiseMultiply(1.0, *gammaRcp, *biFlagRcp, 0.0);
-    DMatRcp->apply(*gammaBiRcp, *forcebRcp);
-    mobOpRcp->apply(*forcebRcp, *velbRcp);
+    applyMatrix(*DMatRcp, *gammaBiRcp, *forcebRcp);
+    applyMobility(*forcebRcp, *velbRcp);
     // unilateral second
     Teuchos::RCP<TV> forceRcp = MOpRcp->getForce();
     Teuchos::RCP<TV> velRcp = MOpRcp->getVel();
@@ -106,4 +301,59 @@ void ConstraintSolver::solveConstraints() {
     veluRcp->update(1.0, *velRcp, -1.0, *velbRcp, 0.0);       // vel_u = vel - vel_b
 }
 
-void ConstraintSolver::writebackGamma() { conCollector.writeBackGamma(gammaRcp.getConst()); }
\ No newline at end of file
+void ConstraintSolver::setAMGPreconditioner(bool amgPrecond) {
+#ifdef SIMTOOLBOX_MUELU
+    if (!amgPrecond) {
+        amgPrecRcp.reset();
+    } else if (amgPrecRcp.is_null()) {
+        amgPrecRcp = Teuchos::rcp(new AMGPreconditioner());
+    }
+#else
+    static bool warned = false;
+    if (amgPrecond && !warned) {
+        spdlog::warn("Trilinos is built without MueLu, AMG preconditioner ignored");
+        warned = true;
+    }
+#endif
+}
+
+void ConstraintSolver::applyMatrix(const TCMAT &A, const TV &x, TV &y) const {
+    if (reproducible) {
+        applyReproducible(A, x, y);
+    } else {
+        A.apply(x, y);
+    }
+}
+
+void ConstraintSolver::applyMobility(const TV &force, TV &vel) const {
+    Teuchos::RCP<const TCMAT> mobMatRcp = Teuchos::rcp_dynamic_cast<const TCMAT>(mobOpRcp);
+    if (reproducible && !mobMatRcp.is_null()) {
+        applyReproducible(*mobMatRcp, force, vel);
+    } else {
+        mobOpRcp->apply(force, vel);
+    }
+}
+
+void ConstraintSolver::writebackGamma() { conCollector.writeBackGamma(gammaRcp.getConst(), keepBlock); }
+
+size_t ConstraintSolver::getMatrixBytes() const {
+    size_t bytes = 0;
+    if (!DMatTransRcp.is_null()) {
+        bytes += getTCMATBytes(*DMatTransRcp);
+    }
+    if (!MOpRcp.is_null() && !MOpRcp->getDMat().is_null()) {
+        bytes += getTCMATBytes(*(MOpRcp->getDMat()));
+    }
+    return bytes;
+}
+
+size_t ConstraintSolver::getVectorBytes() const {
+    size_t bytes = 0;
+    for (const auto &vecRcp : {forceuRcp, forcebRcp, veluRcp, velbRcp, invKappaRcp, biFlagRcp, frictionRcp, delta0Rcp,
+                               deltancRcp, gammaRcp, qRcp}) {
+        if (!vecRcp.is_null()) {
+            bytes += getTMVBytes(*vecRcp);
+        }
+    }
+    return bytes;
+}
@@ -11,15 +11,22 @@
 #ifndef CONSTRAINTSOLVER_HPP_
 #define CONSTRAINTSOLVER_HPP_
 
+#include "AMGPreconditioner.hpp"
 #include "BCQPSolver.hpp"
+#include "BilateralSolver.hpp"
+#include "ChainPreconditioner.hpp"
 #include "ConstraintCollector.hpp"
 #include "ConstraintOperator.hpp"
+#include "RecycleSpace.hpp"
+#include "SchwarzSolver.hpp"
 
 #include "Trilinos/TpetraUtil.hpp"
 #include "Util/EigenDef.hpp"
 
 #include <algorithm>
 #include <cmath>
+#include <memory>
+#include <numeric>
 #include <vector>
 
 #include <mpi.h>
@@ -61,6 +68,70 @@ class ConstraintSolver {
         solverChoice = solver_;
     }
 
+    /**
+     * @brief set the choice of linear solve for bilateral constraints
+     *
+     * @param biChoice_ 0 off, 1 CG for steps with only bilateral constraints,
+     *                  2 also CG for the bilateral block as the initial guess of BCQP in mixed steps
+     */
+    void setBilateralChoice(int biChoice_) { biChoice = biChoice_; }
+
+    /**
+     * @brief use the block tridiagonal chain solver as the preconditioner of bilateral CG
+     *
+     * @param chainPrecond_ true for chain solver, false for Jacobi
+     */
+    void setChainPreconditioner(bool chainPrecond_) { chainPrecond = chainPrecond_; }
+
+    /**
+     * @brief use the coarse correction of the Schwarz solver, solverChoice = 2
+     *
+     * @param schwarzCoarse_ true for the step length of each subdomain by the coarse problem, false for 1
+     */
+    void setSchwarzCoarse(bool schwarzCoarse_) { schwarzCoarse = schwarzCoarse_; }
+
+    /**
+     * @brief use smoothed aggregation AMG as the preconditioner of bilateral CG, instead of the chain solver
+     *
+     * The hierarchy is kept by reset(), and reused while the constraint graph is unchanged.
+     * Requires Trilinos with MueLu, otherwise ignored.
+     * @param amgPrecond
+     */
+    void setAMGPreconditioner(bool amgPrecond);
+
+    /**
+     * @brief remove unilateral constraints that stay inactive from the BCQP problem
+     *
+     * A unilateral constraint is removed if delta_0 + dt D^T vel_nc > screenMargin_.
+     * The tangential rows of a frictional contact are kept or removed together with its normal row.
+     * After the solve, the removed constraints are checked with the constraint velocity.
+     * If any of them is violated, the full problem is solved again.
+     * @param screenMargin_ negative to solve all constraints
+     */
+    void setScreenMargin(double screenMargin_) { screenMargin = screenMargin_; }
+
+    /**
+     * @brief make the solution independent of the distribution of constraints and the number of threads
+     *
+     * Matrix rows and dot products are summed with ReproSum, and the bilateral CG is not used.
+     * @param reproducible_
+     */
+    void setReproducible(bool reproducible_) { reproducible = reproducible_; }
+
+    /**
+     * @brief keep the solutions of bilateral CG to improve its initial guess in later steps
+     *
+     * The space is kept by reset(), and needs the gids of constraints recorded in the collector.
+     * @param recycleSize number of solutions kept, 0 to turn off
+     */
+    void setRecycleSize(int recycleSize) {
+        if (recycleSize <= 0) {
+            recyclePtr.reset();
+        } else if (!recyclePtr || recyclePtr->getMaxSize() != recycleSize) {
+            recyclePtr = std::make_shared<RecycleSpace>(recycleSize);
+        }
+    }
+
     /**
      * @brief setup this solver for solution
      *
@@ -87,11 +158,48 @@ class ConstraintSolver {
     Teuchos::RCP<const TV> getForceBi() const { return forcebRcp; }
     Teuchos::RCP<const TV> getVelocityBi() const { return velbRcp; }
 
+    /**
+     * @brief number of constraints removed by screening on all ranks in the last setup()
+     *
+     * @return int
+     */
+    int getScreenedNumber() const { return nScreenedGlobal; }
+
+    /**
+     * @brief if removed constraints were violated in the last solve, and the full problem was solved again
+     *
+     * @return bool
+     */
+    bool isScreenViolated() const { return screenViolated; }
+
+    /**
+     * @brief bytes of the local part of D^Trans and D
+     *
+     * @return size_t
+     */
+    size_t getMatrixBytes() const;
+
+    /**
+     * @brief bytes of the local part of all force, velocity and constraint vectors
+     *
+     * @return size_t
+     */
+    size_t getVectorBytes() const;
+
   private:
-    double dt;        ///< timestep size
-    double res;       ///< residual tolerance
-    int maxIte;       ///< max iterations
-    int solverChoice; ///< which solver to use
+    double dt;                ///< timestep size
+    double res;               ///< residual tolerance
+    int maxIte;               ///< max iterations
+    int solverChoice;         ///< which solver to use
+    int biChoice = 1;         ///< linear solve for bilateral constraints, see setBilateralChoice()
+    bool chainPrecond = true; ///< chain preconditioner for bilateral CG, see setChainPreconditioner()
+    bool schwarzCoarse = true; ///< coarse correction of SchwarzSolver, see setSchwarzCoarse()
+    double screenMargin = -1; ///< see setScreenMargin()
+    bool reproducible = false; ///< see setReproducible()
+    std::shared_ptr<RecycleSpace> recyclePtr; ///< see setRecycleSize()
+#ifdef SIMTOOLBOX_MUELU
+    Teuchos::RCP<AMGPreconditioner> amgPrecRcp; ///< see setAMGPreconditioner()
+#endif
 
     ConstraintCollector conCollector; ///< constraints
 
@@ -108,6 +216,7 @@ class ConstraintSolver {
     Teuchos::RCP<TCMAT> DMatTransRcp; ///< D^Trans matrix
     Teuchos::RCP<TV> invKappaRcp; ///< K^{-1} diagonal matrix
     Teuchos::RCP<TV> biFlagRcp; ///< bilateral flag vector
+    Teuchos::RCP<TV> frictionRcp; ///< friction coefficient on normal rows, the next two rows are tangential
     Teuchos::RCP<TV> delta0Rcp;  ///< the current (geometric) delta vector delta_0 = [delta_0u ; delta_0b]
     Teuchos::RCP<TV> deltancRcp; ///< delta_nc = [Du^Trans vel_nc,u ; Db^Trans vel_nc,b]
     
@@ -117,6 +226,57 @@ class ConstraintSolver {
     Teuchos::RCP<TV> gammaRcp;               ///< the unknown constraint force magnitude gamma = [gamma_u;gamma_b]
     Teuchos::RCP<TV> qRcp;                   ///< the constant part of BCQP problem. q = delta_0 + delta_nc
 
+    // screening, the objects above are built only for the kept blocks
+    bool screened = false;        ///< if some constraints are removed from the BCQP problem on any rank
+    int nScreenedGlobal = 0;      ///< number of removed constraints on all ranks
+    bool screenViolated = false;  ///< if the full problem was solved again, see isScreenViolated()
+    std::vector<char> keepBlock;  ///< 1 for the local blocks kept in the BCQP problem, empty if all are kept
+    std::vector<int> actRow;      ///< the local block of each row of gamma
+    std::vector<int> screenedRow; ///< the removed local blocks, normal rows only
+    std::vector<double> qBlock;   ///< q of every local block, computed by screenConstraints()
+
+    /**
+     * @brief find the blocks kept in the BCQP problem according to screenMargin, before building the matrix
+     *
+     */
+    void screenConstraints();
+
+    /**
+     * @brief build D^Trans, the vectors, q and MOpRcp for the blocks in keepBlock
+     *
+     */
+    void buildProblem();
+
+    /**
+     * @brief solve the BCQP problem of the kept rows and compute the constraint force and velocity
+     *
+     */
+    void solveActive();
+
+    /**
+     * @brief check if the removed constraints are violated with the constraint velocity
+     *
+     * Computed per block with ConstraintCollector::calcBlockRate(), as the removed rows are not in D^Trans.
+     * @return true if no removed constraint is violated on any rank
+     */
+    bool checkScreened() const;
+
+    /**
+     * @brief y = A x, with applyReproducible() if reproducible
+     *
+     * @param A
+     * @param x
+     * @param y
+     */
+    void applyMatrix(const TCMAT &A, const TV &x, TV &y) const;
+
+    /**
+     * @brief vel = M force, with applyReproducible() if reproducible and M is a TCMAT
+     *
+     * @param force
+     * @param vel
+     */
+    void applyMobility(const TV &force, TV &vel) const;
 };
 
 #endif
\ No newline at end of file
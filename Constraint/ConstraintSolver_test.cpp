@@ -0,0 +1,127 @@
+/**
+ * @file ConstraintSolver_test.cpp
+ * @brief test of constraint screening on a row of three spheres
+ *
+ */
+
+#include "ConstraintCollector.hpp"
+#include "ConstraintSolver.hpp"
+#include "Util/Logger.hpp"
+
+#include <cmath>
+#include <utility>
+#include <vector>
+
+#include <mpi.h>
+
+/**
+ * @brief solve contacts A-B and B-C of three spheres A, B, C along x with unit mobility, all on rank 0
+ *
+ * The contact A-B pushes B towards C.
+ * @param delta0AB separation of A-B, negative for overlap
+ * @param delta0BC separation of B-C
+ * @param screenMargin negative to solve all constraints
+ * @param gamma [out] gamma of A-B and B-C
+ * @param nScreened [out] number of screened constraints
+ * @param violated [out] if the full problem was solved again
+ */
+void solveRow(const double delta0AB, const double delta0BC, const double screenMargin, double gamma[2], int &nScreened,
+              bool &violated) {
+    Teuchos::RCP<const TCOMM> commRcp = getMPIWORLDTCOMM();
+    const bool master = commRcp->getRank() == 0;
+    const int nObjLocal = master ? 3 : 0;
+    Teuchos::RCP<const TMAP> mobMapRcp = getTMAPFromLocalSize(6 * nObjLocal, commRcp);
+    std::vector<std::vector<std::pair<int, double>>> mobRows(6 * nObjLocal);
+    for (int i = 0; i < 6 * nObjLocal; i++) {
+        mobRows[i].emplace_back(i, 1.0);
+    }
+    Teuchos::RCP<TOP> mobOpRcp = getTCMATFromRowEntries(mobRows, mobMapRcp, mobMapRcp);
+    Teuchos::RCP<TV> velncRcp = Teuchos::rcp(new TV(mobMapRcp, true));
+
+    // normI points from J to I, so delta grows as the spheres separate
+    const double zero[3] = {0, 0, 0};
+    const double normI[3] = {-1, 0, 0};
+    const double normJ[3] = {1, 0, 0};
+    const double posI[3] = {0.5, 0, 0};
+    const double posJ[3] = {-0.5, 0, 0};
+    ConstraintCollector collector;
+    auto &pool = *collector.constraintPoolPtr;
+    for (auto &que : pool) {
+        que.clear();
+    }
+    if (master) {
+        pool[0].push_back(ConstraintBlock(delta0AB, 0, 0, 1, 0, 1, normI, normJ, posI, posJ, zero, zero, false, false,
+                                          0, 0));
+        pool[0].push_back(ConstraintBlock(delta0BC, 0, 1, 2, 1, 2, normI, normJ, posI, posJ, zero, zero, false, false,
+                                          0, 0));
+    }
+
+    ConstraintSolver solver;
+    solver.setScreenMargin(screenMargin);
+    solver.setup(collector, mobOpRcp, velncRcp, 1.0);
+    solver.setControlParams(1e-10, 10000, 0);
+    solver.solveConstraints();
+    solver.writebackGamma();
+
+    gamma[0] = master ? pool[0].gamma[0] : 0;
+    gamma[1] = master ? pool[0].gamma[1] : 0;
+    MPI_Bcast(gamma, 2, MPI_DOUBLE, 0, MPI_COMM_WORLD);
+    nScreened = solver.getScreenedNumber();
+    violated = solver.isScreenViolated();
+}
+
+/**
+ * @brief B-C is far apart and screened, the contact A-B is the same as the unscreened solve
+ *
+ * gamma_AB = 0.05 moves B by 0.05, B-C stays separated
+ * @return bool
+ */
+bool testScreenFar() {
+    double gammaFull[2], gammaScreen[2];
+    int nScreened = 0;
+    bool violated = false;
+    solveRow(-0.1, 8, -1, gammaFull, nScreened, violated);
+    if (nScreened != 0 || violated) {
+        return false;
+    }
+    solveRow(-0.1, 8, 0.5, gammaScreen, nScreened, violated);
+    if (nScreened != 1 || violated) {
+        return false;
+    }
+    return std::abs(gammaFull[0] - 0.05) < 1e-6 && gammaFull[1] == 0 && gammaScreen[1] == 0 &&
+           std::abs(gammaScreen[0] - gammaFull[0]) < 1e-6;
+}
+
+/**
+ * @brief B-C is screened, but the contact A-B pushes B into C, and the full problem is solved again
+ *
+ * With A-B alone, gamma_AB = 0.5 moves B by 0.5 and B-C overlaps by 0.2.
+ * The full problem is [2,-1;-1,2] gamma + [-1;0.3] = 0, gamma = [1.7/3; 0.4/3]
+ * @return bool
+ */
+bool testScreenViolated() {
+    double gammaFull[2], gammaScreen[2];
+    int nScreened = 0;
+    bool violated = false;
+    solveRow(-1, 0.3, -1, gammaFull, nScreened, violated);
+    if (nScreened != 0 || violated) {
+        return false;
+    }
+    solveRow(-1, 0.3, 0.2, gammaScreen, nScreened, violated);
+    if (nScreened != 1 || !violated) {
+        return false;
+    }
+    return std::abs(gammaFull[0] - 1.7 / 3) < 1e-6 && std::abs(gammaFull[1] - 0.4 / 3) < 1e-6 &&
+           std::abs(gammaScreen[0] - gammaFull[0]) < 1e-6 && std::abs(gammaScreen[1] - gammaFull[1]) < 1e-6;
+}
+
+int main(int argc, char **argv) {
+    MPI_Init(&argc, &argv);
+    {
+        Logger::setup_mpi_spdlog();
+        const bool pass = testScreenFar() && testScreenViolated();
+        spdlog::info(pass ? "TestPassed" : "Error in constraint screening test");
+    }
+    MPI_Finalize();
+    return 0;
+}
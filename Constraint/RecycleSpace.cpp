@@ -0,0 +1,140 @@
+#include "RecycleSpace.hpp"
+
+#include "Util/EigenDef.hpp"
+
+#include <map>
+
+void RecycleSpace::setRows(const std::vector<RowKey> &rowKey_, const Teuchos::RCP<const TMAP> &mapRcp_) {
+    TEUCHOS_TEST_FOR_EXCEPTION(rowKey_.size() != mapRcp_->getNodeNumElements(), std::invalid_argument,
+                               "RecycleSpace: the number of row keys does not match the map.");
+    std::map<RowKey, int> oldIndex;
+    for (int i = 0; i < rowKey.size(); i++) {
+        oldIndex[rowKey[i]] = i;
+    }
+    const int nNew = rowKey_.size();
+    std::vector<int> fromIndex(nNew, -1);
+    for (int i = 0; i < nNew; i++) {
+        auto it = oldIndex.find(rowKey_[i]);
+        if (it != oldIndex.end()) {
+            fromIndex[i] = it->second;
+        }
+    }
+
+    for (auto &vec : basis) {
+        std::vector<double> newVec(nNew, 0);
+        for (int i = 0; i < nNew; i++) {
+            newVec[i] = fromIndex[i] < 0 ? 0 : vec[fromIndex[i]];
+        }
+        vec.swap(newVec);
+    }
+    rowKey = rowKey_;
+    mapRcp = mapRcp_;
+}
+
+int RecycleSpace::project(const TOP &A, const TV &b, TV &x) const {
+    const int k = basis.size();
+    if (k == 0) {
+        return 0;
+    }
+    TEUCHOS_TEST_FOR_EXCEPTION(!mapRcp->isSameAs(*(x.getMap())), std::invalid_argument,
+                               "RecycleSpace: call setRows() with the map of x first.");
+    const int nLocal = rowKey.size();
+
+    // r = b - A x, AU = A U
+    TV r(b, Teuchos::Copy);
+    A.apply(x, r, Teuchos::NO_TRANS, -1.0, 1.0);
+    TMV U(mapRcp, k, false);
+    {
+        auto uView = U.getLocalView<Kokkos::HostSpace>();
+        U.modify<Kokkos::HostSpace>();
+        for (int v = 0; v < k; v++) {
+#pragma omp parallel for
+            for (int i = 0; i < nLocal; i++) {
+                uView(i, v) = basis[v][i];
+            }
+        }
+    }
+    TMV AU(mapRcp, k, false);
+    A.apply(U, AU);
+
+    // G = U^T A U and c = U^T r, in one reduction
+    auto uView = U.getLocalView<Kokkos::HostSpace>();
+    auto auView = AU.getLocalView<Kokkos::HostSpace>();
+    auto rView = r.getLocalView<Kokkos::HostSpace>();
+    std::vector<double> dotLocal(k * k + k, 0);
+    std::vector<double> dotGlobal(k * k + k, 0);
+    for (int v = 0; v < k; v++) {
+        for (int w = 0; w < k; w++) {
+            double sum = 0;
+#pragma omp parallel for reduction(+ : sum)
+            for (int i = 0; i < nLocal; i++) {
+                sum += uView(i, v) * auView(i, w);
+            }
+            dotLocal[v * k + w] = sum;
+        }
+        double sum = 0;
+#pragma omp parallel for reduction(+ : sum)
+        for (int i = 0; i < nLocal; i++) {
+            sum += uView(i, v) * rView(i, 0);
+        }
+        dotLocal[k * k + v] = sum;
+    }
+    Teuchos::reduceAll(*(mapRcp->getComm()), Teuchos::REDUCE_SUM, k * k + k, dotLocal.data(), dotGlobal.data());
+
+    // pseudo inverse of the symmetric part, previous solutions are often nearly parallel
+    Emat G(k, k);
+    Evec c(k);
+    for (int v = 0; v < k; v++) {
+        for (int w = 0; w < k; w++) {
+            G(v, w) = 0.5 * (dotGlobal[v * k + w] + dotGlobal[w * k + v]);
+        }
+        c[v] = dotGlobal[k * k + v];
+    }
+    Eigen::SelfAdjointEigenSolver<Emat> eig(G);
+    const Evec &lambda = eig.eigenvalues();
+    const double lambdaMax = lambda.cwiseAbs().maxCoeff();
+    Evec proj = eig.eigenvectors().transpose() * c;
+    for (int v = 0; v < k; v++) {
+        proj[v] = lambda[v] > 1e-12 * lambdaMax ? proj[v] / lambda[v] : 0;
+    }
+    const Evec y = eig.eigenvectors() * proj;
+
+    // x += U y
+    auto xView = x.getLocalView<Kokkos::HostSpace>();
+    x.modify<Kokkos::HostSpace>();
+#pragma omp parallel for
+    for (int i = 0; i < nLocal; i++) {
+        double sum = 0;
+        for (int v = 0; v < k; v++) {
+            sum += uView(i, v) * y[v];
+        }
+        xView(i, 0) += sum;
+    }
+
+    return k + 1;
+}
+
+void RecycleSpace::add(const TV &x, const Teuchos::RCP<const TV> &maskRcp) {
+    if (maxSize <= 0) {
+        return;
+    }
+    TEUCHOS_TEST_FOR_EXCEPTION(!mapRcp->isSameAs(*(x.getMap())), std::invalid_argument,
+                               "RecycleSpace: call setRows() with the map of x first.");
+    const int nLocal = rowKey.size();
+    auto xView = x.getLocalView<Kokkos::HostSpace>();
+    std::vector<double> vec(nLocal);
+    if (maskRcp.is_null()) {
+        for (int i = 0; i < nLocal; i++) {
+            vec[i] = xView(i, 0);
+        }
+    } else {
+        auto maskView = maskRcp->getLocalView<Kokkos::HostSpace>();
+        for (int i = 0; i < nLocal; i++) {
+            vec[i] = maskView(i, 0) > 0.5 ? xView(i, 0) : 0;
+        }
+    }
+    basis.push_back(std::move(vec));
+    while (basis.size() > maxSize) {
+        basis.pop_front();
+    }
+}
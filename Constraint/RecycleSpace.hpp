@@ -0,0 +1,81 @@
+/**
+ * @file RecycleSpace.hpp
+ * @brief Recycle previous solutions of the bilateral solve across timesteps
+ *
+ */
+#ifndef RECYCLESPACE_HPP_
+#define RECYCLESPACE_HPP_
+
+#include "Trilinos/TpetraUtil.hpp"
+
+#include <array>
+#include <deque>
+#include <vector>
+
+/**
+ * @brief a space spanned by the solutions of previous timesteps, kept across changes of the constraint set
+ *
+ * Constraint rows are identified by a key (gidI, gidJ, index among the rows of the same pair), so the space is
+ * mapped to the rows of each new problem. Rows not present in a previous step have zero entries.
+ * Keys must not depend on the order of rows, see ConstraintCollector::buildRowKey().
+ * Rows sharing a key must have zero entries, such as unmasked rows of add().
+ * The initial guess of a new solve is corrected by the Galerkin projection onto this space:
+ *   \f$ x := x + U (U^T A U)^{+} U^T (b - A x) \f$
+ * which is the best approximation in the A-norm if A is SPD. This costs size()+1 operator applications.
+ */
+class RecycleSpace {
+  public:
+    using RowKey = std::array<int, 3>; ///< gidI, gidJ, index among the rows of the same pair, or -1
+
+    /**
+     * @brief Construct a new RecycleSpace object
+     *
+     * @param maxSize_ max number of vectors kept, the oldest are dropped first
+     */
+    explicit RecycleSpace(int maxSize_) : maxSize(maxSize_) {}
+
+    ~RecycleSpace() = default;
+
+    int getMaxSize() const { return maxSize; }
+    int getSize() const { return basis.size(); }
+
+    /**
+     * @brief map the stored vectors to the rows of a new problem
+     *
+     * @param rowKey_ key of each local row
+     * @param mapRcp_ the map of the new problem
+     */
+    void setRows(const std::vector<RowKey> &rowKey_, const Teuchos::RCP<const TMAP> &mapRcp_);
+
+    /**
+     * @brief correct x by the Galerkin projection of the error onto the space
+     *
+     * collective
+     * @param A SPD operator
+     * @param b
+     * @param x [in,out] initial guess
+     * @return int number of operator applications
+     */
+    int project(const TOP &A, const TV &b, TV &x) const;
+
+    /**
+     * @brief add a solution to the space
+     *
+     * @param x
+     * @param maskRcp only entries with mask > 0.5 are kept, all if null
+     */
+    void add(const TV &x, const Teuchos::RCP<const TV> &maskRcp = Teuchos::null);
+
+    void clear() {
+        basis.clear();
+        rowKey.clear();
+    }
+
+  private:
+    int maxSize;                           ///< max number of vectors
+    std::vector<RowKey> rowKey;            ///< key of each local row of the current problem
+    Teuchos::RCP<const TMAP> mapRcp;       ///< map of the current problem
+    std::deque<std::vector<double>> basis; ///< local entries of each vector on the current rows, oldest first
+};
+
+#endif
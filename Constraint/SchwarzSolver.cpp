@@ -0,0 +1,385 @@
+#include "SchwarzSolver.hpp"
+
+#include "Util/Logger.hpp"
+#include "Util/Trace.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <map>
+#include <unordered_map>
+#include <utility>
+
+#include <mpi.h>
+
+SchwarzSolver::SchwarzSolver(const Teuchos::RCP<const ConstraintOperator> &AOpRcp_,
+                             const Teuchos::RCP<const TV> &bRcp_, const Teuchos::RCP<const TV> &lbRcp_)
+    : AOpRcp(AOpRcp_), bRcp(bRcp_), lbRcp(lbRcp_), mapRcp(bRcp_->getMap()), commRcp(bRcp_->getMap()->getComm()) {
+    TEUCHOS_TEST_FOR_EXCEPTION(!(AOpRcp->getDomainMap()->isSameAs(*(bRcp->getMap()))), std::invalid_argument,
+                               "A (domain) and b do not have the same Map.");
+    TEUCHOS_TEST_FOR_EXCEPTION(!(mapRcp->isSameAs(*(lbRcp->getMap()))), std::invalid_argument,
+                               "b and lb do not have the same Map.");
+    assembleLocal();
+}
+
+void SchwarzSolver::assembleLocal() {
+    auto DTRcp = AOpRcp->getDMatTrans();
+    auto invKappaRcp = AOpRcp->getInvKappa();
+    auto mobGhostRcp = AOpRcp->getMobilityGhost();
+    TEUCHOS_TEST_FOR_EXCEPTION(mobGhostRcp.is_null(), std::invalid_argument,
+                               "SchwarzSolver requires an explicit mobility matrix.");
+    const TCMAT &mobGhost = *mobGhostRcp;
+    auto colMapRcp = DTRcp->getColMap();
+    auto ghostColMapRcp = mobGhost.getColMap();
+
+    auto invKappaPtr = invKappaRcp->getLocalView<Kokkos::HostSpace>();
+    const int localSize = invKappaPtr.dimension_0();
+    const int nCol = colMapRcp->getNodeNumElements();
+
+    // step 1, rows of D^T touching each column, i.e., the local part of D
+    std::vector<std::vector<std::pair<int, double>>> colRows(nCol);
+    for (int i = 0; i < localSize; i++) {
+        Teuchos::ArrayView<const int> cols;
+        Teuchos::ArrayView<const double> vals;
+        DTRcp->getLocalRowView(i, cols, vals);
+        for (int a = 0; a < cols.size(); a++) {
+            colRows[cols[a]].emplace_back(i, vals[a]);
+        }
+    }
+
+    // step 2, mobility rows of each column, with column indices converted to the column map of D^T
+    // entries outside the column map multiply zero columns of D and are dropped
+    std::vector<std::vector<std::pair<int, double>>> mobRows(nCol);
+#pragma omp parallel for
+    for (int c = 0; c < nCol; c++) {
+        Teuchos::ArrayView<const int> mobCols;
+        Teuchos::ArrayView<const double> mobVals;
+        mobGhost.getLocalRowView(c, mobCols, mobVals); // rowMap of mobGhost == colMap of D^T
+        for (int m = 0; m < mobCols.size(); m++) {
+            const int colDT = colMapRcp->getLocalElement(ghostColMapRcp->getGlobalElement(mobCols[m]));
+            if (colDT >= 0) {
+                mobRows[c].emplace_back(colDT, mobVals[m]);
+            }
+        }
+    }
+
+    // step 3, row i of A_pp = (M D_i)^T D_p + K^{-1}_i e_i
+    std::vector<std::vector<std::pair<int, double>>> rows(localSize);
+#pragma omp parallel for
+    for (int i = 0; i < localSize; i++) {
+        Teuchos::ArrayView<const int> cols;
+        Teuchos::ArrayView<const double> vals;
+        DTRcp->getLocalRowView(i, cols, vals);
+        std::map<int, double> w; // M D_i, on columns of D^T
+        for (int a = 0; a < cols.size(); a++) {
+            for (const auto &m : mobRows[cols[a]]) {
+                w[m.first] += vals[a] * m.second;
+            }
+        }
+        std::map<int, double> row;
+        row[i] = invKappaPtr(i, 0);
+        for (const auto &wc : w) {
+            for (const auto &d : colRows[wc.first]) {
+                row[d.first] += wc.second * d.second;
+            }
+        }
+        rows[i].assign(row.begin(), row.end());
+    }
+
+    // step 4, the CRS matrix on MPI_COMM_SELF
+    Kokkos::View<size_t *> rowPointers("rowPointers", localSize + 1);
+    rowPointers[0] = 0;
+    for (int i = 0; i < localSize; i++) {
+        rowPointers[i + 1] = rowPointers[i] + rows[i].size();
+    }
+    Kokkos::View<int *> columnIndices("columnIndices", rowPointers[localSize]);
+    Kokkos::View<double *> values("values", rowPointers[localSize]);
+#pragma omp parallel for
+    for (int i = 0; i < localSize; i++) {
+        int kk = rowPointers[i];
+        for (const auto &entry : rows[i]) {
+            columnIndices[kk] = entry.first;
+            values[kk] = entry.second;
+            kk++;
+        }
+    }
+
+    Teuchos::RCP<const TCOMM> selfCommRcp = Teuchos::rcp(new Teuchos::MpiComm<int>(MPI_COMM_SELF));
+    Teuchos::RCP<const TMAP> localMapRcp = getTMAPFromLocalSize(localSize, selfCommRcp);
+    Teuchos::RCP<TCMAT> ALocNonConstRcp =
+        Teuchos::rcp(new TCMAT(localMapRcp, localMapRcp, rowPointers, columnIndices, values));
+    ALocNonConstRcp->fillComplete(localMapRcp, localMapRcp);
+    ALocRcp = ALocNonConstRcp;
+}
+
+int SchwarzSolver::solve(Teuchos::RCP<TV> &xsolRcp, const double tol, const int iteMax, IteHistory &history) const {
+    TEUCHOS_TEST_FOR_EXCEPTION(!mapRcp->isSameAs(*(xsolRcp->getMap())), std::invalid_argument,
+                               "xsolrcp and A operator do not have the same Map.");
+    TraceScope trace("SchwarzSolver::Solve");
+
+    const double localTolRatio = 0.1; // local problems are solved tighter than the outer tolerance
+    int mvCount = 0;
+    int iteCount = 0;
+
+    // x, projected to the bound
+    Teuchos::RCP<TV> xRcp = Teuchos::rcp(new TV(*xsolRcp, Teuchos::Copy));
+    auto xPtr = xRcp->getLocalView<Kokkos::HostSpace>();
+    auto lbPtr = lbRcp->getLocalView<Kokkos::HostSpace>();
+    xRcp->modify<Kokkos::HostSpace>();
+    const int localSize = xPtr.dimension_0();
+#pragma omp parallel for
+    for (int i = 0; i < localSize; i++) {
+        xPtr(i, 0) = std::max(xPtr(i, 0), lbPtr(i, 0));
+    }
+
+    Teuchos::RCP<TV> gradRcp = Teuchos::rcp(new TV(mapRcp, true));   // g = Ax+b
+    Teuchos::RCP<TV> deltaRcp = Teuchos::rcp(new TV(mapRcp, true));  // combined correction
+    Teuchos::RCP<TV> AdeltaRcp = Teuchos::rcp(new TV(mapRcp, true)); // A delta
+    Teuchos::RCP<TV> QRcp = Teuchos::rcp(new TV(mapRcp, true));      // temporary space for the residual
+    AOpRcp->apply(*xRcp, *gradRcp);
+    mvCount++;
+    gradRcp->update(1.0, *bRcp, 1.0);
+
+    // owner rank of the objects in the column map of D^T, for the coarse problem
+    std::vector<int> owner;
+    if (coarse) {
+        auto DTRcp = AOpRcp->getDMatTrans();
+        auto gids = DTRcp->getColMap()->getNodeElementList();
+        owner.resize(gids.size());
+        DTRcp->getDomainMap()->getRemoteIndexList(gids, Teuchos::ArrayView<int>(owner));
+    }
+
+    // local problem in the correction delta_p
+    auto localMapRcp = ALocRcp->getDomainMap();
+    Teuchos::RCP<TV> gradLocRcp = Teuchos::rcp(new TV(localMapRcp, false));
+    Teuchos::RCP<TV> lbLocRcp = Teuchos::rcp(new TV(localMapRcp, false));
+
+    double resPhi = projectionResidual(xRcp, gradRcp, QRcp);
+    history.push_back(std::array<double, 6>{{0, 0, 0, 0, resPhi, 1.0 * mvCount}});
+
+    while (fabs(resPhi) >= tol && iteCount < iteMax) {
+        iteCount++;
+        TraceScope trace("SchwarzSolver::Iteration", "SimToolbox", iteCount);
+
+        // step 1, local solve with rows of other ranks fixed
+        auto gradPtr = gradRcp->getLocalView<Kokkos::HostSpace>();
+        auto gradLocPtr = gradLocRcp->getLocalView<Kokkos::HostSpace>();
+        auto lbLocPtr = lbLocRcp->getLocalView<Kokkos::HostSpace>();
+        gradLocRcp->modify<Kokkos::HostSpace>();
+        lbLocRcp->modify<Kokkos::HostSpace>();
+#pragma omp parallel for
+        for (int i = 0; i < localSize; i++) {
+            gradLocPtr(i, 0) = gradPtr(i, 0);
+            lbLocPtr(i, 0) = lbPtr(i, 0) - xPtr(i, 0);
+        }
+        BCQPSolver localSolver(ALocRcp, gradLocRcp);
+        localSolver.setLowerBound(lbLocRcp);
+        Teuchos::RCP<TV> deltaLocRcp = Teuchos::rcp(new TV(localMapRcp, true));
+        IteHistory localHistory;
+        localSolver.solveBBPGD(deltaLocRcp, localTolRatio * tol, iteMax, localHistory);
+
+        auto deltaPtr = deltaRcp->getLocalView<Kokkos::HostSpace>();
+        auto deltaLocPtr = deltaLocRcp->getLocalView<Kokkos::HostSpace>();
+        deltaRcp->modify<Kokkos::HostSpace>();
+#pragma omp parallel for
+        for (int i = 0; i < localSize; i++) {
+            deltaPtr(i, 0) = deltaLocPtr(i, 0);
+        }
+
+        // step 2, step length of each subdomain
+        if (coarse) {
+            deltaRcp->scale(coarseStep(deltaRcp, gradRcp, owner));
+        }
+
+        // step 3, exact line search along the combined correction, keeps x feasible for alpha in [0,1]
+        AOpRcp->apply(*deltaRcp, *AdeltaRcp);
+        mvCount++;
+        auto AdeltaPtr = AdeltaRcp->getLocalView<Kokkos::HostSpace>();
+        double gdLocal = 0, dAdLocal = 0;
+#pragma omp parallel for reduction(+ : gdLocal, dAdLocal)
+        for (int i = 0; i < localSize; i++) {
+            gdLocal += gradPtr(i, 0) * deltaPtr(i, 0);
+            dAdLocal += deltaPtr(i, 0) * AdeltaPtr(i, 0);
+        }
+        double local[2] = {gdLocal, dAdLocal};
+        double global[2] = {0, 0};
+        Teuchos::reduceAll(*commRcp, Teuchos::SumValueReductionOp<int, double>(), 2, local, global);
+        if (global[1] < 10 * std::numeric_limits<double>::epsilon()) {
+            spdlog::warn("SchwarzSolver Stagnate");
+            break;
+        }
+        const double alpha = std::min(1.0, std::max(0.0, -global[0] / global[1]));
+
+        xRcp->update(alpha, *deltaRcp, 1.0);
+        gradRcp->update(alpha, *AdeltaRcp, 1.0);
+        resPhi = projectionResidual(xRcp, gradRcp, QRcp);
+        history.push_back(
+            std::array<double, 6>{{1.0 * iteCount, localHistory.back()[0], 0, alpha, resPhi, 1.0 * mvCount}});
+    }
+
+    xsolRcp = xRcp;
+    return 0;
+}
+
+double SchwarzSolver::coarseStep(const Teuchos::RCP<const TV> &deltaRcp, const Teuchos::RCP<const TV> &gradRcp,
+                                 const std::vector<int> &owner) const {
+    const int rank = commRcp->getRank();
+    const int nProcs = commRcp->getSize();
+
+    auto DTRcp = AOpRcp->getDMatTrans();
+    auto colMapRcp = DTRcp->getColMap();
+    auto deltaPtr = deltaRcp->getLocalView<Kokkos::HostSpace>();
+    auto gradPtr = gradRcp->getLocalView<Kokkos::HostSpace>();
+    auto invKappaPtr = AOpRcp->getInvKappa()->getLocalView<Kokkos::HostSpace>();
+    const int localSize = deltaPtr.dimension_0();
+    const int nCol = colMapRcp->getNodeNumElements();
+
+    // step 1, f_p = D_p delta_p on columns of D^T, and the local terms g^T delta_p and delta_p^T K^{-1} delta_p
+    std::vector<double> force(nCol, 0);
+    double cLocal = 0, kLocal = 0;
+    for (int i = 0; i < localSize; i++) {
+        Teuchos::ArrayView<const int> cols;
+        Teuchos::ArrayView<const double> vals;
+        DTRcp->getLocalRowView(i, cols, vals);
+        for (int a = 0; a < cols.size(); a++) {
+            force[cols[a]] += vals[a] * deltaPtr(i, 0);
+        }
+        cLocal += gradPtr(i, 0) * deltaPtr(i, 0);
+        kLocal += invKappaPtr(i, 0) * deltaPtr(i, 0) * deltaPtr(i, 0);
+    }
+
+    // step 2, send f_p to the owner of each object
+    struct Entry {
+        int gid;      ///< global index in the mobility map
+        int rank;     ///< the subdomain p
+        double value; ///< f_p
+    };
+    std::vector<int> sendCount(nProcs, 0), recvCount(nProcs, 0);
+    for (int c = 0; c < nCol; c++) {
+        if (force[c] != 0) {
+            sendCount[owner[c]]++;
+        }
+    }
+    std::vector<int> sendDisp(nProcs + 1, 0), recvDisp(nProcs + 1, 0);
+    for (int r = 0; r < nProcs; r++) {
+        sendDisp[r + 1] = sendDisp[r] + sendCount[r];
+    }
+    std::vector<Entry> sendBuf(sendDisp[nProcs]);
+    std::vector<int> pos(sendDisp.begin(), sendDisp.end() - 1);
+    for (int c = 0; c < nCol; c++) {
+        if (force[c] != 0) {
+            sendBuf[pos[owner[c]]++] = Entry{colMapRcp->getGlobalElement(c), rank, force[c]};
+        }
+    }
+    MPI_Alltoall(sendCount.data(), 1, MPI_INT, recvCount.data(), 1, MPI_INT, MPI_COMM_WORLD);
+    for (int r = 0; r < nProcs; r++) {
+        recvDisp[r + 1] = recvDisp[r] + recvCount[r];
+    }
+    std::vector<Entry> recvBuf(recvDisp[nProcs]);
+    const int entryBytes = sizeof(Entry);
+    std::vector<int> sendBytes(nProcs), sendBytesDisp(nProcs), recvBytes(nProcs), recvBytesDisp(nProcs);
+    for (int r = 0; r < nProcs; r++) {
+        sendBytes[r] = sendCount[r] * entryBytes;
+        sendBytesDisp[r] = sendDisp[r] * entryBytes;
+        recvBytes[r] = recvCount[r] * entryBytes;
+        recvBytesDisp[r] = recvDisp[r] * entryBytes;
+    }
+    MPI_Alltoallv(sendBuf.data(), sendBytes.data(), sendBytesDisp.data(), MPI_BYTE, recvBuf.data(), recvBytes.data(),
+                  recvBytesDisp.data(), MPI_BYTE, MPI_COMM_WORLD);
+
+    // step 3, E_pq = f_p^T M f_q over owned mobility rows
+    std::unordered_map<int, std::vector<std::pair<int, double>>> ownedForce;
+    for (const auto &e : recvBuf) {
+        ownedForce[e.gid].emplace_back(e.rank, e.value);
+    }
+    auto mobMatRcp = Teuchos::rcp_dynamic_cast<const TCMAT>(AOpRcp->getMobility());
+    auto mobRowMapRcp = mobMatRcp->getRowMap();
+    auto mobColMapRcp = mobMatRcp->getColMap();
+    std::map<std::pair<int, int>, double> coarseMat;
+    for (const auto &row : ownedForce) {
+        Teuchos::ArrayView<const int> mobCols;
+        Teuchos::ArrayView<const double> mobVals;
+        mobMatRcp->getLocalRowView(mobRowMapRcp->getLocalElement(row.first), mobCols, mobVals);
+        for (int m = 0; m < mobCols.size(); m++) {
+            const auto it = ownedForce.find(mobColMapRcp->getGlobalElement(mobCols[m]));
+            if (it == ownedForce.end()) {
+                continue; // off-rank coupling or zero force
+            }
+            for (const auto &fp : row.second) {
+                for (const auto &fq : it->second) {
+                    coarseMat[std::make_pair(fp.first, fq.first)] += fp.second * mobVals[m] * fq.second;
+                }
+            }
+        }
+    }
+    coarseMat[std::make_pair(rank, rank)] += kLocal;
+
+    // step 4, gather the sparse coarse problem on every rank, c_p is stored as the entry (p, -1)
+    std::vector<double> sendCoarse;
+    for (const auto &e : coarseMat) {
+        sendCoarse.insert(sendCoarse.end(), {1.0 * e.first.first, 1.0 * e.first.second, e.second});
+    }
+    sendCoarse.insert(sendCoarse.end(), {1.0 * rank, -1.0, cLocal});
+    int nSend = sendCoarse.size();
+    std::vector<int> coarseCount(nProcs), coarseDisp(nProcs + 1, 0);
+    MPI_Allgather(&nSend, 1, MPI_INT, coarseCount.data(), 1, MPI_INT, MPI_COMM_WORLD);
+    for (int r = 0; r < nProcs; r++) {
+        coarseDisp[r + 1] = coarseDisp[r] + coarseCount[r];
+    }
+    std::vector<double> recvCoarse(coarseDisp[nProcs]);
+    MPI_Allgatherv(sendCoarse.data(), nSend, MPI_DOUBLE, recvCoarse.data(), coarseCount.data(), coarseDisp.data(),
+                   MPI_DOUBLE, MPI_COMM_WORLD);
+
+    std::vector<std::map<int, double>> coarseRow(nProcs);
+    std::vector<double> coarseRhs(nProcs, 0);
+    for (int k = 0; k < coarseDisp[nProcs]; k += 3) {
+        const int p = static_cast<int>(recvCoarse[k]);
+        const int q = static_cast<int>(recvCoarse[k + 1]);
+        if (q < 0) {
+            coarseRhs[p] += recvCoarse[k + 2];
+        } else {
+            coarseRow[p][q] += recvCoarse[k + 2];
+        }
+    }
+
+    // step 5, min 1/2 t^T E t + c^T t, 0 <= t <= 1, by projected Gauss-Seidel, identical on all ranks
+    std::vector<double> t(nProcs, 1.0);
+    for (int sweep = 0; sweep < 100; sweep++) {
+        double maxChange = 0;
+        for (int p = 0; p < nProcs; p++) {
+            const auto diag = coarseRow[p].find(p);
+            if (diag == coarseRow[p].end() || diag->second <= 0) {
+                t[p] = 0; // zero correction
+                continue;
+            }
+            double r = coarseRhs[p];
+            for (const auto &e : coarseRow[p]) {
+                r += e.second * t[e.first];
+            }
+            const double tNew = std::min(1.0, std::max(0.0, t[p] - r / diag->second));
+            maxChange = std::max(maxChange, fabs(tNew - t[p]));
+            t[p] = tNew;
+        }
+        if (maxChange < 1e-8) {
+            break;
+        }
+    }
+
+    return t[rank];
+}
+
+double SchwarzSolver::projectionResidual(const Teuchos::RCP<const TV> &XRcp, const Teuchos::RCP<const TV> &YRcp,
+                                         const Teuchos::RCP<TV> &QRcp) const {
+    const double eps = std::numeric_limits<double>::epsilon() * 100;
+    auto xPtr = XRcp->getLocalView<Kokkos::HostSpace>();
+    auto yPtr = YRcp->getLocalView<Kokkos::HostSpace>();
+    auto lbPtr = lbRcp->getLocalView<Kokkos::HostSpace>();
+    auto qPtr = QRcp->getLocalView<Kokkos::HostSpace>();
+    QRcp->modify<Kokkos::HostSpace>();
+    const int ibound = xPtr.dimension_0();
+#pragma omp parallel for
+    for (int i = 0; i < ibound; i++) {
+        qPtr(i, 0) = xPtr(i, 0) < lbPtr(i, 0) + eps ? std::min(yPtr(i, 0), 0.0) : yPtr(i, 0);
+    }
+    return QRcp->normInf();
+}
@@ -0,0 +1,101 @@
+/**
+ * @file SchwarzSolver.hpp
+ * @brief Nonsmooth additive Schwarz solver for the BCQP constraint problem
+ *
+ */
+#ifndef SCHWARZSOLVER_HPP_
+#define SCHWARZSOLVER_HPP_
+
+#include "BCQPSolver.hpp"
+#include "ConstraintOperator.hpp"
+
+#include "Trilinos/TpetraUtil.hpp"
+
+#include <vector>
+
+/**
+ * @brief solve \f$\min \frac{1}{2}x^TAx + b^Tx, x \ge lb\f$ with one subdomain per rank
+ *
+ * Each outer iteration, every rank solves the BCQP problem of its own rows for a correction \f$\delta_p\f$
+ * with rows of other ranks held fixed:
+ *   \f$\min \frac{1}{2}\delta_p^T A_{pp} \delta_p + g_p^T \delta_p, \delta_p \ge lb_p - x_p, g = Ax+b\f$
+ * \f$A_{pp} = D_p^T M D_p + K_p^{-1}\f$ is assembled explicitly on MPI_COMM_SELF, so the local BBPGD does no
+ * communication. Ranks couple only through the global gradient \f$g\f$, updated once per outer iteration.
+ * The corrections are combined as \f$x \leftarrow x + \alpha \sum_p t_p \delta_p\f$.
+ * Without the coarse correction \f$t_p = 1\f$. With it, \f$t_p \in [0,1]\f$ minimizes the objective in the
+ * P-dimensional space spanned by the corrections, which removes the oscillation of neighboring subdomains
+ * pushing against each other. \f$\alpha \in [0,1]\f$ is the exact line search along the combined correction,
+ * so every outer iteration decreases the objective.
+ * The mobility operator must be a TCMAT. The coarse problem is exact for a block diagonal mobility,
+ * off-rank mobility couplings are dropped from it and only affect the line search.
+ */
+class SchwarzSolver {
+  public:
+    /**
+     * @brief Construct a new SchwarzSolver object
+     *
+     * @param AOpRcp_ the constraint operator \f$A\f$, with a TCMAT mobility
+     * @param bRcp_ the vector \f$b\f$
+     * @param lbRcp_ lower bound, the upper bound is infinity
+     */
+    SchwarzSolver(const Teuchos::RCP<const ConstraintOperator> &AOpRcp_, const Teuchos::RCP<const TV> &bRcp_,
+                  const Teuchos::RCP<const TV> &lbRcp_);
+
+    /**
+     * @brief enable the coarse correction of the step length of each subdomain
+     *
+     * @param coarse_
+     */
+    void setCoarseCorrection(bool coarse_) { coarse = coarse_; }
+
+    /**
+     * @brief outer iterations of local solves
+     *
+     * @param xsolRcp initial guess and result
+     * @param tol residual tolerance, local problems are solved to 0.1 tol
+     * @param iteMax max iteration number, for both outer and local iterations
+     * @param history iteration history, in the same format as BCQPSolver.
+     *                the second entry is the number of local iterations on rank 0
+     * @return int return error code. 0 for normal execution.
+     */
+    int solve(Teuchos::RCP<TV> &xsolRcp, const double tol, const int iteMax, IteHistory &history) const;
+
+  private:
+    Teuchos::RCP<const ConstraintOperator> AOpRcp; ///< linear operator \f$A\f$
+    Teuchos::RCP<const TV> bRcp;                   ///< vector \f$b\f$
+    Teuchos::RCP<const TV> lbRcp;                  ///< lower bound
+    Teuchos::RCP<const TMAP> mapRcp;               ///< map for the distribution of xsolRcp, bRcp, and lbRcp
+    Teuchos::RCP<const TCOMM> commRcp;             ///< Teuchos::MpiComm
+    Teuchos::RCP<const TCMAT> ALocRcp;             ///< \f$A_{pp}\f$ on MPI_COMM_SELF
+    bool coarse = true;                            ///< see setCoarseCorrection()
+
+    /**
+     * @brief assemble \f$A_{pp}\f$ from local rows of \f$D^T\f$ and the mobility rows of their objects
+     *
+     */
+    void assembleLocal();
+
+    /**
+     * @brief the step length \f$t_p\f$ of this rank by the coarse correction. collective
+     *
+     * @param deltaRcp correction of all subdomains, on the map of \f$A\f$
+     * @param gradRcp gradient \f$Ax+b\f$
+     * @param owner owner rank of each column of \f$D^T\f$
+     * @return double
+     */
+    double coarseStep(const Teuchos::RCP<const TV> &deltaRcp, const Teuchos::RCP<const TV> &gradRcp,
+                      const std::vector<int> &owner) const;
+
+    /**
+     * @brief projection residual with EQ 2.2 of Dai & Fletcher 2005, see BCQPSolver
+     *
+     * @param XRcp X
+     * @param YRcp Y=AX+b
+     * @param QRcp temporary working space
+     * @return double
+     */
+    double projectionResidual(const Teuchos::RCP<const TV> &XRcp, const Teuchos::RCP<const TV> &YRcp,
+                              const Teuchos::RCP<TV> &QRcp) const;
+};
+
+#endif
@@ -1,276 +1,262 @@
 #include<iostream>
 #include<cstdlib>
+#include<cstring>
+#include<algorithm>
 #include<cassert>
 #include<vector>
+#include<memory>
+#include<mutex>
+#include<atomic>
 #if defined(PARTICLE_SIMULATOR_THREAD_PARALLEL) && defined(_OPENMP)
 #include<omp.h>
 #endif
 
 namespace ParticleSimulator{
+    // Memory of ReallocatableArray with alloc_mode 1.
+    // Each thread allocates from its own arena, a chain of chunks. A full chunk is never moved, a new chunk
+    // at least as large as the arena is appended instead, so live data keeps its address and alloc/freeMem
+    // are safe inside OpenMP parallel regions. Memory may be freed by any thread, the segment id encodes
+    // the arena and each arena has its own lock.
+    // reset() is the point where an empty arena with several chunks is merged into one chunk of the total
+    // capacity, so that the next tree build needs no malloc.
     class MemoryPool{
     private:
         enum{
-            ALIGN_SIZE        = 8,
-            N_SEGMENT_LIMIT   = 10000,
+            ALIGN_SIZE = 8,
         };
-        typedef struct {
-            void * data;
+        struct Chunk{
+            char * data;
+            size_t cap;
+            size_t top;
+        };
+        struct Segment{
+            int chunk;
+            size_t offset;
             size_t cap;
             bool used;
-            void * ptr_data;
-            void * ptr_id_mpool;
-        } EmergencyBuffer;
+        };
+        struct Arena{
+            std::mutex mtx;
+            std::vector<Chunk> chunks;
+            std::vector<Segment> segs; // in the order of chunk and offset, free segments at the tail are removed
+            size_t cap_init;           // capacity of the first chunk
+            Arena() : cap_init(0) {}
+        };
 
-        MemoryPool(){}
+        MemoryPool() : size_(0), peak_(0), n_malloc_(0) {}
         ~MemoryPool(){}
         MemoryPool(const MemoryPool & mem);
         MemoryPool & operator = (const MemoryPool & mem);
-        void * bottom_;
-        void * top_;
-        size_t cap_;
-        size_t size_;
-        size_t n_segment_;
-        size_t cap_per_seg_[N_SEGMENT_LIMIT];
-        bool   used_per_seg_[N_SEGMENT_LIMIT];
-        void * ptr_data_per_seg_[N_SEGMENT_LIMIT];
-
-        std::vector<EmergencyBuffer> emerg_bufs_;
+        std::vector<std::unique_ptr<Arena>> arenas_;
+        std::atomic<size_t> size_;     // bytes of used segments
+        std::atomic<size_t> peak_;     // max of size_
+        std::atomic<size_t> n_malloc_; // number of chunks allocated
 
+        // never destroyed, arrays in static objects may be freed at exit
         static MemoryPool & getInstance(){
-            static MemoryPool inst;
-            return inst;
+            static MemoryPool * inst = new MemoryPool();
+            return *inst;
         }
         static size_t getAlignSize(const size_t _size){
             return (((_size-1)/ALIGN_SIZE)+1)*ALIGN_SIZE;
         }
-        static bool isLastSegment(const int id_seg) {
-            if (id_seg < N_SEGMENT_LIMIT &&
-                getInstance().n_segment_ > 0 && 
-                (size_t)id_seg == getInstance().n_segment_-1) {
-                return true;
-            } else {
-                return false;
-            }
+        static int getNArena(){
+            return getInstance().arenas_.size();
         }
-        static bool inParallelRegion() {
+        static int getThreadArena(){
 #if defined(PARTICLE_SIMULATOR_THREAD_PARALLEL) && defined(_OPENMP)
-            const int n_thread = omp_get_num_threads();
+            return omp_get_thread_num() % getNArena();
 #else
-            const int n_thread = 1;
+            return 0;
 #endif
-            if (n_thread > 1) return true;
-            else return false;
         }
-    public:
-
-        static size_t getNSegment(){
-            return getInstance().n_segment_;
+        static Arena & getArena(const int id_mpool){
+            return *getInstance().arenas_[id_mpool % getNArena()];
         }
-
-        static size_t getSize(){
-            return getInstance().size_;
+        static int getSegment(const int id_mpool){
+            return id_mpool / getNArena();
         }
-        
-        static void initialize(const size_t _cap){
-            getInstance().cap_ = _cap;
-            getInstance().size_ = 0;
-            getInstance().bottom_ = malloc(getInstance().cap_);
-            if (getInstance().bottom_ != NULL) {
-                getInstance().top_ = getInstance().bottom_;
-                getInstance().n_segment_ = 0;
-                for(size_t i=0; i<N_SEGMENT_LIMIT; i++){
-                    getInstance().cap_per_seg_[i] = 0;
-                    getInstance().used_per_seg_[i] = false;
-                }
-            } else {
+        static void addSize(const size_t size_add){
+            const size_t size_new = getInstance().size_.fetch_add(size_add) + size_add;
+            size_t peak = getInstance().peak_.load();
+            while(size_new > peak && !getInstance().peak_.compare_exchange_weak(peak, size_new)){}
+        }
+        static char * mallocChunk(const size_t cap){
+            char * data = (char*)malloc(cap);
+            if (data == NULL) {
                 std::cerr << "PS_ERROR: malloc failed. (function: " << __func__
-                          << ", line: " << __LINE__ << ", file: " << __FILE__ 
+                          << ", line: " << __LINE__ << ", file: " << __FILE__
                           << ")" <<std::endl;
 #if defined(PARTICLE_SIMULATOR_MPI_PARALLEL)
                 MPI_Abort(MPI_COMM_WORLD,-1);
 #endif
                 std::exit(-1);
             }
+            getInstance().n_malloc_++;
+            return data;
         }
-        static void reInitialize(const size_t size_add){
-            const size_t cap_old = getInstance().cap_;
-            const size_t cap_new = getInstance().getAlignSize( cap_old+size_add );
-            void * bottom_old = getInstance().bottom_;
-            void * bottom_new = malloc(cap_new);
-            if (bottom_new != NULL) {
-                getInstance().bottom_ = bottom_new;
-                const size_t diff = (size_t)getInstance().top_ - (size_t)bottom_old;
-                getInstance().top_  = (void*)((char*)bottom_new + diff);
-                getInstance().cap_  = cap_new;
-                memcpy(bottom_new, bottom_old, cap_old);
-                size_t cap_cum = 0;
-                for(size_t i=0; i<getInstance().n_segment_; i++){
-                    void * p_new = (void*)((char*)bottom_new + cap_cum);
-                    if (getInstance().used_per_seg_[i]) {
-                        memcpy(getInstance().ptr_data_per_seg_[i], &p_new, sizeof(void*));
-                    }
-                    cap_cum += getInstance().cap_per_seg_[i];
-                }
-                if (bottom_old != NULL) free(bottom_old);
-            } else {
-                std::cerr << "PS_ERROR: malloc failed. (function: " << __func__
-                          << ", line: " << __LINE__ << ", file: " << __FILE__ 
-                          << ")" <<std::endl;
-#if defined(PARTICLE_SIMULATOR_MPI_PARALLEL)
-                MPI_Abort(MPI_COMM_WORLD,-1);
-#endif
-                std::exit(-1);
+        static size_t getCapacity(const Arena & arena){
+            size_t cap = 0;
+            for(size_t i=0; i<arena.chunks.size(); i++) cap += arena.chunks[i].cap;
+            return cap;
+        }
+    public:
+
+        static size_t getNSegment(){
+            size_t n_segment = 0;
+            for(int i=0; i<getNArena(); i++){
+                Arena & arena = *getInstance().arenas_[i];
+                std::lock_guard<std::mutex> lock(arena.mtx);
+                n_segment += arena.segs.size();
             }
+            return n_segment;
         }
 
-        static void unifyMem() {
-            const int n_emerg_bufs = getInstance().emerg_bufs_.size();
-            if (!inParallelRegion() && n_emerg_bufs > 0) {
-               
-                size_t size_add = 0;
-                for (int i=0; i<n_emerg_bufs; i++) {
-                    if (getInstance().emerg_bufs_[i].used)
-                        size_add += getInstance().emerg_bufs_[i].cap;
-                }
-                if (getInstance().cap_ < getInstance().size_ + size_add) {
-                    reInitialize(size_add);
-                }
-                for (int i=0; i<n_emerg_bufs; i++) {
-                    if (!getInstance().emerg_bufs_[i].used) continue;
-                    void * data = getInstance().emerg_bufs_[i].data;
-                    const size_t cap = getInstance().emerg_bufs_[i].cap;
-                    void * ptr_data = getInstance().emerg_bufs_[i].ptr_data;
-                    void * ptr_id_mpool = getInstance().emerg_bufs_[i].ptr_id_mpool;
-                    void * top_prev = getInstance().top_;
-                    // Copy a single emergency buffer to the segment at the tail
-                    getInstance().top_ = (void *)((char*)getInstance().top_ + cap);
-                    getInstance().size_ += cap;
-                    getInstance().cap_per_seg_[getInstance().n_segment_] = cap;
-                    getInstance().used_per_seg_[getInstance().n_segment_] = true;
-                    getInstance().ptr_data_per_seg_[getInstance().n_segment_] = ptr_data;
-                    const int id_mpool = getInstance().n_segment_;
-                    getInstance().n_segment_++;
-                    memcpy(top_prev, data, cap);
-                    memcpy(ptr_data, &top_prev, sizeof(void *));
-                    memcpy(ptr_id_mpool, &id_mpool, sizeof(int));
-                }
-                // Release emergency buffers
-                for (int i=0; i<n_emerg_bufs; i++) {
-                    if (getInstance().emerg_bufs_[i].data != NULL)
-                        free(getInstance().emerg_bufs_[i].data);
-                }
-                getInstance().emerg_bufs_.clear();
-            } 
+        static size_t getSize(){
+            return getInstance().size_.load();
+        }
+
+        static size_t getPeakSize(){
+            return getInstance().peak_.load();
+        }
+
+        static size_t getNMalloc(){
+            return getInstance().n_malloc_.load();
         }
 
-        static void alloc(const size_t _size, int & _id_mpool, void * ptr_data, void *& ret){
+        static size_t getCapacity(){
+            size_t cap = 0;
+            for(int i=0; i<getNArena(); i++){
+                Arena & arena = *getInstance().arenas_[i];
+                std::lock_guard<std::mutex> lock(arena.mtx);
+                cap += getCapacity(arena);
+            }
+            return cap;
+        }
+
+        // _cap is shared by the arenas of all threads, chunks are allocated on first use
+        static void initialize(const size_t _cap){
+#if defined(PARTICLE_SIMULATOR_THREAD_PARALLEL) && defined(_OPENMP)
+            const int n_arena = omp_get_max_threads();
+#else
+            const int n_arena = 1;
+#endif
+            getInstance().arenas_.clear();
+            for(int i=0; i<n_arena; i++){
+                getInstance().arenas_.emplace_back(new Arena());
+                getInstance().arenas_.back()->cap_init = _cap > 0 ? getAlignSize(_cap / n_arena) : 0;
+            }
+        }
+
+        static void alloc(const size_t _size, int & _id_mpool, void *& ret){
             if(_size <= 0) return;
-            unifyMem();
+            assert(getNArena() > 0);
             const size_t size_align = getAlignSize(_size);
-            size_t cap_cum = 0;
-            bool flag_break = false;
-            for(size_t i=0; i<getInstance().n_segment_; i++){
-                if( !getInstance().used_per_seg_[i] && getInstance().cap_per_seg_[i] >= size_align){
-                    // insert to middle 
-                    getInstance().used_per_seg_[i] = true;
-                    getInstance().ptr_data_per_seg_[i] = ptr_data;
-                    _id_mpool = i;
-                    ret = (void*)((char*)getInstance().bottom_ + cap_cum);
-                    flag_break = true;
+            const int id_arena = getThreadArena();
+            Arena & arena = *getInstance().arenas_[id_arena];
+            std::lock_guard<std::mutex> lock(arena.mtx);
+            int id_seg = -1;
+            for(size_t i=0; i<arena.segs.size(); i++){
+                if(!arena.segs[i].used && arena.segs[i].cap >= size_align){
+                    // insert to middle
+                    id_seg = i;
                     break;
                 }
-                cap_cum += getInstance().cap_per_seg_[i];
             }
-            if(!flag_break){
-                // In this case, we add a new segment to the tail of the memory pool
-                assert(N_SEGMENT_LIMIT > getInstance().n_segment_+1);
-                // Delete the last segment first if _id_mpool points to the last segment.
-                if (isLastSegment(_id_mpool)) {
-                    getInstance().n_segment_--;
-                    getInstance().top_  = ((char*)getInstance().top_) - getInstance().cap_per_seg_[getInstance().n_segment_];
-                    getInstance().size_ = getInstance().size_ - getInstance().cap_per_seg_[getInstance().n_segment_];
-                    getInstance().cap_per_seg_[getInstance().n_segment_] = 0;
-                    getInstance().used_per_seg_[getInstance().n_segment_] = false;
-                    getInstance().ptr_data_per_seg_[getInstance().n_segment_] = NULL;
+            if(id_seg < 0){
+                // add a new segment to the tail, in the chunk of the last segment or a later one
+                size_t id_chunk = arena.segs.empty() ? 0 : arena.segs.back().chunk;
+                while(id_chunk < arena.chunks.size() &&
+                      arena.chunks[id_chunk].top + size_align > arena.chunks[id_chunk].cap){
+                    id_chunk++;
                 }
-                // Choose an operation mode
-                bool flag_realloc = false;
-                if (getInstance().cap_ < getInstance().size_ + size_align) flag_realloc = true;
-                bool flag_use_emerg_bufs = false;
-                if (flag_realloc && inParallelRegion()) flag_use_emerg_bufs = true;
-                // Add a new segment to the tail of the memory pool.
-                if (!flag_use_emerg_bufs) {
-                    if(flag_realloc) reInitialize(size_align);
-                    void * top_prev = getInstance().top_;
-                    getInstance().top_   = ((char*)getInstance().top_) + size_align;
-                    getInstance().size_ += size_align;
-                    getInstance().cap_per_seg_[getInstance().n_segment_] = size_align;
-                    getInstance().used_per_seg_[getInstance().n_segment_] = true;
-                    getInstance().ptr_data_per_seg_[getInstance().n_segment_] = ptr_data;
-                    _id_mpool = getInstance().n_segment_;
-                    getInstance().n_segment_++;
-                    ret = top_prev;
-                } else {
-                    int n_emerg_bufs = getInstance().emerg_bufs_.size();
-                    // Newly create an emergency buffer
-                    const int idx = n_emerg_bufs;
-                    n_emerg_bufs++;
-                    getInstance().emerg_bufs_.reserve(n_emerg_bufs);
-                    getInstance().emerg_bufs_.resize(n_emerg_bufs);
-                    void * data = malloc(size_align);
-                    if (data != NULL) {
-                        getInstance().emerg_bufs_[idx].data = data;
-                        getInstance().emerg_bufs_[idx].cap = size_align;
-                        getInstance().emerg_bufs_[idx].used = true;
-                        getInstance().emerg_bufs_[idx].ptr_data = ptr_data;
-                        getInstance().emerg_bufs_[idx].ptr_id_mpool = &_id_mpool;
-                        _id_mpool = idx + N_SEGMENT_LIMIT;
-                        ret = getInstance().emerg_bufs_[idx].data;
-                    } else {
-                        std::cerr << "PS_ERROR: malloc failed. (function: " << __func__
-                                  << ", line: " << __LINE__ << ", file: " << __FILE__ 
-                                  << ")" <<std::endl;
-#if defined(PARTICLE_SIMULATOR_MPI_PARALLEL)
-                        MPI_Abort(MPI_COMM_WORLD,-1);
-#endif
-                        std::exit(-1);
-                    }
+                if(id_chunk == arena.chunks.size()){
+                    Chunk chunk;
+                    chunk.cap = std::max(size_align, std::max(arena.cap_init, getCapacity(arena)));
+                    chunk.data = mallocChunk(chunk.cap);
+                    chunk.top = 0;
+                    arena.chunks.push_back(chunk);
                 }
+                Segment seg;
+                seg.chunk = id_chunk;
+                seg.offset = arena.chunks[id_chunk].top;
+                seg.cap = size_align;
+                seg.used = false;
+                arena.chunks[id_chunk].top += size_align;
+                arena.segs.push_back(seg);
+                id_seg = arena.segs.size() - 1;
             }
+            Segment & seg = arena.segs[id_seg];
+            seg.used = true;
+            addSize(seg.cap);
+            _id_mpool = id_seg * getNArena() + id_arena;
+            ret = arena.chunks[seg.chunk].data + seg.offset;
         }
 
-        static void freeMem(const int id_seg){
-            if(getInstance().cap_per_seg_[id_seg] <= 0) return;
-            if (id_seg < N_SEGMENT_LIMIT) {
-                getInstance().used_per_seg_[id_seg] = false;
-                if((size_t)id_seg == getInstance().n_segment_-1){
-                    for(int i=id_seg; i>=0; i--){
-                        if(getInstance().used_per_seg_[i] == true) break;
-                        getInstance().size_ -= getInstance().cap_per_seg_[i];
-                        getInstance().cap_per_seg_[i] = 0;
-                        getInstance().ptr_data_per_seg_[i] = NULL;
-                        getInstance().n_segment_--;
-                    }
-                }
-                getInstance().top_ = ((char*)getInstance().bottom_) + getInstance().size_;
-            } else {
-                const int idx = id_seg - N_SEGMENT_LIMIT;
-                getInstance().emerg_bufs_[idx].used = false;
+        // grow a segment without moving it, possible if it is already large enough (a reused segment),
+        // or if it is the last one of its arena and its chunk has room
+        static bool extend(const size_t _size, const int id_mpool){
+            if(id_mpool < 0 || _size <= 0) return false;
+            const size_t size_align = getAlignSize(_size);
+            Arena & arena = getArena(id_mpool);
+            std::lock_guard<std::mutex> lock(arena.mtx);
+            const size_t id_seg = getSegment(id_mpool);
+            if(id_seg >= arena.segs.size() || !arena.segs[id_seg].used) return false;
+            Segment & seg = arena.segs[id_seg];
+            if(seg.cap >= size_align) return true;
+            Chunk & chunk = arena.chunks[seg.chunk];
+            if(id_seg + 1 != arena.segs.size() || seg.offset + size_align > chunk.cap) return false;
+            addSize(size_align - seg.cap);
+            seg.cap = size_align;
+            chunk.top = seg.offset + size_align;
+            return true;
+        }
+
+        static void freeMem(const int id_mpool){
+            if(id_mpool < 0) return;
+            Arena & arena = getArena(id_mpool);
+            std::lock_guard<std::mutex> lock(arena.mtx);
+            const size_t id_seg = getSegment(id_mpool);
+            if(id_seg >= arena.segs.size() || !arena.segs[id_seg].used) return;
+            arena.segs[id_seg].used = false;
+            getInstance().size_ -= arena.segs[id_seg].cap;
+            while(!arena.segs.empty() && !arena.segs.back().used){
+                arena.chunks[arena.segs.back().chunk].top = arena.segs.back().offset;
+                arena.segs.pop_back();
+            }
+        }
+
+        // merge the chunks of each empty arena
+        static void reset(){
+            for(int i=0; i<getNArena(); i++){
+                Arena & arena = *getInstance().arenas_[i];
+                std::lock_guard<std::mutex> lock(arena.mtx);
+                if(!arena.segs.empty() || arena.chunks.size() <= 1) continue;
+                Chunk chunk;
+                chunk.cap = getCapacity(arena);
+                chunk.top = 0;
+                for(size_t j=0; j<arena.chunks.size(); j++) free(arena.chunks[j].data);
+                arena.chunks.clear();
+                chunk.data = mallocChunk(chunk.cap);
+                arena.chunks.push_back(chunk);
             }
-            unifyMem();
         }
 
         static void dump(){
-            std::cerr<<"bottom_= "<<getInstance().bottom_<<std::endl;
-            std::cerr<<"top_= "<<getInstance().top_<<std::endl;
-            std::cerr<<"cap_= "<<getInstance().cap_<<std::endl;
-            std::cerr<<"size_= "<<getInstance().size_<<std::endl;
-            std::cerr<<"n_segment= "<<getInstance().n_segment_<<std::endl;
-            for(size_t i=0; i<getInstance().n_segment_; i++){
-                std::cerr<<"i= "<<i
-                         <<" cap= "<<getInstance().cap_per_seg_[i]
-                         <<" used= "<<getInstance().used_per_seg_[i]
-                         <<std::endl;
+            std::cerr<<"size_= "<<getSize()<<std::endl;
+            std::cerr<<"peak_= "<<getPeakSize()<<std::endl;
+            std::cerr<<"n_malloc_= "<<getNMalloc()<<std::endl;
+            for(int i=0; i<getNArena(); i++){
+                Arena & arena = *getInstance().arenas_[i];
+                std::lock_guard<std::mutex> lock(arena.mtx);
+                std::cerr<<"arena= "<<i<<" n_chunk= "<<arena.chunks.size()<<" cap= "<<getCapacity(arena)<<std::endl;
+                for(size_t j=0; j<arena.segs.size(); j++){
+                    std::cerr<<"j= "<<j
+                             <<" chunk= "<<arena.segs[j].chunk
+                             <<" cap= "<<arena.segs[j].cap
+                             <<" used= "<<arena.segs[j].used
+                             <<std::endl;
+                }
             }
         }
     };
@@ -51,14 +51,9 @@ namespace  ParticleSimulator{
                 data_ = new T[capacity_];
             }
             else if(alloc_mode_ == 1) {
-#ifdef PARTICLE_SIMULATOR_THREAD_PARALLEL
-#pragma omp critical
-#endif
-                {
-                    void * ret = NULL;
-                    MemoryPool::alloc(sizeof(T)*capacity_, id_mpool_, &data_, ret);
-                    data_ = (T*)ret;
-                }
+                void * ret = NULL;
+                MemoryPool::alloc(sizeof(T)*capacity_, id_mpool_, ret);
+                data_ = (T*)ret;
             }
         }
         
@@ -111,27 +106,20 @@ namespace  ParticleSimulator{
                 delete[] data_old;
             }
             else if(alloc_mode_ == 1){
-#ifdef PARTICLE_SIMULATOR_THREAD_PARALLEL
-#pragma omp critical
-#endif
-                {
-                    // Save old data                                                        
-                    T * data_old = new T[capacity_];
-                    memcpy((void *)data_old, (void *)data_, (size_t)sizeof(T)*capacity_);
-                    // Set new capacity
-                    capacity_ = getNewCapacity(new_cap);
-                    int id_old = id_mpool_;
+                // the pool never moves live data, grow in place or copy to a new segment
+                const int cap_new = getNewCapacity(new_cap);
+                if(!MemoryPool::extend(sizeof(T)*cap_new, id_mpool_)){
+                    T * data_old = data_;
+                    const int id_old = id_mpool_;
                     void * ret = NULL;
-                    MemoryPool::alloc(sizeof(T)*capacity_, id_mpool_, &data_, ret);
+                    MemoryPool::alloc(sizeof(T)*cap_new, id_mpool_, ret);
                     data_ = (T*)ret;
-                    if(id_old != id_mpool_){
-                        MemoryPool::freeMem(id_old);
+                    if(data_old != NULL){
+                        memcpy((void *)data_, (void *)data_old, (size_t)sizeof(T)*size_);
                     }
-                    // Copy old data
-                    memcpy((void *)data_, (void *)data_old, (size_t)sizeof(T)*size_);
-                    // Release memory of temporal buffer
-                    delete [] data_old;
+                    MemoryPool::freeMem(id_old);
                 }
+                capacity_ = cap_new;
             }
         }
     public:
@@ -167,13 +155,7 @@ namespace  ParticleSimulator{
                 if(capacity_ > 0) delete [] data_;
             }
             else if(alloc_mode_ == 1) {
-#ifdef PARTICLE_SIMULATOR_THREAD_PARALLEL
-#pragma omp critical
-#endif
-                {
-                    //if(capacity_ > 0) MemoryPool::freeMem(id_mpool_);
-                    MemoryPool::freeMem(id_mpool_);
-                }
+                MemoryPool::freeMem(id_mpool_);
             }
             data_ = NULL;
         }
@@ -304,14 +286,9 @@ namespace  ParticleSimulator{
             if(data_ == NULL){
                 if(alloc_mode_ == 0){data_ = new T[new_cap];}
                 else if(alloc_mode_ == 1){
-#ifdef PARTICLE_SIMULATOR_THREAD_PARALLEL
-#pragma omp critical
-#endif
-                    {
-                        void * ret = NULL;
-                        MemoryPool::alloc(sizeof(T)*new_cap, id_mpool_, &data_, ret);
-                        data_ = (T*)ret;
-                    }
+                    void * ret = NULL;
+                    MemoryPool::alloc(sizeof(T)*new_cap, id_mpool_, ret);
+                    data_ = (T*)ret;
                 }
                 capacity_ = new_cap;
                 size_ = n;
@@ -433,17 +410,12 @@ namespace  ParticleSimulator{
             }
             else if( alloc_mode_ == 1 && (free_alloc_mode == -1  || free_alloc_mode == 1) ){
                 if(data_ == NULL) return;
-#ifdef PARTICLE_SIMULATOR_THREAD_PARALLEL
-#pragma omp critical
-#endif
-                {
-                    MemoryPool::freeMem(id_mpool_);
-                    capacity_org_ = capacity_;
-                    capacity_ = 0;
-                    size_     = 0;
-                    data_     = NULL;
-                    id_mpool_ = -1;
-                }
+                MemoryPool::freeMem(id_mpool_);
+                capacity_org_ = capacity_;
+                capacity_ = 0;
+                size_     = 0;
+                data_     = NULL;
+                id_mpool_ = -1;
             }
         }
     };
@@ -335,6 +335,8 @@ namespace ParticleSimulator{
             epj_send_.freeMem(1);
             epi_org_.freeMem(1);
 #endif
+            // reset point of the pool, empty arenas grown during this call are merged for the next call
+            MemoryPool::reset();
         }
         
     public:
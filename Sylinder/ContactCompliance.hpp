@@ -0,0 +1,143 @@
+/**
+ * @file ContactCompliance.hpp
+ * @brief Stiffness, damping, and friction of unilateral contacts between sylinders
+ *
+ */
+#ifndef CONTACTCOMPLIANCE_HPP_
+#define CONTACTCOMPLIANCE_HPP_
+
+#include "Util/YamlHelper.hpp"
+
+#include <algorithm>
+#include <cstdio>
+#include <vector>
+
+/**
+ * @brief per group pair contact stiffness, damping, and friction
+ *
+ * A compliant contact is a spring-dashpot in the normal direction, integrated implicitly:
+ *   gamma = -kappa delta1 - damping (delta1 - min(delta0,0)) / dt, gamma >= 0
+ * with delta0 the separation at the beginning and delta1 at the end of the step.
+ * This is the unilateral constraint delta1 + gamma / kappaEff >= 0 with kappaEff = kappa + damping / dt,
+ * after shifting delta0, so it enters the BCQP through the same K^{-1} diagonal as bilateral springs.
+ * Only the overlap is damped, approaching pairs feel no force before they touch.
+ *
+ * A contact with friction > 0 gets two tangential constraints, with the Coulomb cone |gamma_t| <= friction gamma_n
+ * enforced by the constraint solver. Friction works for both rigid and compliant contacts.
+ *
+ * Each entry applies to a pair of sylinder groups, group -1 matches any group.
+ * The most specific matching entry is used, the later one for ties. No matching entry means rigid contacts.
+ */
+class ContactCompliance {
+  public:
+    struct Entry {
+        int groupI = -1;     ///< group of one sylinder, -1 for any
+        int groupJ = -1;     ///< group of the other sylinder, -1 for any
+        double kappa = 0;    ///< pN/um, normal stiffness. <= 0 means rigid
+        double damping = 0;  ///< pN s/um, normal damping
+        double friction = 0; ///< Coulomb friction coefficient. <= 0 means frictionless
+    };
+
+    ContactCompliance() = default;
+    ~ContactCompliance() = default;
+
+    /**
+     * @brief initialize from a yaml list of entries
+     *
+     * @param config
+     */
+    void initialize(const YAML::Node &config) {
+        entries.clear();
+        for (const auto &c : config) {
+            Entry entry;
+            readConfig(c, VARNAME(kappa), entry.kappa, "", true);
+            readConfig(c, VARNAME(damping), entry.damping, "", true);
+            readConfig(c, VARNAME(friction), entry.friction, "", true);
+            readConfig(c, VARNAME(groupI), entry.groupI, "", true);
+            readConfig(c, VARNAME(groupJ), entry.groupJ, "", true);
+            entries.push_back(entry);
+        }
+    }
+
+    bool empty() const { return entries.empty(); }
+
+    /**
+     * @brief find the entry of a pair of groups
+     *
+     * @param groupI
+     * @param groupJ
+     * @return const Entry* nullptr if no entry matches
+     */
+    const Entry *find(int groupI, int groupJ) const {
+        const Entry *best = nullptr;
+        int bestScore = -1;
+        for (const auto &e : entries) {
+            const int score = std::max(matchScore(e.groupI, e.groupJ, groupI, groupJ), //
+                                       matchScore(e.groupI, e.groupJ, groupJ, groupI));
+            if (score >= bestScore && score >= 0) {
+                best = &e;
+                bestScore = score;
+            }
+        }
+        return best;
+    }
+
+    /**
+     * @brief set the spring constant of a unilateral contact and shift its delta0 for damping
+     *
+     * @param groupI
+     * @param groupJ
+     * @param dt timestep
+     * @param delta0 [in,out] current separation
+     * @param kappa [out] effective stiffness, 0 for rigid contacts
+     */
+    void apply(int groupI, int groupJ, double dt, double &delta0, double &kappa) const {
+        const Entry *e = find(groupI, groupJ);
+        if (e == nullptr || e->kappa <= 0) {
+            return;
+        }
+        const double kappaEff = e->kappa + e->damping / dt;
+        delta0 -= e->damping / dt * std::min(delta0, 0.0) / kappaEff;
+        kappa = kappaEff;
+    }
+
+    /**
+     * @brief Coulomb friction coefficient of a pair of groups
+     *
+     * @param groupI
+     * @param groupJ
+     * @return double 0 for frictionless contacts
+     */
+    double getFriction(int groupI, int groupJ) const {
+        const Entry *e = find(groupI, groupJ);
+        return (e == nullptr || e->friction <= 0) ? 0 : e->friction;
+    }
+
+    /**
+     * @brief print the configuration
+     *
+     */
+    void echo() const {
+        for (const auto &e : entries) {
+            printf("Contact compliance: groups %d,%d kappa %g damping %g friction %g\n", e.groupI, e.groupJ, e.kappa,
+                   e.damping, e.friction);
+        }
+    }
+
+  private:
+    std::vector<Entry> entries;
+
+    /**
+     * @brief how specific entry (a,b) matches groups (i,j)
+     *
+     * @return int number of exactly matched groups, -1 for no match
+     */
+    static int matchScore(int a, int b, int i, int j) {
+        if ((a != -1 && a != i) || (b != -1 && b != j)) {
+            return -1;
+        }
+        return (a != -1) + (b != -1);
+    }
+};
+
+#endif
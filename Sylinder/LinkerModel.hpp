@@ -0,0 +1,95 @@
+/**
+ * @file LinkerModel.hpp
+ * @brief Geometry and stiffness of the bilateral constraints of each link type
+ *
+ */
+#ifndef LINKERMODEL_HPP_
+#define LINKERMODEL_HPP_
+
+#include "Util/YamlHelper.hpp"
+
+#include <cstdio>
+#include <vector>
+
+/**
+ * @brief a table of linker models, indexed by the type of a link
+ *
+ * A link prev -> next connects the plus end of prev (I) to the minus end of next (J).
+ * Each model is a list of attachments, and each attachment is one bilateral constraint between
+ *   P = centerI + directionI * (0.5 * lengthI - offsetI)
+ *   Q = centerJ - directionJ * (0.5 * lengthJ - offsetJ)
+ * with separation delta0 = |P - Q| - radiusI - radiusJ - restLength.
+ * The attachments of all models are stored contiguously, model t owns [disp[t], disp[t+1]).
+ */
+class LinkerModel {
+  public:
+    struct Attachment {
+        double offsetI = 0;    ///< um, distance of the anchor on I from its plus end toward the center
+        double offsetJ = 0;    ///< um, distance of the anchor on J from its minus end toward the center
+        double restLength = 0; ///< um, rest length between the surfaces at the anchors
+        double kappa = 0;      ///< pN/um, stiffness. <= 0 means rigid
+    };
+
+    /**
+     * @brief the default is one model of two springs for semiflexible filaments
+     *
+     */
+    LinkerModel() {
+        attachment = {{0.01, 0.01, 0.01, 500}, {0.1465, 0.1465, 0.323, 92}};
+        disp = {0, 2};
+    }
+    ~LinkerModel() = default;
+
+    /**
+     * @brief initialize from a yaml list of models, each with a list of attachments
+     *
+     * @param config
+     */
+    void initialize(const YAML::Node &config) {
+        attachment.clear();
+        disp.assign(1, 0);
+        for (const auto &m : config) {
+            for (const auto &a : m["attachments"]) {
+                Attachment entry;
+                readConfig(a, VARNAME(restLength), entry.restLength, "");
+                readConfig(a, VARNAME(kappa), entry.kappa, "", true);
+                readConfig(a, VARNAME(offsetI), entry.offsetI, "", true);
+                readConfig(a, VARNAME(offsetJ), entry.offsetJ, "", true);
+                attachment.push_back(entry);
+            }
+            disp.push_back(attachment.size());
+        }
+    }
+
+    int getNumModel() const { return disp.size() - 1; }
+
+    bool isValidType(int type) const { return type >= 0 && type < getNumModel(); }
+
+    /**
+     * @brief the attachments of a link type
+     *
+     * @param type
+     * @return const Attachment* first of the model, the rest follow contiguously
+     */
+    const Attachment *begin(int type) const { return attachment.data() + disp[type]; }
+    const Attachment *end(int type) const { return attachment.data() + disp[type + 1]; }
+
+    /**
+     * @brief print the configuration
+     *
+     */
+    void echo() const {
+        for (int t = 0; t < getNumModel(); t++) {
+            for (const auto *a = begin(t); a != end(t); a++) {
+                printf("Linker model %d: offset %g,%g rest length %g kappa %g\n", t, a->offsetI, a->offsetJ,
+                       a->restLength, a->kappa);
+            }
+        }
+    }
+
+  private:
+    std::vector<Attachment> attachment; ///< attachments of all models
+    std::vector<int> disp;              ///< offset of each model in attachment, size getNumModel()+1
+};
+
+#endif
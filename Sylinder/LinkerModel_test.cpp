@@ -0,0 +1,43 @@
+#include "LinkerModel.hpp"
+
+#include <cstdio>
+
+bool sameAttachment(const LinkerModel::Attachment &a, double offsetI, double offsetJ, double restLength,
+                    double kappa) {
+    return a.offsetI == offsetI && a.offsetJ == offsetJ && a.restLength == restLength && a.kappa == kappa;
+}
+
+// the default model is the two springs for semiflexible filaments
+bool testDefault() {
+    const LinkerModel model;
+    const auto *a = model.begin(0);
+    return model.getNumModel() == 1 && model.isValidType(0) && !model.isValidType(1) && !model.isValidType(-1) &&
+           model.end(0) - a == 2 && sameAttachment(a[0], 0.01, 0.01, 0.01, 500) &&
+           sameAttachment(a[1], 0.1465, 0.1465, 0.323, 92);
+}
+
+// each type selects its own attachments, missing optional fields are 0
+bool testConfig() {
+    const YAML::Node config = YAML::Load(R"(
+- attachments:
+    - {restLength: 0.05, kappa: 100}
+- attachments:
+    - {restLength: 0.1, kappa: 10, offsetI: 0.2, offsetJ: 0.3}
+    - {restLength: 0.2}
+    - {restLength: 0.3, kappa: -1}
+)");
+    LinkerModel model;
+    model.initialize(config);
+    const auto *a0 = model.begin(0);
+    const auto *a1 = model.begin(1);
+    return model.getNumModel() == 2 && model.isValidType(1) && !model.isValidType(2) && //
+           model.end(0) - a0 == 1 && sameAttachment(a0[0], 0, 0, 0.05, 100) &&          //
+           model.end(1) - a1 == 3 && sameAttachment(a1[0], 0.2, 0.3, 0.1, 10) &&         //
+           sameAttachment(a1[1], 0, 0, 0.2, 0) && sameAttachment(a1[2], 0, 0, 0.3, -1);
+}
+
+int main() {
+    const bool pass = testDefault() && testConfig();
+    printf(pass ? "TestPassed\n" : "Error in linker model test\n");
+    return 0;
+}
@@ -0,0 +1,164 @@
+/**
+ * @file PairPotential.hpp
+ * @brief Soft pair potentials evaluated in the sylinder near interaction tree walk
+ *
+ */
+#ifndef PAIRPOTENTIAL_HPP_
+#define PAIRPOTENTIAL_HPP_
+
+#include "Util/YamlHelper.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+
+/**
+ * @brief interface to all soft pair potentials
+ *
+ * A potential is a function of the surface separation sep between two spherocylinders,
+ * i.e., the minimal distance between the two center segments minus the sum of radii.
+ * The force acts along the line of minimal distance, and is applied at the closest point on each segment.
+ */
+class PairPotential {
+  public:
+    PairPotential() = default;
+    virtual ~PairPotential(){};
+
+    /**
+     * @brief initialize from a yaml node
+     *
+     * @param config
+     */
+    virtual void initialize(const YAML::Node &config) = 0;
+
+    /**
+     * @brief the surface separation beyond which the force is zero
+     *
+     * must not decrease with radI + radJ
+     * @param radI radius of I
+     * @param radJ radius of J
+     * @return double
+     */
+    virtual double getCutoff(double radI, double radJ) const = 0;
+
+    /**
+     * @brief force magnitude, positive for repulsion
+     *
+     * @param sep surface separation, may be negative for overlapping pairs
+     * @param radI radius of I
+     * @param radJ radius of J
+     * @return double
+     */
+    virtual double getForce(double sep, double radI, double radJ) const = 0;
+
+    /**
+     * @brief print the configuration of this potential
+     *
+     */
+    virtual void echo() const = 0;
+};
+
+/**
+ * @brief WCA steric repulsion on the distance between center segments
+ *
+ * r = sep + radI + radJ, sigma = radI + radJ
+ * U(r) = 4 epsilon [(sigma/r)^12 - (sigma/r)^6] + epsilon for r < 2^(1/6) sigma
+ * sep is clamped to >= 0, overlaps are resolved by collision constraints
+ */
+class PairWCA : public PairPotential {
+  public:
+    PairWCA(const YAML::Node &config) { initialize(config); };
+    PairWCA(double epsilon_) : epsilon(epsilon_){};
+    virtual ~PairWCA() = default;
+
+    virtual void initialize(const YAML::Node &config) {
+        readConfig(config, VARNAME(epsilon), epsilon, "");
+    }
+
+    virtual double getCutoff(double radI, double radJ) const { return (std::pow(2.0, 1.0 / 6) - 1) * (radI + radJ); }
+
+    virtual double getForce(double sep, double radI, double radJ) const {
+        const double sigma = radI + radJ;
+        const double r = std::max(sep, 0.0) + sigma;
+        if (r >= std::pow(2.0, 1.0 / 6) * sigma) {
+            return 0;
+        }
+        const double sr6 = std::pow(sigma / r, 6);
+        return 24 * epsilon / r * (2 * sr6 * sr6 - sr6);
+    }
+
+    virtual void echo() const { printf("WCA: epsilon %g\n", epsilon); }
+
+  private:
+    double epsilon = 0; ///< energy scale
+};
+
+/**
+ * @brief screened electrostatic repulsion between surfaces
+ *
+ * U(sep) = A exp(-sep/lambda), F = A/lambda exp(-sep/lambda) for sep < cutoff
+ * sep is clamped to >= 0
+ */
+class PairYukawa : public PairPotential {
+  public:
+    PairYukawa(const YAML::Node &config) { initialize(config); };
+    PairYukawa(double strength_, double lambda_, double cutoff_)
+        : strength(strength_), lambda(lambda_), cutoff(cutoff_){};
+    virtual ~PairYukawa() = default;
+
+    virtual void initialize(const YAML::Node &config) {
+        readConfig(config, VARNAME(strength), strength, "");
+        readConfig(config, VARNAME(lambda), lambda, "");
+        cutoff = 5 * lambda;
+        readConfig(config, VARNAME(cutoff), cutoff, "", true);
+    }
+
+    virtual double getCutoff(double radI, double radJ) const { return cutoff; }
+
+    virtual double getForce(double sep, double radI, double radJ) const {
+        return sep < cutoff ? strength / lambda * std::exp(-std::max(sep, 0.0) / lambda) : 0;
+    }
+
+    virtual void echo() const { printf("Yukawa: strength %g, lambda %g, cutoff %g\n", strength, lambda, cutoff); }
+
+  private:
+    double strength = 0; ///< energy A at contact
+    double lambda = 1;   ///< Debye screening length
+    double cutoff = 5;   ///< cutoff of surface separation
+};
+
+/**
+ * @brief Asakura-Oosawa depletion attraction in the Derjaguin approximation
+ *
+ * F(sep) = -2 pi Reff Pi (2 delta - sep) for 0 <= sep < 2 delta, Reff = radI radJ / (radI + radJ)
+ * Pi is the osmotic pressure of depletants with radius delta
+ */
+class PairDepletion : public PairPotential {
+  public:
+    PairDepletion(const YAML::Node &config) { initialize(config); };
+    PairDepletion(double pressure_, double delta_) : pressure(pressure_), delta(delta_){};
+    virtual ~PairDepletion() = default;
+
+    virtual void initialize(const YAML::Node &config) {
+        readConfig(config, VARNAME(pressure), pressure, "");
+        readConfig(config, VARNAME(delta), delta, "");
+    }
+
+    virtual double getCutoff(double radI, double radJ) const { return 2 * delta; }
+
+    virtual double getForce(double sep, double radI, double radJ) const {
+        if (sep >= 2 * delta) {
+            return 0;
+        }
+        const double Reff = radI * radJ / (radI + radJ);
+        return -2 * 3.14159265358979323846 * Reff * pressure * (2 * delta - std::max(sep, 0.0));
+    }
+
+    virtual void echo() const { printf("Depletion: pressure %g, depletant radius %g\n", pressure, delta); }
+
+  private:
+    double pressure = 0; ///< osmotic pressure of depletants
+    double delta = 0;    ///< depletant radius
+};
+
+#endif
@@ -0,0 +1,189 @@
+#include "RigidClusterOperator.hpp"
+
+#include <algorithm>
+
+RigidClusterOperator::RigidClusterOperator(const Teuchos::RCP<const TCMAT> &mobMatRcp_,
+                                           const std::vector<int> &bodyGid, const std::vector<int> &clusterGid,
+                                           const std::vector<double> &offset_)
+    : offset(offset_) {
+    mobMapRcp = mobMatRcp_->getRangeMap();
+    auto commRcp = mobMapRcp->getComm();
+    const int nLocal = bodyGid.size();
+    TEUCHOS_TEST_FOR_EXCEPTION(clusterGid.size() != nLocal || offset.size() != 3 * nLocal ||
+                                   mobMapRcp->getNodeNumElements() != 6 * nLocal,
+                               std::invalid_argument, "RigidClusterOperator: inconsistent local sizes.");
+
+    // owned clusters are those with the anchor body on this rank
+    std::vector<int> ownedGid;
+    std::vector<int> memberGid = clusterGid;
+    for (int i = 0; i < nLocal; i++) {
+        if (bodyGid[i] == clusterGid[i]) {
+            ownedGid.push_back(clusterGid[i]);
+        }
+    }
+    std::sort(memberGid.begin(), memberGid.end());
+    memberGid.erase(std::unique(memberGid.begin(), memberGid.end()), memberGid.end());
+    memberIndex.resize(nLocal);
+    for (int i = 0; i < nLocal; i++) {
+        memberIndex[i] = std::lower_bound(memberGid.begin(), memberGid.end(), clusterGid[i]) - memberGid.begin();
+    }
+
+    const auto invalid = Teuchos::OrdinalTraits<Tpetra::global_size_t>::invalid();
+    clusterMapRcp = Teuchos::rcp(new TMAP(invalid, ownedGid.data(), ownedGid.size(), 0, commRcp));
+    memberMapRcp = Teuchos::rcp(new TMAP(invalid, memberGid.data(), memberGid.size(), 0, commRcp));
+    importerRcp = Teuchos::rcp(new Tpetra::Import<int, int>(clusterMapRcp, memberMapRcp));
+
+    // 6x6 mobility block of each body, column index is local
+    // an immovable body has a zero block and makes its cluster immovable
+    resistanceBody.resize(nLocal);
+    std::vector<int> immovable(nLocal, 0);
+    auto colMapRcp = mobMatRcp_->getColMap();
+#pragma omp parallel for
+    for (int i = 0; i < nLocal; i++) {
+        Emat6 mob = Emat6::Zero();
+        for (int a = 0; a < 6; a++) {
+            Teuchos::ArrayView<const int> cols;
+            Teuchos::ArrayView<const double> vals;
+            mobMatRcp_->getLocalRowView(6 * i + a, cols, vals);
+            for (int k = 0; k < cols.size(); k++) {
+                const int b = mobMapRcp->getLocalElement(colMapRcp->getGlobalElement(cols[k])) - 6 * i;
+                TEUCHOS_ASSERT(b >= 0 && b < 6);
+                mob(a, b) = vals[k];
+            }
+        }
+        if (mob.isZero(0)) {
+            immovable[i] = 1;
+            resistanceBody[i].setZero();
+        } else {
+            resistanceBody[i] = mob.inverse();
+        }
+    }
+
+    // R_c = sum_b J_b^T R_b J_b, 36 entries per cluster and the number of immovable bodies
+    TMV memberRes(memberMapRcp, 37, true);
+    {
+        auto resView = memberRes.getLocalView<Kokkos::HostSpace>();
+        memberRes.modify<Kokkos::HostSpace>();
+        for (int i = 0; i < nLocal; i++) {
+            const Emat6 J = getJ(i);
+            const Emat6 R = J.transpose() * resistanceBody[i] * J;
+            const int m = memberIndex[i];
+            for (int k = 0; k < 36; k++) {
+                resView(m, k) += R(k / 6, k % 6);
+            }
+            resView(m, 36) += immovable[i];
+        }
+    }
+    TMV clusterRes(clusterMapRcp, 37, true);
+    clusterRes.doExport(memberRes, *importerRcp, Tpetra::ADD);
+
+    auto resView = clusterRes.getLocalView<Kokkos::HostSpace>();
+    const int nCluster = ownedGid.size();
+    mobCluster.resize(nCluster);
+#pragma omp parallel for
+    for (int c = 0; c < nCluster; c++) {
+        if (resView(c, 36) > 0.5) {
+            mobCluster[c].setZero();
+            continue;
+        }
+        Emat6 R;
+        for (int k = 0; k < 36; k++) {
+            R(k / 6, k % 6) = resView(c, k);
+        }
+        mobCluster[c] = R.ldlt().solve(Emat6::Identity());
+    }
+}
+
+Emat6 RigidClusterOperator::getJ(int i) const {
+    // v_b = v + w x r = v - [r]x w
+    Emat6 J = Emat6::Identity();
+    const Evec3 r = getOffset(i);
+    Emat3 rCross;
+    rCross << 0, -r[2], r[1], //
+        r[2], 0, -r[0],       //
+        -r[1], r[0], 0;
+    J.block<3, 3>(0, 3) = -rCross;
+    return J;
+}
+
+void RigidClusterOperator::apply(const TMV &X, TMV &Y, Teuchos::ETransp mode, scalar_type alpha,
+                                 scalar_type beta) const {
+    applyCluster(X, Y, false, alpha, beta);
+}
+
+void RigidClusterOperator::projectVelocity(TMV &V) const {
+    TMV VCopy(V, Teuchos::Copy);
+    applyCluster(VCopy, V, true, 1.0, 0.0);
+}
+
+void RigidClusterOperator::applyCluster(const TMV &X, TMV &Y, bool resistance, scalar_type alpha,
+                                        scalar_type beta) const {
+    TEUCHOS_TEST_FOR_EXCEPTION(X.getNumVectors() != Y.getNumVectors(), std::invalid_argument,
+                               "X and Y do not have the same numbers of vectors (columns).");
+    const int nVec = X.getNumVectors();
+    const int nLocal = memberIndex.size();
+    const int nCluster = mobCluster.size();
+
+    // force and torque on the anchor point of each cluster, g = J^T f
+    TMV memberF(memberMapRcp, 6 * nVec, true);
+    {
+        auto xView = X.getLocalView<Kokkos::HostSpace>();
+        auto fView = memberF.getLocalView<Kokkos::HostSpace>();
+        memberF.modify<Kokkos::HostSpace>();
+        for (int i = 0; i < nLocal; i++) {
+            const Emat6 JT = getJ(i).transpose();
+            for (int c = 0; c < nVec; c++) {
+                Evec6 f;
+                for (int k = 0; k < 6; k++) {
+                    f[k] = xView(6 * i + k, c);
+                }
+                const Evec6 g = resistance ? Evec6(JT * (resistanceBody[i] * f)) : Evec6(JT * f);
+                for (int k = 0; k < 6; k++) {
+                    fView(memberIndex[i], 6 * c + k) += g[k];
+                }
+            }
+        }
+    }
+    TMV clusterV(clusterMapRcp, 6 * nVec, true);
+    clusterV.doExport(memberF, *importerRcp, Tpetra::ADD);
+
+    // cluster velocity at the anchor point
+    {
+        auto vView = clusterV.getLocalView<Kokkos::HostSpace>();
+        clusterV.modify<Kokkos::HostSpace>();
+#pragma omp parallel for
+        for (int k = 0; k < nCluster; k++) {
+            for (int c = 0; c < nVec; c++) {
+                Evec6 g;
+                for (int j = 0; j < 6; j++) {
+                    g[j] = vView(k, 6 * c + j);
+                }
+                const Evec6 v = mobCluster[k] * g;
+                for (int j = 0; j < 6; j++) {
+                    vView(k, 6 * c + j) = v[j];
+                }
+            }
+        }
+    }
+    TMV memberV(memberMapRcp, 6 * nVec, false);
+    memberV.doImport(clusterV, *importerRcp, Tpetra::INSERT);
+
+    // body velocity, Y = alpha J v + beta Y
+    auto vView = memberV.getLocalView<Kokkos::HostSpace>();
+    auto yView = Y.getLocalView<Kokkos::HostSpace>();
+    Y.modify<Kokkos::HostSpace>();
+#pragma omp parallel for
+    for (int i = 0; i < nLocal; i++) {
+        const Emat6 J = getJ(i);
+        for (int c = 0; c < nVec; c++) {
+            Evec6 v;
+            for (int k = 0; k < 6; k++) {
+                v[k] = vView(memberIndex[i], 6 * c + k);
+            }
+            const Evec6 vb = J * v;
+            for (int k = 0; k < 6; k++) {
+                yView(6 * i + k, c) = alpha * vb[k] + (beta == 0 ? 0 : beta * yView(6 * i + k, c));
+            }
+        }
+    }
+}
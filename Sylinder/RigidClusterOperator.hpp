@@ -0,0 +1,99 @@
+/**
+ * @file RigidClusterOperator.hpp
+ * @brief Mobility of rigid clusters of 6-dof bodies
+ *
+ */
+#ifndef RIGIDCLUSTEROPERATOR_HPP_
+#define RIGIDCLUSTEROPERATOR_HPP_
+
+#include "Trilinos/TpetraUtil.hpp"
+#include "Util/EigenDef.hpp"
+
+#include <vector>
+
+/**
+ * @brief mobility of bodies moving as rigid clusters
+ *
+ * Each body belongs to one cluster, a single body is a cluster of its own.
+ * The velocity (v,w) of a cluster is defined at its anchor point, and the velocity of a body at offset r is
+ *   \f$ v_b = v + w \times r, w_b = w \f$, i.e., \f$ V_b = J_b V_c \f$
+ * The resistance of a cluster is \f$ R_c = \sum_b J_b^T M_b^{-1} J_b \f$ with the 6x6 mobility block \f$ M_b \f$,
+ * and this operator is \f$ J R_c^{-1} J^T \f$ on the mobility map of bodies.
+ * A cluster is owned by the rank of its anchor body, and cluster force and velocity are communicated with an
+ * Import from the owned clusters to the clusters of local bodies.
+ */
+class RigidClusterOperator : public TOP {
+  public:
+    /**
+     * @brief Construct a new RigidClusterOperator object
+     *
+     * collective
+     * @param mobMatRcp_ block diagonal mobility matrix, 6 dof per body
+     * @param bodyGid gid of each local body
+     * @param clusterGid gid of the anchor body of the cluster of each local body
+     * @param offset 3 per local body, body center - anchor point
+     */
+    RigidClusterOperator(const Teuchos::RCP<const TCMAT> &mobMatRcp_, const std::vector<int> &bodyGid,
+                         const std::vector<int> &clusterGid, const std::vector<double> &offset);
+
+    ~RigidClusterOperator() = default;
+
+    Teuchos::RCP<const TMAP> getDomainMap() const { return mobMapRcp; }
+    Teuchos::RCP<const TMAP> getRangeMap() const { return mobMapRcp; }
+
+    bool hasTransposeApply() const { return true; }
+
+    /**
+     * @brief Y := alpha J R_c^{-1} J^T X + beta Y, symmetric
+     *
+     */
+    void apply(const TMV &X, TMV &Y, Teuchos::ETransp mode = Teuchos::NO_TRANS,
+               scalar_type alpha = Teuchos::ScalarTraits<scalar_type>::one(),
+               scalar_type beta = Teuchos::ScalarTraits<scalar_type>::zero()) const;
+
+    /**
+     * @brief project body velocities to the rigid motion of clusters, V := J R_c^{-1} J^T M_b^{-1} V
+     *
+     * The covariance of a projected Brownian velocity with covariance M_b is the cluster mobility.
+     * Velocities already rigid are not changed.
+     * @param V
+     */
+    void projectVelocity(TMV &V) const;
+
+    /**
+     * @brief offset of local body i to its anchor point
+     *
+     * @param i
+     * @return Evec3
+     */
+    Evec3 getOffset(int i) const { return Evec3(offset[3 * i], offset[3 * i + 1], offset[3 * i + 2]); }
+
+    int getClusterNumberGlobal() const { return clusterMapRcp->getGlobalNumElements(); }
+
+  private:
+    Teuchos::RCP<const TMAP> mobMapRcp;     ///< 6 dof per body
+    Teuchos::RCP<const TMAP> clusterMapRcp; ///< one entry per owned cluster, gid of the anchor body
+    Teuchos::RCP<const TMAP> memberMapRcp;  ///< one entry per cluster of local bodies, overlapping
+    Teuchos::RCP<Tpetra::Import<int, int>> importerRcp; ///< from clusterMap to memberMap
+
+    std::vector<int> memberIndex;      ///< local index in memberMap of each local body
+    std::vector<double> offset;        ///< 3 per local body
+    std::vector<Emat6> resistanceBody; ///< inverse of the mobility block of each local body
+    std::vector<Emat6> mobCluster;     ///< inverse of the resistance of each owned cluster
+
+    /**
+     * @brief J_b of body i, maps cluster velocity to body velocity
+     *
+     * @param i
+     * @return Emat6
+     */
+    Emat6 getJ(int i) const;
+
+    /**
+     * @brief Y := alpha J R_c^{-1} J^T F + beta Y, with F = X or F = M_b^{-1} X
+     *
+     */
+    void applyCluster(const TMV &X, TMV &Y, bool resistance, scalar_type alpha, scalar_type beta) const;
+};
+
+#endif
@@ -0,0 +1,196 @@
+/**
+ * @file RigidClusterOperator_test.cpp
+ * @brief test of the mobility of rigid clusters spanning ranks
+ *
+ */
+#include "RigidClusterOperator.hpp"
+
+#include "Util/Logger.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <random>
+#include <utility>
+#include <vector>
+
+#include <mpi.h>
+
+/**
+ * @brief 3 bodies per rank, gid 3r, 3r+1, 3r+2 on rank r
+ *
+ * Bodies 3r are single-body clusters.
+ * All other bodies are rigidly linked to the cluster with anchor body 1 on rank 0.
+ * The mobility block of body g is B B^T + I with a random B seeded by g.
+ */
+struct ClusterProblem {
+    static constexpr int nLocal = 3;
+    int objOffset = 0;
+    Teuchos::RCP<TCMAT> mobMatRcp;
+    Teuchos::RCP<RigidClusterOperator> clusterOpRcp;
+    std::vector<int> bodyGid;
+    std::vector<int> clusterGid;
+    std::vector<double> offset;
+
+    ClusterProblem() {
+        Teuchos::RCP<const TCOMM> commRcp = getMPIWORLDTCOMM();
+        Teuchos::RCP<const TMAP> mobMapRcp = getTMAPFromLocalSize(6 * nLocal, commRcp);
+        objOffset = mobMapRcp->getMinGlobalIndex() / 6;
+
+        std::vector<std::vector<std::pair<int, double>>> mobRows(6 * nLocal);
+        for (int i = 0; i < nLocal; i++) {
+            const int g = objOffset + i;
+            std::mt19937 gen(g);
+            std::uniform_real_distribution<double> dis(-1, 1);
+            Emat6 B;
+            for (int k = 0; k < 36; k++) {
+                B(k / 6, k % 6) = dis(gen);
+            }
+            const Emat6 M = B * B.transpose() + Emat6::Identity();
+            for (int a = 0; a < 6; a++) {
+                for (int b = 0; b < 6; b++) {
+                    mobRows[6 * i + a].emplace_back(6 * g + b, M(a, b));
+                }
+            }
+
+            // body centers along a bent line, the anchor body 1 at (1, 0.3, 0)
+            bodyGid.push_back(g);
+            clusterGid.push_back(g % 3 == 0 ? g : 1);
+            const double pos[3] = {1.0 * g, 0.3 * (g % 2), 0.2 * (g % 3 == 2)};
+            const double anchor[3] = {1.0, 0.3, 0.0};
+            for (int k = 0; k < 3; k++) {
+                offset.push_back(clusterGid.back() == g ? 0 : pos[k] - anchor[k]);
+            }
+        }
+        mobMatRcp = getTCMATFromRowEntries(mobRows, mobMapRcp, mobMapRcp);
+        clusterOpRcp = Teuchos::rcp(new RigidClusterOperator(mobMatRcp, bodyGid, clusterGid, offset));
+    }
+
+    /**
+     * @brief a random vector, entries depend on the global index only
+     *
+     * @param seed
+     * @return Teuchos::RCP<TV>
+     */
+    Teuchos::RCP<TV> getRandomVec(int seed) const {
+        Teuchos::RCP<TV> vecRcp = Teuchos::rcp(new TV(mobMatRcp->getRangeMap(), false));
+        auto vecPtr = vecRcp->getLocalView<Kokkos::HostSpace>();
+        vecRcp->modify<Kokkos::HostSpace>();
+        for (int k = 0; k < 6 * nLocal; k++) {
+            std::mt19937 gen(1000 * seed + 6 * objOffset + k);
+            std::uniform_real_distribution<double> dis(-1, 1);
+            vecPtr(k, 0) = dis(gen);
+        }
+        return vecRcp;
+    }
+};
+
+/**
+ * @brief the cluster mobility is symmetric, and positive for random forces
+ *
+ * @param problem
+ * @return bool
+ */
+bool testSymmetric(const ClusterProblem &problem) {
+    auto xRcp = problem.getRandomVec(1);
+    auto yRcp = problem.getRandomVec(2);
+    TV Ax(xRcp->getMap(), false);
+    TV Ay(yRcp->getMap(), false);
+    problem.clusterOpRcp->apply(*xRcp, Ax);
+    problem.clusterOpRcp->apply(*yRcp, Ay);
+    const double yAx = yRcp->dot(Ax);
+    const double xAy = xRcp->dot(Ay);
+    const double xAx = xRcp->dot(Ax);
+    spdlog::info("yAx {:g}, xAy {:g}, xAx {:g}", yAx, xAy, xAx);
+    return std::abs(yAx - xAy) < 1e-12 * std::abs(xAx) && xAx > 0 && yRcp->dot(Ay) > 0;
+}
+
+/**
+ * @brief a single-body cluster has the mobility block of the body, and does not move other bodies
+ *
+ * @param problem
+ * @return bool
+ */
+bool testSingle(const ClusterProblem &problem) {
+    // force only on single bodies
+    auto fRcp = problem.getRandomVec(3);
+    {
+        auto fPtr = fRcp->getLocalView<Kokkos::HostSpace>();
+        fRcp->modify<Kokkos::HostSpace>();
+        for (int i = 0; i < ClusterProblem::nLocal; i++) {
+            for (int k = 0; k < 6; k++) {
+                fPtr(6 * i + k, 0) *= problem.clusterGid[i] == problem.bodyGid[i] ? 1 : 0;
+            }
+        }
+    }
+    TV velCluster(fRcp->getMap(), false);
+    TV velBody(fRcp->getMap(), false);
+    problem.clusterOpRcp->apply(*fRcp, velCluster);
+    problem.mobMatRcp->apply(*fRcp, velBody);
+
+    auto cPtr = velCluster.getLocalView<Kokkos::HostSpace>();
+    auto bPtr = velBody.getLocalView<Kokkos::HostSpace>();
+    double errorLocal = 0;
+    for (int k = 0; k < 6 * ClusterProblem::nLocal; k++) {
+        errorLocal = std::max(errorLocal, std::abs(cPtr(k, 0) - bPtr(k, 0)));
+    }
+    double error = 0;
+    MPI_Allreduce(&errorLocal, &error, 1, MPI_DOUBLE, MPI_MAX, MPI_COMM_WORLD);
+    spdlog::info("single body cluster error {:g}", error);
+    return error < 1e-10;
+}
+
+/**
+ * @brief bodies linked across ranks move with the rigid velocity of the anchor under a random force
+ *
+ * @param problem
+ * @return bool
+ */
+bool testRigid(const ClusterProblem &problem) {
+    auto fRcp = problem.getRandomVec(4);
+    TV vel(fRcp->getMap(), false);
+    problem.clusterOpRcp->apply(*fRcp, vel);
+    auto velPtr = vel.getLocalView<Kokkos::HostSpace>();
+
+    // the anchor body 1 has zero offset, its velocity is the cluster velocity
+    double anchorLocal[6] = {0, 0, 0, 0, 0, 0};
+    for (int i = 0; i < ClusterProblem::nLocal; i++) {
+        if (problem.bodyGid[i] == 1) {
+            for (int k = 0; k < 6; k++) {
+                anchorLocal[k] = velPtr(6 * i + k, 0);
+            }
+        }
+    }
+    double anchor[6];
+    MPI_Allreduce(anchorLocal, anchor, 6, MPI_DOUBLE, MPI_SUM, MPI_COMM_WORLD);
+    const Evec3 vAnchor(anchor[0], anchor[1], anchor[2]);
+    const Evec3 wAnchor(anchor[3], anchor[4], anchor[5]);
+
+    double errorLocal = 0;
+    for (int i = 0; i < ClusterProblem::nLocal; i++) {
+        if (problem.clusterGid[i] != 1) {
+            continue;
+        }
+        const Evec3 r(problem.offset[3 * i], problem.offset[3 * i + 1], problem.offset[3 * i + 2]);
+        const Evec3 vRigid = vAnchor + wAnchor.cross(r);
+        for (int k = 0; k < 3; k++) {
+            errorLocal = std::max(errorLocal, std::abs(velPtr(6 * i + k, 0) - vRigid[k]));
+            errorLocal = std::max(errorLocal, std::abs(velPtr(6 * i + 3 + k, 0) - wAnchor[k]));
+        }
+    }
+    double error = 0;
+    MPI_Allreduce(&errorLocal, &error, 1, MPI_DOUBLE, MPI_MAX, MPI_COMM_WORLD);
+    spdlog::info("rigid cluster error {:g}, anchor velocity norm {:g}", error, vAnchor.norm() + wAnchor.norm());
+    return error < 1e-12 * (vAnchor.norm() + wAnchor.norm()) && vAnchor.norm() > 0;
+}
+
+int main(int argc, char **argv) {
+    MPI_Init(&argc, &argv);
+    {
+        Logger::setup_mpi_spdlog();
+        const ClusterProblem problem;
+        const bool pass = testSymmetric(problem) && testSingle(problem) && testRigid(problem);
+        spdlog::info(pass ? "TestPassed" : "Error in rigid cluster test");
+    }
+    MPI_Finalize();
+    return 0;
+}
@@ -56,6 +56,7 @@ void Sylinder::clear() {
     sepmin = std::numeric_limits<double>::max();
     globalIndex = GEO_INVALID_INDEX;
     rank = -1;
+    clusterGid = GEO_INVALID_INDEX;
 }
 
 bool Sylinder::isSphere(bool collision) const {
@@ -98,12 +99,29 @@ void Sylinder::stepEuler(double dt) {
     Emapq(orientation).w() = currOrient.w();
 }
 
+void Sylinder::stepEulerRigid(double dt, const Evec3 &offset) {
+    const Evec3 velAnchor = Emap3(vel) - Emap3(omega).cross(offset);
+    Equatn rotation = Equatn::Identity();
+    EquatnHelper::rotateEquatn(rotation, Emap3(omega), dt);
+    Emap3(pos) += velAnchor * dt + rotation * offset - offset;
+    Equatn currOrient = Emapq(orientation);
+    EquatnHelper::rotateEquatn(currOrient, Emap3(omega), dt);
+    Emapq(orientation).x() = currOrient.x();
+    Emapq(orientation).y() = currOrient.y();
+    Emapq(orientation).z() = currOrient.z();
+    Emapq(orientation).w() = currOrient.w();
+}
+
 void Sylinder::writeAscii(FILE *fptr) const {
     Evec3 direction = ECmapq(orientation) * Evec3(0, 0, 1);
     Evec3 minus = ECmap3(pos) - 0.5 * length * direction;
     Evec3 plus = ECmap3(pos) + 0.5 * length * direction;
     char typeChar = isImmovable ? 'S' : 'C';
-    fprintf(fptr, "%c %d %.8g %.8g %.8g %.8g %.8g %.8g %.8g %d\n", //
-            typeChar, gid, radius,                                 //
+    fprintf(fptr, "%c %d %.8g %.8g %.8g %.8g %.8g %.8g %.8g %d", //
+            typeChar, gid, radius,                               //
             minus[0], minus[1], minus[2], plus[0], plus[1], plus[2], group);
+    if (shape >= 0) {
+        fprintf(fptr, " %d", shape);
+    }
+    fprintf(fptr, "\n");
 }
@@ -29,6 +29,7 @@
 struct Link {
     int prev = GEO_INVALID_INDEX; ///< previous link in the link group
     int next = GEO_INVALID_INDEX; ///< next link in the link group
+    int type = 0;                 ///< index of the model in SylinderConfig::linkerModel
 };
 
 /**
@@ -41,14 +42,18 @@ class Sylinder {
     int globalIndex = GEO_INVALID_INDEX; ///< unique global index sequentially ordered
     int rank = -1;                       ///< mpi rank
     int group = -1;                      ///< a 'marker'
+    int clusterGid = GEO_INVALID_INDEX;  ///< gid of the anchor of its rigid cluster, invalid if not clustered
+    int shape = -1;                      ///< index of the convex collision shape, -1 for sylinder
 
     bool isImmovable = false; ///< flag for if Sylinder can move
+    bool isSubcycled = false; ///< in the fast bin, moved with substeps of dt / subcycleNumber
+    bool isFrozen = false;    ///< immovable while the other bin is stepped, set by SylinderSystem
 
     double radius;          ///< radius
     double radiusCollision; ///< radius for collision resolution
     double length;          ///< length
     double lengthCollision; ///< length for collision resolution
-    double radiusSearch;    ///< radiusSearch for short range interactions
+    double radiusSearch;    ///< search buffer beyond the surface for soft pair potentials
     double sepmin;          ///< minimal separation with its neighbors within radiusSearch
     double colBuf;          ///< collision buffer
 
@@ -156,6 +161,16 @@ class Sylinder {
      */
     void stepEuler(double dt);
 
+    /**
+     * @brief update the position and orientation as a member of a rigid cluster
+     *
+     * The velocity is a rigid body motion (v - omega x offset, omega) of the anchor point.
+     * The position is rotated around the anchor point exactly, so the cluster shape is kept over large steps.
+     * @param dt
+     * @param offset position - anchor point of the cluster
+     */
+    void stepEulerRigid(double dt, const Evec3 &offset);
+
     /**
      * @brief return position
      *
@@ -225,6 +240,7 @@ class Sylinder {
         cellDataFields.emplace_back(1, IOHelper::IOTYPE::Int32, "gid");
         cellDataFields.emplace_back(1, IOHelper::IOTYPE::Int32, "group");
         cellDataFields.emplace_back(1, IOHelper::IOTYPE::UInt8, "isImmovable");
+        cellDataFields.emplace_back(1, IOHelper::IOTYPE::Int32, "shape");
 
         cellDataFields.emplace_back(1, IOHelper::IOTYPE::Float32, "radius");
         cellDataFields.emplace_back(1, IOHelper::IOTYPE::Float32, "radiusCollision");
@@ -299,6 +315,7 @@ class Sylinder {
         std::vector<int32_t> gid(sylinderNumber);
         std::vector<int32_t> group(sylinderNumber);
         std::vector<uint8_t> isImmovable(sylinderNumber);
+        std::vector<int32_t> shape(sylinderNumber);
         std::vector<float> radius(sylinderNumber);
         std::vector<float> radiusCollision(sylinderNumber);
         std::vector<float> length(sylinderNumber);
@@ -357,6 +374,7 @@ class Sylinder {
             gid[i] = sy.gid;
             group[i] = sy.group;
             isImmovable[i] = sy.isImmovable ? 1 : 0;
+            shape[i] = sy.shape;
 
             radius[i] = sy.radius;
             radiusCollision[i] = sy.radiusCollision;
@@ -417,6 +435,7 @@ class Sylinder {
         IOHelper::writeDataArrayBase64(gid, "gid", 1, file);
         IOHelper::writeDataArrayBase64(group, "group", 1, file);
         IOHelper::writeDataArrayBase64(isImmovable, "isImmovable", 1, file);
+        IOHelper::writeDataArrayBase64(shape, "shape", 1, file);
         IOHelper::writeDataArrayBase64(radius, "radius", 1, file);
         IOHelper::writeDataArrayBase64(radiusCollision, "radiusCollision", 1, file);
         IOHelper::writeDataArrayBase64(length, "length", 1, file);
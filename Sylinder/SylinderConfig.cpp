@@ -34,10 +34,44 @@ SylinderConfig::SylinderConfig(std::string filename) {
 
     timerLevel = logLevel; // default to info
     readConfig(config, VARNAME(timerLevel), timerLevel, "", true);
+    logAsync = false;
+    readConfig(config, VARNAME(logAsync), logAsync, "", true);
+    logInterval = 1;
+    readConfig(config, VARNAME(logInterval), logInterval, "", true);
+    logInterval = std::max(logInterval, 1);
+
+    memReport = false;
+    readConfig(config, VARNAME(memReport), memReport, "", true);
+    memSoftLimitMB = 0;
+    readConfig(config, VARNAME(memSoftLimitMB), memSoftLimitMB, "", true);
+    traceStart = 0;
+    readConfig(config, VARNAME(traceStart), traceStart, "", true);
+    traceSteps = 0;
+    readConfig(config, VARNAME(traceSteps), traceSteps, "", true);
+    stepTaskGraph = false;
+    readConfig(config, VARNAME(stepTaskGraph), stepTaskGraph, "", true);
+    reproducible = false;
+    readConfig(config, VARNAME(reproducible), reproducible, "", true);
 
     monolayer = false;
     readConfig(config, VARNAME(monolayer), monolayer, "", true);
 
+    domainDecompChoice = 0;
+    readConfig(config, VARNAME(domainDecompChoice), domainDecompChoice, "", true);
+    domainLinkRefine = false;
+    readConfig(config, VARNAME(domainLinkRefine), domainLinkRefine, "", true);
+    if (domainLinkRefine && domainDecompChoice == 0) {
+        spdlog::critical("domainLinkRefine requires a Zoltan domainDecompChoice");
+        std::exit(1);
+    }
+
+    shearRate = 0;
+    readConfig(config, VARNAME(shearRate), shearRate, "", true);
+    if (shearRate != 0 && !(simBoxPBC[0] && simBoxPBC[1])) {
+        spdlog::critical("Lees-Edwards shearRate requires periodic x and y");
+        std::exit(1);
+    }
+
     std::copy(simBoxLow, simBoxLow + 3, initBoxLow);
     std::copy(simBoxHigh, simBoxHigh + 3, initBoxHigh);
     readConfig(config, VARNAME(initBoxLow), initBoxLow, 3, "", true);
@@ -52,6 +86,13 @@ SylinderConfig::SylinderConfig(std::string filename) {
     initPreSteps = 100;
     readConfig(config, VARNAME(initPreSteps), initPreSteps, "", true);
 
+    initOverlapFree = false;
+    initInsertTrial = 20;
+    initRelaxIte = 100;
+    readConfig(config, VARNAME(initOverlapFree), initOverlapFree, "", true);
+    readConfig(config, VARNAME(initInsertTrial), initInsertTrial, "", true);
+    readConfig(config, VARNAME(initRelaxIte), initRelaxIte, "", true);
+
     thermEquilTime = 0;
     readConfig(config, VARNAME(thermEquilTime), thermEquilTime, "", true);
 
@@ -59,6 +100,23 @@ SylinderConfig::SylinderConfig(std::string filename) {
     linkGap = 0.01;
     readConfig(config, VARNAME(linkKappa), linkKappa, "", true);
     readConfig(config, VARNAME(linkGap), linkGap, "", true);
+    rigidCluster = false;
+    readConfig(config, VARNAME(rigidCluster), rigidCluster, "", true);
+    if (rigidCluster && shearRate != 0) {
+        spdlog::critical("rigidCluster does not support Lees-Edwards shearRate");
+        std::exit(1);
+    }
+
+    subcycleNumber = 1;
+    readConfig(config, VARNAME(subcycleNumber), subcycleNumber, "", true);
+    subcycleDiffusion = 0.1;
+    readConfig(config, VARNAME(subcycleDiffusion), subcycleDiffusion, "", true);
+    subcycleGroups.clear();
+    readConfig(config, VARNAME(subcycleGroups), subcycleGroups, "", true);
+    if (subcycleNumber < 1 || (subcycleNumber > 1 && rigidCluster)) {
+        spdlog::critical("subcycleNumber must be >= 1 and does not support rigidCluster");
+        std::exit(1);
+    }
 
     sylinderFixed = false;
     readConfig(config, VARNAME(sylinderFixed), sylinderFixed, "", true);
@@ -71,6 +129,19 @@ SylinderConfig::SylinderConfig(std::string filename) {
     sylinderColBuf = 0.3;
     readConfig(config, VARNAME(sylinderColBuf), sylinderColBuf, "", true);
 
+    conBilateralChoice = 1;
+    readConfig(config, VARNAME(conBilateralChoice), conBilateralChoice, "", true);
+    conChainPrecond = true;
+    readConfig(config, VARNAME(conChainPrecond), conChainPrecond, "", true);
+    conAMGPrecond = false;
+    readConfig(config, VARNAME(conAMGPrecond), conAMGPrecond, "", true);
+    conSchwarzCoarse = true;
+    readConfig(config, VARNAME(conSchwarzCoarse), conSchwarzCoarse, "", true);
+    conScreenMargin = -1;
+    readConfig(config, VARNAME(conScreenMargin), conScreenMargin, "", true);
+    conRecycleSize = 0;
+    readConfig(config, VARNAME(conRecycleSize), conRecycleSize, "", true);
+
     boundaryPtr.clear();
     if (config["boundaries"]) {
         YAML::Node boundaries = config["boundaries"];
@@ -86,6 +157,48 @@ SylinderConfig::SylinderConfig(std::string filename) {
             }
         }
     }
+    wallMobility = false;
+    readConfig(config, VARNAME(wallMobility), wallMobility, "", true);
+
+    pairPotentialPtr.clear();
+    if (config["pairPotentials"]) {
+        YAML::Node pairPotentials = config["pairPotentials"];
+        for (const auto &p : pairPotentials) {
+            std::string name = p["type"].as<std::string>();
+            spdlog::debug(name);
+            if (name == "wca") {
+                pairPotentialPtr.push_back(std::make_shared<PairWCA>(p));
+            } else if (name == "yukawa") {
+                pairPotentialPtr.push_back(std::make_shared<PairYukawa>(p));
+            } else if (name == "depletion") {
+                pairPotentialPtr.push_back(std::make_shared<PairDepletion>(p));
+            } else {
+                spdlog::critical("pair potential type {} not supported", name);
+                std::exit(1);
+            }
+        }
+    }
+    if (reproducible && !pairPotentialPtr.empty()) {
+        spdlog::critical("reproducible does not support pairPotentials, soft pair forces are summed in tree order");
+        std::exit(1);
+    }
+    if (reproducible) {
+        spdlog::warn("reproducible is for verification runs, its sums cost about 3x a plain sum");
+    }
+
+    contactCompliance = ContactCompliance();
+    if (config["contactCompliance"]) {
+        contactCompliance.initialize(config["contactCompliance"]);
+    }
+
+    linkerModel = LinkerModel();
+    if (config["linkerModels"]) {
+        linkerModel.initialize(config["linkerModels"]);
+        if (linkerModel.getNumModel() == 0) {
+            spdlog::critical("linkerModels must list at least one model");
+            std::exit(1);
+        }
+    }
 }
 
 void SylinderConfig::dump() const {
@@ -95,14 +208,28 @@ void SylinderConfig::dump() const {
         printf("Random number seed: %d\n", rngSeed);
         printf("Log Level: %d\n", logLevel);
         printf("Timer Level: %d\n", timerLevel);
+        printf("Log Async: %d\n", logAsync);
+        printf("Log Interval: %d\n", logInterval);
+        printf("Memory Report: %d, Soft Limit: %g MB\n", memReport, memSoftLimitMB);
+        printf("Trace Steps: %d from step %d\n", traceSteps, traceStart);
+        printf("Step Task Graph: %d\n", stepTaskGraph);
+        printf("Reproducible: %d\n", reproducible);
         printf("Simulation box Low: %g,%g,%g\n", simBoxLow[0], simBoxLow[1], simBoxLow[2]);
         printf("Simulation box High: %g,%g,%g\n", simBoxHigh[0], simBoxHigh[1], simBoxHigh[2]);
         printf("Periodicity: %d,%d,%d\n", simBoxPBC[0], simBoxPBC[1], simBoxPBC[2]);
+        printf("Lees-Edwards shear rate: %g\n", shearRate);
+        printf("Domain decomposition choice: %d\n", domainDecompChoice);
+        printf("Domain link refinement: %d\n", domainLinkRefine);
         printf("Initialization box Low: %g,%g,%g\n", initBoxLow[0], initBoxLow[1], initBoxLow[2]);
         printf("Initialization box High: %g,%g,%g\n", initBoxHigh[0], initBoxHigh[1], initBoxHigh[2]);
         printf("Initialization orientation: %g,%g,%g\n", initOrient[0], initOrient[1], initOrient[2]);
         printf("Initialization circular cross: %d\n", initCircularX);
         printf("Initialization pre-steps for collision-resolution: %d\n", initPreSteps);
+        printf("Initialization overlap-free insertion: %d\n", initOverlapFree);
+        if (initOverlapFree) {
+            printf("Initialization insertion trials: %d\n", initInsertTrial);
+            printf("Initialization relaxation iterations: %d\n", initRelaxIte);
+        }
         printf("Time step size: %g\n", dt);
         printf("Total Time: %g\n", timeTotal);
         printf("Snap Time: %g\n", timeSnap);
@@ -119,6 +246,14 @@ void SylinderConfig::dump() const {
         printf("kBT: %g\n", KBT);
         printf("Link Kappa: %g\n", linkKappa);
         printf("Link Gap: %g\n", linkGap);
+        printf("Rigid Cluster: %d\n", rigidCluster);
+        printf("Subcycle Number: %d\n", subcycleNumber);
+        if (subcycleNumber > 1) {
+            printf("Subcycle Diffusion: %g\n", subcycleDiffusion);
+            for (const int g : subcycleGroups) {
+                printf("Subcycle Group: %d\n", g);
+            }
+        }
         printf("Sylinder Number: %d\n", sylinderNumber);
         printf("Sylinder Length: %g\n", sylinderLength);
         printf("Sylinder Length Sigma: %g\n", sylinderLengthSigma);
@@ -131,11 +266,23 @@ void SylinderConfig::dump() const {
         printf("Residual Tolerance: %g\n", conResTol);
         printf("Max Iteration: %d\n", conMaxIte);
         printf("Solver Choice: %d\n", conSolverChoice);
+        printf("Bilateral Solver Choice: %d\n", conBilateralChoice);
+        printf("Bilateral Chain Preconditioner: %d\n", conChainPrecond);
+        printf("Bilateral AMG Preconditioner: %d\n", conAMGPrecond);
+        printf("Schwarz Coarse Correction: %d\n", conSchwarzCoarse);
+        printf("Screen Margin: %g\n", conScreenMargin);
+        printf("Bilateral Recycle Size: %d\n", conRecycleSize);
         printf("-------------------------------------------\n");
     }
     {
         for (const auto &b : boundaryPtr) {
             b->echo();
         }
+        printf("Wall Mobility Correction: %d\n", wallMobility);
+        for (const auto &p : pairPotentialPtr) {
+            p->echo();
+        }
+        contactCompliance.echo();
+        linkerModel.echo();
     }
 }
\ No newline at end of file
@@ -12,10 +12,14 @@
 #define SYLINDERCONFIG_HPP_
 
 #include "Boundary/Boundary.hpp"
+#include "Sylinder/ContactCompliance.hpp"
+#include "Sylinder/LinkerModel.hpp"
+#include "Sylinder/PairPotential.hpp"
 #include "Util/GeoCommon.h"
 
 #include <iostream>
 #include <memory>
+#include <vector>
 
 /**
  * @brief read configuration parameters from a yaml file
@@ -23,21 +27,35 @@
  */
 class SylinderConfig {
   public:
-    unsigned int rngSeed; ///< random number seed
-    int logLevel;         ///< follows SPDLOG level enum, see Util/Logger.hpp for details
-    int timerLevel = 0;   ///< how detailed the timer should be
+    unsigned int rngSeed;       ///< random number seed
+    int logLevel;               ///< follows SPDLOG level enum, see Util/Logger.hpp for details
+    int timerLevel = 0;         ///< how detailed the timer should be
+    bool logAsync = false;      ///< log through a background thread that never blocks the time step
+    int logInterval = 1;        ///< steps between timer summaries and reports of warnings from all ranks
+    bool memReport = false;     ///< log per-phase memory usage at every snapshot
+    double memSoftLimitMB = 0;  ///< warn if the memory of a rank exceeds this. 0 means no limit
+    int traceStart = 0;         ///< first step of timeline tracing
+    int traceSteps = 0;         ///< number of steps of timeline tracing. 0 means off
+    bool stepTaskGraph = false; ///< overlap independent phases of a timestep, see SylinderSystem::runStepTaskGraph()
+    bool reproducible = false;  ///< bitwise identical for any ranks and threads, slower, for verification runs only
 
     // domain setting
     double simBoxHigh[3];   ///< simulation box size
     double simBoxLow[3];    ///< simulation box size
     bool simBoxPBC[3];      ///< flag of true/false of periodic in that direction
+    double shearRate = 0;   ///< Lees-Edwards shear rate, flow along x and gradient along y. 0 for no shear
     bool monolayer = false; ///< flag for simulating monolayer on x-y plane
+    int domainDecompChoice = 0; ///< 0 for FDPS multisection, 1 for Zoltan RCB, 2 for Zoltan HSFC
+    bool domainLinkRefine = false; ///< refine the Zoltan partition with a link graph to cut fewer links
 
     double initBoxHigh[3];      ///< initialize sylinders within this box
     double initBoxLow[3];       ///< initialize sylinders within this box
     double initOrient[3];       ///< initial orientation for each sylinder. >1 <-1 means random
     bool initCircularX = false; ///< set the initial cross-section as a circle in the yz-plane
     int initPreSteps = 100;     ///< number of initial pre steps to resolve potential collisions
+    bool initOverlapFree = false; ///< generate initial sylinders on all ranks with overlap-aware insertion
+    int initInsertTrial = 20;     ///< max number of insertion trials per sylinder if initOverlapFree
+    int initRelaxIte = 100;       ///< max number of soft-repulsion sweeps if initOverlapFree
     double thermEquilTime = 0;  ///< Time to equilibrate system before running crosslinking steps
 
     // physical constant
@@ -46,6 +64,13 @@ class SylinderConfig {
     double linkKappa; ///< pN/um stiffness of sylinder links
     double linkGap;   ///< um length of gap between sylinder links
 
+    bool rigidCluster = false; ///< move sylinders connected by links as rigid clusters, links are not resolved
+
+    // multi-rate time stepping
+    int subcycleNumber = 1;          ///< substeps of the fast bin per step. 1 means off
+    double subcycleDiffusion = 0.1;  ///< fast if the rms Brownian displacement per step > this * radius
+    std::vector<int> subcycleGroups; ///< sylinders in these groups are always fast
+
     // sylinder settings
     bool sylinderFixed = false; ///< sylinders do not move
     int sylinderNumber;         ///< initial number of sylinders
@@ -66,9 +91,19 @@ class SylinderConfig {
     // constraint solver
     double conResTol;    ///< constraint solver residual
     int conMaxIte;       ///< constraint solver maximum iteration
-    int conSolverChoice; ///< choose a iterative solver. 0 for BBPGD, 1 for APGD, etc
+    int conSolverChoice; ///< choose a iterative solver. 0 for BBPGD, 1 for APGD, 2 for Schwarz
+    int conBilateralChoice = 1; ///< CG for bilateral constraints. 0 off, 1 bilateral-only steps, 2 also mixed steps
+    bool conChainPrecond = true; ///< block tridiagonal chain solver as the preconditioner of bilateral CG
+    bool conAMGPrecond = false; ///< smoothed aggregation AMG as the preconditioner of bilateral CG, needs MueLu
+    bool conSchwarzCoarse = true; ///< coarse correction of the step length of each rank in the Schwarz solver
+    double conScreenMargin = -1; ///< remove unilateral constraints with separation > margin without constraint force
+    int conRecycleSize = 0; ///< previous solutions projected for the initial guess of bilateral CG. 0 off
 
     std::vector<std::shared_ptr<Boundary>> boundaryPtr;
+    bool wallMobility = false; ///< correct the mobility of sylinders near boundaries, see WallMobility
+    std::vector<std::shared_ptr<PairPotential>> pairPotentialPtr; ///< soft pair potentials, summed
+    ContactCompliance contactCompliance; ///< stiffness and damping of sylinder contacts, rigid if empty
+    LinkerModel linkerModel;             ///< bilateral constraints of each link type
 
     SylinderConfig() = default;
     SylinderConfig(std::string filename);
@@ -11,9 +11,13 @@
 #ifndef SylinderNear_HPP_
 #define SylinderNear_HPP_
 
+#include "ContactCompliance.hpp"
+#include "PairPotential.hpp"
 #include "Sylinder.hpp"
 
+#include "Collision/ConvexShape.hpp"
 #include "Collision/DCPQuery.hpp"
+#include "Collision/GJK.hpp"
 #include "Constraint/ConstraintCollector.hpp"
 #include "FDPS/particle_simulator.hpp"
 #include "Util/EigenDef.hpp"
@@ -42,14 +46,20 @@ struct SylinderNearEP {
     int gid;                            ///< global unique id
     int globalIndex;                    ///< sequentially ordered unique index in sylinder map
     int rank;                           ///< mpi rank of owning rank
+    int clusterGid = GEO_INVALID_INDEX; ///< gid of the anchor of its rigid cluster
+    int group = -1;                     ///< group marker, for contact compliance
+    int shape = -1;                     ///< index of the convex collision shape, -1 for sylinder
+    bool isFrozen = false;              ///< immovable while the other bin is stepped
     double radius;                      ///< radius
     double length;                      ///< length
     double radiusCollision;             ///< collision radius
     double lengthCollision;             ///< collision length
     double colBuf = GEO_DEFAULT_COLBUF; ///< collision search buffer
+    double radiusSearch = 0;            ///< search buffer for soft pair potentials
 
-    double pos[3];       ///< position
-    double direction[3]; ///< direction (unit norm vector)
+    double pos[3];         ///< position
+    double direction[3];   ///< direction (unit norm vector)
+    double orientation[4]; ///< orientation quaternion, for convex shapes
 
     /**
      * @brief Get gid
@@ -75,7 +85,12 @@ struct SylinderNearEP {
         gid = fp.gid;
         globalIndex = fp.globalIndex;
         rank = fp.rank;
+        clusterGid = fp.clusterGid;
+        group = fp.group;
+        shape = fp.shape;
+        isFrozen = fp.isFrozen;
         colBuf = fp.colBuf;
+        radiusSearch = fp.radiusSearch;
 
         radius = fp.radius;
         length = fp.length;
@@ -83,6 +98,7 @@ struct SylinderNearEP {
         lengthCollision = fp.lengthCollision;
 
         std::copy(fp.pos, fp.pos + 3, pos);
+        std::copy(fp.orientation, fp.orientation + 4, orientation);
         Evec3 q = ECmapq(fp.orientation) * Evec3(0, 0, 1);
         direction[0] = q[0];
         direction[1] = q[1];
@@ -108,7 +124,7 @@ struct SylinderNearEP {
     PS::F64 getRSearch() const {
         // return std::max(length + 2 * radius, lengthCollision + 2 * lengthCollision) * (1 + colBuf);
         const double boundingSphereRad = .5* std::max(length + 2. * radius, lengthCollision + 2.*radiusCollision);
-        const double searchRadius = boundingSphereRad + colBuf;
+        const double searchRadius = boundingSphereRad + std::max(colBuf, radiusSearch);
         return searchRadius;
     }
 
@@ -156,14 +172,54 @@ class ForceNear {
 static_assert(std::is_trivially_copyable<ForceNear>::value, "");
 static_assert(std::is_default_constructible<ForceNear>::value, "");
 
+/**
+ * @brief collision body of a SylinderNearEP in the lab frame, for GJKQuery
+ *
+ * A sylinder is its center segment rounded by the collision radius, a sylinder treated as a sphere is its center
+ * rounded by the effective radius. A convex shape is rotated from its body frame by the orientation.
+ */
+struct SylinderNearBody {
+    const ConvexShape *shape = nullptr; ///< null for sylinder
+    Evec3 center;                       ///< position
+    Evec3 direction;                    ///< direction of sylinder
+    Equatn orientation;                 ///< orientation of shape
+    double halfLength = 0;              ///< half length of the segment of sylinder
+    double margin = 0;                  ///< rounding radius
+
+    Evec3 support(const Evec3 &d) const {
+        if (shape) {
+            return center + orientation * shape->support(orientation.conjugate() * d);
+        }
+        return center + (direction.dot(d) >= 0 ? halfLength : -halfLength) * direction;
+    }
+
+    double getMargin() const { return margin; }
+};
+
 /**
  * @brief callable object to collect collision blocks and compute near force
  *
+ * Collision constraints are collected once per pair, by the sylinder with the smaller gid.
+ * Soft pair forces are evaluated for every target-source pair in the same walk and written to ForceNear,
+ * so each sylinder gets the force from all of its neighbors without a reverse communication.
+ * With Lees-Edwards boundaries, sylinders outside [shearBoxLow,shearBoxHigh) in y are sliding images.
+ * Images are only sources. The velocity of an image differs from its sylinder by the shear velocity jump,
+ * which is added to delta0 of its constraints as the separation change over one step.
+ * Sylinders in the same rigid cluster do not collide with each other.
+ * Contacts are rigid unless contact compliance is set for the pair of groups.
+ * Pairs with a convex shape (SylinderNearEP::shape >= 0) are resolved by GJK/EPA.
  */
 class CalcSylinderNearForce {
 
   public:
-    std::shared_ptr<ConstraintBlockPool> conPoolPtr; ///< shared object for collecting collision constraints
+    std::shared_ptr<ConstraintBlockPool> conPoolPtr;    ///< shared object for collecting collision constraints
+    std::vector<std::shared_ptr<PairPotential>> pairPot; ///< soft pair potentials, none if empty
+    double shearBoxLow = 0;  ///< Lees-Edwards box low bound in y
+    double shearBoxHigh = 0; ///< Lees-Edwards box high bound in y
+    double shearStepDx = 0;  ///< x displacement of the image box at +y in one step. 0 for no Lees-Edwards images
+    ContactCompliance contact; ///< stiffness, damping, and friction of contacts, rigid if empty
+    double dt = 0;             ///< timestep, for contact damping
+    std::shared_ptr<const std::vector<ConvexShape>> shapeTablePtr; ///< convex shapes indexed by SylinderNearEP::shape
 
     /**
      * @brief Construct a new CalcSylinderNearForce object
@@ -198,41 +254,70 @@ class CalcSylinderNearForce {
                     const PS::S32 Njp, ForceNear *const forceNear) {
         const int myThreadId = omp_get_thread_num();
         auto &conQue = (*conPoolPtr)[myThreadId];
+        const bool soft = !pairPot.empty();
 
         for (PS::S32 i = 0; i < Nip; ++i) {
             auto &syI = ep_i[i];
             auto &forceI = forceNear[i];
             forceI.clear();
+            if (getImageShift(syI) != 0)
+                continue;
 
             if (isSphere(syI)) { // sphereI collisions
                 for (int j = 0; j < Njp; j++) {
                     auto &syJ = ep_j[j];
-                    if (syI.gid >= syJ.gid)
+                    if (soft && syI.gid != syJ.gid)
+                        pairForce(syI, syJ, forceI);
+                    if (syI.gid >= syJ.gid || sameCluster(syI, syJ) || (syI.isFrozen && syJ.isFrozen))
                         continue;
                     ConstraintBlock conBlock;
                     bool collision = false;
-                    if (isSphere(syJ)) {
+                    if (isShape(syI) || isShape(syJ)) {
+                        collision = cv_cv(syI, syJ, forceI, conBlock);
+                    } else if (isSphere(syJ)) {
                         collision = sp_sp(syI, syJ, forceI, conBlock);
                     } else {
                         collision = sp_sy(syI, syJ, forceI, conBlock);
                     }
-                    if (collision)
+                    if (collision) {
+                        if (!contact.empty()) {
+                            contact.apply(syI.group, syJ.group, dt, conBlock.delta0, conBlock.kappa);
+                            conBlock.friction = contact.getFriction(syI.group, syJ.group);
+                        }
+                        addImageVelocity(syJ, conBlock);
                         conQue.push_back(conBlock);
+                        if (conBlock.friction > 0) {
+                            pushTangent(syI, syJ, conBlock, conQue);
+                        }
+                    }
                 }
             } else { // sylinderI collisions
                 for (int j = 0; j < Njp; j++) {
                     auto &syJ = ep_j[j];
-                    if (syI.gid >= syJ.gid)
+                    if (soft && syI.gid != syJ.gid)
+                        pairForce(syI, syJ, forceI);
+                    if (syI.gid >= syJ.gid || sameCluster(syI, syJ) || (syI.isFrozen && syJ.isFrozen))
                         continue;
                     ConstraintBlock conBlock;
                     bool collision = false;
-                    if (isSphere(syJ)) {
+                    if (isShape(syI) || isShape(syJ)) {
+                        collision = cv_cv(syI, syJ, forceI, conBlock);
+                    } else if (isSphere(syJ)) {
                         collision = sp_sy(syJ, syI, forceI, conBlock, true);
                     } else {
                         collision = sy_sy(syI, syJ, forceI, conBlock);
                     }
-                    if (collision)
+                    if (collision) {
+                        if (!contact.empty()) {
+                            contact.apply(syI.group, syJ.group, dt, conBlock.delta0, conBlock.kappa);
+                            conBlock.friction = contact.getFriction(syI.group, syJ.group);
+                        }
+                        addImageVelocity(syJ, conBlock);
                         conQue.push_back(conBlock);
+                        if (conBlock.friction > 0) {
+                            pushTangent(syI, syJ, conBlock, conQue);
+                        }
+                    }
                 }
             }
         }
@@ -240,6 +325,195 @@ class CalcSylinderNearForce {
 
     bool isSphere(const SylinderNearEP &sy) const { return sy.lengthCollision < 2 * sy.radiusCollision; }
 
+    // the shape index is checked by SylinderSystem::checkShape() when sylinders are read or created
+    bool isShape(const SylinderNearEP &sy) const { return sy.shape >= 0; }
+
+    /**
+     * @brief the collision body of sy for GJKQuery
+     *
+     * @param sy
+     * @return SylinderNearBody
+     */
+    SylinderNearBody getBody(const SylinderNearEP &sy) const {
+        SylinderNearBody body;
+        body.center = ECmap3(sy.pos);
+        body.direction = ECmap3(sy.direction);
+        if (isShape(sy)) {
+            body.shape = &(*shapeTablePtr)[sy.shape];
+            body.orientation = ECmapq(sy.orientation);
+            body.margin = body.shape->margin;
+        } else if (isSphere(sy)) {
+            body.margin = sy.lengthCollision * 0.5 + sy.radiusCollision;
+        } else {
+            body.halfLength = sy.lengthCollision * 0.5;
+            body.margin = sy.radiusCollision;
+        }
+        return body;
+    }
+
+    /**
+     * @brief if I and J belong to the same rigid cluster, which does not need collision constraints
+     *
+     * @param syI
+     * @param syJ
+     * @return true
+     * @return false
+     */
+    bool sameCluster(const SylinderNearEP &syI, const SylinderNearEP &syJ) const {
+        return syI.clusterGid != GEO_INVALID_INDEX && syI.clusterGid == syJ.clusterGid;
+    }
+
+    /**
+     * @brief number of boxes a Lees-Edwards image is shifted in y
+     *
+     * @param sy
+     * @return int 0 for sylinders in the box, +1 for images above the box, -1 for images below the box
+     */
+    int getImageShift(const SylinderNearEP &sy) const {
+        if (shearStepDx == 0)
+            return 0;
+        return (sy.pos[1] >= shearBoxHigh) - (sy.pos[1] < shearBoxLow);
+    }
+
+    /**
+     * @brief add the separation change due to the velocity jump of a Lees-Edwards image J over one step
+     *
+     * The solver uses the velocity of sylinder J, not the velocity of its image
+     * @param syJ
+     * @param conBlock I is never an image
+     */
+    void addImageVelocity(const SylinderNearEP &syJ, ConstraintBlock &conBlock) const {
+        conBlock.delta0 += getImageShift(syJ) * shearStepDx * conBlock.normJ[0];
+    }
+
+    /**
+     * @brief push the two tangential blocks of a frictional contact, right after its normal block
+     *
+     * The tangential blocks act at the same points as the normal block, with normI along the tangents.
+     * Their gammas are the friction force components, bounded by the Coulomb cone in the constraint solver.
+     * @param syI
+     * @param syJ
+     * @param conBlock the normal block, I is syI
+     * @param conQue
+     */
+    void pushTangent(const SylinderNearEP &syI, const SylinderNearEP &syJ, const ConstraintBlock &conBlock,
+                     ConstraintBlockQue &conQue) const {
+        Evec3 tangent[2];
+        getTangent(ECmap3(conBlock.normI), tangent[0], tangent[1]);
+
+        Evec3 dirI, dirJ;
+        double hI, hJ, rI, rJ;
+        getStressBody(syI, dirI, hI, rI);
+        getStressBody(syJ, dirJ, hJ, rJ);
+
+        for (int t = 0; t < 2; t++) {
+            ConstraintBlock tanBlock = conBlock;
+            tanBlock.delta0 = 0;
+            tanBlock.gamma = 0;
+            tanBlock.kappa = 0;
+            tanBlock.friction = 0;
+            tanBlock.tangent = true;
+            for (int k = 0; k < 3; k++) {
+                tanBlock.normI[k] = tangent[t][k];
+                tanBlock.normJ[k] = -tangent[t][k];
+            }
+            Emat3 stressIJ;
+            collideStress(dirI, dirJ, ECmap3(syI.pos), ECmap3(syJ.pos), hI, hJ, rI, rJ, 1.0, ECmap3(conBlock.labI),
+                          ECmap3(conBlock.labJ), tangent[t], stressIJ);
+            tanBlock.setStress(stressIJ);
+            addImageVelocity(syJ, tanBlock);
+            conQue.push_back(tanBlock);
+        }
+    }
+
+    /**
+     * @brief the geometry of sy used by collideStress()
+     *
+     * sphere degenerates to length = 0, as in sp_sp, sp_sy, and cv_cv
+     * @param sy
+     * @param dir [out] direction
+     * @param h [out] length
+     * @param r [out] radius
+     */
+    void getStressBody(const SylinderNearEP &sy, Evec3 &dir, double &h, double &r) const {
+        if (isSphere(sy)) {
+            dir = Evec3(0, 0, 1);
+            h = 0;
+            r = sy.lengthCollision * 0.5 + sy.radiusCollision;
+        } else {
+            dir = ECmap3(sy.direction);
+            h = sy.lengthCollision;
+            r = sy.radiusCollision;
+        }
+    }
+
+    /**
+     * @brief orthonormal tangents of a unit normal, t2 = norm x t1
+     *
+     * t1 is orthogonal to the axis least aligned with norm, so the basis is a deterministic function of norm
+     * @param norm
+     * @param t1 [out]
+     * @param t2 [out]
+     */
+    static void getTangent(const Evec3 &norm, Evec3 &t1, Evec3 &t2) {
+        int axis = 0;
+        for (int k = 1; k < 3; k++) {
+            if (fabs(norm[k]) < fabs(norm[axis])) {
+                axis = k;
+            }
+        }
+        t1 = norm.cross(Evec3::Unit(axis)).normalized();
+        t2 = norm.cross(t1);
+    }
+
+    /**
+     * @brief add the force and torque on I due to J from all soft pair potentials
+     *
+     * The geometry uses radius and length, not the collision radius and length.
+     * @param syI
+     * @param syJ
+     * @param forceI
+     */
+    void pairForce(const SylinderNearEP &syI, const SylinderNearEP &syJ, ForceNear &forceI) const {
+        DCPQuery<3, double, Evec3> DistSegSeg3;
+
+        const Evec3 centerI = ECmap3(syI.pos);
+        const Evec3 directionI = ECmap3(syI.direction);
+        const Evec3 Pm = centerI - directionI * (0.5 * syI.length);
+        const Evec3 Pp = centerI + directionI * (0.5 * syI.length);
+
+        const Evec3 centerJ = ECmap3(syJ.pos);
+        const Evec3 directionJ = ECmap3(syJ.direction);
+        const Evec3 Qm = centerJ - directionJ * (0.5 * syJ.length);
+        const Evec3 Qp = centerJ + directionJ * (0.5 * syJ.length);
+
+        Evec3 Ploc = Evec3::Zero();
+        Evec3 Qloc = Evec3::Zero();
+        double s, t = 0;
+        const double distMin = DistSegSeg3(Pm, Pp, Qm, Qp, Ploc, Qloc, s, t);
+        if (distMin < std::numeric_limits<double>::epsilon()) {
+            return; // direction undefined, overlap is resolved by constraints
+        }
+        const double sep = distMin - (syI.radius + syJ.radius);
+
+        double f = 0;
+        for (const auto &pot : pairPot) {
+            if (sep < pot->getCutoff(syI.radius, syJ.radius)) {
+                f += pot->getForce(sep, syI.radius, syJ.radius);
+            }
+        }
+        if (f == 0) {
+            return;
+        }
+
+        const Evec3 F = (Ploc - Qloc) * (f / distMin); // along normI, positive for repulsion
+        const Evec3 T = (Ploc - centerI).cross(F);
+        for (int k = 0; k < 3; k++) {
+            forceI.forceNear[k] += F[k];
+            forceI.torqueNear[k] += T[k];
+        }
+    }
+
     /**
      * @brief
      *
@@ -273,7 +547,7 @@ class CalcSylinderNearForce {
             collision = true;
             const double delta0 = sep;
             const double gamma = sep < 0 ? -sep : 0;
-            const Evec3 normI = (Ploc - Qloc).normalized();
+            const Evec3 normI = getContactNorm(Ploc, Qloc, centerI, centerJ);
             const Evec3 normJ = -normI;
             const Evec3 posI = Ploc - centerI;
             const Evec3 posJ = Qloc - centerJ;
@@ -331,7 +605,7 @@ class CalcSylinderNearForce {
             collision = true;
             const double delta0 = sep;
             const double gamma = sep < 0 ? -sep : 0;
-            const Evec3 normI = (Ploc - Qloc).normalized();
+            const Evec3 normI = getContactNorm(Ploc, Qloc, centerI, centerJ);
             const Evec3 normJ = -normI;
             const Evec3 posI = Ploc - centerI;
             const Evec3 posJ = Qloc - centerJ;
@@ -393,7 +667,7 @@ class CalcSylinderNearForce {
             collision = true;
             const double delta0 = sep;
             const double gamma = sep < 0 ? -sep : 0;
-            const Evec3 normI = (Ploc - Qloc).normalized();
+            const Evec3 normI = getContactNorm(Ploc, Qloc, centerI, centerJ);
             const Evec3 normJ = -normI;
             const Evec3 posI = Ploc - centerI;
             const Evec3 posJ = Qloc - centerJ;
@@ -413,6 +687,84 @@ class CalcSylinderNearForce {
         return collision;
     }
 
+    /**
+     * @brief collision of two general convex bodies, at least one is a convex shape
+     *
+     * Ploc and Qloc are the witness points on the surfaces.
+     * The stress uses the collision sylinder of a shape, i.e., its bounding spherocylinder.
+     * @param syI
+     * @param syJ
+     * @param forceI
+     * @param conBlock
+     * @return true
+     * @return false
+     */
+    bool cv_cv(const SylinderNearEP &syI, const SylinderNearEP &syJ, ForceNear &forceI,
+               ConstraintBlock &conBlock) const {
+        const SylinderNearBody bodyI = getBody(syI);
+        const SylinderNearBody bodyJ = getBody(syJ);
+        const Evec3 &centerI = bodyI.center;
+        const Evec3 &centerJ = bodyJ.center;
+
+        const double buffer = std::max(syI.colBuf, syJ.colBuf);
+        ResultGJK result;
+        if (!GJKQuery::query(bodyI, bodyJ, centerI - centerJ, buffer, result) || !(result.distance < buffer)) {
+            return false;
+        }
+
+        const double sep = result.distance; // goal of constraint is sep >=0
+        const double delta0 = sep;
+        const double gamma = sep < 0 ? -sep : 0;
+        const Evec3 &Ploc = result.pointA;
+        const Evec3 &Qloc = result.pointB;
+        const Evec3 &normI = result.normal;
+        const Evec3 normJ = -normI;
+        const Evec3 posI = Ploc - centerI;
+        const Evec3 posJ = Qloc - centerJ;
+        conBlock = ConstraintBlock(delta0, gamma,              // current separation, initial guess of gamma
+                                   syI.gid, syJ.gid,           //
+                                   syI.globalIndex,            //
+                                   syJ.globalIndex,            //
+                                   normI.data(), normJ.data(), // direction of collision force
+                                   posI.data(), posJ.data(),   // location of collision relative to particle center
+                                   Ploc.data(), Qloc.data(),   // location of collision in lab frame
+                                   false, false, 0.0, 0.0);
+        // sphere degenerates to length = 0, as in sp_sp and sp_sy
+        const bool sphereI = isSphere(syI), sphereJ = isSphere(syJ);
+        Emat3 stressIJ;
+        collideStress(sphereI ? Evec3(0, 0, 1) : bodyI.direction, sphereJ ? Evec3(0, 0, 1) : bodyJ.direction, centerI,
+                      centerJ, sphereI ? 0 : syI.lengthCollision, sphereJ ? 0 : syJ.lengthCollision,
+                      sphereI ? syI.lengthCollision * 0.5 + syI.radiusCollision : syI.radiusCollision,
+                      sphereJ ? syJ.lengthCollision * 0.5 + syJ.radiusCollision : syJ.radiusCollision, 1.0, Ploc, Qloc,
+                      normI, stressIJ);
+        conBlock.setStress(stressIJ);
+        return true;
+    }
+
+    /**
+     * @brief unit normal on I of a contact from Qloc to Ploc
+     *
+     * Compliant contacts may overlap deep enough that the two center segments touch or cross.
+     * Then Ploc = Qloc and the normal falls back to the direction between the centers.
+     * @param Ploc location of the contact on I
+     * @param Qloc location of the contact on J
+     * @param centerI
+     * @param centerJ
+     * @return Evec3
+     */
+    static Evec3 getContactNorm(const Evec3 &Ploc, const Evec3 &Qloc, const Evec3 &centerI, const Evec3 &centerJ) {
+        const double eps = std::numeric_limits<double>::epsilon();
+        const Evec3 rQP = Ploc - Qloc;
+        if (rQP.norm() > eps * (1 + Ploc.norm())) {
+            return rQP.normalized();
+        }
+        const Evec3 rJI = centerI - centerJ;
+        if (rJI.norm() > eps * (1 + centerI.norm())) {
+            return rJI.normalized();
+        }
+        return Evec3(0, 0, 1);
+    }
+
     /**
      * @brief compute collision stress for a pair of sylinders
      *
@@ -434,6 +786,21 @@ class CalcSylinderNearForce {
                               double hI, double hJ, const double rI, const double rJ, //
                               const double rho,                                       //
                               const Evec3 &Ploc, const Evec3 &Qloc, Emat3 &StressIJ) {
+        collideStress(dirI, dirJ, centerI, centerJ, hI, hJ, rI, rJ, rho, Ploc, Qloc,
+                      getContactNorm(Ploc, Qloc, centerI, centerJ), StressIJ);
+    }
+
+    /**
+     * @brief compute collision stress for a pair of sylinders with a given contact normal
+     *
+     * Ploc and Qloc of penetrating convex shapes do not give the normal
+     * @param normI unit normal on I
+     */
+    static void collideStress(const Evec3 &dirI, const Evec3 &dirJ,                   //
+                              const Evec3 &centerI, const Evec3 &centerJ,             //
+                              double hI, double hJ, const double rI, const double rJ, //
+                              const double rho,                                       //
+                              const Evec3 &Ploc, const Evec3 &Qloc, const Evec3 &normI, Emat3 &StressIJ) {
         Emat3 NI, GAMMAI, NJ, GAMMAJ, InvGAMMAI, InvGAMMAJ;
         InitializeSyN(NI, rI, hI, rho);
         InitializeSyGA(GAMMAI, rI, hI, rho);
@@ -453,7 +820,7 @@ class CalcSylinderNearForce {
         InvGAMMAI = aI * Emat3::Identity() + (bI - aI) * (dirI * dirI.transpose());
         InvGAMMAJ = aJ * Emat3::Identity() + (bJ - aJ) * (dirJ * dirJ.transpose());
 
-        Evec3 F1 = (Qloc - Ploc).normalized();
+        Evec3 F1 = -normI;
         Emat3 rIf = (centerI) * (-F1.transpose()); // Newton's law
         Emat3 rJf = (centerJ) * (F1.transpose());
         Evec3 xICf = (Ploc - centerI).cross(-F1); // Newton's law
@@ -88,8 +88,9 @@ void testFixedPair() {
     }
     ForceNear fnear;
     calc(sylinderP.data(), 1, sylinderQ.data(), 1, &fnear);
-    printf("%zu collisions recorded\n", calc.conPoolPtr->front().size());
-    auto stress = calc.conPoolPtr->front().front().stress;
+    printf("%d collisions recorded\n", calc.conPoolPtr->front().size());
+    auto block = calc.conPoolPtr->front().front();
+    auto stress = block.stress;
     printf("stress:\n");
     printMat3(stress);
     bool pass = true;
@@ -158,9 +159,9 @@ void testParallel() {
     }
     ForceNear fnear;
     calc(sylinderP.data(), 1, sylinderQ.data(), 1, &fnear);
-    printf("%zu collisions recorded\n", calc.conPoolPtr->front().size());
-    auto stress = calc.conPoolPtr->front().front().stress;
+    printf("%d collisions recorded\n", calc.conPoolPtr->front().size());
     auto block = calc.conPoolPtr->front().front();
+    auto stress = block.stress;
     printf("stress:\n");
     printMat3(stress);
     printf("posI:\n");
@@ -217,9 +218,9 @@ void testSphere() {
     }
     ForceNear fnear;
     calc(sylinderP.data(), 1, sylinderQ.data(), 1, &fnear);
-    printf("%zu collisions recorded\n", calc.conPoolPtr->front().size());
-    auto stress = calc.conPoolPtr->front().front().stress;
+    printf("%d collisions recorded\n", calc.conPoolPtr->front().size());
     auto block = calc.conPoolPtr->front().front();
+    auto stress = block.stress;
     printf("stress:\n");
     printMat3(stress);
     printf("posI:\n");
@@ -291,9 +292,9 @@ void testSylinderSphere() {
     }
     ForceNear fnear;
     calc(sylinderP.data(), 1, sylinderQ.data(), 1, &fnear);
-    printf("%zu collisions recorded\n", calc.conPoolPtr->front().size());
-    auto stress = calc.conPoolPtr->front().front().stress;
+    printf("%d collisions recorded\n", calc.conPoolPtr->front().size());
     auto block = calc.conPoolPtr->front().front();
+    auto stress = block.stress;
     printf("stress:\n");
     printMat3(stress);
     printf("posI:\n");
@@ -302,6 +303,222 @@ void testSylinderSphere() {
     printVec3(block.posJ);
 }
 
+void testPairPotential() {
+    omp_set_num_threads(1);
+    CalcSylinderNearForce calc;
+    calc.conPoolPtr = std::make_shared<ConstraintBlockPool>();
+    calc.conPoolPtr->resize(1);
+    const double strength = 2.0, lambda = 0.1;
+    calc.pairPot.push_back(std::make_shared<PairYukawa>(strength, lambda, 5 * lambda));
+
+    // two parallel sylinders along x, separated along y, not in contact
+    std::vector<SylinderNearEP> sylinders(2);
+    for (int i = 0; i < 2; i++) {
+        auto &sy = sylinders[i];
+        sy.gid = i;
+        sy.globalIndex = i;
+        sy.rank = 0;
+        sy.radius = sy.radiusCollision = 0.5;
+        sy.length = sy.lengthCollision = 2.0;
+        sy.colBuf = 0.0;
+        sy.pos[0] = 0.3 * i; // shifted along the axis, produces no torque along z
+        sy.pos[1] = 1.2 * i;
+        sy.pos[2] = 0;
+        sy.direction[0] = 1;
+        sy.direction[1] = 0;
+        sy.direction[2] = 0;
+    }
+
+    ForceNear fnear[2];
+    calc(sylinders.data(), 1, sylinders.data(), 2, &fnear[0]);
+    calc(sylinders.data() + 1, 1, sylinders.data(), 2, &fnear[1]);
+
+    const double sep = 1.2 - 1.0;
+    const double fExpect = strength / lambda * exp(-sep / lambda);
+    printf("pair force on I: ");
+    printVec3(fnear[0].forceNear);
+    printf("pair force on J: ");
+    printVec3(fnear[1].forceNear);
+    bool pass = true;
+    pass = pass && calc.conPoolPtr->front().size() == 0; // sep > colBuf, no constraint
+    pass = pass && fabs(fnear[0].forceNear[1] + fExpect) < 1e-10 * fExpect; // repulsion along -y on I
+    for (int k = 0; k < 3; k++) {
+        pass = pass && fabs(fnear[0].forceNear[k] + fnear[1].forceNear[k]) < 1e-10 * fExpect;
+    }
+    if (!pass) {
+        printf("Error: pair potential force\n");
+        std::exit(1);
+    }
+}
+
+void testContactCompliance() {
+    omp_set_num_threads(1);
+    CalcSylinderNearForce calc;
+    calc.conPoolPtr = std::make_shared<ConstraintBlockPool>();
+    calc.conPoolPtr->resize(1);
+    calc.contact.initialize(YAML::Load("[{kappa: 100}, {groupI: 1, groupJ: 0, kappa: 500, damping: 2}]"));
+    calc.dt = 0.01;
+
+    // two crossing sylinders, the center segments intersect at the origin
+    std::vector<SylinderNearEP> sylinders(2);
+    for (int i = 0; i < 2; i++) {
+        auto &sy = sylinders[i];
+        sy.gid = i;
+        sy.globalIndex = i;
+        sy.rank = 0;
+        sy.group = i;
+        sy.radius = sy.radiusCollision = 0.5;
+        sy.length = sy.lengthCollision = 2.0;
+        sy.colBuf = 0.0;
+        sy.pos[0] = 0;
+        sy.pos[1] = 0;
+        sy.pos[2] = 0;
+        sy.direction[0] = i == 0 ? 1 : 0;
+        sy.direction[1] = i == 0 ? 0 : 1;
+        sy.direction[2] = 0;
+    }
+
+    ForceNear fnear[2];
+    calc(sylinders.data(), 1, sylinders.data(), 2, &fnear[0]);
+    const auto &que = calc.conPoolPtr->front();
+    bool pass = que.size() == 1;
+    if (pass) {
+        const auto block = que.front();
+        const double kappaEff = 500 + 2 / calc.dt;
+        const double delta0 = -1.0 + 2 / calc.dt * 1.0 / kappaEff; // sep = -1, shifted by damping
+        printf("kappa %g, delta0 %g, normI %g %g %g\n", block.kappa, block.delta0, block.normI[0], block.normI[1],
+               block.normI[2]);
+        pass = pass && fabs(block.kappa - kappaEff) < 1e-12 * kappaEff;
+        pass = pass && fabs(block.delta0 - delta0) < 1e-12;
+        pass = pass && fabs(Evec3(block.normI[0], block.normI[1], block.normI[2]).norm() - 1) < 1e-12;
+        for (int k = 0; k < 9; k++) {
+            pass = pass && std::isfinite(block.stress[k]);
+        }
+    }
+    // groups without a specific entry use the wildcard entry
+    double delta0 = -0.5, kappa = 0;
+    calc.contact.apply(2, 3, calc.dt, delta0, kappa);
+    pass = pass && kappa == 100 && delta0 == -0.5;
+    if (!pass) {
+        printf("Error: contact compliance\n");
+        std::exit(1);
+    }
+}
+
+void testFriction() {
+    omp_set_num_threads(1);
+    CalcSylinderNearForce calc;
+    calc.conPoolPtr = std::make_shared<ConstraintBlockPool>();
+    calc.conPoolPtr->resize(1);
+    calc.contact.initialize(YAML::Load("[{friction: 0.5}]"));
+    calc.dt = 0.01;
+
+    // two crossing sylinders overlapping by 0.2
+    std::vector<SylinderNearEP> sylinders(2);
+    for (int i = 0; i < 2; i++) {
+        auto &sy = sylinders[i];
+        sy.gid = i;
+        sy.globalIndex = i;
+        sy.rank = 0;
+        sy.radius = sy.radiusCollision = 0.5;
+        sy.length = sy.lengthCollision = 2.0;
+        sy.colBuf = 0.0;
+        sy.pos[0] = 0;
+        sy.pos[1] = 0;
+        sy.pos[2] = 0.8 * i;
+        sy.direction[0] = i == 0 ? 1 : 0;
+        sy.direction[1] = i == 0 ? 0 : 1;
+        sy.direction[2] = 0;
+    }
+
+    ForceNear fnear[2];
+    calc(sylinders.data(), 1, sylinders.data(), 2, &fnear[0]);
+    const auto &que = calc.conPoolPtr->front();
+    bool pass = que.size() == 3;
+    if (pass) {
+        const auto block = que[0];
+        const Evec3 norm = ECmap3(block.normI);
+        pass = pass && block.friction == 0.5 && !block.tangent && block.kappa == 0;
+        pass = pass && fabs(block.delta0 + 0.2) < 1e-12;
+        for (int t = 1; t < 3; t++) {
+            const auto tanBlock = que[t];
+            const Evec3 tangent = ECmap3(tanBlock.normI);
+            pass = pass && tanBlock.tangent && tanBlock.friction == 0 && tanBlock.delta0 == 0;
+            pass = pass && fabs(tangent.norm() - 1) < 1e-12 && fabs(tangent.dot(norm)) < 1e-12;
+            // the stress of a unit force along the tangent, with the same geometry as the normal block
+            Emat3 stressIJ;
+            CalcSylinderNearForce::collideStress(ECmap3(sylinders[0].direction), ECmap3(sylinders[1].direction),
+                                                 ECmap3(sylinders[0].pos), ECmap3(sylinders[1].pos), 2.0, 2.0, 0.5,
+                                                 0.5, 1.0, ECmap3(block.labI), ECmap3(block.labJ), tangent, stressIJ);
+            Emat3 stressBlock;
+            tanBlock.getStress(stressBlock);
+            pass = pass && (stressBlock - stressIJ).norm() < 1e-12 * (1 + stressIJ.norm());
+        }
+        pass = pass && fabs(ECmap3(que[1].normI).dot(ECmap3(que[2].normI))) < 1e-12;
+    }
+    if (!pass) {
+        printf("Error: friction\n");
+        std::exit(1);
+    }
+}
+
+void testConvexShape() {
+    omp_set_num_threads(1);
+    CalcSylinderNearForce calc;
+    calc.conPoolPtr = std::make_shared<ConstraintBlockPool>();
+    calc.conPoolPtr->resize(1);
+    auto shapeTablePtr = std::make_shared<std::vector<ConvexShape>>(1);
+    auto &ball = shapeTablePtr->front();
+    ball.type = ConvexShape::Type::Ellipsoid;
+    ball.param[0] = ball.param[1] = ball.param[2] = 0.5;
+    calc.shapeTablePtr = shapeTablePtr;
+
+    // a ball shape at the origin and a sylinder along x, overlapping by 0.1
+    std::vector<SylinderNearEP> sylinders(2);
+    for (int i = 0; i < 2; i++) {
+        auto &sy = sylinders[i];
+        sy.gid = i;
+        sy.globalIndex = i;
+        sy.rank = 0;
+        sy.radius = sy.radiusCollision = 0.5;
+        sy.length = sy.lengthCollision = i == 0 ? 0 : 2.0;
+        sy.colBuf = 0.0;
+        sy.pos[0] = 0.3 * i;
+        sy.pos[1] = 0.9 * i;
+        sy.pos[2] = 0;
+        sy.direction[0] = 1;
+        sy.direction[1] = 0;
+        sy.direction[2] = 0;
+        Emapq(sy.orientation) = Equatn::FromTwoVectors(Evec3(0, 0, 1), Evec3(1, 0, 0));
+    }
+
+    // the same pair resolved by sp_sy and by GJK
+    ForceNear fnear;
+    calc(sylinders.data(), 1, sylinders.data(), 2, &fnear);
+    sylinders[0].shape = 0;
+    calc(sylinders.data(), 1, sylinders.data(), 2, &fnear);
+    const auto &que = calc.conPoolPtr->front();
+    bool pass = que.size() == 2;
+    if (pass) {
+        const auto &blockSy = que[0];
+        const auto &blockCv = que[1];
+        printf("delta0 %g %g, normI %g %g %g\n", blockSy.delta0, blockCv.delta0, blockCv.normI[0], blockCv.normI[1],
+               blockCv.normI[2]);
+        pass = pass && fabs(blockCv.delta0 + 0.1) < 1e-10 && fabs(blockSy.delta0 - blockCv.delta0) < 1e-10;
+        for (int k = 0; k < 3; k++) {
+            pass = pass && fabs(blockSy.normI[k] - blockCv.normI[k]) < 1e-10;
+        }
+        // witness points converge slower than the distance
+        for (int k = 0; k < 9; k++) {
+            pass = pass && fabs(blockSy.stress[k] - blockCv.stress[k]) < 1e-6;
+        }
+    }
+    if (!pass) {
+        printf("Error: convex shape\n");
+        std::exit(1);
+    }
+}
+
 int main() {
     printf("--------------------testing epsilon tensor\n");
     testEpsilon();
@@ -313,5 +530,13 @@ int main() {
     testSphere();
     printf("---------------------------------------------\ntesting sylinder-sphere \n");
     testSylinderSphere();
+    printf("---------------------------------------------\ntesting soft pair potential \n");
+    testPairPotential();
+    printf("---------------------------------------------\ntesting contact compliance \n");
+    testContactCompliance();
+    printf("---------------------------------------------\ntesting friction \n");
+    testFriction();
+    printf("---------------------------------------------\ntesting convex shape \n");
+    testConvexShape();
     return 0;
 }
\ No newline at end of file
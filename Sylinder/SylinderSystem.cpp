@@ -1,16 +1,25 @@
 #include "SylinderSystem.hpp"
 
+#include "Boundary/WallMobility.hpp"
+#include "Collision/DCPQuery.hpp"
 #include "MPI/CommMPI.hpp"
+#include "Util/CounterRng.hpp"
 #include "Util/EquatnHelper.hpp"
 #include "Util/GeoUtil.hpp"
 #include "Util/IOHelper.hpp"
 #include "Util/Logger.hpp"
+#include "Util/Trace.hpp"
 
+#include <algorithm>
+#include <array>
 #include <cmath>
 #include <cstdio>
 #include <fstream>
+#include <limits>
+#include <map>
 #include <memory>
 #include <random>
+#include <sstream>
 #include <vector>
 
 #include <vtkCellData.h>
@@ -21,6 +30,8 @@
 #include <vtkXMLPPolyDataReader.h>
 #include <vtkXMLPolyDataReader.h>
 
+#include <Teuchos_DefaultSerialComm.hpp>
+
 #include <mpi.h>
 #include <omp.h>
 
@@ -34,6 +45,7 @@ SylinderSystem::SylinderSystem(const SylinderConfig &runConfig_, const std::stri
 
 void SylinderSystem::initialize(const SylinderConfig &runConfig_, const std::string &posFile, int argc, char **argv) {
     runConfig = runConfig_;
+    stepDt = runConfig.dt;
     stepCount = 0;
     snapID = 0; // the first snapshot starts from 0 in writeResult
 
@@ -45,7 +57,7 @@ void SylinderSystem::initialize(const SylinderConfig &runConfig_, const std::str
     MPI_Initialized(&mpiflag);
     TEUCHOS_ASSERT(mpiflag);
 
-    Logger::set_level(runConfig.logLevel);
+    Logger::setup_mpi_spdlog(runConfig.logLevel, runConfig.logAsync);
     commRcp = getMPIWORLDTCOMM();
 
     showOnScreenRank0();
@@ -57,24 +69,27 @@ void SylinderSystem::initialize(const SylinderConfig &runConfig_, const std::str
 
     dinfo.initialize(); // init DomainInfo
     setDomainInfo();
+    setGeomPartitioner();
 
     sylinderContainer.initialize();
     sylinderContainer.setAverageTargetNumberOfSampleParticlePerProcess(200); // more sample for better balance
 
     if (IOHelper::fileExist(posFile)) {
         setInitialFromFile(posFile);
+    } else if (runConfig.initOverlapFree) {
+        setInitialFromConfigParallel();
     } else {
         setInitialFromConfig();
     }
     setLinkMapFromFile(posFile);
+    setShapeFromFile(posFile);
 
-    // at this point all sylinders located on rank 0
+    // at this point all sylinders located on rank 0, or on every rank if initOverlapFree
     commRcp->barrier();
+    sylinderNearDataDirectoryPtr = std::make_shared<ZDD<SylinderNearEP>>(sylinderContainer.getNumberOfParticleLocal());
     decomposeDomain();
     exchangeSylinder(); // distribute to ranks, initial domain decomposition
 
-    sylinderNearDataDirectoryPtr = std::make_shared<ZDD<SylinderNearEP>>(sylinderContainer.getNumberOfParticleLocal());
-
     treeSylinderNumber = 0;
     setTreeSylinder();
 
@@ -91,6 +106,7 @@ void SylinderSystem::initialize(const SylinderConfig &runConfig_, const std::str
         spdlog::warn("Initial Collision Resolution Begin");
         for (int i = 0; i < runConfig.initPreSteps; i++) {
             prepareStep();
+            collectPairCollision();
             calcVelocityNonCon();
             resolveConstraints();
             saveForceVelocityConstraints();
@@ -105,6 +121,7 @@ void SylinderSystem::initialize(const SylinderConfig &runConfig_, const std::str
 
 void SylinderSystem::reinitialize(const SylinderConfig &runConfig_, const std::string &restartFile, int argc, char **argv, bool eulerStep) {
     runConfig = runConfig_;
+    stepDt = runConfig.dt;
 
     // Read the timestep information and pvtp filenames from restartFile
     std::string pvtpFileName;
@@ -123,7 +140,7 @@ void SylinderSystem::reinitialize(const SylinderConfig &runConfig_, const std::s
     MPI_Initialized(&mpiflag);
     TEUCHOS_ASSERT(mpiflag);
 
-    Logger::set_level(runConfig.logLevel);
+    Logger::setup_mpi_spdlog(runConfig.logLevel, runConfig.logAsync);
     commRcp = getMPIWORLDTCOMM();
 
     showOnScreenRank0();
@@ -135,6 +152,7 @@ void SylinderSystem::reinitialize(const SylinderConfig &runConfig_, const std::s
 
     dinfo.initialize(); // init DomainInfo
     setDomainInfo();
+    setGeomPartitioner();
 
     sylinderContainer.initialize();
     sylinderContainer.setAverageTargetNumberOfSampleParticlePerProcess(200); // more samples for better balance
@@ -149,6 +167,7 @@ void SylinderSystem::reinitialize(const SylinderConfig &runConfig_, const std::s
     setInitialFromVTKFile(baseFolder + pvtpFileName);
 
     setLinkMapFromFile(baseFolder + asciiFileName);
+    setShapeFromFile(baseFolder + asciiFileName);
 
     // VTK data is wrote before the Euler step, thus we need to run one Euler step below
     if (eulerStep)
@@ -160,12 +179,11 @@ void SylinderSystem::reinitialize(const SylinderConfig &runConfig_, const std::s
     // at this point all sylinders located on rank 0
     commRcp->barrier();
     applyBoxBC();
+    sylinderNearDataDirectoryPtr = std::make_shared<ZDD<SylinderNearEP>>(sylinderContainer.getNumberOfParticleLocal());
     decomposeDomain();
     exchangeSylinder(); // distribute to ranks, initial domain decomposition
     updateSylinderMap();
 
-    sylinderNearDataDirectoryPtr = std::make_shared<ZDD<SylinderNearEP>>(sylinderContainer.getNumberOfParticleLocal());
-
     treeSylinderNumber = 0;
     setTreeSylinder();
     calcVolFrac();
@@ -262,6 +280,255 @@ void SylinderSystem::setInitialFromConfig() {
     }
 }
 
+void SylinderSystem::setInitialFromConfigParallel() {
+    // this function init sylinders on all ranks, each rank fills its own slabs of initBox
+    const int rank = commRcp->getRank();
+    const int nProcs = commRcp->getSize();
+    const CounterRng rng(runConfig.rngSeed);
+
+    const double boxEdge[3] = {runConfig.initBoxHigh[0] - runConfig.initBoxLow[0],
+                               runConfig.initBoxHigh[1] - runConfig.initBoxLow[1],
+                               runConfig.initBoxHigh[2] - runConfig.initBoxLow[2]};
+    const double minBoxEdge = std::min(std::min(boxEdge[0], boxEdge[1]), boxEdge[2]);
+    const double maxLength = minBoxEdge * 0.5;
+    const double radius = runConfig.sylinderDiameter / 2;
+    const double radiusCol = radius * runConfig.sylinderDiameterColRatio;
+
+    // split initBox into slabs along the longest edge. x for circular cross section
+    int axis = 0;
+    if (!runConfig.initCircularX) {
+        for (int k = 1; k < 3; k++) {
+            axis = boxEdge[k] > boxEdge[axis] ? k : axis;
+        }
+    }
+    // the number of slabs and the gids of each slab depend only on runConfig, not on the number of ranks
+    // each rank fills a contiguous range of slabs
+    const int nGlobal = runConfig.sylinderNumber;
+    const double slabMin = 2 * (runConfig.sylinderLength * runConfig.sylinderLengthColRatio + 2 * radiusCol);
+    const int nSlab = std::max(1, std::min(nGlobal, static_cast<int>(std::min(1024.0, boxEdge[axis] / slabMin))));
+    const int slabBegin = static_cast<int64_t>(nSlab) * rank / nProcs;
+    const int slabEnd = static_cast<int64_t>(nSlab) * (rank + 1) / nProcs;
+    auto getSlabGidBase = [&](int slab) { return slab * (nGlobal / nSlab) + std::min(slab, nGlobal % nSlab); };
+    sylinderContainer.setNumberOfParticleLocal(getSlabGidBase(slabEnd) - getSlabGidBase(slabBegin));
+
+    const double monoZ = (runConfig.simBoxHigh[2] + runConfig.simBoxLow[2]) / 2;
+    const double radiusCrossSec = 0.5 * std::min(runConfig.initBoxHigh[2] - runConfig.initBoxLow[2],
+                                                 runConfig.initBoxHigh[1] - runConfig.initBoxLow[1]);
+    const int nTrial = std::max(1, runConfig.initInsertTrial);
+    const bool randomOrient =
+        std::all_of(runConfig.initOrient, runConfig.initOrient + 3, [](double p) { return p < -1 || p > 1; });
+
+    int nFailed = 0;
+    int ite = 0;
+    for (int slab = slabBegin; slab < slabEnd; slab++) {
+        double slabLow[3], slabHigh[3];
+        std::copy(runConfig.initBoxLow, runConfig.initBoxLow + 3, slabLow);
+        std::copy(runConfig.initBoxHigh, runConfig.initBoxHigh + 3, slabHigh);
+        slabLow[axis] = runConfig.initBoxLow[axis] + boxEdge[axis] * slab / nSlab;
+        slabHigh[axis] = runConfig.initBoxLow[axis] + boxEdge[axis] * (slab + 1) / nSlab;
+
+        // contiguous gid block in each slab
+        const int gidBase = getSlabGidBase(slab);
+        const int nLocal = getSlabGidBase(slab + 1) - gidBase;
+        const int offset = gidBase - getSlabGidBase(slabBegin); // index of the first sylinder of this slab
+        auto sylinderSlab = [&](int i) -> Sylinder & { return sylinderContainer[offset + i]; };
+
+        // counter layout for each gid: [0,16) length, [16+8t,24+8t) trial t
+        std::vector<double> length(nLocal);
+    #pragma omp parallel for
+        for (int i = 0; i < nLocal; i++) {
+            const int gid = gidBase + i;
+            if (runConfig.sylinderLengthSigma > 0) {
+                int counter = 0;
+                do { // generate random length
+                    length[i] = rng.getLN(gid, counter, runConfig.sylinderLength, runConfig.sylinderLengthSigma);
+                    counter += 2;
+                } while (length[i] >= maxLength && counter < 16);
+                length[i] = std::min(length[i], maxLength);
+            } else {
+                length[i] = runConfig.sylinderLength;
+            }
+        }
+        const double maxLocalLength = nLocal > 0 ? *std::max_element(length.begin(), length.end()) : 0;
+        const double maxLengthCol = maxLocalLength * runConfig.sylinderLengthColRatio;
+
+        // uniform cell grid over the slab, cell edge >= max interaction range
+        // cells are clamped so that the total number stays O(nLocal)
+        double cellSize = std::max(maxLengthCol + 2 * radiusCol, 1e-12);
+        int nCell[3];
+        auto setCellGrid = [&]() {
+            for (int k = 0; k < 3; k++) {
+                nCell[k] = std::max(1, static_cast<int>(std::floor((slabHigh[k] - slabLow[k]) / cellSize)));
+            }
+        };
+        setCellGrid();
+        while (static_cast<double>(nCell[0]) * nCell[1] * nCell[2] > 8.0 * nLocal + 8) {
+            cellSize *= 1.26;
+            setCellGrid();
+        }
+        auto getCell = [&](const Evec3 &pos, int idx[3]) {
+            for (int k = 0; k < 3; k++) {
+                const int c = std::floor((pos[k] - slabLow[k]) / (slabHigh[k] - slabLow[k]) * nCell[k]);
+                idx[k] = std::max(0, std::min(nCell[k] - 1, c));
+            }
+        };
+        std::vector<std::vector<int>> cells(nCell[0] * nCell[1] * nCell[2]);
+        auto cellId = [&](const int idx[3]) { return idx[0] + nCell[0] * (idx[1] + nCell[1] * idx[2]); };
+
+        std::vector<Evec3> center(nLocal);
+        std::vector<Evec3> direction(nLocal);
+
+        // max overlap of a trial rod against rods already inserted into cells
+        auto calcOverlap = [&](const Evec3 &pos, const Evec3 &drt, const double lengthCol, const int self,
+                               double &overlap, Evec3 &push) {
+            DCPQuery<3, double, Evec3> DistSegSeg3;
+            const Evec3 Pm = pos - drt * (0.5 * lengthCol);
+            const Evec3 Pp = pos + drt * (0.5 * lengthCol);
+            overlap = 0;
+            push.setZero();
+            int idx[3];
+            getCell(pos, idx);
+            for (int cz = std::max(0, idx[2] - 1); cz <= std::min(nCell[2] - 1, idx[2] + 1); cz++) {
+                for (int cy = std::max(0, idx[1] - 1); cy <= std::min(nCell[1] - 1, idx[1] + 1); cy++) {
+                    for (int cx = std::max(0, idx[0] - 1); cx <= std::min(nCell[0] - 1, idx[0] + 1); cx++) {
+                        const int cidx[3] = {cx, cy, cz};
+                        for (const int j : cells[cellId(cidx)]) {
+                            if (j == self) {
+                                continue;
+                            }
+                            const double lengthColJ = length[j] * runConfig.sylinderLengthColRatio;
+                            const Evec3 Qm = center[j] - direction[j] * (0.5 * lengthColJ);
+                            const Evec3 Qp = center[j] + direction[j] * (0.5 * lengthColJ);
+                            Evec3 Ploc, Qloc;
+                            double s, t;
+                            const double dist = DistSegSeg3(Pm, Pp, Qm, Qp, Ploc, Qloc, s, t);
+                            const double olp = 2 * radiusCol - dist;
+                            if (olp > 0) {
+                                overlap = std::max(overlap, olp);
+                                const Evec3 norm = dist > 1e-12 * radiusCol
+                                                       ? Evec3((Ploc - Qloc) / dist)
+                                                       : Evec3(drt.cross(direction[j]).normalized());
+                                push += 0.5 * olp * norm;
+                            }
+                        }
+                    }
+                }
+            }
+        };
+
+        // step 1, random sequential insertion with a few trials per rod
+        const int nFailedBefore = nFailed;
+        for (int i = 0; i < nLocal; i++) {
+            const uint64_t gid = gidBase + i;
+            const double lengthCol = length[i] * runConfig.sylinderLengthColRatio;
+            double bestOverlap = std::numeric_limits<double>::max();
+            for (int t = 0; t < nTrial; t++) {
+                const uint64_t counter = 16 + 8 * t;
+                Evec3 pos;
+                for (int k = 0; k < 3; k++) {
+                    pos[k] = rng.getU01(gid, counter + k) * (slabHigh[k] - slabLow[k]) + slabLow[k];
+                }
+                if (runConfig.initCircularX) {
+                    double y = 0, z = 0;
+                    getRandPointInCircle(radiusCrossSec, rng.getU01(gid, counter + 1), rng.getU01(gid, counter + 2), y,
+                                         z);
+                    pos[1] = y + 0.5 * (runConfig.initBoxHigh[1] + runConfig.initBoxLow[1]);
+                    pos[2] = z + 0.5 * (runConfig.initBoxHigh[2] + runConfig.initBoxLow[2]);
+                }
+                // same rule as getOrient()
+                Evec3 pvec;
+                for (int k = 0; k < 3; k++) {
+                    const double p = runConfig.initOrient[k];
+                    pvec[k] = (p < -1 || p > 1) ? 2 * rng.getU01(gid, counter + 3 + k) - 1 : p;
+                }
+                Equatn orientq;
+                if (randomOrient) {
+                    EquatnHelper::setUnitRandomEquatn(orientq, rng.getU01(gid, counter + 3),
+                                                      rng.getU01(gid, counter + 4), rng.getU01(gid, counter + 5));
+                } else {
+                    orientq = Equatn::FromTwoVectors(Evec3(0, 0, 1), pvec);
+                }
+                if (runConfig.monolayer) {
+                    pos[2] = monoZ;
+                    Evec3 drt = orientq * Evec3(0, 0, 1);
+                    drt[2] = 0;
+                    drt.normalize();
+                    orientq.setFromTwoVectors(Evec3(0, 0, 1), drt);
+                }
+                const Evec3 drt = orientq * Evec3(0, 0, 1);
+
+                double overlap = 0;
+                Evec3 push;
+                calcOverlap(pos, drt, lengthCol, -1, overlap, push);
+                // the first half of trials must also stay inside the slab to avoid overlaps across slabs
+                const double extent = 0.5 * lengthCol * std::abs(drt[axis]) + radiusCol;
+                if (t < nTrial / 2 && (pos[axis] - extent < slabLow[axis] || pos[axis] + extent > slabHigh[axis])) {
+                    overlap += 2 * radiusCol;
+                }
+                if (overlap < bestOverlap) {
+                    bestOverlap = overlap;
+                    center[i] = pos;
+                    direction[i] = drt;
+                    double orientation[4];
+                    Emapq(orientation).coeffs() = orientq.coeffs();
+                    sylinderSlab(i) = Sylinder(gid, radius, radius, length[i], length[i], pos.data(), orientation);
+                    sylinderSlab(i).clear();
+                }
+                if (overlap == 0) {
+                    break;
+                }
+            }
+            if (bestOverlap > 0) {
+                nFailed++;
+            }
+            int idx[3];
+            getCell(center[i], idx);
+            cells[cellId(idx)].push_back(i);
+        }
+
+        // step 2, soft repulsion relaxation, Jacobi sweeps pushing overlapping pairs apart
+        int slabIte = 0;
+        double maxOverlap = nFailed > nFailedBefore ? std::numeric_limits<double>::max() : 0;
+        std::vector<Evec3> displacement(nLocal);
+        while (slabIte < runConfig.initRelaxIte && maxOverlap > 1e-3 * radiusCol) {
+            maxOverlap = 0;
+    #pragma omp parallel for reduction(max : maxOverlap)
+            for (int i = 0; i < nLocal; i++) {
+                double overlap = 0;
+                calcOverlap(center[i], direction[i], length[i] * runConfig.sylinderLengthColRatio, i, overlap,
+                            displacement[i]);
+                maxOverlap = std::max(maxOverlap, overlap);
+            }
+            for (auto &c : cells) {
+                c.clear();
+            }
+            for (int i = 0; i < nLocal; i++) {
+                for (int k = 0; k < 3; k++) {
+                    center[i][k] = std::max(slabLow[k], std::min(slabHigh[k], center[i][k] + displacement[i][k]));
+                }
+                if (runConfig.monolayer) {
+                    center[i][2] = monoZ;
+                }
+                std::copy(center[i].data(), center[i].data() + 3, sylinderSlab(i).pos);
+                int idx[3];
+                getCell(center[i], idx);
+                cells[cellId(idx)].push_back(i);
+            }
+            slabIte++;
+        }
+        ite = std::max(ite, slabIte);
+    }
+
+    int nFailedGlobal = 0;
+    Teuchos::reduceAll(*commRcp, Teuchos::SumValueReductionOp<int, int>(), 1, &nFailed, &nFailedGlobal);
+    if (nFailedGlobal > 0) {
+        spdlog::warn("Overlap-free insertion: {} of {} sylinders inserted with overlaps, {} relaxation iterations",
+                     nFailedGlobal, nGlobal, ite);
+    } else {
+        spdlog::info("Overlap-free insertion: {} sylinders inserted, {} relaxation iterations", nGlobal, ite);
+    }
+}
+
 void SylinderSystem::setInitialCircularCrossSection() {
     const int nLocal = sylinderContainer.getNumberOfParticleLocal();
     double radiusCrossSec = 0;            // x, y, z, axis radius
@@ -321,10 +588,13 @@ void SylinderSystem::setInitialFromFile(const std::string &filename) {
         // optional data
         int group = -1;
         liness >> group;
+        int shape = -1;
+        liness >> shape;
 
         Emap3(sy.pos) = Evec3((mx + px), (my + py), (mz + pz)) * 0.5;
         sy.gid = gid;
         sy.group = group;
+        sy.shape = shape;
         sy.isImmovable = (type == 'S') ? true : false;
         sy.radius = radius;
         sy.radiusCollision = radius;
@@ -377,6 +647,8 @@ void SylinderSystem::setLinkMapFromFile(const std::string &filename) {
         char header;
         liness >> header >> link.prev >> link.next;
         assert(header == 'L');
+        link.type = 0;
+        liness >> link.type; // optional
     };
 
     std::ifstream myfile(filename);
@@ -385,19 +657,73 @@ void SylinderSystem::setLinkMapFromFile(const std::string &filename) {
     std::getline(myfile, line);
 
     linkMap.clear();
+    linkReverseMap.clear();
+    linkTypeMap.clear();
     while (std::getline(myfile, line)) {
         if (line[0] == 'L') {
             Link link;
             parseLink(link, line);
-            linkMap.emplace(link.prev, link.next);
-            linkReverseMap.emplace(link.next, link.prev);
+            addLink(link);
         }
     }
     myfile.close();
+    updateLinkCluster();
 
     spdlog::debug("Link number in file {} ", linkMap.size());
 }
 
+void SylinderSystem::setShapeFromFile(const std::string &filename) {
+    shapeTablePtr = std::make_shared<std::vector<ConvexShape>>();
+
+    std::ifstream myfile(filename);
+    std::string line;
+    std::getline(myfile, line); // read two header lines
+    std::getline(myfile, line);
+
+    std::map<int, ConvexShape> shapeRead;
+    while (std::getline(myfile, line)) {
+        if (line[0] == 'H') {
+            std::stringstream liness(line);
+            char header;
+            int index = -1;
+            ConvexShape shape;
+            liness >> header >> index;
+            if (index < 0 || !shape.readAscii(liness)) {
+                spdlog::critical("Invalid shape line: {}", line);
+                std::exit(1);
+            }
+            shapeRead[index] = shape;
+        }
+    }
+    myfile.close();
+
+    if (!shapeRead.empty()) {
+        shapeTablePtr->resize(shapeRead.rbegin()->first + 1);
+        for (const auto &index_shape : shapeRead) {
+            (*shapeTablePtr)[index_shape.first] = index_shape.second;
+        }
+        if (shapeRead.size() != shapeTablePtr->size()) {
+            spdlog::critical("Shape index must be contiguous from 0");
+            std::exit(1);
+        }
+    }
+
+    const int nLocal = sylinderContainer.getNumberOfParticleLocal();
+    for (int i = 0; i < nLocal; i++) {
+        checkShape(sylinderContainer[i]);
+    }
+
+    spdlog::debug("Shape number in file {} ", shapeTablePtr->size());
+}
+
+void SylinderSystem::checkShape(const Sylinder &sy) const {
+    const int nShape = shapeTablePtr ? shapeTablePtr->size() : 0;
+    if (sy.shape >= nShape) {
+        spdlog::critical("Sylinder {} uses undefined shape {}, {} shapes defined", sy.gid, sy.shape, nShape);
+        std::exit(1);
+    }
+}
+
 void SylinderSystem::setInitialFromVTKFile(const std::string &pvtpFileName) {
     spdlog::warn("Reading file " + pvtpFileName);
 
@@ -422,12 +748,16 @@ void SylinderSystem::setInitialFromVTKFile(const std::string &pvtpFileName) {
         // unsigned char type
         vtkSmartPointer<vtkTypeUInt8Array> isImmovableData =
             vtkArrayDownCast<vtkTypeUInt8Array>(polydata->GetCellData()->GetAbstractArray("isImmovable"));
+        // optional, absent in files without convex shapes
+        vtkSmartPointer<vtkTypeInt32Array> shapeData =
+            vtkArrayDownCast<vtkTypeInt32Array>(polydata->GetCellData()->GetAbstractArray("shape"));
         // float/double types
         vtkSmartPointer<vtkDataArray> lengthData = polydata->GetCellData()->GetArray("length");
         vtkSmartPointer<vtkDataArray> lengthCollisionData = polydata->GetCellData()->GetArray("lengthCollision");
         vtkSmartPointer<vtkDataArray> radiusData = polydata->GetCellData()->GetArray("radius");
         vtkSmartPointer<vtkDataArray> radiusCollisionData = polydata->GetCellData()->GetArray("radiusCollision");
         vtkSmartPointer<vtkDataArray> znormData = polydata->GetCellData()->GetArray("znorm");
+        vtkSmartPointer<vtkDataArray> xnormData = polydata->GetCellData()->GetArray("xnorm");
         vtkSmartPointer<vtkDataArray> velData = polydata->GetCellData()->GetArray("vel");
         vtkSmartPointer<vtkDataArray> omegaData = polydata->GetCellData()->GetArray("omega");
 
@@ -453,6 +783,16 @@ void SylinderSystem::setInitialFromVTKFile(const std::string &pvtpFileName) {
             sy.radiusCollision = radiusCollisionData->GetComponent(i, 0);
             const Evec3 direction(znormData->GetComponent(i, 0), znormData->GetComponent(i, 1), znormData->GetComponent(i, 2));
             Emapq(sy.orientation) = Equatn::FromTwoVectors(Evec3(0, 0, 1), direction);
+            sy.shape = shapeData ? shapeData->GetValue(i) : -1;
+            if (sy.shape >= 0 && xnormData) {
+                // convex shapes are not axisymmetric, keep the rotation around the direction
+                const Evec3 nz = direction.normalized();
+                Evec3 nx(xnormData->GetComponent(i, 0), xnormData->GetComponent(i, 1), xnormData->GetComponent(i, 2));
+                nx = (nx - nz * nz.dot(nx)).normalized();
+                Emat3 rotation;
+                rotation << nx, nz.cross(nx), nz;
+                Emapq(sy.orientation) = Equatn(rotation).normalized();
+            }
             sy.vel[0] = velData->GetComponent(i, 0);
             sy.vel[1] = velData->GetComponent(i, 1);
             sy.vel[2] = velData->GetComponent(i, 2);
@@ -490,7 +830,15 @@ void SylinderSystem::writeAscii(const std::string &baseFolder) {
     if (commRcp->getRank() == 0) {
         FILE *fptr = fopen(name.c_str(), "a");
         for (const auto &key_value : linkMap) {
-            fprintf(fptr, "L %d %d\n", key_value.first, key_value.second);
+            const auto it = linkTypeMap.find(linkKey(key_value.first, key_value.second));
+            if (it != linkTypeMap.end()) {
+                fprintf(fptr, "L %d %d %d\n", key_value.first, key_value.second, it->second);
+            } else {
+                fprintf(fptr, "L %d %d\n", key_value.first, key_value.second);
+            }
+        }
+        for (int i = 0; i < shapeTablePtr->size(); i++) {
+            (*shapeTablePtr)[i].writeAscii(fptr, i);
         }
         fclose(fptr);
     }
@@ -559,8 +907,9 @@ void SylinderSystem::showOnScreenRank0() {
 }
 
 void SylinderSystem::setDomainInfo() {
+    // Lees-Edwards images across y are added by addLeesEdwardsImage(), not by FDPS
     const int pbcX = (runConfig.simBoxPBC[0] ? 1 : 0);
-    const int pbcY = (runConfig.simBoxPBC[1] ? 1 : 0);
+    const int pbcY = (runConfig.simBoxPBC[1] && runConfig.shearRate == 0 ? 1 : 0);
     const int pbcZ = (runConfig.simBoxPBC[2] ? 1 : 0);
     const int pbcFlag = 100 * pbcX + 10 * pbcY + pbcZ;
 
@@ -601,16 +950,253 @@ void SylinderSystem::setDomainInfo() {
     dinfo.setPosRootDomain(rootDomainLow, rootDomainHigh); // rootdomain must be specified after PBC
 }
 
+void SylinderSystem::setGeomPartitioner() {
+    switch (runConfig.domainDecompChoice) {
+    case 0:
+        geomPartitionerPtr.reset(); // FDPS multisection
+        break;
+    case 1:
+        geomPartitionerPtr = std::make_shared<ZGeomPartitioner>("RCB");
+        break;
+    case 2:
+        geomPartitionerPtr = std::make_shared<ZGeomPartitioner>("HSFC");
+        break;
+    default:
+        spdlog::critical("domainDecompChoice {} not supported", runConfig.domainDecompChoice);
+        std::exit(1);
+    }
+    graphPartitionerPtr.reset();
+    if (runConfig.domainLinkRefine) {
+        graphPartitionerPtr = std::make_shared<ZGraphPartitioner>();
+    }
+}
+
+namespace {
+// the number of near neighbors scales roughly with the aspect ratio
+double getDecompWeight(const Sylinder &sy) { return 1 + sy.length / (2 * sy.radius); }
+} // namespace
+
 void SylinderSystem::decomposeDomain() {
     applyBoxBC();
-    dinfo.decomposeDomainAll(sylinderContainer);
+    if (!geomPartitionerPtr) {
+        dinfo.decomposeDomainAll(sylinderContainer);
+        return;
+    }
+
+    // Zoltan partition, fully distributed
+    const int nLocal = sylinderContainer.getNumberOfParticleLocal();
+    std::vector<int> gid(nLocal);
+    std::vector<double> coord(3 * nLocal);
+    std::vector<double> weight(nLocal);
+#pragma omp parallel for
+    for (int i = 0; i < nLocal; i++) {
+        const auto &sy = sylinderContainer[i];
+        gid[i] = sy.gid;
+        for (int k = 0; k < 3; k++) {
+            coord[3 * i + k] = sy.pos[k];
+        }
+        weight[i] = getDecompWeight(sy);
+    }
+    std::vector<int> destRank;
+    geomPartitionerPtr->partition(gid, coord, weight, destRank);
+    migrateSylinder(destRank);
+    if (graphPartitionerPtr) {
+        refineDomainByLink();
+    }
+    setDomainFromGeomPartitioner();
+}
+
+void SylinderSystem::refineDomainByLink() {
+    std::vector<int> edgeDisp, edgeGid, edgeRank;
+    const int nCutLocal = findLinkEdge(edgeDisp, edgeGid, edgeRank);
+
+    const int nLocal = sylinderContainer.getNumberOfParticleLocal();
+    std::vector<int> gid(nLocal);
+    std::vector<double> weight(nLocal);
+#pragma omp parallel for
+    for (int i = 0; i < nLocal; i++) {
+        gid[i] = sylinderContainer[i].gid;
+        weight[i] = getDecompWeight(sylinderContainer[i]);
+    }
+    std::vector<int> destRank;
+    graphPartitionerPtr->partition(gid, weight, edgeDisp, edgeGid, edgeRank, destRank);
+    migrateSylinder(destRank);
+
+    refinedGid.clear();
+    const int myRank = commRcp->getRank();
+    const int nLocalNew = sylinderContainer.getNumberOfParticleLocal();
+    for (int i = 0; i < nLocalNew; i++) {
+        const auto &sy = sylinderContainer[i];
+        if (geomPartitionerPtr->assignPoint(sy.pos) != myRank) {
+            refinedGid.insert(sy.gid);
+        }
+    }
+
+    // each cross-rank link is counted on both ranks
+    if (runConfig.logLevel <= spdlog::level::info) {
+        int nCut[2] = {nCutLocal, findLinkEdge(edgeDisp, edgeGid, edgeRank)};
+        MPI_Allreduce(MPI_IN_PLACE, nCut, 2, MPI_INT, MPI_SUM, MPI_COMM_WORLD);
+        spdlog::info("RECORD: Link refinement cross-rank links {} -> {}", nCut[0] / 2, nCut[1] / 2);
+    }
+}
+
+int SylinderSystem::findLinkEdge(std::vector<int> &edgeDisp, std::vector<int> &edgeGid, std::vector<int> &edgeRank) {
+    updateSylinderRank();
+    buildSylinderNearDataDirectory();
+
+    const int nLocal = sylinderContainer.getNumberOfParticleLocal();
+    auto &gidToFind = sylinderNearDataDirectoryPtr->gidToFind;
+    gidToFind.clear();
+    edgeDisp.assign(nLocal + 1, 0);
+    for (int i = 0; i < nLocal; i++) {
+        const int gid = sylinderContainer[i].gid;
+        for (const auto *map : {&linkMap, &linkReverseMap}) {
+            const auto &range = map->equal_range(gid);
+            for (auto it = range.first; it != range.second; it++) {
+                gidToFind.push_back(it->second);
+            }
+        }
+        edgeDisp[i + 1] = gidToFind.size();
+    }
+    sylinderNearDataDirectoryPtr->find();
+
+    const int nEdge = gidToFind.size();
+    const int myRank = commRcp->getRank();
+    edgeGid.assign(gidToFind.begin(), gidToFind.end());
+    edgeRank.resize(nEdge);
+    int nCut = 0;
+    for (int e = 0; e < nEdge; e++) {
+        edgeRank[e] = sylinderNearDataDirectoryPtr->dataToFind[e].rank;
+        nCut += (edgeRank[e] != myRank);
+    }
+    return nCut;
 }
 
 void SylinderSystem::exchangeSylinder() {
-    sylinderContainer.exchangeParticle(dinfo);
+    if (geomPartitionerPtr) {
+        // assign with the cuts of the last decomposeDomain(), sylinders moved by the link refinement stay
+        const int nLocal = sylinderContainer.getNumberOfParticleLocal();
+        const int myRank = commRcp->getRank();
+        std::vector<int> destRank(nLocal);
+        for (int i = 0; i < nLocal; i++) {
+            const auto &sy = sylinderContainer[i];
+            destRank[i] = refinedGid.count(sy.gid) ? myRank : geomPartitionerPtr->assignPoint(sy.pos);
+        }
+        migrateSylinder(destRank);
+        if (!geomPartitionerPtr->hasPartBox() || graphPartitionerPtr) {
+            setDomainFromGeomPartitioner();
+        }
+    } else {
+        sylinderContainer.exchangeParticle(dinfo);
+    }
     updateSylinderRank();
 }
 
+void SylinderSystem::migrateSylinder(std::vector<int> &destRank) {
+    const int nLocal = sylinderContainer.getNumberOfParticleLocal();
+    const int myRank = commRcp->getRank();
+    TEUCHOS_ASSERT(static_cast<int>(destRank.size()) == nLocal);
+
+    std::vector<int> sendDestRank;
+    std::vector<Sylinder> sendSylinder;
+    int nKeep = 0;
+    for (int i = 0; i < nLocal; i++) {
+        if (destRank[i] == myRank) {
+            sylinderContainer[nKeep] = sylinderContainer[i];
+            nKeep++;
+        } else {
+            sendDestRank.push_back(destRank[i]);
+            sendSylinder.push_back(sylinderContainer[i]);
+        }
+    }
+
+    CommMPI comm;
+    std::vector<int> recvSrcRank;
+    std::vector<Sylinder> recvSylinder;
+    comm.exchangeAllToAllV(sendDestRank, sendSylinder, recvSrcRank, recvSylinder);
+
+    const int nRecv = recvSylinder.size();
+    sylinderContainer.setNumberOfParticleLocal(nKeep + nRecv);
+#pragma omp parallel for
+    for (int i = 0; i < nRecv; i++) {
+        sylinderContainer[nKeep + i] = recvSylinder[i];
+    }
+}
+
+void SylinderSystem::setDomainFromGeomPartitioner() {
+    const int nProcs = commRcp->getSize();
+    if (geomPartitionerPtr->hasPartBox() && !graphPartitionerPtr) {
+        // RCB parts are boxes tiling the root domain
+        for (int i = 0; i < nProcs; i++) {
+            double low[3], high[3];
+            geomPartitionerPtr->getPartBox(i, runConfig.simBoxLow, runConfig.simBoxHigh, low, high);
+            dinfo.setPosDomain(i, PS::F64ort(PS::F64vec3(low[0], low[1], low[2]), PS::F64vec3(high[0], high[1], high[2])));
+        }
+    } else {
+        // HSFC and refined parts are not boxes. use the bounding box of particle centers on each rank
+        // boxes may overlap, which is fine for the tree because each particle is owned by one rank
+        double box[6];
+        calcLocalDomainBox(box, box + 3);
+        std::vector<double> boxAll(6 * nProcs);
+        Teuchos::gatherAll(*commRcp, 6, box, 6 * nProcs, boxAll.data());
+        for (int i = 0; i < nProcs; i++) {
+            const double *b = boxAll.data() + 6 * i;
+            dinfo.setPosDomain(i, PS::F64ort(PS::F64vec3(b[0], b[1], b[2]), PS::F64vec3(b[3], b[4], b[5])));
+        }
+    }
+}
+
+void SylinderSystem::calcLocalDomainBox(double low[3], double high[3]) const {
+    const int nLocal = sylinderContainer.getNumberOfParticleLocal();
+    if (nLocal == 0) {
+        // an empty box at the corner of the root domain
+        std::copy(runConfig.simBoxLow, runConfig.simBoxLow + 3, low);
+        std::copy(runConfig.simBoxLow, runConfig.simBoxLow + 3, high);
+        return;
+    }
+
+    bool pbc[3];
+    dinfo.getPeriodicAxis(pbc);
+    for (int k = 0; k < 3; k++) {
+        const double boxLow = runConfig.simBoxLow[k];
+        const double boxLength = runConfig.simBoxHigh[k] - boxLow;
+        double start = boxLow; // centers below start are shifted by boxLength
+        if (pbc[k]) {
+            // the box starts after the longest circular run of empty bins
+            constexpr int nBin = 256;
+            std::array<bool, nBin> occupied{};
+            for (int i = 0; i < nLocal; i++) {
+                const int b = std::floor((sylinderContainer[i].pos[k] - boxLow) / boxLength * nBin);
+                occupied[std::min(std::max(b, 0), nBin - 1)] = true;
+            }
+            const int first = std::find(occupied.begin(), occupied.end(), true) - occupied.begin();
+            int startBin = first;
+            int run = 0, longestRun = 0;
+            for (int j = 1; j <= nBin; j++) {
+                const int b = (first + j) % nBin;
+                if (!occupied[b]) {
+                    run++;
+                    continue;
+                }
+                if (run > longestRun) {
+                    longestRun = run;
+                    startBin = b;
+                }
+                run = 0;
+            }
+            start = boxLow + startBin * boxLength / nBin;
+        }
+        low[k] = std::numeric_limits<double>::max();
+        high[k] = -std::numeric_limits<double>::max();
+        for (int i = 0; i < nLocal; i++) {
+            const double x = sylinderContainer[i].pos[k];
+            const double image = x < start ? x + boxLength : x;
+            low[k] = std::min(low[k], image);
+            high[k] = std::max(high[k], image);
+        }
+    }
+}
+
 void SylinderSystem::calcMobMatrix() {
     // diagonal hydro mobility operator
     // 3*3 block for translational + 3*3 block for rotational.
@@ -648,9 +1234,10 @@ void SylinderSystem::calcMobMatrix() {
         double dragPerp = 0;
         double dragRot = 0;
         sy.calcDragCoeff(mu, dragPara, dragPerp, dragRot);
-        const double dragParaInv = sy.isImmovable ? 0.0 : 1 / dragPara;
-        const double dragPerpInv = sy.isImmovable ? 0.0 : 1 / dragPerp;
-        const double dragRotInv = sy.isImmovable ? 0.0 : 1 / dragRot;
+        const bool immovable = sy.isImmovable || sy.isFrozen;
+        const double dragParaInv = immovable ? 0.0 : 1 / dragPara;
+        const double dragPerpInv = immovable ? 0.0 : 1 / dragPerp;
+        const double dragRotInv = immovable ? 0.0 : 1 / dragRot;
 
         MobTrans = dragParaInv * qq + dragPerpInv * Imqq;
         MobRot = dragRotInv * qq + dragRotInv * Imqq; // = dragRotInv * Identity
@@ -660,6 +1247,13 @@ void SylinderSystem::calcMobMatrix() {
         // no problem for axissymetric slender body.
         // this simplifies the rotational Brownian calculations.
 
+        if (runConfig.wallMobility) {
+            Emat3 transSqrt, rotSqrt;
+            calcWallFactor(sy, ECmap3(sy.pos), q, transSqrt, rotSqrt);
+            MobTrans = transSqrt * MobTrans * transSqrt;
+            MobRot = rotSqrt * MobRot * rotSqrt;
+        }
+
         // column index is local index
         columnIndices[18 * i] = 6 * i; // line 1 of Mob Trans
         columnIndices[18 * i + 1] = 6 * i + 1;
@@ -710,6 +1304,47 @@ void SylinderSystem::calcMobMatrix() {
 void SylinderSystem::calcMobOperator() {
     calcMobMatrix();
     mobilityOperatorRcp = mobilityMatrixRcp;
+    rigidClusterOperatorRcp.reset();
+    if (runConfig.rigidCluster) {
+        calcRigidClusterOperator();
+        mobilityOperatorRcp = rigidClusterOperatorRcp;
+    }
+}
+
+void SylinderSystem::calcRigidClusterOperator() {
+    const int nLocal = sylinderContainer.getNumberOfParticleLocal();
+
+    // find the anchor of the cluster of each local sylinder
+    auto &sylinderNearDataDirectory = *sylinderNearDataDirectoryPtr;
+    sylinderNearDataDirectory.gidToFind.resize(nLocal);
+#pragma omp parallel for
+    for (int i = 0; i < nLocal; i++) {
+        sylinderNearDataDirectory.gidToFind[i] = sylinderContainer[i].clusterGid;
+    }
+    sylinderNearDataDirectory.find();
+
+    std::vector<int> bodyGid(nLocal);
+    std::vector<int> clusterGid(nLocal);
+    std::vector<double> offset(3 * nLocal);
+#pragma omp parallel for
+    for (int i = 0; i < nLocal; i++) {
+        const auto &sy = sylinderContainer[i];
+        const auto &anchor = sylinderNearDataDirectory.dataToFind[i];
+        bodyGid[i] = sy.gid;
+        clusterGid[i] = sy.clusterGid;
+        for (int k = 0; k < 3; k++) {
+            double trg = sy.pos[k];
+            double xk = anchor.pos[k];
+            // the anchor image closest to this sylinder, clusters must be shorter than half of the box
+            if (runConfig.simBoxPBC[k]) {
+                findPBCImage(runConfig.simBoxLow[k], runConfig.simBoxHigh[k], xk, trg);
+            }
+            offset[3 * i + k] = trg - xk;
+        }
+    }
+
+    rigidClusterOperatorRcp = Teuchos::rcp(new RigidClusterOperator(mobilityMatrixRcp, bodyGid, clusterGid, offset));
+    spdlog::debug("Rigid cluster number {}", rigidClusterOperatorRcp->getClusterNumberGlobal());
 }
 
 void SylinderSystem::calcVelocityNonCon() {
@@ -758,9 +1393,36 @@ void SylinderSystem::calcVelocityNonCon() {
                 velNBPtr(6 * i + 4, 0) = 0; // omegay
             }
         }
+        if (runConfig.rigidCluster) {
+            rigidClusterOperatorRcp->projectVelocity(*velocityPartNonBrownRcp);
+        }
         velocityNonConRcp->update(1.0, *velocityPartNonBrownRcp, 1.0);
     }
 
+    if (runConfig.shearRate != 0) {
+        // Lees-Edwards shear flow u = shearRate * (y - yc) ex, zero at the box center
+        // rotation = vorticity/2 + Jeffery rotation with Bretherton parameter of the spherocylinder aspect ratio
+        const double rate = runConfig.shearRate;
+        const double yc = 0.5 * (runConfig.simBoxLow[1] + runConfig.simBoxHigh[1]);
+        Emat3 strain = Emat3::Zero();
+        strain(0, 1) = strain(1, 0) = 0.5 * rate;
+#pragma omp parallel for
+        for (int i = 0; i < nLocal; i++) {
+            const auto &sy = sylinderContainer[i];
+            if (sy.isFrozen) {
+                continue; // a frozen sylinder moves only with the velocity set by runStepSubcycle()
+            }
+            const Evec3 direction = ECmapq(sy.orientation) * Evec3(0, 0, 1);
+            const double aspect = (sy.length + 2 * sy.radius) / (2 * sy.radius);
+            const double bretherton = (aspect * aspect - 1) / (aspect * aspect + 1);
+            const Evec3 omega = Evec3(0, 0, -0.5 * rate) + bretherton * direction.cross(strain * direction);
+            velNCPtr(6 * i + 0, 0) += rate * (sy.pos[1] - yc);
+            for (int k = 0; k < 3; k++) {
+                velNCPtr(6 * i + 3 + k, 0) += omega[k];
+            }
+        }
+    }
+
         // write back total non Brownian velocity
         // combine and sync the velNonB set in by setForceNonBrown() and setVelocityNonBrown()
 #pragma omp parallel for
@@ -786,6 +1448,19 @@ void SylinderSystem::calcVelocityNonCon() {
                 velBPtr(6 * i + 4, 0) = 0; // omegay
             }
         }
+        if (runConfig.rigidCluster) {
+            // a rigid cluster moves with the Brownian velocity of its cluster mobility
+            rigidClusterOperatorRcp->projectVelocity(*velocityBrownRcp);
+            auto velBPtr = velocityBrownRcp->getLocalView<Kokkos::HostSpace>();
+#pragma omp parallel for
+            for (int i = 0; i < nLocal; i++) {
+                auto &sy = sylinderContainer[i];
+                for (int k = 0; k < 3; k++) {
+                    sy.velBrown[k] = velBPtr(6 * i + k, 0);
+                    sy.omegaBrown[k] = velBPtr(6 * i + 3 + k, 0);
+                }
+            }
+        }
         velocityNonConRcp->update(1.0, *velocityBrownRcp, 1.0);
     }
 }
@@ -806,9 +1481,18 @@ void SylinderSystem::sumForceVelocity() {
 
 void SylinderSystem::stepEuler() {
     const int nLocal = sylinderContainer.getNumberOfParticleLocal();
-    const double dt = runConfig.dt;
+    const double dt = stepDt;
 
     if (!runConfig.sylinderFixed) {
+        // the offsets are known after prepareStep(), not when stepping a restart snapshot
+        if (runConfig.rigidCluster && !rigidClusterOperatorRcp.is_null()) {
+#pragma omp parallel for
+            for (int i = 0; i < nLocal; i++) {
+                auto &sy = sylinderContainer[i];
+                sy.stepEulerRigid(dt, rigidClusterOperatorRcp->getOffset(i));
+            }
+            return;
+        }
 #pragma omp parallel for
         for (int i = 0; i < nLocal; i++) {
             auto &sy = sylinderContainer[i];
@@ -822,30 +1506,47 @@ void SylinderSystem::resolveConstraints() {
     Teuchos::RCP<Teuchos::Time> collectColTimer = Teuchos::TimeMonitor::getNewCounter("SylinderSystem::CollectCollision");
     Teuchos::RCP<Teuchos::Time> collectLinkTimer = Teuchos::TimeMonitor::getNewCounter("SylinderSystem::CollectLink");
 
+    // pair collisions are collected by collectPairCollision() before this
     spdlog::debug("start collect collisions");
     {
         Teuchos::TimeMonitor mon(*collectColTimer);
-        collectPairCollision();
+        TraceScope trace("SylinderSystem::CollectCollision");
         collectBoundaryCollision();
     }
 
     spdlog::debug("start collect links");
     {
         Teuchos::TimeMonitor mon(*collectLinkTimer);
+        TraceScope trace("SylinderSystem::CollectLink");
         collectLinkBilateral();
     }
 
+    solveConstraints();
+}
+
+void SylinderSystem::solveConstraints() {
     // solve collision
     // positive buffer value means collision radius is effectively smaller
     // i.e., less likely to collide
     Teuchos::RCP<Teuchos::Time> solveTimer = Teuchos::TimeMonitor::getNewCounter("SylinderSystem::SolveConstraints");
     {
         Teuchos::TimeMonitor mon(*solveTimer);
+        TraceScope trace("SylinderSystem::SolveConstraints");
         const double buffer = 0;
         spdlog::debug("constraint solver setup");
-        conSolverPtr->setup(*conCollectorPtr, mobilityOperatorRcp, velocityNonConRcp, runConfig.dt);
+        if (runConfig.reproducible) {
+            conCollectorPtr->sortCanonical();
+        }
+        conSolverPtr->setScreenMargin(runConfig.conScreenMargin);
+        conSolverPtr->setReproducible(runConfig.reproducible);
+        conSolverPtr->setRecycleSize(runConfig.conRecycleSize);
+        conSolverPtr->setup(*conCollectorPtr, mobilityOperatorRcp, velocityNonConRcp, stepDt);
         spdlog::debug("setControl");
         conSolverPtr->setControlParams(runConfig.conResTol, runConfig.conMaxIte, runConfig.conSolverChoice);
+        conSolverPtr->setBilateralChoice(runConfig.conBilateralChoice);
+        conSolverPtr->setChainPreconditioner(runConfig.conChainPrecond);
+        conSolverPtr->setAMGPreconditioner(runConfig.conAMGPrecond);
+        conSolverPtr->setSchwarzCoarse(runConfig.conSchwarzCoarse);
         spdlog::debug("solveConstraints");
         conSolverPtr->solveConstraints();
         spdlog::debug("writebackGamma");
@@ -873,23 +1574,67 @@ bool SylinderSystem::getIfWriteResultCurrentStep() { return (stepCount % static_
 
 void SylinderSystem::prepareStep() {
     spdlog::warn("CurrentStep {}", stepCount);
+    if (runConfig.traceSteps > 0 && stepCount == runConfig.traceStart && !Trace::instance().isEnabled()) {
+        Trace::instance().enable();
+    }
+    TraceScope trace("SylinderSystem::PrepareStep", "SimToolbox", stepCount);
+
+    stepDt = runConfig.dt;
+    subStep = -1;
     applyBoxBC();
 
     if (stepCount % 50 == 0) {
+        TraceScope traceDecomp("SylinderSystem::DecomposeDomain");
         decomposeDomain();
     }
 
-    exchangeSylinder();
+    {
+        TraceScope traceExchange("SylinderSystem::ExchangeSylinder");
+        exchangeSylinder();
+    }
 
     const int nLocal = sylinderContainer.getNumberOfParticleLocal();
 #pragma omp parallel for
     for (int i = 0; i < nLocal; i++) {
         auto &sy = sylinderContainer[i];
         sy.clear();
-        sy.radiusCollision = sylinderContainer[i].radius * runConfig.sylinderDiameterColRatio;
-        sy.lengthCollision = sylinderContainer[i].length * runConfig.sylinderLengthColRatio;
+        if (sy.shape >= 0) {
+            // the collision sylinder of a shape is its bounding spherocylinder, for tree search and boundaries
+            (*shapeTablePtr)[sy.shape].getBoundingCapsule(sy.radiusCollision, sy.lengthCollision);
+        } else {
+            sy.radiusCollision = sylinderContainer[i].radius * runConfig.sylinderDiameterColRatio;
+            sy.lengthCollision = sylinderContainer[i].length * runConfig.sylinderLengthColRatio;
+        }
         sy.rank = commRcp->getRank();
+        if (runConfig.rigidCluster) {
+            const auto it = linkClusterAnchor.find(sy.gid);
+            sy.clusterGid = it == linkClusterAnchor.end() ? sy.gid : it->second;
+        }
         sy.colBuf = runConfig.sylinderColBuf;
+        sy.radiusSearch = 0;
+        for (const auto &pot : runConfig.pairPotentialPtr) {
+            sy.radiusSearch = std::max(sy.radiusSearch, pot->getCutoff(sy.radius, sy.radius));
+        }
+        sy.isSubcycled = false;
+        if (runConfig.subcycleNumber > 1 && !sy.isImmovable) {
+            double dragPara = 0, dragPerp = 0, dragRot = 0;
+            sy.calcDragCoeff(runConfig.viscosity, dragPara, dragPerp, dragRot);
+            const double dispBrown = sqrt(2 * runConfig.KBT * runConfig.dt / std::min(dragPara, dragPerp));
+            sy.isSubcycled = dispBrown > runConfig.subcycleDiffusion * sy.radius ||
+                             std::count(runConfig.subcycleGroups.begin(), runConfig.subcycleGroups.end(), sy.group);
+        }
+        sy.isFrozen = sy.isSubcycled; // the slow bin is resolved first
+    }
+
+    if (runConfig.subcycleNumber > 1) {
+        int nFast = 0;
+        for (int i = 0; i < nLocal; i++) {
+            nFast += sylinderContainer[i].isSubcycled;
+        }
+        int nFastGlobal = 0;
+        MPI_Allreduce(&nFast, &nFastGlobal, 1, MPI_INT, MPI_SUM, MPI_COMM_WORLD);
+        subcycleActive = nFastGlobal > 0;
+        spdlog::info("Subcycled sylinder number {}", nFastGlobal);
     }
 
     if (runConfig.monolayer) {
@@ -907,16 +1652,21 @@ void SylinderSystem::prepareStep() {
 
     updateSylinderMap();
 
-    buildSylinderNearDataDirectory();
+    {
+        TraceScope traceZDD("SylinderSystem::BuildSylinderNearDataDirectory");
+        buildSylinderNearDataDirectory();
+    }
 
     calcMobOperator();
 
-    conCollectorPtr->clear();
+    conCollectorPtr->clear(needConstraintOutput());
 
     forcePartNonBrownRcp.reset();
     velocityPartNonBrownRcp.reset();
     velocityNonBrownRcp.reset();
     velocityBrownRcp.reset();
+
+    sampleMemory("PrepareStep");
 }
 
 void SylinderSystem::setForceNonBrown(const std::vector<double> &forceNonBrown) {
@@ -933,27 +1683,230 @@ void SylinderSystem::setVelocityNonBrown(const std::vector<double> &velNonBrown)
     velocityPartNonBrownRcp = getTVFromVector(velNonBrown, commRcp);
 }
 
+bool SylinderSystem::needConstraintOutput() {
+    // output-only constraint data is needed for snapshots, for calcConStress(), and gid for sortCanonical()
+    // and the recycle space of bilateral CG
+    return runConfig.reproducible || runConfig.conRecycleSize > 0 || getIfWriteResultCurrentStep() ||
+           runConfig.logLevel <= spdlog::level::info;
+}
+
 void SylinderSystem::runStep(bool count_flag) {
 
-    if (runConfig.KBT > 0) {
-        calcVelocityBrown();
+    if (subcycleActive) {
+        runStepSubcycle(count_flag);
+    } else {
+        resolveStep();
+        writeStepResult(count_flag);
+        TraceScope trace("SylinderSystem::StepEuler");
+        stepEuler();
+    }
+
+    if (count_flag)
+        stepCount++;
+
+    if (count_flag && Trace::instance().isEnabled() && stepCount == runConfig.traceStart + runConfig.traceSteps) {
+        Trace::instance().disable();
+        Trace::instance().dump("./result/Trace_" + std::to_string(runConfig.traceStart) + ".json");
+        spdlog::warn("Trace written for steps {} to {}", runConfig.traceStart, stepCount - 1);
     }
+}
 
-    calcVelocityNonCon();
+void SylinderSystem::resolveStep() {
+    // soft pair forces are added to forcePartNonBrown, before computing velocityNonCon
+    collectPairCollision();
+    sampleMemory("CollectPair");
 
-    resolveConstraints();
+    // Brownian velocity, boundary and link constraints
+    runStepTaskGraph();
+
+    {
+        TraceScope trace("SylinderSystem::CalcVelocityNonCon");
+        calcVelocityNonCon();
+    }
+
+    solveConstraints();
+    sampleMemory("ResolveConstraints");
 
     sumForceVelocity();
+}
 
+void SylinderSystem::writeStepResult(bool count_flag) {
     if (getIfWriteResultCurrentStep() && count_flag) {
         // write result before moving. guarantee data written is consistent to geometry
+        TraceScope trace("SylinderSystem::WriteResult");
         writeResult();
+        sampleMemory("WriteResult", true);
     }
 
-    stepEuler();
+    if (runConfig.memReport && getIfWriteResultCurrentStep()) {
+        memTracker.report();
+        // the FDPS pool holds the tree arrays, growth after the first steps means mallocs in every tree build
+        double poolLocal[3] = {1.0 * PS::MemoryPool::getPeakSize(), 1.0 * PS::MemoryPool::getCapacity(),
+                               1.0 * PS::MemoryPool::getNMalloc()};
+        double poolMax[3] = {0, 0, 0};
+        MPI_Allreduce(poolLocal, poolMax, 3, MPI_DOUBLE, MPI_MAX, MPI_COMM_WORLD);
+        spdlog::info("RECORD: MEM FDPS MemoryPool peak max {:.1f} MB, capacity max {:.1f} MB, mallocs max {:g}",
+                     poolMax[0] / (1024 * 1024), poolMax[1] / (1024 * 1024), poolMax[2]);
+    } else if (!runConfig.memReport) {
+        memTracker.clearPhase();
+    }
+}
 
-    if (count_flag)
-        stepCount++;
+void SylinderSystem::runStepSubcycle(bool count_flag) {
+    TraceScope trace("SylinderSystem::RunStepSubcycle");
+    const int nLocal = sylinderContainer.getNumberOfParticleLocal();
+    const int nSub = runConfig.subcycleNumber;
+
+    // the inputs of setForceNonBrown() and setVelocityNonBrown() are rates, reused by every substep
+    Teuchos::RCP<TV> forceInputRcp;
+    Teuchos::RCP<TV> velocityInputRcp;
+    if (!forcePartNonBrownRcp.is_null()) {
+        forceInputRcp = Teuchos::rcp(new TV(*forcePartNonBrownRcp, Teuchos::Copy));
+    }
+    if (!velocityPartNonBrownRcp.is_null()) {
+        velocityInputRcp = Teuchos::rcp(new TV(*velocityPartNonBrownRcp, Teuchos::Copy));
+    }
+
+    // 1. the slow bin over the whole step, the fast bin is frozen by prepareStep()
+    resolveStep();
+    std::vector<Sylinder> slowState(nLocal);
+#pragma omp parallel for
+    for (int i = 0; i < nLocal; i++) {
+        slowState[i] = sylinderContainer[i];
+    }
+
+    // 2. the fast bin with substeps, the slow bin moves with its velocity as a prescribed motion
+    stepDt = runConfig.dt / nSub;
+    for (subStep = 0; subStep < nSub; subStep++) {
+        // positions moved by the last substep, wrapped as in prepareStep(). sylinders are not reordered
+        applyBoxBC();
+#pragma omp parallel for
+        for (int i = 0; i < nLocal; i++) {
+            auto &sy = sylinderContainer[i];
+            sy.isFrozen = !sy.isSubcycled;
+        }
+        buildSylinderNearDataDirectory();
+        calcMobOperator();
+        conCollectorPtr->clear(needConstraintOutput());
+
+        std::vector<double> velocityPart(6 * nLocal, 0.0);
+        if (!velocityInputRcp.is_null()) {
+            auto velPtr = velocityInputRcp->getLocalView<Kokkos::HostSpace>();
+#pragma omp parallel for
+            for (int k = 0; k < 6 * nLocal; k++) {
+                velocityPart[k] = velPtr(k, 0);
+            }
+        }
+#pragma omp parallel for
+        for (int i = 0; i < nLocal; i++) {
+            if (sylinderContainer[i].isFrozen) {
+                for (int k = 0; k < 3; k++) {
+                    velocityPart[6 * i + k] = slowState[i].vel[k];
+                    velocityPart[6 * i + 3 + k] = slowState[i].omega[k];
+                }
+            }
+        }
+        velocityPartNonBrownRcp = getTVFromVector(velocityPart, commRcp);
+        forcePartNonBrownRcp.reset();
+        if (!forceInputRcp.is_null()) {
+            forcePartNonBrownRcp = Teuchos::rcp(new TV(*forceInputRcp, Teuchos::Copy));
+        }
+        velocityNonBrownRcp.reset();
+        velocityBrownRcp.reset();
+
+        resolveStep();
+
+        if (subStep == 0) {
+            // nothing has moved, the slow bin keeps the results of its own step for output
+#pragma omp parallel for
+            for (int i = 0; i < nLocal; i++) {
+                auto &sy = sylinderContainer[i];
+                if (sy.isFrozen) {
+                    sy = slowState[i];
+                    sy.isFrozen = true;
+                }
+            }
+            writeStepResult(count_flag);
+        }
+
+        TraceScope traceEuler("SylinderSystem::StepEuler");
+        stepEuler();
+    }
+
+    stepDt = runConfig.dt;
+    subStep = -1;
+#pragma omp parallel for
+    for (int i = 0; i < nLocal; i++) {
+        sylinderContainer[i].isFrozen = false;
+    }
+}
+
+void SylinderSystem::runStepTaskGraph() {
+    Teuchos::RCP<Teuchos::Time> graphTimer = Teuchos::TimeMonitor::getNewCounter("SylinderSystem::StepTaskGraph");
+    Teuchos::TimeMonitor mon(*graphTimer);
+    TraceScope trace("SylinderSystem::StepTaskGraph");
+
+    const int nLocal = sylinderContainer.getNumberOfParticleLocal();
+    const int nBoundary = runConfig.boundaryPtr.size();
+    auto &conPool = *(conCollectorPtr->constraintPoolPtr);
+    const int nThreads = conPool.size();
+    if (nThreads != omp_get_max_threads()) {
+        spdlog::critical("conPool multithread mismatch error");
+        std::exit(1);
+    }
+
+    // separate pools so that the order of constraints does not depend on the scheduling of nodes
+    ConstraintBlockPool boundaryPool(nThreads);
+    ConstraintBlockPool linkPool(nThreads);
+    for (int t = 0; t < nThreads; t++) {
+        boundaryPool[t].setRecordOutput(conPool[t].hasOutput());
+        linkPool[t].setRecordOutput(conPool[t].hasOutput());
+    }
+
+    const int chunk = 256;
+    TaskGraph graph;
+    if (runConfig.KBT > 0) {
+        graph.addLoop("VelocityBrown", nLocal, chunk,
+                      [&](int begin, int end, int threadId) {
+                          for (int i = begin; i < end; i++) {
+                              calcVelocityBrownSylinder(i, threadId);
+                          }
+                      });
+    }
+    const int boundaryNode =
+        graph.addLoop("BoundaryCollision", nBoundary * nLocal, chunk, [&](int begin, int end, int threadId) {
+            for (int k = begin; k < end; k++) {
+                const auto &boundary = *(runConfig.boundaryPtr[k / nLocal]);
+                collectBoundaryCollisionSylinder(k % nLocal, boundary, boundaryPool[threadId]);
+            }
+        });
+    const int findNode = graph.addMaster("FindLinkData", [&]() { findLinkData(); });
+    const int linkNode = graph.addLoop(
+        "LinkBilateral", nLocal, chunk,
+        [&](int begin, int end, int threadId) {
+            for (int i = begin; i < end; i++) {
+                collectLinkBilateralSylinder(i, linkPool[threadId]);
+            }
+        },
+        {findNode});
+    graph.addLoop(
+        "MergeConstraint", nThreads, 1,
+        [&](int begin, int end, int threadId) {
+            for (int t = begin; t < end; t++) {
+                conPool[t].append(boundaryPool[t]);
+                conPool[t].append(linkPool[t]);
+            }
+        },
+        {boundaryNode, linkNode});
+
+    graph.run(runConfig.stepTaskGraph);
+
+    if (runConfig.KBT > 0) {
+        setVelocityBrownFromSylinder();
+    }
+
+    spdlog::debug("StepTaskGraph overlap {} wall {:g} s, idle thread fraction {:.3f}", runConfig.stepTaskGraph,
+                  graph.getWallTime(), graph.getIdleFraction());
 }
 
 void SylinderSystem::saveForceVelocityConstraints() {
@@ -1007,57 +1960,115 @@ void SylinderSystem::saveForceVelocityConstraints() {
 
 void SylinderSystem::calcVelocityBrown() {
     const int nLocal = sylinderContainer.getNumberOfParticleLocal();
-    const double Pi = 3.1415926535897932384626433;
-    const double mu = runConfig.viscosity;
-    const double dt = runConfig.dt;
-    const double delta = dt * 0.1; // a small parameter used in RFD algorithm
-    const double kBT = runConfig.KBT;
-    const double kBTfactor = sqrt(2 * kBT / dt);
-
 #pragma omp parallel
     {
         const int threadId = omp_get_thread_num();
 #pragma omp for
         for (int i = 0; i < nLocal; i++) {
-            auto &sy = sylinderContainer[i];
-            // constants
-            double dragPara = 0;
-            double dragPerp = 0;
-            double dragRot = 0;
-            sy.calcDragCoeff(mu, dragPara, dragPerp, dragRot);
-            const double dragParaInv = sy.isImmovable ? 0.0 : 1 / dragPara;
-            const double dragPerpInv = sy.isImmovable ? 0.0 : 1 / dragPerp;
-            const double dragRotInv = sy.isImmovable ? 0.0 : 1 / dragRot;
-
-            // convert FDPS vec3 to Evec3
-            Evec3 direction = Emapq(sy.orientation) * Evec3(0, 0, 1);
+            calcVelocityBrownSylinder(i, threadId);
+        }
+    }
 
-            // RFD from Delong, JCP, 2015
-            // slender fiber has 0 rot drag, regularize with identity rot mobility
-            // trans mobility is this
-            Evec3 q = direction;
-            Emat3 Nmat = (dragParaInv - dragPerpInv) * (q * q.transpose()) + (dragPerpInv)*Emat3::Identity();
-            Emat3 Nmatsqrt = Nmat.llt().matrixL();
+    setVelocityBrownFromSylinder();
+}
 
-            // velocity
-            Evec3 Wrot(rngPoolPtr->getN01(threadId), rngPoolPtr->getN01(threadId), rngPoolPtr->getN01(threadId));
-            Evec3 Wpos(rngPoolPtr->getN01(threadId), rngPoolPtr->getN01(threadId), rngPoolPtr->getN01(threadId));
-            Evec3 Wrfdrot(rngPoolPtr->getN01(threadId), rngPoolPtr->getN01(threadId), rngPoolPtr->getN01(threadId));
-            Evec3 Wrfdpos(rngPoolPtr->getN01(threadId), rngPoolPtr->getN01(threadId), rngPoolPtr->getN01(threadId));
+void SylinderSystem::calcVelocityBrownSylinder(const int i, const int threadId) {
+    const double mu = runConfig.viscosity;
+    const double dt = stepDt;
+    const double delta = dt * 0.1; // a small parameter used in RFD algorithm
+    const double kBT = runConfig.KBT;
+    const double kBTfactor = sqrt(2 * kBT / dt);
 
-            Equatn orientRFD = Emapq(sy.orientation);
-            EquatnHelper::rotateEquatn(orientRFD, Wrfdrot, delta);
-            q = orientRFD * Evec3(0, 0, 1);
-            Emat3 Nmatrfd = (dragParaInv - dragPerpInv) * (q * q.transpose()) + (dragPerpInv)*Emat3::Identity();
+    auto &sy = sylinderContainer[i];
+    // constants
+    double dragPara = 0;
+    double dragPerp = 0;
+    double dragRot = 0;
+    sy.calcDragCoeff(mu, dragPara, dragPerp, dragRot);
+    const bool immovable = sy.isImmovable || sy.isFrozen;
+    const double dragParaInv = immovable ? 0.0 : 1 / dragPara;
+    const double dragPerpInv = immovable ? 0.0 : 1 / dragPerp;
+    const double dragRotInv = immovable ? 0.0 : 1 / dragRot;
+
+    // convert FDPS vec3 to Evec3
+    Evec3 direction = Emapq(sy.orientation) * Evec3(0, 0, 1);
+
+    // RFD from Delong, JCP, 2015
+    // slender fiber has 0 rot drag, regularize with identity rot mobility
+    // trans mobility is this
+    Evec3 q = direction;
+    Emat3 Nmat = (dragParaInv - dragPerpInv) * (q * q.transpose()) + (dragPerpInv)*Emat3::Identity();
+    Emat3 Nmatsqrt = Nmat.llt().matrixL();
+
+    // velocity
+    double W[12];
+    if (runConfig.reproducible || runConfig.stepTaskGraph) {
+        // the noise is keyed by gid, step and substep, independent of the thread, rank and task scheduling
+        const CounterRng rng(restartRngSeed);
+        const uint64_t counter = 24 * static_cast<uint64_t>(stepCount) + (static_cast<uint64_t>(subStep + 1) << 48);
+        for (int k = 0; k < 12; k++) {
+            W[k] = rng.getN01(sy.gid, counter + 2 * k); // getN01 consumes 2 counters
+        }
+    } else {
+        for (int k = 0; k < 12; k++) {
+            W[k] = rngPoolPtr->getN01(threadId);
+        }
+    }
+    Evec3 Wrot(W[0], W[1], W[2]);
+    Evec3 Wpos(W[3], W[4], W[5]);
+    Evec3 Wrfdrot(W[6], W[7], W[8]);
+    Evec3 Wrfdpos(W[9], W[10], W[11]);
+
+    Equatn orientRFD = Emapq(sy.orientation);
+    EquatnHelper::rotateEquatn(orientRFD, Wrfdrot, delta);
+    q = orientRFD * Evec3(0, 0, 1);
+    Emat3 Nmatrfd = (dragParaInv - dragPerpInv) * (q * q.transpose()) + (dragPerpInv)*Emat3::Identity();
+
+    if (!runConfig.wallMobility) {
+        Evec3 vel = kBTfactor * (Nmatsqrt * Wpos);           // Gaussian noise
+        vel += (kBT / delta) * ((Nmatrfd - Nmat) * Wrfdpos); // rfd drift. seems no effect in this case
+        Evec3 omega = sqrt(dragRotInv) * kBTfactor * Wrot;   // regularized identity rotation drag
+
+        Emap3(sy.velBrown) = vel;
+        Emap3(sy.omegaBrown) = omega;
+        return;
+    }
 
-            Evec3 vel = kBTfactor * (Nmatsqrt * Wpos);           // Gaussian noise
-            vel += (kBT / delta) * ((Nmatrfd - Nmat) * Wrfdpos); // rfd drift. seems no effect in this case
-            Evec3 omega = sqrt(dragRotInv) * kBTfactor * Wrot;   // regularized identity rotation drag
+    // near-wall mobility F^{1/2} N F^{1/2}, with the square root F^{1/2} N^{1/2}
+    // it depends on the position, so rfd also along a small displacement
+    const Evec3 center = ECmap3(sy.pos);
+    const double deltaPos = 1e-4 * sy.radius;
+    Emat3 transSqrt, rotSqrt, transSqrtrfd, rotSqrtrfd, transSqrtPosrfd, rotSqrtPosrfd;
+    calcWallFactor(sy, center, direction, transSqrt, rotSqrt);
+    calcWallFactor(sy, center, q, transSqrtrfd, rotSqrtrfd);
+    calcWallFactor(sy, center + deltaPos * Wrfdpos, direction, transSqrtPosrfd, rotSqrtPosrfd);
+    const Emat3 Mmat = transSqrt * Nmat * transSqrt;
+    const Emat3 Mmatrfd = transSqrtrfd * Nmatrfd * transSqrtrfd;
+    const Emat3 MmatPosrfd = transSqrtPosrfd * Nmat * transSqrtPosrfd;
+
+    Evec3 vel = kBTfactor * (transSqrt * (Nmatsqrt * Wpos));       // Gaussian noise
+    vel += (kBT / delta) * ((Mmatrfd - Mmat) * Wrfdpos);           // rfd drift of orientation
+    vel += (kBT / deltaPos) * ((MmatPosrfd - Mmat) * Wrfdpos);     // rfd drift of position
+    Evec3 omega = sqrt(dragRotInv) * kBTfactor * (rotSqrt * Wrot); // wall factor of the identity rotation drag
+
+    Emap3(sy.velBrown) = vel;
+    Emap3(sy.omegaBrown) = omega;
+}
 
-            Emap3(sy.velBrown) = vel;
-            Emap3(sy.omegaBrown) = omega;
-        }
+void SylinderSystem::calcWallFactor(const Sylinder &sy, const Evec3 &center, const Evec3 &direction,
+                                    Emat3 &transSqrt, Emat3 &rotSqrt) const {
+    // the same geometry as calcDragCoeff()
+    if (sy.isSphere()) {
+        WallMobility::getFactorSqrt(runConfig.boundaryPtr, center, direction, 0, 0.5 * sy.length + sy.radius,
+                                    transSqrt, rotSqrt);
+    } else {
+        WallMobility::getFactorSqrt(runConfig.boundaryPtr, center, direction, sy.length, sy.radius, transSqrt,
+                                    rotSqrt);
     }
+}
+
+void SylinderSystem::setVelocityBrownFromSylinder() {
+    const int nLocal = sylinderContainer.getNumberOfParticleLocal();
 
     velocityBrownRcp = Teuchos::rcp<TV>(new TV(sylinderMobilityMapRcp, true));
     auto velocityPtr = velocityBrownRcp->getLocalView<Kokkos::HostSpace>();
@@ -1091,57 +2102,101 @@ void SylinderSystem::collectBoundaryCollision() {
             auto &que = (*collisionPoolPtr)[threadId];
 #pragma omp for
             for (int i = 0; i < nLocal; i++) {
-                const auto &sy = sylinderContainer[i];
-                const Evec3 center = ECmap3(sy.pos);
-
-                // check one point
-                auto checkEnd = [&](const Evec3 &Query, const double radius) {
-                    double Proj[3], delta[3];
-                    bPtr->project(Query.data(), Proj, delta);
-                    // if (!bPtr->check(Query.data(), Proj, delta)) {
-                    //     printf("boundary projection error\n");
-                    // }
-                    // if inside boundary, delta = Q-Proj
-                    // if outside boundary, delta = Proj-Q
-                    double deltanorm = Emap3(delta).norm();
-                    Evec3 norm = Emap3(delta) * (1 / deltanorm);
-                    Evec3 posI = Query - center;
-
-                    if ((Query - ECmap3(Proj)).dot(ECmap3(delta)) < 0) { // outside boundary
-                        que.emplace_back(-deltanorm - radius, 0, sy.gid, sy.gid, sy.globalIndex, sy.globalIndex, norm.data(), norm.data(),
-                                         posI.data(), posI.data(), Query.data(), Proj, true, false, 0.0, 0.0);
-                    } else if (deltanorm < (1 + runConfig.sylinderColBuf * 2) * sy.radiusCollision) { // inside boundary but close
-                        que.emplace_back(deltanorm - radius, 0, sy.gid, sy.gid, sy.globalIndex, sy.globalIndex, norm.data(), norm.data(),
-                                         posI.data(), posI.data(), Query.data(), Proj, true, false, 0.0, 0.0);
-                    }
-                };
-
-                if (sy.isSphere(true)) {
-                    double radius = sy.lengthCollision * 0.5 + sy.radiusCollision;
-                    checkEnd(center, radius);
-                } else {
-                    const Equatn orientation = ECmapq(sy.orientation);
-                    const Evec3 direction = orientation * Evec3(0, 0, 1);
-                    const double length = sy.lengthCollision;
-                    const Evec3 Qm = center - direction * (length * 0.5);
-                    const Evec3 Qp = center + direction * (length * 0.5);
-                    checkEnd(Qm, sy.radiusCollision);
-                    checkEnd(Qp, sy.radiusCollision);
-                }
+                collectBoundaryCollisionSylinder(i, *bPtr, que);
             }
         }
     }
     return;
 }
 
+void SylinderSystem::collectBoundaryCollisionSylinder(const int i, const Boundary &boundary, ConstraintBlockQue &que) {
+    const auto &sy = sylinderContainer[i];
+    if (sy.isFrozen) {
+        return;
+    }
+    const Evec3 center = ECmap3(sy.pos);
+
+    // check one point
+    auto checkEnd = [&](const Evec3 &Query, const double radius) {
+        double Proj[3], delta[3];
+        boundary.project(Query.data(), Proj, delta);
+        // if (!boundary.check(Query.data(), Proj, delta)) {
+        //     printf("boundary projection error\n");
+        // }
+        // if inside boundary, delta = Q-Proj
+        // if outside boundary, delta = Proj-Q
+        double deltanorm = Emap3(delta).norm();
+        Evec3 norm = Emap3(delta) * (1 / deltanorm);
+        Evec3 posI = Query - center;
+
+        if ((Query - ECmap3(Proj)).dot(ECmap3(delta)) < 0) { // outside boundary
+            que.emplace_back(-deltanorm - radius, 0, sy.gid, sy.gid, sy.globalIndex, sy.globalIndex, norm.data(),
+                             norm.data(), posI.data(), posI.data(), Query.data(), Proj, true, false, 0.0, 0.0);
+        } else if (deltanorm < (1 + runConfig.sylinderColBuf * 2) * sy.radiusCollision) { // inside boundary but close
+            que.emplace_back(deltanorm - radius, 0, sy.gid, sy.gid, sy.globalIndex, sy.globalIndex, norm.data(),
+                             norm.data(), posI.data(), posI.data(), Query.data(), Proj, true, false, 0.0, 0.0);
+        }
+    };
+
+    if (sy.isSphere(true)) {
+        double radius = sy.lengthCollision * 0.5 + sy.radiusCollision;
+        checkEnd(center, radius);
+    } else {
+        const Equatn orientation = ECmapq(sy.orientation);
+        const Evec3 direction = orientation * Evec3(0, 0, 1);
+        const double length = sy.lengthCollision;
+        const Evec3 Qm = center - direction * (length * 0.5);
+        const Evec3 Qp = center + direction * (length * 0.5);
+        checkEnd(Qm, sy.radiusCollision);
+        checkEnd(Qp, sy.radiusCollision);
+    }
+}
+
 void SylinderSystem::collectPairCollision() {
+    Teuchos::RCP<Teuchos::Time> collectPairTimer =
+        Teuchos::TimeMonitor::getNewCounter("SylinderSystem::CollectPairCollision");
+    Teuchos::TimeMonitor mon(*collectPairTimer);
+    TraceScope trace("SylinderSystem::CollectPairCollision");
 
     CalcSylinderNearForce calcColFtr(conCollectorPtr->constraintPoolPtr);
+    calcColFtr.pairPot = runConfig.pairPotentialPtr;
+    calcColFtr.contact = runConfig.contactCompliance;
+    calcColFtr.dt = stepDt;
+    calcColFtr.shapeTablePtr = shapeTablePtr;
 
     TEUCHOS_ASSERT(treeSylinderNearPtr);
     const int nLocal = sylinderContainer.getNumberOfParticleLocal();
+    if (runConfig.shearRate != 0) {
+        addLeesEdwardsImage();
+        calcColFtr.shearBoxLow = runConfig.simBoxLow[1];
+        calcColFtr.shearBoxHigh = runConfig.simBoxHigh[1];
+        calcColFtr.shearStepDx =
+            runConfig.shearRate * (runConfig.simBoxHigh[1] - runConfig.simBoxLow[1]) * stepDt;
+    }
     setTreeSylinder();
     treeSylinderNearPtr->calcForceAll(calcColFtr, sylinderContainer, dinfo);
+    sylinderContainer.setNumberOfParticleLocal(nLocal); // remove Lees-Edwards images
+
+    if (runConfig.pairPotentialPtr.empty()) {
+        return;
+    }
+
+    // add soft pair forces to forcePartNonBrown
+    std::vector<double> forcePair(6 * nLocal);
+#pragma omp parallel for
+    for (int i = 0; i < nLocal; i++) {
+        const auto forceNear = treeSylinderNearPtr->getForce(i); // same order as sylinderContainer
+        for (int k = 0; k < 3; k++) {
+            forcePair[6 * i + k] = forceNear.forceNear[k];
+            forcePair[6 * i + 3 + k] = forceNear.torqueNear[k];
+        }
+    }
+    Teuchos::RCP<TV> forcePairRcp = getTVFromVector(forcePair, commRcp);
+    if (forcePartNonBrownRcp.is_null()) {
+        forcePartNonBrownRcp = forcePairRcp;
+    } else {
+        forcePartNonBrownRcp->update(1.0, *forcePairRcp, 1.0);
+    }
 }
 
 std::pair<int, int> SylinderSystem::getMaxGid() {
@@ -1205,7 +2260,64 @@ void SylinderSystem::updateSylinderRank() {
     }
 }
 
-void SylinderSystem::applyBoxBC() { sylinderContainer.adjustPositionIntoRootDomain(dinfo); }
+void SylinderSystem::applyBoxBC() {
+    if (runConfig.shearRate != 0) {
+        const double offset = getShearOffset();
+        const int nLocal = sylinderContainer.getNumberOfParticleLocal();
+#pragma omp parallel for
+        for (int i = 0; i < nLocal; i++) {
+            findLEImage(runConfig.simBoxLow, runConfig.simBoxHigh, offset, sylinderContainer[i].pos);
+        }
+    }
+    sylinderContainer.adjustPositionIntoRootDomain(dinfo);
+}
+
+double SylinderSystem::getShearOffset() const {
+    const double Lx = runConfig.simBoxHigh[0] - runConfig.simBoxLow[0];
+    const double Ly = runConfig.simBoxHigh[1] - runConfig.simBoxLow[1];
+    return std::fmod(runConfig.shearRate * Ly * (stepCount * runConfig.dt + std::max(subStep, 0) * stepDt), Lx);
+}
+
+void SylinderSystem::addLeesEdwardsImage() {
+    const int nLocal = sylinderContainer.getNumberOfParticleLocal();
+    const double lowY = runConfig.simBoxLow[1];
+    const double highY = runConfig.simBoxHigh[1];
+    const double Ly = highY - lowY;
+    const double offset = getShearOffset();
+
+    // FDPS finds pairs within the larger search radius of the two, so images within the global max are enough
+    double rSearchLocal = 0;
+    for (int i = 0; i < nLocal; i++) {
+        SylinderNearEP ep;
+        ep.copyFromFP(sylinderContainer[i]);
+        rSearchLocal = std::max(rSearchLocal, ep.getRSearch());
+    }
+    double rSearch = rSearchLocal;
+    Teuchos::reduceAll(*commRcp, Teuchos::MaxValueReductionOp<int, double>(), 1, &rSearchLocal, &rSearch);
+    if (2 * rSearch > Ly) {
+        spdlog::critical("box y length {:g} too small for Lees-Edwards images with search radius {:g}", Ly, rSearch);
+        std::exit(1);
+    }
+
+    // the image of a sylinder close to the low bound is above the box, displaced by +offset, and vice versa
+    std::vector<Sylinder> image;
+    for (int i = 0; i < nLocal; i++) {
+        const auto &sy = sylinderContainer[i];
+        for (int shift : {-1, 1}) {
+            const bool close = shift > 0 ? sy.pos[1] - lowY < rSearch : highY - sy.pos[1] <= rSearch;
+            if (!close)
+                continue;
+            image.push_back(sy);
+            auto &syImage = image.back();
+            syImage.pos[1] += shift * Ly;
+            syImage.pos[0] += shift * offset;
+            findPBCImage(runConfig.simBoxLow[0], runConfig.simBoxHigh[0], syImage.pos[0]);
+        }
+    }
+    for (const auto &sy : image) {
+        sylinderContainer.addOneParticle(sy);
+    }
+}
 
 void SylinderSystem::calcConStress() {
     if (runConfig.logLevel > spdlog::level::info)
@@ -1213,7 +2325,11 @@ void SylinderSystem::calcConStress() {
 
     Emat3 sumBiStress = Emat3::Zero();
     Emat3 sumUniStress = Emat3::Zero();
-    conCollectorPtr->sumLocalConstraintStress(sumUniStress, sumBiStress, false);
+    if (runConfig.reproducible) {
+        conCollectorPtr->sumConstraintStressReproducible(sumUniStress, sumBiStress, false); // already global
+    } else {
+        conCollectorPtr->sumLocalConstraintStress(sumUniStress, sumBiStress, false);
+    }
 
     // scale to nkBT
     const double scaleFactor = 1 / (sylinderMapRcp->getGlobalNumElements() * runConfig.KBT);
@@ -1233,8 +2349,13 @@ void SylinderSystem::calcConStress() {
         }
     }
 
-    Teuchos::reduceAll(*commRcp, Teuchos::SumValueReductionOp<int, double>(), 9, uniStressLocal, uniStressGlobal);
-    Teuchos::reduceAll(*commRcp, Teuchos::SumValueReductionOp<int, double>(), 9, biStressLocal, biStressGlobal);
+    if (runConfig.reproducible) {
+        std::copy(uniStressLocal, uniStressLocal + 9, uniStressGlobal);
+        std::copy(biStressLocal, biStressLocal + 9, biStressGlobal);
+    } else {
+        Teuchos::reduceAll(*commRcp, Teuchos::SumValueReductionOp<int, double>(), 9, uniStressLocal, uniStressGlobal);
+        Teuchos::reduceAll(*commRcp, Teuchos::SumValueReductionOp<int, double>(), 9, biStressLocal, biStressGlobal);
+    }
 
     spdlog::info("RECORD: ColXF,{:g},{:g},{:g},{:g},{:g},{:g},{:g},{:g},{:g}", //
                  uniStressGlobal[0], uniStressGlobal[1], uniStressGlobal[2],   //
@@ -1328,6 +2449,7 @@ std::vector<int> SylinderSystem::addNewSylinder(const std::vector<Sylinder> &new
     for (int i = 0; i < newCountLocal; i++) {
         Sylinder sy = newSylinder[i];
         sy.gid = newGidRecv[i];
+        checkShape(sy);
         sylinderContainer.addOneParticle(sy);
     }
 
@@ -1347,8 +2469,52 @@ void SylinderSystem::addNewLink(const std::vector<Link> &newLink) {
 
     // put newLinks into the map, same op on all mpi ranks
     for (const auto &ll : newLinkRecv) {
-        linkMap.emplace(ll.prev, ll.next);
-        linkReverseMap.emplace(ll.next, ll.prev);
+        addLink(ll);
+    }
+    updateLinkCluster();
+}
+
+void SylinderSystem::addLink(const Link &link) {
+    if (!runConfig.linkerModel.isValidType(link.type)) {
+        spdlog::critical("link {} {} type {} has no linker model", link.prev, link.next, link.type);
+        std::exit(1);
+    }
+    linkMap.emplace(link.prev, link.next);
+    linkReverseMap.emplace(link.next, link.prev);
+    if (link.type != 0) {
+        linkTypeMap[linkKey(link.prev, link.next)] = link.type;
+    }
+}
+
+void SylinderSystem::updateLinkCluster() {
+    // union-find over all links, the root of each cluster is its min gid
+    std::unordered_map<int, int> parent;
+    auto findRoot = [&](int gid) {
+        auto it = parent.find(gid);
+        if (it == parent.end()) {
+            parent[gid] = gid;
+            return gid;
+        }
+        int root = gid;
+        while (parent[root] != root) {
+            root = parent[root];
+        }
+        while (parent[gid] != root) { // path compression
+            const int next = parent[gid];
+            parent[gid] = root;
+            gid = next;
+        }
+        return root;
+    };
+    for (const auto &key_value : linkMap) {
+        const int rootPrev = findRoot(key_value.first);
+        const int rootNext = findRoot(key_value.second);
+        parent[std::max(rootPrev, rootNext)] = std::min(rootPrev, rootNext);
+    }
+
+    linkClusterAnchor.clear();
+    for (const auto &gid_parent : parent) {
+        linkClusterAnchor[gid_parent.first] = findRoot(gid_parent.first);
     }
 }
 
@@ -1378,147 +2544,171 @@ void SylinderSystem::collectLinkBilateral() {
         std::exit(1);
     }
 
+    findLinkData();
+
+#pragma omp parallel
+    {
+        const int threadId = omp_get_thread_num();
+        auto &conQue = conPool[threadId];
+#pragma omp for
+        for (int i = 0; i < nLocal; i++) {
+            collectLinkBilateralSylinder(i, conQue);
+        }
+    }
+}
+
+void SylinderSystem::findLinkData() {
+    const int nLocal = sylinderContainer.getNumberOfParticleLocal();
+
     // fill the data to find
     auto &gidToFind = sylinderNearDataDirectoryPtr->gidToFind;
-    const auto &dataToFind = sylinderNearDataDirectoryPtr->dataToFind;
 
-    std::vector<int> gidDisp(nLocal + 1, 0);
+    linkGidDisp.assign(nLocal + 1, 0);
     gidToFind.clear();
     gidToFind.reserve(nLocal);
+    linkGidType.clear();
 
     // loop over all sylinders
     // if linkMap[sy.gid] not empty, find info for all next
     for (int i = 0; i < nLocal; i++) {
         const auto &sy = sylinderContainer[i];
+        if (runConfig.rigidCluster) { // links are inside rigid clusters, not constraints
+            linkGidDisp[i + 1] = linkGidDisp[i];
+            continue;
+        }
         const auto &range = linkMap.equal_range(sy.gid);
         int count = 0;
         for (auto it = range.first; it != range.second; it++) {
             gidToFind.push_back(it->second); // next
+            const auto type = linkTypeMap.find(linkKey(sy.gid, it->second));
+            linkGidType.push_back(type == linkTypeMap.end() ? 0 : type->second);
             count++;
         }
-        gidDisp[i + 1] = gidDisp[i] + count; // number of links for each local Sylinder
+        linkGidDisp[i + 1] = linkGidDisp[i] + count; // number of links for each local Sylinder
     }
 
     sylinderNearDataDirectoryPtr->find();
+}
 
-#pragma omp parallel
-    {
-        const int threadId = omp_get_thread_num();
-        auto &conQue = conPool[threadId];
-#pragma omp for
-        for (int i = 0; i < nLocal; i++) {
-            const auto &syI = sylinderContainer[i]; // sylinder
-            const int lb = gidDisp[i];
-            const int ub = gidDisp[i + 1];
+void SylinderSystem::collectLinkBilateralSylinder(const int i, ConstraintBlockQue &que) {
+    const auto &syI = sylinderContainer[i]; // sylinder
+    const int lb = linkGidDisp[i];
+    const int ub = linkGidDisp[i + 1];
+    const auto &linkerModel = runConfig.linkerModel;
 
-            for (int j = lb; j < ub; j++) {
-                const auto &syJ = sylinderNearDataDirectoryPtr->dataToFind[j]; // sylinderNear
+    // minimum image by rounding, period 0 for non-periodic axes and axes handled by Lees-Edwards
+    double period[3], invPeriod[3];
+    for (int k = 0; k < 3; k++) {
+        const bool pbc = runConfig.simBoxPBC[k] && !(runConfig.shearRate != 0 && k < 2);
+        period[k] = pbc ? runConfig.simBoxHigh[k] - runConfig.simBoxLow[k] : 0;
+        invPeriod[k] = pbc ? 1 / period[k] : 0;
+    }
 
-                const Evec3 &centerI = ECmap3(syI.pos);
-                Evec3 centerJ = ECmap3(syJ.pos);
-                // apply PBC on centerJ
-                for (int k = 0; k < 3; k++) {
-                    if (!runConfig.simBoxPBC[k])
-                        continue;
-                    double trg = centerI[k];
-                    double xk = centerJ[k];
-                    findPBCImage(runConfig.simBoxLow[k], runConfig.simBoxHigh[k], xk, trg);
-                    centerJ[k] = xk;
-                    // error check
-                    if (fabs(trg - xk) > 0.5 * (runConfig.simBoxHigh[k] - runConfig.simBoxLow[k])) {
-                        spdlog::critical("pbc image error in bilateral links");
-                        std::exit(1);
-                    }
-                }
-                
-                //dmr518, hardcoding primary linker parameters and position, 20220624
-                // sylinders are not treated as spheres for bilateral constraints
-                // constraint is always added between Pp and Qm
-                // constraint target length is radiusI + radiusJ + runConfig.linkGap
-                
-                // see 20220601 presentation for these definitions
-                const double d1 = 0.01; // um
-                const double l0_1 = 0.01; // um
-                const double k1 = 500; // pN/um
-                
-                const Evec3 directionI = ECmapq(syI.orientation) * Evec3(0, 0, 1);
-                const Evec3 Pp = centerI + directionI * (0.5 * syI.length - d1); // plus end
-                const Evec3 directionJ = ECmap3(syJ.direction);
-                const Evec3 Qm = centerJ - directionJ * (0.5 * syJ.length - d1);
-                const Evec3 Ploc = Pp;
-                const Evec3 Qloc = Qm;
-                const Evec3 rvec = Qloc - Ploc;
-                const double rnorm = rvec.norm();
-                //const double delta0 = rnorm - syI.radius - syJ.radius - runConfig.linkGap;
-                const double delta0 = rnorm - syI.radius - syJ.radius - l0_1;
-                const double gamma = delta0 < 0 ? -delta0 : 0;
-                const Evec3 normI = (Ploc - Qloc).normalized();
-                const Evec3 normJ = -normI;
-                const Evec3 posI = Ploc - centerI;
-                const Evec3 posJ = Qloc - centerJ;
-                ConstraintBlock conBlock(delta0, gamma,              // current separation, initial guess of gamma
-                                         syI.gid, syJ.gid,           //
-                                         syI.globalIndex,            //
-                                         syJ.globalIndex,            //
-                                         normI.data(), normJ.data(), // direction of collision force
-                                         posI.data(), posJ.data(), // location of collision relative to particle center
-                                         Ploc.data(), Qloc.data(), // location of collision in lab frame
-                                         false, true, k1, 0.0);
-                Emat3 stressIJ;
-                CalcSylinderNearForce::collideStress(directionI, directionJ, centerI, centerJ, syI.length, syJ.length, syI.radius,
-                                                     syJ.radius, 1.0, Ploc, Qloc, stressIJ);
-                conBlock.setStress(stressIJ);
-                conQue.push_back(conBlock);
-                
-                
-                
-                // dmr518, adding in secondary linkers with hardcoded parameters and position, 20220624
-                // adding an secondary bilateral constraint for semiflexbile filaments
-                // sylinders are not treated as spheres for bilateral constraints
-                // constraint is always added between Pp and Qm
-                // constraint target length is radiusI + radiusJ + runConfig.linkGap
-                
-                // see 20220601 presentation for these definitions
-                const double d2 = 0.1465; // um
-                const double l0_2 = 0.323; // um
-                const double k2 = 92; // pN/um
-                
-                //const Evec3 directionI = ECmapq(syI.orientation) * Evec3(0, 0, 1);
-                const Evec3 Pp_secondary = centerI + directionI * (0.5 * syI.length - d2); // plus end
-                //const Evec3 directionJ = ECmap3(syJ.direction);
-                const Evec3 Qm_secondary = centerJ - directionJ * (0.5 * syJ.length - d2);
-                const Evec3 Ploc_secondary = Pp_secondary;
-                const Evec3 Qloc_secondary = Qm_secondary;
-                const Evec3 rvec_secondary = Qloc_secondary - Ploc_secondary;
-                const double rnorm_secondary = rvec_secondary.norm();
-                //const double delta0_secondary = rnorm_secondary - syI.radius - syJ.radius - runConfig.linkGap;
-                const double delta0_secondary = rnorm_secondary - syI.radius - syJ.radius - l0_2;
-                const double gamma_secondary = delta0_secondary < 0 ? -delta0_secondary : 0;
-                const Evec3 normI_secondary = (Ploc_secondary - Qloc_secondary).normalized();
-                const Evec3 normJ_secondary = -normI_secondary;
-                const Evec3 posI_secondary = Ploc_secondary - centerI;
-                const Evec3 posJ_secondary = Qloc_secondary - centerJ;
-                ConstraintBlock conBlock_secondary(delta0_secondary, gamma_secondary,              // current separation, initial guess of gamma
-                                         syI.gid, syJ.gid,           //
-                                         syI.globalIndex,            //
-                                         syJ.globalIndex,            //
-                                         normI_secondary.data(), normJ_secondary.data(), // direction of collision force
-                                         posI_secondary.data(), posJ_secondary.data(), // location of collision relative to particle center
-                                         Ploc_secondary.data(), Qloc_secondary.data(), // location of collision in lab frame
-                                         false, true, k2, 0.0);
-                Emat3 stressIJ_secondary;
-                CalcSylinderNearForce::collideStress(directionI, directionJ, centerI, centerJ, syI.length, syJ.length,
-                                                     syI.radius, syJ.radius, 1.0, Ploc_secondary, Qloc_secondary, stressIJ_secondary);
-                conBlock_secondary.setStress(stressIJ_secondary);
-                conQue.push_back(conBlock_secondary);
-            }
+    const Evec3 &centerI = ECmap3(syI.pos);
+    const Evec3 directionI = ECmapq(syI.orientation) * Evec3(0, 0, 1);
+    for (int j = lb; j < ub; j++) {
+        const auto &syJ = sylinderNearDataDirectoryPtr->dataToFind[j]; // sylinderNear
+        if (syI.isFrozen && syJ.isFrozen) {
+            continue;
+        }
+
+        Evec3 centerJ = ECmap3(syJ.pos);
+        // apply Lees-Edwards boundary on centerJ in x and y
+        // the image of J moves with an extra velocity shift * shearRate * Ly along x, added to delta0 over one step
+        double imageStepDx = 0;
+        if (runConfig.shearRate != 0) {
+            const int shift = findLEImage(runConfig.simBoxLow, runConfig.simBoxHigh, getShearOffset(), centerJ.data(),
+                                          centerI.data());
+            const double Ly = runConfig.simBoxHigh[1] - runConfig.simBoxLow[1];
+            imageStepDx = shift * runConfig.shearRate * Ly * stepDt;
+        }
+        // apply PBC on centerJ, the image closest to centerI
+        for (int k = 0; k < 3; k++) {
+            centerJ[k] -= period[k] * std::nearbyint((centerJ[k] - centerI[k]) * invPeriod[k]);
+        }
+
+        // sylinders are not treated as spheres for bilateral constraints
+        // constraints are added between anchors near the plus end of I and the minus end of J
+        const Evec3 directionJ = ECmap3(syJ.direction);
+        const int type = linkGidType[j];
+        for (auto a = linkerModel.begin(type); a != linkerModel.end(type); a++) {
+            const Evec3 Ploc = centerI + directionI * (0.5 * syI.length - a->offsetI);
+            const Evec3 Qloc = centerJ - directionJ * (0.5 * syJ.length - a->offsetJ);
+            const Evec3 rvec = Qloc - Ploc;
+            const double rnorm = rvec.norm();
+            const Evec3 normI = (Ploc - Qloc).normalized();
+            const Evec3 normJ = -normI;
+            const double delta0 = rnorm - syI.radius - syJ.radius - a->restLength + imageStepDx * normJ[0];
+            const double gamma = delta0 < 0 ? -delta0 : 0;
+            const Evec3 posI = Ploc - centerI;
+            const Evec3 posJ = Qloc - centerJ;
+            ConstraintBlock conBlock(delta0, gamma,              // current separation, initial guess of gamma
+                                     syI.gid, syJ.gid,           //
+                                     syI.globalIndex,            //
+                                     syJ.globalIndex,            //
+                                     normI.data(), normJ.data(), // direction of collision force
+                                     posI.data(), posJ.data(),   // location of collision relative to particle center
+                                     Ploc.data(), Qloc.data(),   // location of collision in lab frame
+                                     false, true, std::max(a->kappa, 0.0), 0.0);
+            Emat3 stressIJ;
+            CalcSylinderNearForce::collideStress(directionI, directionJ, centerI, centerJ, syI.length, syJ.length,
+                                                 syI.radius, syJ.radius, 1.0, Ploc, Qloc, stressIJ);
+            conBlock.setStress(stressIJ);
+            que.push_back(conBlock);
         }
     }
 }
 
 void SylinderSystem::printTimingSummary(const bool zeroOut) {
-    if (runConfig.timerLevel <= spdlog::level::info)
-        Teuchos::TimeMonitor::summarize();
+    // timers accumulate over the steps in between
+    if (stepCount % runConfig.logInterval != 0)
+        return;
+    Logger::aggregate(); // collective
+    if (runConfig.timerLevel <= spdlog::level::info) {
+        if (runConfig.logAsync) {
+            // local timers of each rank, not collective, written to a file per rank by the logging thread
+            std::ostringstream timerStream;
+            const Teuchos::SerialComm<int> selfComm;
+            Teuchos::TimeMonitor::summarize(Teuchos::ptrInArg(selfComm), timerStream);
+            const std::string name = "./result/Timer_r" + std::to_string(commRcp->getRank()) + ".txt";
+            Logger::get_rank_file_logger("timer", name)->info("CurrentStep {}\n{}", stepCount, timerStream.str());
+        } else {
+            Teuchos::TimeMonitor::summarize(); // collective
+        }
+    }
     if (zeroOut)
         Teuchos::TimeMonitor::zeroOutTimers();
-}
\ No newline at end of file
+}
+
+void SylinderSystem::sampleMemory(const std::string &phase, bool output) {
+    if (!runConfig.memReport && runConfig.memSoftLimitMB <= 0) {
+        return;
+    }
+    memTracker.setSoftLimit(runConfig.memSoftLimitMB * 1024 * 1024);
+
+    memTracker.set("SylinderContainer", sylinderContainer.getMemSizeUsed());
+    memTracker.set("TreeSylinderNear", treeSylinderNearPtr ? treeSylinderNearPtr->getMemSizeUsed() : 0);
+    memTracker.set("ConstraintPool", conCollectorPtr->getLocalMemoryBytes());
+    memTracker.set("ConstraintMatrix", conSolverPtr->getMatrixBytes());
+
+    size_t vecBytes = conSolverPtr->getVectorBytes();
+    for (const auto &vecRcp : {forcePartNonBrownRcp, velocityPartNonBrownRcp, velocityNonBrownRcp, velocityBrownRcp,
+                               velocityNonConRcp}) {
+        vecBytes += vecRcp.is_null() ? 0 : getTMVBytes(*vecRcp);
+    }
+    memTracker.set("SolverVector", vecBytes);
+    memTracker.set("MobilityMatrix", mobilityMatrixRcp.is_null() ? 0 : getTCMATBytes(*mobilityMatrixRcp));
+    memTracker.set("DataDirectory", sylinderNearDataDirectoryPtr ? sylinderNearDataDirectoryPtr->getMemoryBytes() : 0);
+
+    size_t outputBytes = 0;
+    if (output) {
+        // writeParticleAscii() gathers all sylinders into a buffer allocated on every rank
+        // the VTP arrays take about 330 bytes per sylinder, doubled by the base64 encoded copy
+        const size_t nGlobal = sylinderContainer.getNumberOfParticleGlobal();
+        const size_t nLocal = sylinderContainer.getNumberOfParticleLocal();
+        outputBytes = std::max(nGlobal * sizeof(Sylinder), 2 * 330 * nLocal + conCollectorPtr->getLocalMemoryBytes());
+    }
+    memTracker.set("OutputBuffer", outputBytes);
+
+    memTracker.endPhase(phase);
+}
@@ -11,6 +11,7 @@
 #ifndef SYLINDERSYSTEM_HPP_
 #define SYLINDERSYSTEM_HPP_
 
+#include "RigidClusterOperator.hpp"
 #include "Sylinder.hpp"
 #include "SylinderConfig.hpp"
 #include "SylinderNear.hpp"
@@ -20,9 +21,14 @@
 #include "FDPS/particle_simulator.hpp"
 #include "Trilinos/TpetraUtil.hpp"
 #include "Trilinos/ZDD.hpp"
+#include "Trilinos/ZGeomPartitioner.hpp"
+#include "Trilinos/ZGraphPartitioner.hpp"
+#include "Util/MemoryTracker.hpp"
+#include "Util/TaskGraph.hpp"
 #include "Util/TRngPool.hpp"
 
 #include <unordered_map>
+#include <unordered_set>
 
 /**
  * @brief A collection of sylinders distributed to multiple MPI ranks.
@@ -33,11 +39,65 @@ class SylinderSystem {
     int snapID;                  ///< the current id of the snapshot file to be saved. sequentially numbered from 0
     int stepCount;               ///< timestep Count. sequentially numbered from 0
     unsigned int restartRngSeed; ///< parallel seed used by restarted simulations
+    double stepDt = 0;           ///< size of the current step, runConfig.dt except in substeps
+    int subStep = -1;            ///< index of the current substep of the fast bin, -1 outside substeps
+    bool subcycleActive = false; ///< some sylinders on some rank are in the fast bin at this step
 
     // FDPS stuff
     PS::DomainInfo dinfo; ///< domain size, boundary condition, and decomposition info
     void setDomainInfo();
 
+    // Zoltan geometric partition, replacing FDPS multisection if runConfig.domainDecompChoice > 0
+    std::shared_ptr<ZGeomPartitioner> geomPartitionerPtr; ///< null for FDPS multisection
+    void setGeomPartitioner();
+
+    /**
+     * @brief set the domain of each rank in dinfo from the last Zoltan partition
+     *
+     * RCB uses the cut boxes, HSFC uses the bounding box of local particles on each rank, see calcLocalDomainBox()
+     */
+    void setDomainFromGeomPartitioner();
+
+    /**
+     * @brief bounding box of the centers of local sylinders
+     *
+     * On periodic axes it is the shortest interval with an image of each center, and may extend past the root
+     * domain. FDPS checks all periodic images of each domain.
+     * @param low
+     * @param high
+     */
+    void calcLocalDomainBox(double low[3], double high[3]) const;
+
+    // Zoltan PHG refinement of the geometric partition, if runConfig.domainLinkRefine
+    std::shared_ptr<ZGraphPartitioner> graphPartitionerPtr; ///< null if off
+    std::unordered_set<int> refinedGid; ///< local sylinders moved off their geometric part by refineDomainByLink()
+
+    /**
+     * @brief move sylinders between ranks to cut fewer links, keeping the load balanced
+     *
+     * The graph has one vertex per sylinder and one edge per link.
+     * Sylinders moved by the refinement stay on their new ranks until the next decomposeDomain(),
+     * the others follow the geometric cuts in exchangeSylinder(). Domains are particle bounding boxes.
+     */
+    void refineDomainByLink();
+
+    /**
+     * @brief find the linked sylinders of each local sylinder and their ranks with the data directory
+     *
+     * @param edgeDisp offset of the links of each local sylinder
+     * @param edgeGid gid of linked sylinders, both prev and next
+     * @param edgeRank rank of linked sylinders
+     * @return int number of local links with a sylinder on another rank
+     */
+    int findLinkEdge(std::vector<int> &edgeDisp, std::vector<int> &edgeGid, std::vector<int> &edgeRank);
+
+    /**
+     * @brief move local sylinders to the given ranks, replacing FDPS exchangeParticle() for Zoltan partitions
+     *
+     * @param destRank destination rank of each local sylinder
+     */
+    void migrateSylinder(std::vector<int> &destRank);
+
     PS::ParticleSystem<Sylinder> sylinderContainer;        ///< sylinders
     std::unique_ptr<TreeSylinderNear> treeSylinderNearPtr; ///< short range interaction of sylinders
     int treeSylinderNumber;                                ///< the current max_glb number of treeSylinderNear
@@ -45,6 +105,14 @@ class SylinderSystem {
 
     std::unordered_multimap<int, int> linkMap;        ///< links prev,next
     std::unordered_multimap<int, int> linkReverseMap; ///< links next, prev
+    std::shared_ptr<std::vector<ConvexShape>> shapeTablePtr; ///< convex collision shapes, the same on all ranks
+    std::unordered_map<long long, int> linkTypeMap; ///< type of links prev,next with type != 0
+    std::vector<int> linkGidDisp; ///< offset of the links of each local sylinder in the ZDD find list
+    std::vector<int> linkGidType; ///< linker model type of each link in the ZDD find list
+    static long long linkKey(int prev, int next) { return (static_cast<long long>(prev) << 32) | unsigned(next); }
+    void addLink(const Link &link); ///< insert into linkMap, linkReverseMap and linkTypeMap
+    std::unordered_map<int, int> linkClusterAnchor; ///< min gid of the linked cluster of each linked sylinder
+    void updateLinkCluster(); ///< find the connected clusters of linkMap, the same on all ranks
 
     // Constraint stuff
     std::shared_ptr<ConstraintSolver> conSolverPtr;       ///< pointer to ConstraintSolver
@@ -68,10 +136,93 @@ class SylinderSystem {
     Teuchos::RCP<TMAP> sylinderMobilityMapRcp; ///< TMAP, contiguous and sequentially ordered 6 dofs per sylinder
     Teuchos::RCP<TCMAT> mobilityMatrixRcp;     ///< block-diagonal mobility matrix
     Teuchos::RCP<TOP> mobilityOperatorRcp;     ///< full mobility operator (matrix-free), to be implemented
+    Teuchos::RCP<RigidClusterOperator> rigidClusterOperatorRcp; ///< mobility of rigid clusters if rigidCluster
+    void calcRigidClusterOperator(); ///< needs buildSylinderNearDataDirectory(), collective
 
     // Data directory
     std::shared_ptr<ZDD<SylinderNearEP>> sylinderNearDataDirectoryPtr; ///< distributed data directory for sylinder data
 
+    // per-sylinder kernels shared by the fork-join phases and runStepTaskGraph()
+    void calcVelocityBrownSylinder(const int i, const int threadId); ///< write sy.velBrown/omegaBrown of sylinder i
+    void setVelocityBrownFromSylinder();                             ///< copy sy.velBrown/omegaBrown to velocityBrown
+    void collectBoundaryCollisionSylinder(const int i, const Boundary &boundary, ConstraintBlockQue &que);
+    void calcWallFactor(const Sylinder &sy, const Evec3 &center, const Evec3 &direction, Emat3 &transSqrt,
+                        Emat3 &rotSqrt) const; ///< WallMobility factors of sy at center and direction
+    void findLinkData(); ///< find the data of the next sylinder of all local links, collective
+    void collectLinkBilateralSylinder(const int i, ConstraintBlockQue &que); ///< needs findLinkData()
+
+    // Lees-Edwards boundary, flow along x and gradient along y
+    /**
+     * @brief x displacement of the image box at +y at the current step
+     *
+     * @return double shearRate * Ly * t, wrapped by Lx
+     */
+    double getShearOffset() const;
+
+    /**
+     * @brief append sliding images of sylinders close to the y bounds to sylinderContainer, collective
+     *
+     * y is not periodic for FDPS if runConfig.shearRate != 0, and the tree finds neighbors across the y bounds
+     * through these images. Images must be removed after the tree walk, before any other use of sylinderContainer.
+     */
+    void addLeesEdwardsImage();
+
+    /**
+     * @brief collect boundary and link constraints and generate Brownian velocity with a TaskGraph
+     *
+     * The ZDD find of link data runs on the master thread while the other threads work on
+     * Brownian velocity and boundary collisions.
+     * Constraints are collected into separate pools then appended to conCollector, boundary before link,
+     * same as resolveConstraints().
+     * If runConfig.stepTaskGraph is false, the same graph is executed as serial fork-join phases.
+     */
+    void runStepTaskGraph();
+
+    /**
+     * @brief compute the velocity of all movable sylinders at the current configuration, collective
+     *
+     * pair collisions, Brownian velocity, boundaries and links, then the constraint solve, with step size stepDt
+     */
+    void resolveStep();
+
+    /**
+     * @brief write the snapshot and the memory report of this step, before sylinders are moved
+     *
+     * @param count_flag
+     */
+    void writeStepResult(bool count_flag);
+
+    /**
+     * @brief multi-rate step, if runConfig.subcycleNumber > 1 and some sylinders are in the fast bin
+     *
+     * 1. the slow bin is resolved over runConfig.dt with the fast bin frozen at the beginning of the step
+     * 2. the fast bin takes subcycleNumber substeps, each resolved with the slow bin frozen and moving with
+     *    its velocity from 1, i.e., linearly interpolated over the step
+     * Constraints between two frozen sylinders are not collected.
+     * The snapshot is written after the first substep is resolved, before any sylinder moves.
+     * @param count_flag
+     */
+    void runStepSubcycle(bool count_flag);
+
+    /**
+     * @brief if the output-only data of constraints must be recorded in this step
+     *
+     * needed for snapshots, for calcConStress(), gid for sortCanonical() and the recycle space of bilateral CG
+     */
+    bool needConstraintOutput();
+
+    // memory accounting
+    MemoryTracker memTracker; ///< bytes of each subsystem, enabled by runConfig.memReport or memSoftLimitMB
+
+    /**
+     * @brief record the current bytes of each subsystem at the end of a phase
+     *
+     * no-op if neither runConfig.memReport nor runConfig.memSoftLimitMB is set
+     * @param phase
+     * @param output if output buffers are allocated in this phase
+     */
+    void sampleMemory(const std::string &phase, bool output = false);
+
     // internal utility functions
     /**
      * @brief generate initial configuration on rank 0 according to runConfig
@@ -79,6 +230,19 @@ class SylinderSystem {
      */
     void setInitialFromConfig();
 
+    /**
+     * @brief generate a nearly overlap-free initial configuration on all ranks according to runConfig
+     *
+     * initBox is split into slabs, each filled with a contiguous block of gids using a counter-based rng keyed by gid.
+     * The slabs depend only on runConfig and each rank fills a contiguous range of them,
+     * so the result does not depend on the number of ranks.
+     * Rods are placed by random sequential insertion on a cell grid with runConfig.initInsertTrial trials per rod,
+     * followed by at most runConfig.initRelaxIte soft-repulsion sweeps in each slab
+     * if some rods could not be inserted without overlap.
+     * Overlaps across slab boundaries are left to the initPreSteps collision resolution.
+     */
+    void setInitialFromConfigParallel();
+
     /**
      * @brief set initial configuration as given in the (.dat) file
      *
@@ -91,10 +255,26 @@ class SylinderSystem {
      * @brief set linkMap from the .dat file
      *
      * Every mpi rank run this simultaneously to set linkMap from the same file
+     * Each line is 'L prev next [type]', with type the linker model index, 0 by default
      * @param filename
      */
     void setLinkMapFromFile(const std::string &filename);
 
+    /**
+     * @brief set the convex shape table from the 'H index type parameters' lines of the .dat file
+     *
+     * Every mpi rank run this simultaneously to set the same table from the same file
+     * @param filename
+     */
+    void setShapeFromFile(const std::string &filename);
+
+    /**
+     * @brief exit if the shape index of sy is not in the shape table
+     *
+     * @param sy
+     */
+    void checkShape(const Sylinder &sy) const;
+
     /**
      * @brief set initial configuration as given in the (.dat) file
      *
@@ -249,6 +429,9 @@ class SylinderSystem {
      * @brief compute domain decomposition by sampling sylinder distribution
      *
      * domain decomposition must be triggered when particle distribution significantly changes
+     * if runConfig.domainDecompChoice > 0, Zoltan RCB/HSFC is used instead of sampling,
+     * with weight 1+length/diameter per sylinder, and sylinders are migrated to the new ranks
+     * if runConfig.domainLinkRefine, the Zoltan partition is then refined by refineDomainByLink()
      */
     void decomposeDomain();
 
@@ -256,6 +439,8 @@ class SylinderSystem {
      * @brief exchange between mpi ranks according to domain decomposition
      *
      * particle exchange must be triggered every timestep:
+     * with Zoltan, each sylinder goes to the owner of its position under the cuts of the last decomposeDomain(),
+     * except those in refinedGid
      */
     void exchangeSylinder();
 
@@ -282,6 +467,18 @@ class SylinderSystem {
     const std::unordered_multimap<int, int> &getLinkMap() { return linkMap; }
     const std::unordered_multimap<int, int> &getLinkReverseMap() { return linkReverseMap; }
 
+    /**
+     * @brief type of the link prev -> next, the index of its model in runConfig.linkerModel
+     *
+     * @param prev
+     * @param next
+     * @return int 0 if the link has type 0 or does not exist
+     */
+    int getLinkType(int prev, int next) const {
+        const auto it = linkTypeMap.find(linkKey(prev, next));
+        return it == linkTypeMap.end() ? 0 : it->second;
+    }
+
     /**
      * @brief Get the RngPoolPtr object
      *
@@ -331,7 +528,8 @@ class SylinderSystem {
 
     /**
      * @brief resolve collision with given nonBrownian motion and advance the system configuration
-     * 
+     *
+     * With runConfig.subcycleNumber > 1, sylinders in the fast bin are subcycled, see runStepSubcycle()
      * @param count_flag: add count step to index
      *
      */
@@ -384,6 +582,7 @@ class SylinderSystem {
     /**
      * @brief apply periodic boundary condition
      *
+     * with Lees-Edwards boundary, crossing the box in y also shifts x by getShearOffset()
      */
     void applyBoxBC();
 
@@ -400,7 +599,7 @@ class SylinderSystem {
      *
      * velocityNonCon = velocityBrown + velocityNonBrown + mobility * forceNonBrown
      * velocityNonBrown sums both the values set by setVelocityNonBrown() and directly written to
-     * sylinder[i].velNonB/omegaNonB
+     * sylinder[i].velNonB/omegaNonB, and the imposed Lees-Edwards shear flow
      * write back to sylinder.velNonB/omegaNonB
      */
     void calcVelocityNonCon();
@@ -438,11 +637,12 @@ class SylinderSystem {
     std::shared_ptr<ZDD<SylinderNearEP>> &getSylinderNearDataDirectory() { return sylinderNearDataDirectoryPtr; }
 
     // resolve constraints
-    void collectPairCollision();     ///< collect pair collision constraints
+    void collectPairCollision();     ///< collect pair collision constraints and soft pair forces
     void collectBoundaryCollision(); ///< collect boundary collision constraints
     void collectLinkBilateral();     ///< setup link constraints
 
     void resolveConstraints();           ///< resolve constraints
+    void solveConstraints();             ///< solve the collected constraints
     void saveForceVelocityConstraints(); ///< write back to sylinder.velCol and velBi
 
     void stepEuler(); ///< Euler step update position and orientation, with both collision and non-collision velocity
@@ -482,8 +682,10 @@ class SylinderSystem {
     std::pair<int, int> getMaxGid();
 
     /**
-     * @brief
+     * @brief print the timer summary and the warnings of all ranks, every runConfig.logInterval steps
      *
+     * If runConfig.logAsync, each rank writes its own timers to result/Timer_r{rank}.txt instead, without
+     * the collective summary.
      * @param zeroOut zero out all timing info after printing out
      */
     void printTimingSummary(const bool zeroOut = true);
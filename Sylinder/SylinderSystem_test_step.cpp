@@ -0,0 +1,442 @@
+/**
+ * @file SylinderSystem_test_step.cpp
+ * @brief This file tests the timestepping of SylinderSystem class
+ *
+ */
+#include "SylinderSystem.hpp"
+
+#include "Collision/DCPQuery.hpp"
+#include "MPI/CommMPI.hpp"
+#include "Util/Logger.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <map>
+#include <string>
+#include <vector>
+
+using SylinderState = std::map<int, std::vector<double>>; ///< gid -> values of each local sylinder
+
+/**
+ * @brief count local sylinders different from ref on all ranks, including sylinders missing from either one
+ *
+ * @param ref
+ * @param state
+ * @return int
+ */
+int countMismatch(const SylinderState &ref, const SylinderState &state) {
+    int nMismatch = ref.size() == state.size() ? 0 : 1;
+    for (const auto &s : state) {
+        const auto it = ref.find(s.first);
+        if (it == ref.end() || it->second != s.second) {
+            nMismatch++;
+        }
+    }
+    int nMismatchGlobal = 0;
+    MPI_Allreduce(&nMismatch, &nMismatchGlobal, 1, MPI_INT, MPI_SUM, MPI_COMM_WORLD);
+    return nMismatchGlobal;
+}
+
+/**
+ * @brief velBrown and omegaBrown of local sylinders after one step with the overlapped task graph
+ *
+ * @param runConfig
+ * @return SylinderState
+ */
+SylinderState getBrownOneStep(const SylinderConfig &runConfig) {
+    SylinderSystem sylinderSystem(runConfig, "posInitial.dat", 0, nullptr);
+    sylinderSystem.prepareStep();
+    sylinderSystem.runStep();
+
+    SylinderState state;
+    const auto &sylinderContainer = sylinderSystem.getContainer();
+    const int nLocal = sylinderContainer.getNumberOfParticleLocal();
+    for (int i = 0; i < nLocal; i++) {
+        const auto &sy = sylinderContainer[i];
+        state[sy.gid] = {sy.velBrown[0],   sy.velBrown[1],   sy.velBrown[2],
+                         sy.omegaBrown[0], sy.omegaBrown[1], sy.omegaBrown[2]};
+    }
+    return state;
+}
+
+/**
+ * @brief the Brownian noise does not depend on which thread runs which chunk of the task graph
+ *
+ * @param runConfig
+ * @return bool
+ */
+bool testBrownOverlap(SylinderConfig runConfig) {
+    runConfig.stepTaskGraph = true;
+    const auto state0 = getBrownOneStep(runConfig);
+    const auto state1 = getBrownOneStep(runConfig);
+    const int nMismatch = countMismatch(state0, state1);
+    spdlog::warn("Brownian velocity of two overlapped runs, {} mismatch", nMismatch);
+    return nMismatch == 0;
+}
+
+/**
+ * @brief pos and orientation of local sylinders after a few reproducible steps
+ *
+ * @param runConfig
+ * @return SylinderState
+ */
+SylinderState getPosSteps(SylinderConfig runConfig) {
+    runConfig.reproducible = true;
+    SylinderSystem sylinderSystem(runConfig, "posInitial.dat", 0, nullptr);
+    for (int i = 0; i < 5; i++) {
+        sylinderSystem.prepareStep();
+        sylinderSystem.runStep();
+    }
+
+    SylinderState state;
+    const auto &sylinderContainer = sylinderSystem.getContainer();
+    const int nLocal = sylinderContainer.getNumberOfParticleLocal();
+    for (int i = 0; i < nLocal; i++) {
+        const auto &sy = sylinderContainer[i];
+        state[sy.gid] = {sy.pos[0],         sy.pos[1],         sy.pos[2],        //
+                         sy.orientation[0], sy.orientation[1], sy.orientation[2], sy.orientation[3]};
+    }
+    return state;
+}
+
+/**
+ * @brief with an empty fast bin, subcycleNumber > 1 gives the same trajectory as subcycleNumber = 1
+ *
+ * @param runConfig
+ * @return bool
+ */
+bool testSubcycleOff(SylinderConfig runConfig) {
+    runConfig.subcycleNumber = 1;
+    const auto state0 = getPosSteps(runConfig);
+    runConfig.subcycleNumber = 4;
+    runConfig.subcycleDiffusion = 1e10;
+    runConfig.subcycleGroups.clear();
+    const auto state1 = getPosSteps(runConfig);
+    const int nMismatch = countMismatch(state0, state1);
+    spdlog::warn("Subcycle without fast sylinders, {} mismatch", nMismatch);
+    return nMismatch == 0;
+}
+
+/**
+ * @brief sylinders in the slow bin move with their own velocity over the substeps of the fast bin
+ *
+ * Even gids are in the fast bin. After one step, a slow sylinder moves by vel * dt up to rounding of the
+ * substeps, where vel is the velocity of the slow bin resolved over the whole step.
+ * @param runConfig
+ * @return bool
+ */
+bool testSubcycleFrozen(SylinderConfig runConfig) {
+    runConfig.subcycleNumber = 4;
+    runConfig.subcycleDiffusion = 1e10;
+    runConfig.subcycleGroups = {1};
+    SylinderSystem sylinderSystem(runConfig, "posInitial.dat", 0, nullptr);
+    auto &sylinderContainer = sylinderSystem.getContainerNonConst();
+    int nLocal = sylinderContainer.getNumberOfParticleLocal();
+    for (int i = 0; i < nLocal; i++) {
+        sylinderContainer[i].group = sylinderContainer[i].gid % 2 == 0 ? 1 : 0;
+    }
+
+    sylinderSystem.prepareStep();
+    nLocal = sylinderContainer.getNumberOfParticleLocal();
+    std::vector<double> posStart(3 * nLocal);
+    for (int i = 0; i < nLocal; i++) {
+        std::copy(sylinderContainer[i].pos, sylinderContainer[i].pos + 3, posStart.data() + 3 * i);
+    }
+    sylinderSystem.runStep();
+
+    // the container is not reordered within a step
+    int nError = 0;
+    int nSlow = 0;
+    for (int i = 0; i < nLocal; i++) {
+        const auto &sy = sylinderContainer[i];
+        if (sy.isSubcycled) {
+            continue;
+        }
+        nSlow++;
+        for (int k = 0; k < 3; k++) {
+            const double L = runConfig.simBoxHigh[k] - runConfig.simBoxLow[k];
+            double error = sy.pos[k] - posStart[3 * i + k] - sy.vel[k] * runConfig.dt;
+            if (runConfig.simBoxPBC[k]) {
+                error -= L * std::round(error / L);
+            }
+            nError += std::abs(error) > 1e-12 * L;
+        }
+    }
+    int count[2] = {nError, nSlow};
+    int countGlobal[2] = {0, 0};
+    MPI_Allreduce(count, countGlobal, 2, MPI_INT, MPI_SUM, MPI_COMM_WORLD);
+    spdlog::warn("Subcycle with {} slow sylinders, {} displacement errors", countGlobal[1], countGlobal[0]);
+    return countGlobal[0] == 0 && countGlobal[1] > 0;
+}
+
+/**
+ * @brief each link selects the linker model of its type, keyed by prev and next
+ *
+ * Rank 0 adds a chain a -> b -> c and a branch a -> d, with types 1, 0 and 2.
+ * @param runConfig
+ * @return bool
+ */
+bool testLinkType(SylinderConfig runConfig) {
+    runConfig.linkerModel.initialize(YAML::Load(R"(
+- attachments:
+    - {restLength: 0.01, kappa: 500}
+- attachments:
+    - {restLength: 0.01, kappa: 500}
+    - {restLength: 0.1, kappa: 50, offsetI: 0.1, offsetJ: 0.1}
+- attachments:
+    - {restLength: 0.2}
+)"));
+    SylinderSystem sylinderSystem(runConfig, "posInitial.dat", 0, nullptr);
+
+    int rank = 0;
+    MPI_Comm_rank(MPI_COMM_WORLD, &rank);
+    std::vector<Sylinder> newSylinder;
+    if (rank == 0) {
+        // parallel to z, side by side along x
+        const double radius = runConfig.sylinderDiameter / 2;
+        const double length = runConfig.sylinderLength;
+        for (int i = 0; i < 4; i++) {
+            const double pos[3] = {1 + 3 * radius * i, 1, 1};
+            newSylinder.emplace_back(i, radius, radius, length, length, pos);
+        }
+    }
+    std::vector<int> newGid = sylinderSystem.addNewSylinder(newSylinder);
+    newGid.resize(4);
+    MPI_Bcast(newGid.data(), 4, MPI_INT, 0, MPI_COMM_WORLD);
+
+    std::vector<Link> newLink;
+    if (rank == 0) {
+        newLink.resize(3);
+        newLink[0] = {newGid[0], newGid[1], 1};
+        newLink[1] = {newGid[1], newGid[2], 0};
+        newLink[2] = {newGid[0], newGid[3], 2};
+    }
+    sylinderSystem.addNewLink(newLink);
+    sylinderSystem.prepareStep();
+    sylinderSystem.runStep();
+
+    const bool pass = sylinderSystem.getLinkType(newGid[0], newGid[1]) == 1 &&
+                      sylinderSystem.getLinkType(newGid[1], newGid[2]) == 0 &&
+                      sylinderSystem.getLinkType(newGid[0], newGid[3]) == 2 &&
+                      sylinderSystem.getLinkType(newGid[1], newGid[0]) == 0; // the reverse is not a link
+    spdlog::warn("Link types {} {} {}", sylinderSystem.getLinkType(newGid[0], newGid[1]),
+                 sylinderSystem.getLinkType(newGid[1], newGid[2]), sylinderSystem.getLinkType(newGid[0], newGid[3]));
+    return pass;
+}
+
+/**
+ * @brief gather rows of width values from all ranks to rank 0, sorted by the first value of each row
+ *
+ * @param local rows of local sylinders, the first value of each row is the gid
+ * @param width number of values per row
+ * @return std::vector<double> sorted rows on rank 0, empty on other ranks
+ */
+std::vector<double> gatherSorted(const std::vector<double> &local, const int width) {
+    int rank = 0, nProcs = 1;
+    MPI_Comm_rank(MPI_COMM_WORLD, &rank);
+    MPI_Comm_size(MPI_COMM_WORLD, &nProcs);
+    const int nSend = local.size();
+    std::vector<int> nRecv(nProcs, 0);
+    MPI_Gather(&nSend, 1, MPI_INT, nRecv.data(), 1, MPI_INT, 0, MPI_COMM_WORLD);
+    std::vector<int> displ(nProcs, 0);
+    for (int r = 1; r < nProcs; r++) {
+        displ[r] = displ[r - 1] + nRecv[r - 1];
+    }
+    std::vector<double> all(rank == 0 ? displ.back() + nRecv.back() : 0);
+    MPI_Gatherv(local.data(), nSend, MPI_DOUBLE, all.data(), nRecv.data(), displ.data(), MPI_DOUBLE, 0,
+                MPI_COMM_WORLD);
+
+    const int nGlobal = all.size() / width;
+    std::vector<int> order(nGlobal);
+    for (int k = 0; k < nGlobal; k++) {
+        order[k] = k;
+    }
+    std::sort(order.begin(), order.end(), [&](int a, int b) { return all[width * a] < all[width * b]; });
+    std::vector<double> sorted;
+    sorted.reserve(all.size());
+    for (const int k : order) {
+        sorted.insert(sorted.end(), all.begin() + width * k, all.begin() + width * (k + 1));
+    }
+    return sorted;
+}
+
+/**
+ * @brief gid, pos, orientation of local sylinders, 8 values per sylinder
+ *
+ * @param sylinderSystem
+ * @return std::vector<double>
+ */
+std::vector<double> getPosRows(const SylinderSystem &sylinderSystem) {
+    const auto &sylinderContainer = sylinderSystem.getContainer();
+    const int nLocal = sylinderContainer.getNumberOfParticleLocal();
+    std::vector<double> local(8 * nLocal);
+    for (int i = 0; i < nLocal; i++) {
+        const auto &sy = sylinderContainer[i];
+        local[8 * i] = sy.gid;
+        std::copy(sy.pos, sy.pos + 3, local.data() + 8 * i + 1);
+        std::copy(sy.orientation, sy.orientation + 4, local.data() + 8 * i + 4);
+    }
+    return local;
+}
+
+/**
+ * @brief write sorted rows of 8 values as hex floats, on rank 0
+ *
+ * @param rows
+ * @param name
+ */
+void writeRows(const std::vector<double> &rows, const std::string &name) {
+    int rank = 0;
+    MPI_Comm_rank(MPI_COMM_WORLD, &rank);
+    if (rank != 0) {
+        return;
+    }
+    FILE *fp = fopen(name.c_str(), "w");
+    const int nGlobal = rows.size() / 8;
+    for (int k = 0; k < nGlobal; k++) {
+        for (int j = 0; j < 8; j++) {
+            fprintf(fp, "%a ", rows[8 * k + j]); // hex float, exact
+        }
+        fprintf(fp, "\n");
+    }
+    fclose(fp);
+}
+
+/**
+ * @brief run a few reproducible steps and write pos and orientation of all sylinders, sorted by gid
+ *
+ * The file Repro_<nProcs>.dat is compared bitwise for different numbers of ranks by the ctest command.
+ * @param runConfig
+ */
+void writeReproState(SylinderConfig runConfig) {
+    runConfig.reproducible = true;
+    SylinderSystem sylinderSystem(runConfig, "posInitial.dat", 0, nullptr);
+    for (int i = 0; i < 10; i++) {
+        sylinderSystem.prepareStep();
+        sylinderSystem.runStep();
+    }
+
+    int nProcs = 1;
+    MPI_Comm_size(MPI_COMM_WORLD, &nProcs);
+    writeRows(gatherSorted(getPosRows(sylinderSystem), 8), "Repro_" + std::to_string(nProcs) + ".dat");
+}
+
+/**
+ * @brief max overlap of all pairs of sorted rows, with the minimum image on periodic axes
+ *
+ * All sylinders have the same length and radius for collision in this test case.
+ * @param runConfig
+ * @param rows
+ * @return double
+ */
+double getMaxOverlap(const SylinderConfig &runConfig, const std::vector<double> &rows) {
+    const double radius = runConfig.sylinderDiameter / 2 * runConfig.sylinderDiameterColRatio;
+    const double length = runConfig.sylinderLength * runConfig.sylinderLengthColRatio;
+    const int nGlobal = rows.size() / 8;
+    std::vector<Evec3> center(nGlobal), direction(nGlobal);
+    for (int k = 0; k < nGlobal; k++) {
+        center[k] = Evec3(rows[8 * k + 1], rows[8 * k + 2], rows[8 * k + 3]);
+        direction[k] = ECmapq(rows.data() + 8 * k + 4) * Evec3(0, 0, 1);
+    }
+
+    DCPQuery<3, double, Evec3> DistSegSeg3;
+    double maxOverlap = 0;
+    for (int a = 0; a < nGlobal; a++) {
+        for (int b = a + 1; b < nGlobal; b++) {
+            Evec3 shift = Evec3::Zero();
+            for (int k = 0; k < 3; k++) {
+                if (runConfig.simBoxPBC[k]) {
+                    const double L = runConfig.simBoxHigh[k] - runConfig.simBoxLow[k];
+                    shift[k] = L * std::round((center[b][k] - center[a][k]) / L);
+                }
+            }
+            const Evec3 Pm = center[a] - 0.5 * length * direction[a];
+            const Evec3 Pp = center[a] + 0.5 * length * direction[a];
+            const Evec3 Qm = center[b] - shift - 0.5 * length * direction[b];
+            const Evec3 Qp = center[b] - shift + 0.5 * length * direction[b];
+            Evec3 Ploc, Qloc;
+            const double distance = DistSegSeg3(Pm, Pp, Qm, Qp, Ploc, Qloc);
+            maxOverlap = std::max(maxOverlap, 2 * radius - distance);
+        }
+    }
+    return maxOverlap;
+}
+
+/**
+ * @brief generate sylinders with setInitialFromConfigParallel and write pos and orientation, sorted by gid
+ *
+ * The global number and gids are checked, and every sylinder is inside initBox. The file Init_<nProcs>.dat is
+ * compared bitwise for different numbers of ranks by the ctest command. Overlaps across slab seams are left to
+ * initPreSteps, and are checked after those steps.
+ * @param runConfig
+ * @return bool
+ */
+bool testInitParallel(SylinderConfig runConfig) {
+    runConfig.initOverlapFree = true;
+    const int initPreSteps = runConfig.initPreSteps;
+    runConfig.initPreSteps = 0;
+
+    int rank = 0, nProcs = 1;
+    MPI_Comm_rank(MPI_COMM_WORLD, &rank);
+    MPI_Comm_size(MPI_COMM_WORLD, &nProcs);
+
+    std::vector<double> rows;
+    {
+        SylinderSystem sylinderSystem(runConfig, "posInitial.dat", 0, nullptr);
+        rows = gatherSorted(getPosRows(sylinderSystem), 8);
+    }
+    writeRows(rows, "Init_" + std::to_string(nProcs) + ".dat");
+
+    runConfig.initPreSteps = initPreSteps;
+    std::vector<double> rowsPreSteps;
+    {
+        SylinderSystem sylinderSystem(runConfig, "posInitial.dat", 0, nullptr);
+        rowsPreSteps = gatherSorted(getPosRows(sylinderSystem), 8);
+    }
+
+    int pass = 1;
+    if (rank == 0) {
+        const int nGlobal = rows.size() / 8;
+        int nGidError = nGlobal == runConfig.sylinderNumber ? 0 : 1;
+        int nOutside = 0;
+        for (int k = 0; k < nGlobal; k++) {
+            // sorted by gid, so unique gids covering [0, nGlobal) are exactly k
+            nGidError += rows[8 * k] != k;
+            for (int j = 0; j < 3; j++) {
+                const double x = rows[8 * k + 1 + j];
+                nOutside += x < runConfig.initBoxLow[j] || x > runConfig.initBoxHigh[j];
+            }
+        }
+        const double maxOverlap = getMaxOverlap(runConfig, rowsPreSteps);
+        spdlog::warn("Parallel init of {} sylinders, {} gid errors, {} outside initBox, max overlap {} after {} "
+                     "pre steps",
+                     nGlobal, nGidError, nOutside, maxOverlap, initPreSteps);
+        pass = nGidError == 0 && nOutside == 0 && maxOverlap < 1e-3 * runConfig.sylinderDiameter;
+    }
+    MPI_Bcast(&pass, 1, MPI_INT, 0, MPI_COMM_WORLD);
+    return pass;
+}
+
+int main(int argc, char **argv) {
+    MPI_Init(&argc, &argv);
+    Logger::setup_mpi_spdlog();
+
+    {
+        const SylinderConfig runConfig("RunConfig.yaml");
+        if (argc > 1 && std::strcmp(argv[1], "repro") == 0) {
+            writeReproState(runConfig);
+        } else if (argc > 1 && std::strcmp(argv[1], "init") == 0) {
+            spdlog::warn(testInitParallel(runConfig) ? "TestPassed" : "Error in parallel init test");
+        } else {
+            const bool pass = testBrownOverlap(runConfig) && testSubcycleOff(runConfig) &&
+                              testSubcycleFrozen(runConfig) && testLinkType(runConfig);
+            spdlog::warn(pass ? "TestPassed" : "Error in timestepping test");
+        }
+    }
+
+    MPI_Barrier(MPI_COMM_WORLD);
+    MPI_Finalize();
+    return 0;
+}
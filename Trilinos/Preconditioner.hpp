@@ -14,6 +14,12 @@
 
 #include "TpetraUtil.hpp"
 
+#ifdef SIMTOOLBOX_MUELU
+#include <MueLu_CreateTpetraPreconditioner.hpp>
+
+using TAMG = MueLu::TpetraOperator<double, int, int>; ///< MueLu multigrid hierarchy as a Tpetra::Operator
+#endif
+
 /**
  * @brief an abstract class for creating preconditioners
  *
@@ -450,6 +456,46 @@ class PrecondUtil {
                                                       const Teuchos::RCP<const TMV> &initialGuess) {
         return Teuchos::rcp(new KinvOperator(A.getConst(), initialGuess.getConst()));
     }
+
+#ifdef SIMTOOLBOX_MUELU
+    /**
+     * @brief create a smoothed aggregation AMG preconditioner for an SPD matrix
+     *
+     * Chebyshev smoothing threads well, and the tentative prolongator is kept for reuseMueLuPreconditioner()
+     *
+     * @param A
+     * @return Teuchos::RCP<TAMG>
+     */
+    static Teuchos::RCP<TAMG> createMueLuPreconditioner(const Teuchos::RCP<TCMAT> &A) {
+        Teuchos::RCP<Teuchos::Time> setupTimer = Teuchos::TimeMonitor::getNewCounter("MueLu::Setup");
+        Teuchos::TimeMonitor mon(*setupTimer);
+
+        Teuchos::ParameterList plist;
+        plist.set("verbosity", "none");
+        plist.set("multigrid algorithm", "sa");
+        plist.set("problem: symmetric", true);
+        plist.set("max levels", 10);
+        plist.set("coarse: max size", 2000);
+        plist.set("aggregation: type", "uncoupled");
+        plist.set("aggregation: drop tol", 0.01); // drop weak couplings, including zeroed rows and columns
+        plist.set("smoother: type", "CHEBYSHEV");
+        plist.set("reuse: type", "tP");
+        Teuchos::RCP<TOP> AOp = A;
+        return MueLu::CreateTpetraPreconditioner<double, int, int, TOP::node_type>(AOp, plist);
+    }
+
+    /**
+     * @brief recompute the AMG preconditioner with the aggregates and the tentative prolongator of a previous A
+     *
+     * @param A must have the same row map as the previous matrix
+     * @param prec
+     */
+    static void reuseMueLuPreconditioner(const Teuchos::RCP<TCMAT> &A, TAMG &prec) {
+        Teuchos::RCP<Teuchos::Time> reuseTimer = Teuchos::TimeMonitor::getNewCounter("MueLu::Reuse");
+        Teuchos::TimeMonitor mon(*reuseTimer);
+        MueLu::ReuseTpetraPreconditioner(A, prec);
+    }
+#endif
 };
 
 #endif
\ No newline at end of file
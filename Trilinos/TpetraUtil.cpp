@@ -1,7 +1,13 @@
 #include "TpetraUtil.hpp"
 #include "Util/Logger.hpp"
+#include "Util/ReproSum.hpp"
 
+#include <algorithm>
+#include <cassert>
+#include <cmath>
 #include <limits>
+#include <utility>
+#include <vector>
 
 void dumpTCMAT(const Teuchos::RCP<const TCMAT> &A, std::string filename) {
     filename = filename + std::string("_TCMAT.mtx");
@@ -102,4 +108,96 @@ Teuchos::RCP<TV> getTVFromVector(const std::vector<double> &in, Teuchos::RCP<con
     }
 
     return out;
-}
\ No newline at end of file
+}
+
+Teuchos::RCP<TCMAT> getTCMATFromRowEntries(const std::vector<std::vector<std::pair<int, double>>> &rows,
+                                           const Teuchos::RCP<const TMAP> &rowMapRcp,
+                                           const Teuchos::RCP<const TMAP> &domainMapRcp) {
+    const int localSize = rows.size();
+    assert(localSize == static_cast<int>(rowMapRcp->getNodeNumElements()));
+
+    // column map of all referenced global columns
+    std::vector<int> colMapIndex;
+    for (const auto &row : rows) {
+        for (const auto &entry : row) {
+            colMapIndex.push_back(entry.first);
+        }
+    }
+    std::sort(colMapIndex.begin(), colMapIndex.end());
+    colMapIndex.erase(std::unique(colMapIndex.begin(), colMapIndex.end()), colMapIndex.end());
+    Teuchos::RCP<TMAP> colMapRcp = Teuchos::rcp(new TMAP(Teuchos::OrdinalTraits<int>::invalid(), colMapIndex.data(),
+                                                         colMapIndex.size(), 0, rowMapRcp->getComm()));
+
+    Kokkos::View<size_t *> rowPointers("rowPointers", localSize + 1);
+    rowPointers[0] = 0;
+    for (int i = 0; i < localSize; i++) {
+        rowPointers[i + 1] = rowPointers[i] + rows[i].size();
+    }
+    Kokkos::View<int *> columnIndices("columnIndices", rowPointers[localSize]);
+    Kokkos::View<double *> values("values", rowPointers[localSize]);
+#pragma omp parallel for
+    for (int i = 0; i < localSize; i++) {
+        int p = rowPointers[i];
+        for (const auto &entry : rows[i]) {
+            columnIndices[p] = colMapRcp->getLocalElement(entry.first);
+            values[p] = entry.second;
+            p++;
+        }
+    }
+
+    Teuchos::RCP<TCMAT> matRcp = Teuchos::rcp(new TCMAT(rowMapRcp, colMapRcp, rowPointers, columnIndices, values));
+    matRcp->fillComplete(domainMapRcp, rowMapRcp);
+    return matRcp;
+}
+
+size_t getTCMATBytes(const TCMAT &mat) {
+    const size_t nnz = mat.getNodeNumEntries();
+    const size_t nRows = mat.getNodeNumRows();
+    return nnz * (sizeof(double) + sizeof(int)) + (nRows + 1) * sizeof(size_t);
+}
+
+size_t getTMVBytes(const TMV &vec) { return vec.getLocalLength() * vec.getNumVectors() * sizeof(double); }
+
+void applyReproducible(const TCMAT &A, const TV &x, TV &y, double alpha, double beta) {
+    TEUCHOS_TEST_FOR_EXCEPTION(!A.getGraph()->getExporter().is_null(), std::invalid_argument,
+                               "applyReproducible requires the same row and range map");
+
+    // x on the column map of A
+    Teuchos::RCP<const TV> xColRcp = Teuchos::rcpFromRef(x);
+    auto importer = A.getGraph()->getImporter();
+    if (!importer.is_null()) {
+        Teuchos::RCP<TV> xImportRcp = Teuchos::rcp(new TV(A.getColMap(), false));
+        xImportRcp->doImport(x, *importer, Tpetra::INSERT);
+        xColRcp = xImportRcp;
+    }
+
+    auto xPtr = xColRcp->getLocalView<Kokkos::HostSpace>();
+    auto yPtr = y.getLocalView<Kokkos::HostSpace>();
+    y.modify<Kokkos::HostSpace>();
+    const int nRows = A.getNodeNumRows();
+#pragma omp parallel
+    {
+        std::vector<double> prod;
+#pragma omp for
+        for (int i = 0; i < nRows; i++) {
+            Teuchos::ArrayView<const int> cols;
+            Teuchos::ArrayView<const double> vals;
+            A.getLocalRowView(i, cols, vals);
+            prod.resize(cols.size());
+            for (int k = 0; k < cols.size(); k++) {
+                prod[k] = vals[k] * xPtr(cols[k], 0);
+            }
+            const double Ax = ReproSum::sortedSum(prod.data(), prod.size());
+            yPtr(i, 0) = beta == 0 ? alpha * Ax : alpha * Ax + beta * yPtr(i, 0);
+        }
+    }
+}
+
+double dotReproducible(const TV &x, const TV &y) {
+    auto xPtr = x.getLocalView<Kokkos::HostSpace>();
+    auto yPtr = y.getLocalView<Kokkos::HostSpace>();
+    const int n = x.getLocalLength();
+    return ReproSum::sum(n, [&](int i) { return xPtr(i, 0) * yPtr(i, 0); });
+}
+
+double norm2Reproducible(const TV &x) { return std::sqrt(dotReproducible(x, x)); }
@@ -38,6 +38,9 @@
 // Preconditioner
 #include <Ifpack2_Factory.hpp>
 
+#include <utility>
+#include <vector>
+
 // no need to specify node type for new version of Tpetra. It defaults to
 // Kokkos::default, which is openmp
 // typedef Tpetra::Details::DefaultTypes::node_type TNODE;
@@ -184,4 +187,63 @@ Teuchos::RCP<TV> getTVFromTwoBlockTV(const Teuchos::RCP<const TV> &vec1, const T
  */
 Teuchos::RCP<TV> getTVFromVector(const std::vector<double> &in, Teuchos::RCP<const TCOMM> &commRcp);
 
+/**
+ * @brief CrsMatrix from the entries of local rows
+ *
+ * @param rows global column index and value of each entry, for each row of rowMapRcp on local
+ * @param rowMapRcp also the range map
+ * @param domainMapRcp
+ * @return Teuchos::RCP<TCMAT> fill completed
+ */
+Teuchos::RCP<TCMAT> getTCMATFromRowEntries(const std::vector<std::vector<std::pair<int, double>>> &rows,
+                                           const Teuchos::RCP<const TMAP> &rowMapRcp,
+                                           const Teuchos::RCP<const TMAP> &domainMapRcp);
+
+/**
+ * @brief estimate the bytes of the local part of a CrsMatrix
+ *
+ * values, column indices and row offsets, the graph and import/export buffers are not included
+ * @param mat
+ * @return size_t
+ */
+size_t getTCMATBytes(const TCMAT &mat);
+
+/**
+ * @brief bytes of the local part of a MultiVector
+ *
+ * @param vec
+ * @return size_t
+ */
+size_t getTMVBytes(const TMV &vec);
+
+/**
+ * @brief y = alpha A x + beta y, independent of the distribution of A and the number of threads
+ *
+ * Each row sums its products in a canonical order with ReproSum::sortedSum().
+ * The row map of A must be the same as its range map.
+ * @param A
+ * @param x in the domain map of A
+ * @param y in the range map of A
+ * @param alpha
+ * @param beta
+ */
+void applyReproducible(const TCMAT &A, const TV &x, TV &y, double alpha = 1.0, double beta = 0.0);
+
+/**
+ * @brief dot product independent of the distribution and the number of threads, see ReproSum
+ *
+ * @param x
+ * @param y
+ * @return double
+ */
+double dotReproducible(const TV &x, const TV &y);
+
+/**
+ * @brief 2-norm independent of the distribution and the number of threads, see ReproSum
+ *
+ * @param x
+ * @return double
+ */
+double norm2Reproducible(const TV &x);
+
 #endif /* TPETRAUTIL_HPP_ */
@@ -146,6 +146,17 @@ class ZDD {
         int status = findZDD.Find(idPtr, NULL, (char *)dataPtr, NULL, gidToFind.size(), NULL);
         return status;
     }
+
+    /**
+     * @brief bytes allocated by the local buffer lists
+     *
+     * the directory stored inside Zoltan_DD is not included
+     * @return size_t
+     */
+    size_t getMemoryBytes() const {
+        return (gidToFind.capacity() + gidOnLocal.capacity()) * sizeof(GID_TYPE) +
+               (dataToFind.capacity() + dataOnLocal.capacity()) * sizeof(DATA_TYPE);
+    }
 };
 
 #endif /* ZDD_HPP_ */
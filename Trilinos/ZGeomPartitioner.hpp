@@ -0,0 +1,148 @@
+/**
+ * @file ZGeomPartitioner.hpp
+ * @brief A wrapper for Zoltan parallel geometric partitioners (RCB and HSFC)
+ *
+ */
+
+#ifndef ZGEOMPARTITIONER_HPP_
+#define ZGEOMPARTITIONER_HPP_
+
+#include "ZPartitioner.hpp"
+
+#include <algorithm>
+#include <cfloat>
+#include <string>
+#include <vector>
+
+/**
+ * @brief A wrapper for Zoltan RCB and HSFC geometric partitioners
+ *
+ * Objects are 3D points with one weight each.
+ * All steps are distributed, no data is gathered to a single rank.
+ * Cuts are kept after partition() so that assignPoint() can locate the owner rank of arbitrary points.
+ */
+class ZGeomPartitioner : public ZPartitioner {
+    bool rcb; ///< true for RCB, false for HSFC
+
+    // pointer to the current input coordinates, valid during partition()
+    const std::vector<double> *coordPtr = nullptr;
+
+    static int getNumGeom(void *data, int *ierr) {
+        *ierr = ZOLTAN_OK;
+        return 3;
+    }
+
+    static void getGeomMulti(void *data, int numGidEntries, int numLidEntries, int numObj, ZOLTAN_ID_PTR globalIds,
+                             ZOLTAN_ID_PTR localIds, int numDim, double *geomVec, int *ierr) {
+        auto self = static_cast<ZGeomPartitioner *>(data);
+        for (int i = 0; i < numObj; i++) {
+            const int lid = localIds[i];
+            for (int k = 0; k < 3; k++) {
+                geomVec[3 * i + k] = (*self->coordPtr)[3 * lid + k];
+            }
+        }
+        *ierr = ZOLTAN_OK;
+    }
+
+  public:
+    /**
+     * @brief Construct a new ZGeomPartitioner object
+     *
+     * @param method "RCB" or "HSFC"
+     */
+    explicit ZGeomPartitioner(const std::string &method) {
+        Zoltan &zz = *zzPtr;
+
+        if (method != "RCB" && method != "HSFC") {
+            spdlog::critical("ZGeomPartitioner method {} not supported", method);
+            std::exit(1);
+        }
+        rcb = (method == "RCB");
+
+        zz.Set_Param("LB_METHOD", method);
+        zz.Set_Param("KEEP_CUTS", "1"); // for assignPoint() and getPartBox()
+        if (rcb) {
+            zz.Set_Param("RCB_REUSE", "1");             // start from the previous cuts
+            zz.Set_Param("RCB_RECTILINEAR_BLOCKS", "1"); // do not split objects at the same cut coordinate
+        }
+
+        zz.Set_Num_Geom_Fn(ZGeomPartitioner::getNumGeom, this);
+        zz.Set_Geom_Multi_Fn(ZGeomPartitioner::getGeomMulti, this);
+    }
+
+    ~ZGeomPartitioner() = default;
+
+    /**
+     * @brief if the partition boxes can be retrieved by getPartBox()
+     *
+     * @return true for RCB
+     * @return false for HSFC, the parts are not boxes
+     */
+    bool hasPartBox() const { return rcb; }
+
+    /**
+     * @brief compute a new partition
+     *
+     * @param gid unique gid of each local object
+     * @param coord 3 coordinates per local object
+     * @param weight 1 weight per local object. uniform weights if empty
+     * @param destRank the destination rank of each local object
+     */
+    void partition(const std::vector<int> &gid, const std::vector<double> &coord, const std::vector<double> &weight,
+                   std::vector<int> &destRank) {
+        if (coord.size() != 3 * gid.size()) {
+            spdlog::critical("ZGeomPartitioner input size error");
+            std::exit(1);
+        }
+        coordPtr = &coord;
+        runPartition(gid, weight, destRank);
+        coordPtr = nullptr;
+    }
+
+    /**
+     * @brief find the owner rank of a point with the cuts of the last partition()
+     *
+     * @param pos
+     * @return int
+     */
+    int assignPoint(const double pos[3]) {
+        double coord[3] = {pos[0], pos[1], pos[2]};
+        int proc = -1, part = -1;
+        int error = zzPtr->LB_Point_PP_Assign(coord, proc, part);
+        if (error != ZOLTAN_OK || proc < 0 || proc >= rankSize) {
+            spdlog::critical("Zoltan LB_Point_PP_Assign error {} proc {}", error, proc);
+            std::exit(1);
+        }
+        return proc;
+    }
+
+    /**
+     * @brief get the box of a part with the cuts of the last partition(), RCB only
+     *
+     * Zoltan returns +-DBL_MAX for faces on the outer boundary.
+     * These are clipped to [rootLow, rootHigh]
+     * @param part
+     * @param rootLow
+     * @param rootHigh
+     * @param low
+     * @param high
+     */
+    void getPartBox(int part, const double rootLow[3], const double rootHigh[3], double low[3], double high[3]) {
+        if (!rcb) {
+            spdlog::critical("ZGeomPartitioner getPartBox() requires RCB");
+            std::exit(1);
+        }
+        int ndim = 0;
+        int error = zzPtr->RCB_Box(part, ndim, low[0], low[1], low[2], high[0], high[1], high[2]);
+        if (error != ZOLTAN_OK) {
+            spdlog::critical("Zoltan RCB_Box error {}", error);
+            std::exit(1);
+        }
+        for (int k = 0; k < 3; k++) {
+            low[k] = std::min(std::max(low[k], rootLow[k]), rootHigh[k]);
+            high[k] = std::min(std::max(high[k], rootLow[k]), rootHigh[k]);
+        }
+    }
+};
+
+#endif
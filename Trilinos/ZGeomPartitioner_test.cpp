@@ -0,0 +1,156 @@
+/**
+ * @file ZGeomPartitioner_test.cpp
+ * @brief test of the parts of RCB and HSFC partitions
+ *
+ */
+#include "ZGeomPartitioner.hpp"
+
+#include <cmath>
+#include <random>
+#include <vector>
+
+#include <mpi.h>
+
+constexpr double rootLow[3] = {0, 0, 0};
+constexpr double rootHigh[3] = {10, 5, 2};
+
+/**
+ * @brief partition random points, more on rank 0
+ *
+ * @param partitioner
+ * @param coord [out] 3 per local point
+ * @param destRank [out]
+ */
+void partitionPoints(ZGeomPartitioner &partitioner, std::vector<double> &coord, std::vector<int> &destRank) {
+    int rank = 0;
+    MPI_Comm_rank(MPI_COMM_WORLD, &rank);
+    const int nLocal = rank == 0 ? 2000 : 500;
+    std::mt19937 gen(rank);
+    std::uniform_real_distribution<double> dis(0, 1);
+    std::vector<int> gid(nLocal);
+    coord.resize(3 * nLocal);
+    for (int i = 0; i < nLocal; i++) {
+        gid[i] = 100000 * rank + i;
+        for (int k = 0; k < 3; k++) {
+            // clustered towards the low corner
+            const double u = dis(gen);
+            coord[3 * i + k] = rootLow[k] + u * u * (rootHigh[k] - rootLow[k]);
+        }
+    }
+    partitioner.partition(gid, coord, std::vector<double>(), destRank);
+}
+
+/**
+ * @brief local points are assigned to their destination rank, and points of a grid over the root box to all ranks
+ *
+ * @param partitioner
+ * @param coord
+ * @param destRank
+ * @return bool
+ */
+bool checkAssign(ZGeomPartitioner &partitioner, const std::vector<double> &coord, const std::vector<int> &destRank) {
+    int nProcs = 1;
+    MPI_Comm_size(MPI_COMM_WORLD, &nProcs);
+    int nError = 0;
+    const int nLocal = destRank.size();
+    for (int i = 0; i < nLocal; i++) {
+        nError += partitioner.assignPoint(coord.data() + 3 * i) != destRank[i];
+    }
+
+    // cell centers of a 20^3 grid
+    const int nGrid = 20;
+    std::vector<int> count(nProcs, 0);
+    for (int n = 0; n < nGrid * nGrid * nGrid; n++) {
+        const int idx[3] = {n % nGrid, (n / nGrid) % nGrid, n / (nGrid * nGrid)};
+        double pos[3];
+        for (int k = 0; k < 3; k++) {
+            pos[k] = rootLow[k] + (idx[k] + 0.5) / nGrid * (rootHigh[k] - rootLow[k]);
+        }
+        count[partitioner.assignPoint(pos)]++;
+    }
+    for (int r = 0; r < nProcs; r++) {
+        nError += count[r] == 0;
+    }
+
+    int nErrorGlobal = 0;
+    MPI_Allreduce(&nError, &nErrorGlobal, 1, MPI_INT, MPI_SUM, MPI_COMM_WORLD);
+    return nErrorGlobal == 0;
+}
+
+/**
+ * @brief RCB boxes are inside the root box, do not overlap, cover its volume, and contain the assigned points
+ *
+ * @param partitioner
+ * @param coord
+ * @param destRank
+ * @return bool
+ */
+bool checkBox(ZGeomPartitioner &partitioner, const std::vector<double> &coord, const std::vector<int> &destRank) {
+    int nProcs = 1;
+    MPI_Comm_size(MPI_COMM_WORLD, &nProcs);
+    std::vector<double> low(3 * nProcs), high(3 * nProcs);
+    for (int r = 0; r < nProcs; r++) {
+        partitioner.getPartBox(r, rootLow, rootHigh, low.data() + 3 * r, high.data() + 3 * r);
+    }
+
+    int nError = 0;
+    double volume = 0;
+    for (int r = 0; r < nProcs; r++) {
+        double v = 1;
+        for (int k = 0; k < 3; k++) {
+            nError += low[3 * r + k] < rootLow[k] || high[3 * r + k] > rootHigh[k] || low[3 * r + k] > high[3 * r + k];
+            v *= high[3 * r + k] - low[3 * r + k];
+        }
+        volume += v;
+        for (int s = 0; s < r; s++) {
+            double overlap = 1;
+            for (int k = 0; k < 3; k++) {
+                overlap *= std::max(0.0, std::min(high[3 * r + k], high[3 * s + k]) -
+                                             std::max(low[3 * r + k], low[3 * s + k]));
+            }
+            nError += overlap > 0;
+        }
+    }
+    const double rootVolume = (rootHigh[0] - rootLow[0]) * (rootHigh[1] - rootLow[1]) * (rootHigh[2] - rootLow[2]);
+    nError += std::abs(volume - rootVolume) > 1e-10 * rootVolume;
+
+    const int nLocal = destRank.size();
+    for (int i = 0; i < nLocal; i++) {
+        const int r = destRank[i];
+        for (int k = 0; k < 3; k++) {
+            nError += coord[3 * i + k] < low[3 * r + k] || coord[3 * i + k] > high[3 * r + k];
+        }
+    }
+
+    int nErrorGlobal = 0;
+    MPI_Allreduce(&nError, &nErrorGlobal, 1, MPI_INT, MPI_SUM, MPI_COMM_WORLD);
+    return nErrorGlobal == 0;
+}
+
+int main(int argc, char **argv) {
+    MPI_Init(&argc, &argv);
+    Logger::setup_mpi_spdlog();
+    bool pass = true;
+    {
+        ZGeomPartitioner rcb("RCB");
+        std::vector<double> coord;
+        std::vector<int> destRank;
+        partitionPoints(rcb, coord, destRank);
+        const bool assignRCB = checkAssign(rcb, coord, destRank);
+        const bool boxRCB = checkBox(rcb, coord, destRank);
+        spdlog::info("RCB assign {}, box {}", assignRCB, boxRCB);
+        pass = pass && assignRCB && boxRCB;
+    }
+    {
+        ZGeomPartitioner hsfc("HSFC");
+        std::vector<double> coord;
+        std::vector<int> destRank;
+        partitionPoints(hsfc, coord, destRank);
+        const bool assignHSFC = checkAssign(hsfc, coord, destRank);
+        spdlog::info("HSFC assign {}", assignHSFC);
+        pass = pass && assignHSFC;
+    }
+    spdlog::info(pass ? "TestPassed" : "Error in geometric partition test");
+    MPI_Finalize();
+    return 0;
+}
@@ -0,0 +1,108 @@
+/**
+ * @file ZGraphPartitioner.hpp
+ * @brief A wrapper for Zoltan PHG graph repartitioning
+ *
+ */
+
+#ifndef ZGRAPHPARTITIONER_HPP_
+#define ZGRAPHPARTITIONER_HPP_
+
+#include "ZPartitioner.hpp"
+
+#include <string>
+#include <vector>
+
+/**
+ * @brief A wrapper for Zoltan PHG graph partitioner in refinement mode
+ *
+ * Objects have one weight each, and edges point to objects on any rank.
+ * The graph must be symmetric, i.e., each edge is listed on both of its ends.
+ * LB_APPROACH=REFINE improves the current distribution by moving objects to cut fewer edges within the
+ * imbalance tolerance, so the locality of a geometric partition computed before is mostly kept.
+ */
+class ZGraphPartitioner : public ZPartitioner {
+    // pointers to the current input edges, valid during partition()
+    const std::vector<int> *edgeDispPtr = nullptr;
+    const std::vector<int> *edgeGidPtr = nullptr;
+    const std::vector<int> *edgeRankPtr = nullptr;
+
+    static void getNumEdgesMulti(void *data, int numGidEntries, int numLidEntries, int numObj,
+                                 ZOLTAN_ID_PTR globalIds, ZOLTAN_ID_PTR localIds, int *numEdges, int *ierr) {
+        auto self = static_cast<ZGraphPartitioner *>(data);
+        const auto &disp = *self->edgeDispPtr;
+        for (int i = 0; i < numObj; i++) {
+            const int lid = localIds[i];
+            numEdges[i] = disp[lid + 1] - disp[lid];
+        }
+        *ierr = ZOLTAN_OK;
+    }
+
+    static void getEdgeListMulti(void *data, int numGidEntries, int numLidEntries, int numObj,
+                                 ZOLTAN_ID_PTR globalIds, ZOLTAN_ID_PTR localIds, int *numEdges,
+                                 ZOLTAN_ID_PTR nborGlobalId, int *nborProcs, int wgtDim, float *edgeWgts,
+                                 int *ierr) {
+        auto self = static_cast<ZGraphPartitioner *>(data);
+        const auto &disp = *self->edgeDispPtr;
+        int k = 0;
+        for (int i = 0; i < numObj; i++) {
+            const int lid = localIds[i];
+            for (int e = disp[lid]; e < disp[lid + 1]; e++) {
+                nborGlobalId[k] = (*self->edgeGidPtr)[e];
+                nborProcs[k] = (*self->edgeRankPtr)[e];
+                k++;
+            }
+        }
+        *ierr = ZOLTAN_OK;
+    }
+
+  public:
+    /**
+     * @brief Construct a new ZGraphPartitioner object
+     *
+     * @param imbalanceTol max load of a rank over the average load
+     */
+    explicit ZGraphPartitioner(double imbalanceTol = 1.1) {
+        Zoltan &zz = *zzPtr;
+
+        zz.Set_Param("LB_METHOD", "GRAPH");
+        zz.Set_Param("GRAPH_PACKAGE", "PHG");
+        zz.Set_Param("LB_APPROACH", "REFINE");
+        zz.Set_Param("EDGE_WEIGHT_DIM", "0");
+        zz.Set_Param("CHECK_GRAPH", "0");
+        zz.Set_Param("IMBALANCE_TOL", std::to_string(imbalanceTol));
+
+        zz.Set_Num_Edges_Multi_Fn(ZGraphPartitioner::getNumEdgesMulti, this);
+        zz.Set_Edge_List_Multi_Fn(ZGraphPartitioner::getEdgeListMulti, this);
+    }
+
+    ~ZGraphPartitioner() = default;
+
+    /**
+     * @brief refine the current partition
+     *
+     * @param gid unique gid of each local object
+     * @param weight 1 weight per local object. uniform weights if empty
+     * @param edgeDisp offset of the edges of each local object, size gid.size()+1
+     * @param edgeGid gid of the other end of each edge
+     * @param edgeRank current rank of the other end of each edge
+     * @param destRank the destination rank of each local object
+     */
+    void partition(const std::vector<int> &gid, const std::vector<double> &weight, const std::vector<int> &edgeDisp,
+                   const std::vector<int> &edgeGid, const std::vector<int> &edgeRank, std::vector<int> &destRank) {
+        const int nObj = gid.size();
+        if (static_cast<int>(edgeDisp.size()) != nObj + 1 || static_cast<int>(edgeGid.size()) != edgeDisp.back() ||
+            edgeRank.size() != edgeGid.size()) {
+            spdlog::critical("ZGraphPartitioner input size error");
+            std::exit(1);
+        }
+        edgeDispPtr = &edgeDisp;
+        edgeGidPtr = &edgeGid;
+        edgeRankPtr = &edgeRank;
+        runPartition(gid, weight, destRank);
+        edgeDispPtr = nullptr;
+        edgeGidPtr = nullptr;
+        edgeRankPtr = nullptr;
+    }
+};
+
+#endif
@@ -0,0 +1,97 @@
+/**
+ * @file ZGraphPartitioner_test.cpp
+ * @brief test of the PHG refinement on a chain spanning ranks
+ *
+ */
+#include "ZGraphPartitioner.hpp"
+
+#include <vector>
+
+#include <mpi.h>
+
+constexpr int nChain = 400; ///< objects in the chain, gid 0 to nChain-1
+constexpr int nBlock = 5;   ///< consecutive objects on the same rank before refinement
+
+/**
+ * @brief rank of each chain object on all ranks
+ *
+ * @param gid local objects
+ * @param rank rank of each local object
+ * @return std::vector<int>
+ */
+std::vector<int> gatherRank(const std::vector<int> &gid, const std::vector<int> &rank) {
+    std::vector<int> rankLocal(nChain, 0);
+    const int nLocal = gid.size();
+    for (int i = 0; i < nLocal; i++) {
+        rankLocal[gid[i]] = rank[i];
+    }
+    std::vector<int> rankGlobal(nChain, 0);
+    MPI_Allreduce(rankLocal.data(), rankGlobal.data(), nChain, MPI_INT, MPI_SUM, MPI_COMM_WORLD);
+    return rankGlobal;
+}
+
+/**
+ * @brief number of chain links with the two ends on different ranks
+ *
+ * @param rankGlobal
+ * @return int
+ */
+int countCut(const std::vector<int> &rankGlobal) {
+    int nCut = 0;
+    for (int g = 0; g + 1 < nChain; g++) {
+        nCut += rankGlobal[g] != rankGlobal[g + 1];
+    }
+    return nCut;
+}
+
+int main(int argc, char **argv) {
+    MPI_Init(&argc, &argv);
+    Logger::setup_mpi_spdlog();
+    bool pass = false;
+    {
+        int myRank = 0, nProcs = 1;
+        MPI_Comm_rank(MPI_COMM_WORLD, &myRank);
+        MPI_Comm_size(MPI_COMM_WORLD, &nProcs);
+
+        // blocks of the chain are dealt to ranks in turn, as a geometric partition of a chain folded across cuts
+        std::vector<int> gid;
+        for (int g = 0; g < nChain; g++) {
+            if ((g / nBlock) % nProcs == myRank) {
+                gid.push_back(g);
+            }
+        }
+        const int nLocal = gid.size();
+        const auto rankBefore = gatherRank(gid, std::vector<int>(nLocal, myRank));
+
+        // both ends list each link
+        std::vector<int> edgeDisp(1, 0), edgeGid, edgeRank;
+        for (int i = 0; i < nLocal; i++) {
+            for (const int nbr : {gid[i] - 1, gid[i] + 1}) {
+                if (nbr >= 0 && nbr < nChain) {
+                    edgeGid.push_back(nbr);
+                    edgeRank.push_back(rankBefore[nbr]);
+                }
+            }
+            edgeDisp.push_back(edgeGid.size());
+        }
+
+        const double imbalanceTol = 1.1;
+        ZGraphPartitioner partitioner(imbalanceTol);
+        std::vector<int> destRank;
+        partitioner.partition(gid, std::vector<double>(), edgeDisp, edgeGid, edgeRank, destRank);
+        const auto rankAfter = gatherRank(gid, destRank);
+
+        std::vector<int> load(nProcs, 0);
+        for (int g = 0; g < nChain; g++) {
+            load[rankAfter[g]]++;
+        }
+        const int maxLoad = *std::max_element(load.begin(), load.end());
+        const int nCutBefore = countCut(rankBefore);
+        const int nCutAfter = countCut(rankAfter);
+        spdlog::info("cross-rank links {} -> {}, max load {} of {}", nCutBefore, nCutAfter, maxLoad, nChain);
+        pass = nProcs == 1 || (nCutAfter < nCutBefore && maxLoad <= imbalanceTol * nChain / nProcs + 1);
+    }
+    spdlog::info(pass ? "TestPassed" : "Error in graph partition test");
+    MPI_Finalize();
+    return 0;
+}
@@ -0,0 +1,131 @@
+/**
+ * @file ZPartitioner.hpp
+ * @brief Common part of the Zoltan partitioner wrappers
+ *
+ */
+
+#ifndef ZPARTITIONER_HPP_
+#define ZPARTITIONER_HPP_
+
+#include "Util/Logger.hpp"
+
+#include <algorithm>
+#include <cstdlib>
+#include <memory>
+#include <vector>
+
+#include <zoltan_cpp.h>
+
+#include <mpi.h>
+
+/**
+ * @brief Zoltan object, object callbacks, and LB_Partition
+ *
+ * Objects have a unique gid and one weight each.
+ * Derived classes set the LB_METHOD parameters and register the callbacks of their own input data.
+ */
+class ZPartitioner {
+  protected:
+    int rankSize;                  ///< mpi rank size
+    int myRank;                    ///< local mpi rank id
+    std::unique_ptr<Zoltan> zzPtr; ///< Zoltan object
+
+    // pointers to the current input data, valid during runPartition()
+    const std::vector<int> *gidPtr = nullptr;
+    const std::vector<double> *weightPtr = nullptr;
+
+    static int getNumObj(void *data, int *ierr) {
+        auto self = static_cast<ZPartitioner *>(data);
+        *ierr = ZOLTAN_OK;
+        return self->gidPtr->size();
+    }
+
+    static void getObjList(void *data, int numGidEntries, int numLidEntries, ZOLTAN_ID_PTR globalIds,
+                           ZOLTAN_ID_PTR localIds, int wgtDim, float *objWgts, int *ierr) {
+        auto self = static_cast<ZPartitioner *>(data);
+        const int nObj = self->gidPtr->size();
+        for (int i = 0; i < nObj; i++) {
+            globalIds[i] = (*self->gidPtr)[i];
+            localIds[i] = i;
+            if (wgtDim > 0) {
+                objWgts[i] = self->weightPtr->empty() ? 1.0f : static_cast<float>((*self->weightPtr)[i]);
+            }
+        }
+        *ierr = ZOLTAN_OK;
+    }
+
+    ZPartitioner() {
+        MPI_Comm_rank(MPI_COMM_WORLD, &myRank);
+        MPI_Comm_size(MPI_COMM_WORLD, &rankSize);
+
+        // must be called after MPI_Init() and before creating the Zoltan object
+        float version = 0;
+        if (Zoltan_Initialize(0, nullptr, &version) != ZOLTAN_OK) {
+            spdlog::critical("Zoltan_Initialize error");
+            std::exit(1);
+        }
+        zzPtr = std::make_unique<Zoltan>(MPI_COMM_WORLD);
+        Zoltan &zz = *zzPtr;
+
+        zz.Set_Param("DEBUG_LEVEL", "0");
+        zz.Set_Param("NUM_GID_ENTRIES", "1");
+        zz.Set_Param("NUM_LID_ENTRIES", "1");
+        zz.Set_Param("OBJ_WEIGHT_DIM", "1");
+        zz.Set_Param("RETURN_LISTS", "EXPORT");
+
+        zz.Set_Num_Obj_Fn(ZPartitioner::getNumObj, this);
+        zz.Set_Obj_List_Fn(ZPartitioner::getObjList, this);
+    }
+
+    ~ZPartitioner() = default;
+
+    /**
+     * @brief run LB_Partition with the callbacks registered for the current input
+     *
+     * @param gid unique gid of each local object
+     * @param weight 1 weight per local object. uniform weights if empty
+     * @param destRank the destination rank of each local object
+     */
+    void runPartition(const std::vector<int> &gid, const std::vector<double> &weight, std::vector<int> &destRank) {
+        const int nObj = gid.size();
+        if (!weight.empty() && static_cast<int>(weight.size()) != nObj) {
+            spdlog::critical("Zoltan partitioner weight size error");
+            std::exit(1);
+        }
+        gidPtr = &gid;
+        weightPtr = &weight;
+
+        int changes = 0, numGidEntries = 1, numLidEntries = 1;
+        int numImport = 0, numExport = 0;
+        ZOLTAN_ID_PTR importGlobalIds = nullptr, importLocalIds = nullptr;
+        ZOLTAN_ID_PTR exportGlobalIds = nullptr, exportLocalIds = nullptr;
+        int *importProcs = nullptr, *importToPart = nullptr;
+        int *exportProcs = nullptr, *exportToPart = nullptr;
+
+        int error = zzPtr->LB_Partition(changes, numGidEntries, numLidEntries,                              //
+                                        numImport, importGlobalIds, importLocalIds, importProcs, importToPart, //
+                                        numExport, exportGlobalIds, exportLocalIds, exportProcs, exportToPart);
+        if (error != ZOLTAN_OK) {
+            spdlog::critical("Zoltan LB_Partition error {}", error);
+            std::exit(1);
+        }
+
+        destRank.resize(nObj);
+        std::fill(destRank.begin(), destRank.end(), myRank);
+        for (int i = 0; i < numExport; i++) {
+            destRank[exportLocalIds[i]] = exportProcs[i];
+        }
+
+        zzPtr->LB_Free_Part(&importGlobalIds, &importLocalIds, &importProcs, &importToPart);
+        zzPtr->LB_Free_Part(&exportGlobalIds, &exportLocalIds, &exportProcs, &exportToPart);
+
+        gidPtr = nullptr;
+        weightPtr = nullptr;
+    }
+
+  public:
+    ZPartitioner(const ZPartitioner &) = delete;
+    ZPartitioner &operator=(const ZPartitioner &) = delete;
+};
+
+#endif
@@ -0,0 +1,117 @@
+/**
+ * @file BlockTriDiag.hpp
+ * @brief Direct solver for symmetric positive definite block tridiagonal systems
+ *
+ */
+#ifndef BLOCKTRIDIAG_HPP_
+#define BLOCKTRIDIAG_HPP_
+
+#include "EigenDef.hpp"
+
+#include <cassert>
+#include <vector>
+
+/**
+ * @brief block Thomas algorithm (block LDL^T) for SPD block tridiagonal matrices
+ *
+ * The matrix is
+ *   [A_0   B_0                ]
+ *   [B_0^T A_1   B_1          ]
+ *   [      B_1^T A_2   ...    ]
+ *   [            ...   A_{n-1}]
+ * where A_k is m_k x m_k and B_k is m_k x m_{k+1}. Block sizes may vary.
+ * factorize() costs O(n m^3) and solve() costs O(n m^2).
+ */
+class BlockTriDiag {
+  public:
+    std::vector<Emat> diag;    ///< A_k, n blocks
+    std::vector<Emat> offDiag; ///< B_k, n-1 blocks
+
+    BlockTriDiag() = default;
+    ~BlockTriDiag() = default;
+
+    /**
+     * @brief clear all blocks and factorizations
+     *
+     */
+    void clear() {
+        diag.clear();
+        offDiag.clear();
+        schurLLT.clear();
+        gain.clear();
+    }
+
+    /**
+     * @brief total size of the matrix
+     *
+     * @return int
+     */
+    int size() const {
+        int n = 0;
+        for (const auto &d : diag) {
+            n += d.rows();
+        }
+        return n;
+    }
+
+    /**
+     * @brief factorize the matrix after diag and offDiag are set
+     *
+     * @return true if all Schur complements are positive definite
+     * @return false otherwise
+     */
+    bool factorize() {
+        const int n = diag.size();
+        assert(static_cast<int>(offDiag.size()) + 1 == n || n == 0);
+        schurLLT.resize(n);
+        gain.resize(n > 0 ? n - 1 : 0);
+        bool spd = true;
+        for (int k = 0; k < n; k++) {
+            Emat S = diag[k];
+            if (k > 0) {
+                // S_k = A_k - B_{k-1}^T S_{k-1}^{-1} B_{k-1}
+                S.noalias() -= offDiag[k - 1].transpose() * gain[k - 1];
+            }
+            schurLLT[k].compute(S);
+            spd = spd && (schurLLT[k].info() == Eigen::Success);
+            if (k < n - 1) {
+                // G_k = S_k^{-1} B_k
+                gain[k] = schurLLT[k].solve(offDiag[k]);
+            }
+        }
+        return spd;
+    }
+
+    /**
+     * @brief solve in place. x is the rhs on input and the solution on output
+     *
+     * @param x contiguous vector, ordered block by block
+     */
+    void solve(Evec &x) const {
+        const int n = diag.size();
+        assert(x.size() == size());
+        std::vector<int> offset(n + 1, 0);
+        for (int k = 0; k < n; k++) {
+            offset[k + 1] = offset[k] + diag[k].rows();
+        }
+        // forward: y_k = S_k^{-1} (r_k - B_{k-1}^T y_{k-1})
+        for (int k = 0; k < n; k++) {
+            Evec r = x.segment(offset[k], offset[k + 1] - offset[k]);
+            if (k > 0) {
+                r.noalias() -= offDiag[k - 1].transpose() * x.segment(offset[k - 1], offset[k] - offset[k - 1]);
+            }
+            x.segment(offset[k], offset[k + 1] - offset[k]) = schurLLT[k].solve(r);
+        }
+        // backward: x_k = y_k - G_k x_{k+1}
+        for (int k = n - 2; k >= 0; k--) {
+            x.segment(offset[k], offset[k + 1] - offset[k]) -=
+                gain[k] * x.segment(offset[k + 1], offset[k + 2] - offset[k + 1]);
+        }
+    }
+
+  private:
+    std::vector<Eigen::LLT<Emat>> schurLLT; ///< Cholesky of Schur complements S_k
+    std::vector<Emat> gain;                 ///< G_k = S_k^{-1} B_k
+};
+
+#endif
@@ -0,0 +1,71 @@
+#include "BlockTriDiag.hpp"
+
+#include <cstdio>
+#include <random>
+
+bool testSolve(int nBlock, int blockSizeMax) {
+    std::mt19937 gen(nBlock);
+    std::uniform_int_distribution<int> sizeDist(1, blockSizeMax);
+    std::uniform_real_distribution<double> u01(-1, 1);
+
+    BlockTriDiag mat;
+    for (int k = 0; k < nBlock; k++) {
+        const int m = sizeDist(gen);
+        mat.diag.push_back(Emat::Zero(m, m));
+    }
+    for (int k = 0; k < nBlock - 1; k++) {
+        Emat B(mat.diag[k].rows(), mat.diag[k + 1].rows());
+        for (int i = 0; i < B.size(); i++) {
+            B.data()[i] = u01(gen);
+        }
+        mat.offDiag.push_back(B);
+    }
+    // diagonally dominant SPD blocks
+    for (int k = 0; k < nBlock; k++) {
+        const int m = mat.diag[k].rows();
+        Emat R(m, m);
+        for (int i = 0; i < R.size(); i++) {
+            R.data()[i] = u01(gen);
+        }
+        mat.diag[k] = R * R.transpose() + 4.0 * (blockSizeMax + 1) * Emat::Identity(m, m);
+    }
+
+    // dense copy
+    const int n = mat.size();
+    Emat dense = Emat::Zero(n, n);
+    int offset = 0;
+    for (int k = 0; k < nBlock; k++) {
+        const int m = mat.diag[k].rows();
+        dense.block(offset, offset, m, m) = mat.diag[k];
+        if (k < nBlock - 1) {
+            const int m1 = mat.diag[k + 1].rows();
+            dense.block(offset, offset + m, m, m1) = mat.offDiag[k];
+            dense.block(offset + m, offset, m1, m) = mat.offDiag[k].transpose();
+        }
+        offset += m;
+    }
+
+    Evec b(n);
+    for (int i = 0; i < n; i++) {
+        b[i] = u01(gen);
+    }
+    Evec x = b;
+    if (!mat.factorize()) {
+        printf("factorization failed\n");
+        return false;
+    }
+    mat.solve(x);
+    Evec xTrue = dense.llt().solve(b);
+    const double error = (x - xTrue).norm() / xTrue.norm();
+    printf("nBlock %d, size %d, relative error %g\n", nBlock, n, error);
+    return error < 1e-10;
+}
+
+int main() {
+    if (testSolve(1, 2) && testSolve(2, 2) && testSolve(100, 2) && testSolve(500, 5)) {
+        printf("TestPassed\n");
+    } else {
+        printf("Error\n");
+    }
+    return 0;
+}
@@ -0,0 +1,98 @@
+/**
+ * @file CounterRng.hpp
+ * @brief Stateless counter-based random number generator
+ *
+ * Each random number is a pure function of (seed, key, counter), so it does not
+ * depend on the number of MPI ranks or OpenMP threads used to generate it.
+ *
+ */
+#ifndef COUNTERRNG_HPP_
+#define COUNTERRNG_HPP_
+
+#include <cmath>
+#include <cstdint>
+
+/**
+ * @brief counter-based rng, hashing (seed, key, counter) with a splitmix64 finalizer
+ *
+ * Typical usage: key = gid of an object, counter = index of the random number drawn for this object.
+ * No state is mutated, and the object can be shared by all threads.
+ */
+class CounterRng {
+  private:
+    uint64_t seed; ///< global seed
+
+    /**
+     * @brief splitmix64 finalizer, a bijection with good avalanche
+     *
+     * @param z
+     * @return uint64_t
+     */
+    static inline uint64_t mix(uint64_t z) {
+        z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ULL;
+        z = (z ^ (z >> 27)) * 0x94d049bb133111ebULL;
+        return z ^ (z >> 31);
+    }
+
+  public:
+    /**
+     * @brief Construct a new CounterRng object with seed
+     *
+     * @param seed_
+     */
+    explicit CounterRng(uint64_t seed_ = 0) : seed(mix(seed_ + 0x9e3779b97f4a7c15ULL)) {}
+
+    ~CounterRng() = default;
+
+    /**
+     * @brief get 64 random bits for (key, counter)
+     *
+     * @param key
+     * @param counter
+     * @return uint64_t
+     */
+    inline uint64_t getBits(uint64_t key, uint64_t counter) const {
+        return mix(mix(seed ^ mix(key + 0x9e3779b97f4a7c15ULL)) + counter * 0x9e3779b97f4a7c15ULL);
+    }
+
+    /**
+     * @brief get a U01 random number in [0,1) for (key, counter)
+     *
+     * @param key
+     * @param counter
+     * @return double
+     */
+    inline double getU01(uint64_t key, uint64_t counter) const {
+        return (getBits(key, counter) >> 11) * (1.0 / 9007199254740992.0); // 53 bits
+    }
+
+    /**
+     * @brief get a N01 random number with Box-Muller, consuming counter and counter+1
+     *
+     * @param key
+     * @param counter
+     * @return double
+     */
+    inline double getN01(uint64_t key, uint64_t counter) const {
+        constexpr double Pi = 3.14159265358979323846;
+        const double u1 = 1.0 - getU01(key, counter); // (0,1]
+        const double u2 = getU01(key, counter + 1);
+        return std::sqrt(-2.0 * std::log(u1)) * std::cos(2 * Pi * u2);
+    }
+
+    /**
+     * @brief get a logNormal(mu,sigma) random number, consuming counter and counter+1
+     *
+     * same parameterization as TRngPool::setLogNormalParameters()
+     * @param key
+     * @param counter
+     * @param mu
+     * @param sigma
+     * @return double
+     */
+    inline double getLN(uint64_t key, uint64_t counter, double mu, double sigma) const {
+        return std::exp(mu + sigma * getN01(key, counter));
+    }
+};
+
+#endif
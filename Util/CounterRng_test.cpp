@@ -0,0 +1,84 @@
+#include "CounterRng.hpp"
+
+#include <cstdio>
+#include <random>
+#include <vector>
+
+#include <omp.h>
+
+constexpr int nSample = 10000000;
+
+std::pair<double, double> checkSample(const std::vector<double> &sample) {
+    double mean = 0, var = 0;
+    const int n = sample.size();
+    for (int i = 0; i < n; i++)
+        mean += sample[i];
+    mean /= n;
+
+    for (int i = 0; i < n; i++)
+        var += (sample[i] - mean) * (sample[i] - mean);
+    var /= n;
+
+    return std::pair<double, double>(mean, var);
+}
+
+bool testU01() {
+    std::random_device rd;
+    CounterRng rng(rd());
+    std::vector<double> sample(nSample);
+#pragma omp parallel for
+    for (int i = 0; i < nSample; i++) {
+        sample[i] = rng.getU01(i / 4, i % 4);
+    }
+
+    auto check = checkSample(sample);
+    printf("sample mean  :%g\n", check.first);
+    printf("sample var   :%g\n", check.second);
+    return fabs(check.first - 0.5) < 0.01 && fabs(check.second - 1.0 / 12) < 0.01;
+}
+
+bool testN01() {
+    std::random_device rd;
+    CounterRng rng(rd());
+    std::vector<double> sample(nSample);
+#pragma omp parallel for
+    for (int i = 0; i < nSample; i++) {
+        sample[i] = rng.getN01(i, 0);
+    }
+
+    auto check = checkSample(sample);
+    printf("sample mean  :%g\n", check.first);
+    printf("sample var   :%g\n", check.second);
+    return fabs(check.first - 0.0) < 0.01 && fabs(check.second - 1.0) < 0.01;
+}
+
+bool testReproducible() {
+    // the same (seed, key, counter) must give the same number regardless of thread count and order
+    CounterRng rng(12345);
+    const int n = 100000;
+    std::vector<double> serial(n), parallel(n);
+    for (int i = n - 1; i >= 0; i--) {
+        serial[i] = rng.getU01(i, 7);
+    }
+#pragma omp parallel for schedule(dynamic, 17)
+    for (int i = 0; i < n; i++) {
+        parallel[i] = CounterRng(12345).getU01(i, 7);
+    }
+    for (int i = 0; i < n; i++) {
+        if (serial[i] != parallel[i]) {
+            return false;
+        }
+    }
+    // different seeds differ
+    return CounterRng(1).getU01(0, 0) != CounterRng(2).getU01(0, 0);
+}
+
+int main() {
+    if (testU01() && testN01() && testReproducible()) {
+        printf("TestPassed\n");
+    } else {
+        printf("Error\n");
+    }
+
+    return 0;
+}
@@ -59,6 +59,61 @@ inline void findPBCImage(const Real &lb, const Real &ub, Real &x, Real &trg) {
     }
 }
 
+/**
+ * @brief find Lees-Edwards Image of x in box [lb,ub)
+ *
+ * flow along x, gradient along y.
+ * the image box at +y is displaced by +offset in x and moves with +shearRate*(ub[1]-lb[1]) in x
+ * z is not changed
+ * @tparam Real
+ * @param lb
+ * @param ub
+ * @param offset displacement of the image box at +y
+ * @param x
+ * @return int number of boxes x is moved in +y. the image velocity is v + shift * shearRate * (ub[1]-lb[1])
+ */
+template <class Real>
+inline int findLEImage(const Real lb[3], const Real ub[3], const Real &offset, Real x[3]) {
+    const Real Ly = ub[1] - lb[1];
+    int shift = 0;
+    while (x[1] >= ub[1]) {
+        x[1] -= Ly;
+        x[0] -= offset;
+        shift--;
+    }
+    while (x[1] < lb[1]) {
+        x[1] += Ly;
+        x[0] += offset;
+        shift++;
+    }
+    findPBCImage(lb[0], ub[0], x[0]);
+    return shift;
+}
+
+/**
+ * @brief find Lees-Edwards Image of x closest to trg in x and y
+ *
+ * x and trg may be out of range [lb,ub). z is not changed
+ * @tparam Real
+ * @param lb
+ * @param ub
+ * @param offset displacement of the image box at +y
+ * @param x
+ * @param trg
+ * @return int number of boxes x is moved in +y
+ */
+template <class Real>
+inline int findLEImage(const Real lb[3], const Real ub[3], const Real &offset, Real x[3], const Real trg[3]) {
+    const Real Ly = ub[1] - lb[1];
+    const int shift = static_cast<int>(std::round((trg[1] - x[1]) / Ly));
+    x[1] += shift * Ly;
+    x[0] += shift * offset;
+    Real trgx = trg[0];
+    findPBCImage(lb[0], ub[0], x[0], trgx);
+    x[0] += trg[0] - trgx; // findPBCImage wraps trg into [lb,ub)
+    return shift;
+}
+
 /**
  * @brief Get a random point (x,y) in a circle uniformly
  *
@@ -40,6 +40,30 @@ bool testFindPBCImageTrg(double lb, double ub, double x, double trg) {
     return pass;
 }
 
+bool testFindLEImage(double lb[3], double ub[3], double offset, double x[3], double trg[3]) {
+    const double Lx = ub[0] - lb[0];
+    const double Ly = ub[1] - lb[1];
+
+    // wrap into the box, then shift back to the image closest to trg
+    double ximg[3] = {x[0], x[1], x[2]};
+    const int shift = findLEImage(lb, ub, offset, ximg);
+    bool pass = ximg[0] >= lb[0] && ximg[0] < ub[0] && ximg[1] >= lb[1] && ximg[1] < ub[1] && ximg[2] == x[2];
+    double jump = (ximg[0] - x[0] - shift * offset) / Lx; // should be an integer
+    pass = pass && fabs(jump - round(jump)) < 1e-8 && fabs(ximg[1] - x[1] - shift * Ly) < 1e-8;
+
+    double xtrg[3] = {x[0], x[1], x[2]};
+    const int shiftTrg = findLEImage(lb, ub, offset, xtrg, trg);
+    jump = (xtrg[0] - x[0] - shiftTrg * offset) / Lx;
+    pass = pass && fabs(jump - round(jump)) < 1e-8 && fabs(xtrg[1] - x[1] - shiftTrg * Ly) < 1e-8;
+    pass = pass && fabs(xtrg[0] - trg[0]) <= 0.5 * Lx + 1e-8 && fabs(xtrg[1] - trg[1]) <= 0.5 * Ly + 1e-8;
+
+    if (!pass) {
+        printf("%g,%g,%g,%g,%g,%g,%g\n", offset, x[0], x[1], ximg[0], ximg[1], xtrg[0], xtrg[1]);
+    }
+
+    return pass;
+}
+
 int main() {
     bool pass = true;
 
@@ -60,6 +84,15 @@ int main() {
         pass = (pass && testFindPBCImageTrg(lb, ub, x, trg));
     }
 
+    for (int i = 0; i < 1000; i++) {
+        double lb[3] = {-rngPool.getU01() * 10 - 1, -rngPool.getU01() * 10 - 1, 0};
+        double ub[3] = {rngPool.getU01() * 10 + 1, rngPool.getU01() * 10 + 1, 1};
+        double x[3] = {rngPool.getU01() * 100 - 50, rngPool.getU01() * 100 - 50, rngPool.getU01()};
+        double trg[3] = {rngPool.getU01() * 100 - 50, rngPool.getU01() * 100 - 50, rngPool.getU01()};
+        double offset = rngPool.getU01() * 100 - 50;
+        pass = (pass && testFindLEImage(lb, ub, offset, x, trg));
+    }
+
     if (pass) {
         printf("TestPassed\n");
     }
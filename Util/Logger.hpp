@@ -11,15 +11,122 @@
 #ifndef LOGGER_HPP_
 #define LOGGER_HPP_
 
+#include "spdlog/async.h"
 #include "spdlog/cfg/env.h"
+#include "spdlog/sinks/basic_file_sink.h"
+#include "spdlog/sinks/base_sink.h"
 #include "spdlog/sinks/null_sink.h"
 #include "spdlog/sinks/stdout_sinks.h"
 #include "spdlog/spdlog.h"
 
+#include <algorithm>
+#include <cctype>
+#include <map>
 #include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
 
 #include "mpi.h"
 
+/**
+ * @brief count warning messages on the local rank by template, collected by Logger::aggregate()
+ *
+ * The template of a message replaces each run of digits with '#', so that messages printing a step number or a
+ * value, e.g. "CurrentStep {}", count as one entry instead of filling the table with a new entry per step.
+ */
+class WarnCountSink : public spdlog::sinks::base_sink<std::mutex> {
+  public:
+    struct Entry {
+        int count = 0;       ///< number of times
+        std::string example; ///< the last message of this template
+    };
+
+    /**
+     * @brief take the counts since the last call
+     *
+     * @return std::map<std::string, Entry> template and its entry
+     */
+    std::map<std::string, Entry> take() {
+        std::lock_guard<std::mutex> lock(mutex_);
+        std::map<std::string, Entry> result;
+        result.swap(count);
+        return result;
+    }
+
+    /**
+     * @brief replace each run of digits with '#'
+     *
+     * @param text
+     * @return std::string
+     */
+    static std::string getTemplate(const std::string &text) {
+        std::string key;
+        key.reserve(text.size());
+        for (size_t i = 0; i < text.size(); i++) {
+            if (!std::isdigit(static_cast<unsigned char>(text[i]))) {
+                key += text[i];
+            } else if (key.empty() || key.back() != '#') {
+                key += '#';
+            }
+        }
+        return key;
+    }
+
+  protected:
+    void sink_it_(const spdlog::details::log_msg &msg) override {
+        if (msg.level != spdlog::level::warn) {
+            return;
+        }
+        std::string text(msg.payload.data(), msg.payload.size());
+        std::replace(text.begin(), text.end(), '\n', ' ');
+        std::replace(text.begin(), text.end(), '\t', ' ');
+        const std::string key = getTemplate(text);
+        auto it = count.find(key);
+        if (it == count.end()) {
+            if (count.size() >= maxDistinct) {
+                return;
+            }
+            it = count.emplace(key, Entry()).first;
+        }
+        it->second.count++;
+        it->second.example.swap(text);
+    }
+
+    void flush_() override {}
+
+  private:
+    static constexpr size_t maxDistinct = 1000; ///< further distinct templates are dropped until take()
+    std::map<std::string, Entry> count;         ///< template and its entry
+};
+
+/**
+ * @brief logger that counts warnings in the calling thread and writes through an async logger
+ *
+ * The counts are up to date when Logger::aggregate() takes them, the output runs in the background thread.
+ */
+class WarnCountAsyncLogger : public spdlog::logger {
+  public:
+    WarnCountAsyncLogger(const std::string &name, spdlog::sink_ptr sink, std::shared_ptr<WarnCountSink> warnSink_)
+        : spdlog::logger(name), warnSink(std::move(warnSink_)),
+          asyncLogger(std::make_shared<spdlog::async_logger>(name, std::move(sink), spdlog::thread_pool(),
+                                                             spdlog::async_overflow_policy::overrun_oldest)) {
+        asyncLogger->set_level(spdlog::level::trace); // filtered by this logger
+    }
+
+  protected:
+    void sink_it_(const spdlog::details::log_msg &msg) override {
+        warnSink->log(msg);
+        asyncLogger->log(msg.time, msg.source, msg.level, msg.payload);
+    }
+
+    void flush_() override { asyncLogger->flush(); }
+
+  private:
+    std::shared_ptr<WarnCountSink> warnSink;
+    std::shared_ptr<spdlog::async_logger> asyncLogger;
+};
+
 /**
  * @brief utility class
  *
@@ -30,15 +137,18 @@ class Logger {
      * @brief initialize the spdlog
      *
      * @param level default level set to warn, i.e., print warn, err and critical
+     * @param async log through a background thread. the queue overwrites the oldest messages when full,
+     *              so logging never blocks the caller
      */
   public:
-    static void setup_mpi_spdlog(const int level_rank0 = spdlog::level::info) {
+    static void setup_mpi_spdlog(const int level_rank0 = spdlog::level::info, const bool async = false) {
 
         /**
          *  spdlog levels and the what each level means in this code
          *  spdlog::level is different on mpi ranks
          *  on rank 0 level is set by level_rank0
-         *  on other ranks level is set to spdlog::level::err
+         *  on other ranks err and critical are printed,
+         *  and warn is counted and reported on rank 0 by aggregate()
          *  environtment variable SPDLOG_LEVEL is ignored
          *
          * trace = SPDLOG_LEVEL_TRACE,       -> other least important messages
@@ -53,20 +163,24 @@ class Logger {
 
         int rank;
         MPI_Comm_rank(MPI_COMM_WORLD, &rank);
-        // spdlog::logger sink = rank ? spdlog::logger("log", std::make_shared<spdlog::sinks::stdout_sink_st>())
-        //                            : spdlog::logger("log", std::make_shared<spdlog::sinks::null_sink_st>());
-        // sink.set_level(spdlog::level::err);
-        // spdlog::cfg::load_env_levels();
 
-        spdlog::logger sink =
-            spdlog::logger("rank " + std::to_string(rank), std::make_shared<spdlog::sinks::stdout_sink_st>());
+        auto stdoutSink = std::make_shared<spdlog::sinks::stdout_sink_st>();
+        stdoutSink->set_level(rank == 0 ? spdlog::level::trace : spdlog::level::err);
 
-        spdlog::set_default_logger(std::make_shared<spdlog::logger>(sink));
+        const std::string name = "rank " + std::to_string(rank);
+        std::shared_ptr<spdlog::logger> logger;
+        if (async) {
+            if (!spdlog::thread_pool()) {
+                spdlog::init_thread_pool(8192, 1);
+            }
+            logger = std::make_shared<WarnCountAsyncLogger>(name, stdoutSink, getWarnSink());
+        } else {
+            std::vector<spdlog::sink_ptr> sinks = {stdoutSink, getWarnSink()};
+            logger = std::make_shared<spdlog::logger>(name, sinks.begin(), sinks.end());
+        }
+        spdlog::set_default_logger(logger);
 
-        if (rank == 0)
-            spdlog::set_level(static_cast<spdlog::level::level_enum>(level_rank0));
-        else
-            spdlog::set_level(spdlog::level::err);
+        set_level(level_rank0);
     }
 
     static void set_level(const int level_rank0 = spdlog::level::info) {
@@ -75,8 +189,100 @@ class Logger {
         if (rank == 0)
             spdlog::set_level(static_cast<spdlog::level::level_enum>(level_rank0));
         else
-            spdlog::set_level(spdlog::level::err);
+            spdlog::set_level(spdlog::level::warn);
+    }
+
+    /**
+     * @brief report on rank 0 the warnings of other ranks since the last call, deduplicated
+     *
+     * Collective. Messages are grouped by template, see WarnCountSink.
+     * Templates also logged on rank 0 are already printed and are not repeated.
+     */
+    static void aggregate() {
+        int rank, nProcs;
+        MPI_Comm_rank(MPI_COMM_WORLD, &rank);
+        MPI_Comm_size(MPI_COMM_WORLD, &nProcs);
+
+        spdlog::default_logger()->flush();
+        const auto local = getWarnSink()->take();
+        std::string buf;
+        for (const auto &m : local) {
+            buf += std::to_string(m.second.count) + '\t' + m.first + '\t' + m.second.example + '\n';
+        }
+
+        int len = buf.size();
+        std::vector<int> lens(nProcs, 0), disp(nProcs + 1, 0);
+        MPI_Gather(&len, 1, MPI_INT, lens.data(), 1, MPI_INT, 0, MPI_COMM_WORLD);
+        for (int r = 0; r < nProcs; r++) {
+            disp[r + 1] = disp[r] + lens[r];
+        }
+        std::vector<char> all(rank == 0 ? disp[nProcs] : 0);
+        MPI_Gatherv(buf.data(), len, MPI_CHAR, all.data(), lens.data(), disp.data(), MPI_CHAR, 0, MPI_COMM_WORLD);
+        if (rank != 0) {
+            return;
+        }
+
+        // template -> number of ranks, number of times, last example
+        struct Merged {
+            int nRanks = 0;
+            int count = 0;
+            std::string example;
+        };
+        std::map<std::string, Merged> merged;
+        for (int r = 1; r < nProcs; r++) {
+            const std::string text(all.data() + disp[r], lens[r]);
+            size_t pos = 0;
+            while (pos < text.size()) {
+                const size_t tab = text.find('\t', pos);
+                const size_t tab2 = text.find('\t', tab + 1);
+                const size_t end = text.find('\n', tab2);
+                const std::string key = text.substr(tab + 1, tab2 - tab - 1);
+                if (local.find(key) == local.end()) {
+                    auto &entry = merged[key];
+                    entry.nRanks++;
+                    entry.count += std::stoi(text.substr(pos, tab - pos));
+                    entry.example = text.substr(tab2 + 1, end - tab2 - 1);
+                }
+                pos = end + 1;
+            }
+        }
+        for (const auto &m : merged) {
+            spdlog::warn("{} times on {} ranks: {}", m.second.count, m.second.nRanks, m.second.example);
+        }
+    }
+
+    /**
+     * @brief a logger writing to a file of the local rank only
+     *
+     * Created on the first call, through the background thread of setup_mpi_spdlog() if async.
+     * Not collective.
+     * @param name unique name of the logger
+     * @param filename
+     * @return std::shared_ptr<spdlog::logger>
+     */
+    static std::shared_ptr<spdlog::logger> get_rank_file_logger(const std::string &name, const std::string &filename) {
+        auto logger = spdlog::get(name);
+        if (logger) {
+            return logger;
+        }
+        auto sink = std::make_shared<spdlog::sinks::basic_file_sink_mt>(filename);
+        if (spdlog::thread_pool()) {
+            logger = std::make_shared<spdlog::async_logger>(name, sink, spdlog::thread_pool(),
+                                                            spdlog::async_overflow_policy::block);
+        } else {
+            logger = std::make_shared<spdlog::logger>(name, sink);
+        }
+        logger->set_pattern("%v");
+        logger->set_level(spdlog::level::trace);
+        spdlog::register_logger(logger);
+        return logger;
+    }
+
+  private:
+    static std::shared_ptr<WarnCountSink> getWarnSink() {
+        static auto sink = std::make_shared<WarnCountSink>();
+        return sink;
     }
 };
 
-#endif
\ No newline at end of file
+#endif
@@ -0,0 +1,224 @@
+/**
+ * @file MemoryTracker.hpp
+ * @brief Per-subsystem memory accounting with peak and soft-limit reporting
+ *
+ */
+#ifndef MEMORYTRACKER_HPP_
+#define MEMORYTRACKER_HPP_
+
+#include "Util/Logger.hpp"
+
+#include <algorithm>
+#include <array>
+#include <cstdio>
+#include <cstring>
+#include <map>
+#include <string>
+#include <vector>
+
+#include <mpi.h>
+
+/**
+ * @brief track the bytes held by each subsystem on the local rank
+ *
+ * Usage:
+ *   set(category, bytes) for each subsystem, then endPhase(phase), repeated for each phase of a timestep.
+ *   report() every a few timesteps, collective on MPI_COMM_WORLD.
+ * Each phase keeps the peak over all timesteps since the last report().
+ * The tracked bytes are the sizes of the data structures, i.e., a lower bound of the allocated memory.
+ * The resident set size and its high water mark from /proc/self/status are reported alongside.
+ */
+class MemoryTracker {
+  public:
+    MemoryTracker() = default;
+    ~MemoryTracker() = default;
+
+    /**
+     * @brief warn if the tracked bytes or the resident set size exceed this limit on any rank
+     *
+     * @param softLimitBytes_ 0 to disable
+     */
+    void setSoftLimit(size_t softLimitBytes_) { softLimitBytes = softLimitBytes_; }
+
+    /**
+     * @brief set the current bytes of a category, and update its peak
+     *
+     * @param category
+     * @param bytes
+     */
+    void set(const std::string &category, size_t bytes) {
+        auto &usage = categoryUsage[category];
+        usage[0] = bytes;
+        usage[1] = std::max(usage[1], bytes);
+    }
+
+    /**
+     * @brief total of current bytes of all categories
+     *
+     * @return size_t
+     */
+    size_t getTotal() const {
+        size_t total = 0;
+        for (const auto &cat : categoryUsage) {
+            total += cat.second[0];
+        }
+        return total;
+    }
+
+    /**
+     * @brief mark the end of a phase, record the current total and check the soft limit locally
+     *
+     * @param phase
+     */
+    void endPhase(const std::string &phase) {
+        const size_t total = getTotal();
+        const size_t rss = getProcStatus("VmRSS:");
+        auto it = std::find_if(phaseUsage.begin(), phaseUsage.end(),
+                               [&](const decltype(phaseUsage)::value_type &p) { return p.first == phase; });
+        if (it == phaseUsage.end()) {
+            phaseUsage.push_back(std::make_pair(phase, std::array<size_t, 2>{{total, rss}}));
+        } else {
+            it->second[0] = std::max(it->second[0], total);
+            it->second[1] = std::max(it->second[1], rss);
+        }
+        // warn once when crossing the limit, rearmed when the usage drops below it
+        const bool above = softLimitBytes > 0 && std::max(total, rss) > softLimitBytes;
+        if (above && !aboveSoftLimit) {
+            int rank = 0;
+            MPI_Comm_rank(MPI_COMM_WORLD, &rank);
+            // warnings of other ranks are collected by Logger::aggregate()
+            spdlog::warn("rank {} memory above soft limit in phase {}: tracked {:.1f} MB, resident {:.1f} MB, "
+                         "limit {:.1f} MB",
+                         rank, phase, toMB(total), toMB(rss), toMB(softLimitBytes));
+        }
+        aboveSoftLimit = above;
+    }
+
+    /**
+     * @brief if the usage at the last endPhase() is above the soft limit
+     *
+     */
+    bool isAboveSoftLimit() const { return aboveSoftLimit; }
+
+    /**
+     * @brief current and peak bytes of a category
+     *
+     * @param category
+     * @return std::array<size_t, 2> zeros if the category is not set
+     */
+    std::array<size_t, 2> getUsage(const std::string &category) const {
+        auto it = categoryUsage.find(category);
+        return it == categoryUsage.end() ? std::array<size_t, 2>{{0, 0}} : it->second;
+    }
+
+    /**
+     * @brief peak tracked and resident bytes of a phase since the last report()
+     *
+     * @param phase
+     * @return std::array<size_t, 2> zeros if the phase is not recorded
+     */
+    std::array<size_t, 2> getPhaseUsage(const std::string &phase) const {
+        for (const auto &p : phaseUsage) {
+            if (p.first == phase) {
+                return p.second;
+            }
+        }
+        return std::array<size_t, 2>{{0, 0}};
+    }
+
+    /**
+     * @brief reduce the phase peaks recorded since the last report() over all ranks and log on rank 0
+     *
+     * Collective, all ranks must have recorded the same phases in the same order
+     */
+    void report() {
+        int nProcs = 1;
+        MPI_Comm_size(MPI_COMM_WORLD, &nProcs);
+
+        // per phase: max and average over ranks, of tracked total and resident size
+        const int nPhase = phaseUsage.size();
+        std::vector<double> localVal(2 * nPhase);
+        for (int p = 0; p < nPhase; p++) {
+            localVal[2 * p] = phaseUsage[p].second[0];
+            localVal[2 * p + 1] = phaseUsage[p].second[1];
+        }
+        std::vector<double> maxVal(2 * nPhase, 0);
+        MPI_Allreduce(localVal.data(), maxVal.data(), 2 * nPhase, MPI_DOUBLE, MPI_MAX, MPI_COMM_WORLD);
+        std::vector<double> sumVal(2 * nPhase, 0);
+        MPI_Allreduce(localVal.data(), sumVal.data(), 2 * nPhase, MPI_DOUBLE, MPI_SUM, MPI_COMM_WORLD);
+        for (int p = 0; p < nPhase; p++) {
+            spdlog::info("RECORD: MEM {} tracked max {:.1f} MB avg {:.1f} MB, resident max {:.1f} MB avg {:.1f} MB",
+                         phaseUsage[p].first, toMB(maxVal[2 * p]), toMB(sumVal[2 * p] / nProcs),
+                         toMB(maxVal[2 * p + 1]), toMB(sumVal[2 * p + 1] / nProcs));
+        }
+
+        // per category: max current and max peak over ranks
+        const int nCat = categoryUsage.size();
+        std::vector<double> localCat(2 * nCat), maxCat(2 * nCat, 0);
+        int c = 0;
+        for (const auto &cat : categoryUsage) {
+            localCat[2 * c] = cat.second[0];
+            localCat[2 * c + 1] = cat.second[1];
+            c++;
+        }
+        MPI_Allreduce(localCat.data(), maxCat.data(), 2 * nCat, MPI_DOUBLE, MPI_MAX, MPI_COMM_WORLD);
+        c = 0;
+        for (const auto &cat : categoryUsage) {
+            spdlog::info("RECORD: MEM {} current max {:.1f} MB, peak max {:.1f} MB", cat.first, toMB(maxCat[2 * c]),
+                         toMB(maxCat[2 * c + 1]));
+            c++;
+        }
+
+        // per rank, for locating imbalance
+        std::vector<double> localTotal = {static_cast<double>(getTotal()),
+                                          static_cast<double>(getProcStatus("VmHWM:"))};
+        std::vector<double> rankTotal(2 * nProcs, 0);
+        MPI_Gather(localTotal.data(), 2, MPI_DOUBLE, rankTotal.data(), 2, MPI_DOUBLE, 0, MPI_COMM_WORLD);
+        for (int r = 0; r < nProcs; r++) {
+            spdlog::debug("RECORD: MEM rank {} tracked {:.1f} MB, resident peak {:.1f} MB", r, toMB(rankTotal[2 * r]),
+                          toMB(rankTotal[2 * r + 1]));
+        }
+
+        clearPhase();
+    }
+
+    /**
+     * @brief discard the phase peaks without reporting
+     *
+     */
+    void clearPhase() { phaseUsage.clear(); }
+
+    /**
+     * @brief read a memory entry in kB from /proc/self/status
+     *
+     * @param key "VmRSS:" for resident set size, "VmHWM:" for its high water mark
+     * @return size_t bytes, 0 if not available
+     */
+    static size_t getProcStatus(const char *key) {
+        size_t kB = 0;
+        FILE *fp = fopen("/proc/self/status", "r");
+        if (fp == nullptr) {
+            return 0;
+        }
+        char line[256];
+        const int keyLength = strlen(key);
+        while (fgets(line, sizeof(line), fp) != nullptr) {
+            if (strncmp(line, key, keyLength) == 0) {
+                sscanf(line + keyLength, "%zu", &kB);
+                break;
+            }
+        }
+        fclose(fp);
+        return kB * 1024;
+    }
+
+  private:
+    size_t softLimitBytes = 0;                                             ///< 0 for no limit
+    bool aboveSoftLimit = false;                                           ///< latched at the last endPhase()
+    std::map<std::string, std::array<size_t, 2>> categoryUsage;            ///< current and peak bytes
+    std::vector<std::pair<std::string, std::array<size_t, 2>>> phaseUsage; ///< peak tracked and resident bytes
+
+    static double toMB(double bytes) { return bytes / (1024.0 * 1024.0); }
+};
+
+#endif
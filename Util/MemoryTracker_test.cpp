@@ -0,0 +1,66 @@
+#include "MemoryTracker.hpp"
+
+#include <cstdio>
+
+bool testBookkeeping() {
+    MemoryTracker tracker;
+    tracker.set("A", 100);
+    tracker.set("B", 50);
+    tracker.endPhase("P1");
+    tracker.set("A", 300);
+    tracker.endPhase("P2");
+    tracker.set("A", 20);
+    tracker.endPhase("P1");
+
+    bool pass = true;
+    pass = pass && tracker.getTotal() == 70;
+    pass = pass && tracker.getUsage("A")[0] == 20 && tracker.getUsage("A")[1] == 300;
+    pass = pass && tracker.getUsage("B")[0] == 50 && tracker.getUsage("B")[1] == 50;
+    pass = pass && tracker.getUsage("C")[0] == 0 && tracker.getUsage("C")[1] == 0;
+    // phase peaks are the max total over repeated phases
+    pass = pass && tracker.getPhaseUsage("P1")[0] == 150 && tracker.getPhaseUsage("P2")[0] == 350;
+    pass = pass && tracker.getPhaseUsage("P1")[1] > 0;
+
+    tracker.clearPhase();
+    pass = pass && tracker.getPhaseUsage("P1")[0] == 0;
+    // category peaks are kept after clearPhase()
+    pass = pass && tracker.getUsage("A")[1] == 300;
+    if (!pass) {
+        printf("bookkeeping failed\n");
+    }
+    return pass;
+}
+
+bool testSoftLimit() {
+    MemoryTracker tracker;
+    const size_t gB = 1024UL * 1024UL * 1024UL;
+    const size_t limit = MemoryTracker::getProcStatus("VmRSS:") + gB;
+    tracker.setSoftLimit(limit);
+
+    bool pass = true;
+    tracker.set("A", 0);
+    tracker.endPhase("P");
+    pass = pass && !tracker.isAboveSoftLimit();
+    // latched above the limit, warned once
+    tracker.set("A", 2 * limit);
+    tracker.endPhase("P");
+    tracker.endPhase("P");
+    pass = pass && tracker.isAboveSoftLimit();
+    // rearmed below the limit
+    tracker.set("A", 0);
+    tracker.endPhase("P");
+    pass = pass && !tracker.isAboveSoftLimit();
+    if (!pass) {
+        printf("soft limit failed\n");
+    }
+    return pass;
+}
+
+int main(int argc, char **argv) {
+    MPI_Init(&argc, &argv);
+    Logger::setup_mpi_spdlog();
+    const bool pass = testBookkeeping() && testSoftLimit();
+    printf(pass ? "TestPassed\n" : "Error\n");
+    MPI_Finalize();
+    return 0;
+}
@@ -0,0 +1,332 @@
+/**
+ * @file ReproSum.hpp
+ * @brief Floating point sums independent of the order of terms, the number of openmp threads and mpi ranks
+ *
+ */
+#ifndef REPROSUM_HPP_
+#define REPROSUM_HPP_
+
+#include <algorithm>
+#include <cmath>
+#include <map>
+#include <vector>
+
+#include <mpi.h>
+#include <omp.h>
+
+/**
+ * @brief reproducible sums
+ *
+ * sum() uses binned pre-rounding, as in ReproBLAS (Demmel & Nguyen, 2015).
+ * Bin b collects the parts of terms that are multiples of 2^(binWidth b). The bins are aligned to the same lattice
+ * on all threads and ranks, so each block of terms picks its own top bin from its local max |term|, and partial
+ * sums are merged bin by bin. A bin is a pair of a sum and a count of carries, so all additions are exact for any
+ * number of terms, and the result does not depend on the order of terms, the number of openmp threads or the number
+ * of mpi ranks. The partial sums of all components are merged in a single MPI_Allreduce with a custom reduction.
+ * Each term is rounded to the nFold bins below the global top bin, the error is at most 2^-79 max|term| per term.
+ * Terms of 2^999 or larger, Inf and NaN fall back to a plain sum, which is NaN or Inf in practice.
+ * Must not be compiled with -ffast-math, which reorders (c + x) - c.
+ *
+ * sortedSum() sums a short local list in a canonical order, for matrix rows.
+ */
+class ReproSum {
+  public:
+    static constexpr int nFold = 3;       ///< number of bins kept below and including the top bin
+    static constexpr int binWidth = 40;   ///< bin b collects multiples of 2^(binWidth b)
+    static constexpr int blockSize = 512; ///< terms evaluated at a time, kept in cache for the max and the deposit
+
+    /**
+     * @brief sum of term(i, value) for i in [0,n) on all ranks of comm
+     *
+     * collective on comm
+     * @tparam Term void(int i, double *value), writes nComp values for term i
+     * @param n number of local terms
+     * @param nComp number of components, summed independently
+     * @param term
+     * @param result nComp sums, the same on all ranks
+     * @param comm
+     */
+    template <class Term>
+    static void sum(const int n, const int nComp, const Term &term, double *result, MPI_Comm comm = MPI_COMM_WORLD) {
+        std::vector<double> &record = getBuffer(0);
+        initRecord(record, nComp);
+
+#pragma omp parallel if (n > blockSize)
+        {
+            // reused across calls, no allocation after the first call
+            std::vector<double> &value = getBuffer(1);
+            std::vector<double> &recordThread = getBuffer(2);
+            value.resize(blockSize * nComp);
+            initRecord(recordThread, nComp);
+            const int nBlock = (n + blockSize - 1) / blockSize;
+#pragma omp for schedule(static)
+            for (int b = 0; b < nBlock; b++) {
+                const int begin = b * blockSize;
+                const int m = std::min(blockSize, n - begin);
+                for (int i = 0; i < m; i++) {
+                    term(begin + i, value.data() + i * nComp);
+                }
+                for (int c = 0; c < nComp; c++) {
+                    depositBlock(value.data() + c, m, nComp, recordThread.data() + c * binLength);
+                }
+            }
+#pragma omp critical
+            mergeRecord(recordThread.data(), record.data(), nComp);
+        }
+
+        MPI_Allreduce(MPI_IN_PLACE, record.data(), 1, getRecordType(nComp * binLength), getMergeOp(), comm);
+
+        for (int c = 0; c < nComp; c++) {
+            const double *bin = record.data() + c * binLength;
+            const int top = bin[0];
+            if (top == specialBin) {
+                result[c] = bin[1]; // NaN or Inf anyway
+                continue;
+            }
+            // fixed order, from the top bin. carry * unit and sum are exact, their sum is rounded once
+            double s = 0;
+            for (int k = 0; k < nFold; k++) {
+                s += bin[2 + 2 * k] * getCarryUnit(top - k) + bin[1 + 2 * k];
+            }
+            result[c] = s;
+        }
+    }
+
+    /**
+     * @brief sum of term(i) for i in [0,n) on all ranks of comm
+     *
+     * @tparam Term double(int i)
+     * @param n number of local terms
+     * @param term
+     * @param comm
+     * @return double the same on all ranks
+     */
+    template <class Term>
+    static double sum(const int n, const Term &term, MPI_Comm comm = MPI_COMM_WORLD) {
+        double result = 0;
+        sum(n, 1, [&](int i, double *value) { *value = term(i); }, &result, comm);
+        return result;
+    }
+
+    /**
+     * @brief dot product of two distributed arrays
+     *
+     * @param x
+     * @param y
+     * @param n local length
+     * @param comm
+     * @return double
+     */
+    static double dot(const double *x, const double *y, const int n, MPI_Comm comm = MPI_COMM_WORLD) {
+        return sum(n, [&](int i) { return x[i] * y[i]; }, comm);
+    }
+
+    /**
+     * @brief sum of a short local list in a canonical order, independent of the input order
+     *
+     * @param x sorted in place
+     * @param n
+     * @return double
+     */
+    static double sortedSum(double *x, const int n) {
+        // -0 before +0, so that the sign of a zero sum is also canonical
+        std::sort(x, x + n,
+                  [](double a, double b) { return a < b || (a == b && std::signbit(a) && !std::signbit(b)); });
+        double s = 0;
+        for (int i = 0; i < n; i++) {
+            s += x[i];
+        }
+        return s;
+    }
+
+  private:
+    // each component of a record is {top bin, then sum and carry count of nFold bins}
+    static constexpr int binLength = 1 + 2 * nFold;
+    static constexpr int emptyBin = -1000;  ///< top bin of an all zero record
+    static constexpr int specialBin = 1000; ///< top bin of a plain sum with Inf, NaN or huge terms
+
+    /**
+     * @brief per thread buffers, reused across calls
+     *
+     * 0 for the record of the calling thread, 1 and 2 for the values and the record of each thread in the sum
+     * @param index
+     * @return std::vector<double>&
+     */
+    static std::vector<double> &getBuffer(const int index) {
+        thread_local std::vector<double> buffer[3];
+        return buffer[index];
+    }
+
+    static void initRecord(std::vector<double> &record, const int nComp) {
+        record.assign(nComp * binLength, 0);
+        for (int c = 0; c < nComp; c++) {
+            record[c * binLength] = emptyBin;
+        }
+    }
+
+    /**
+     * @brief 1.5 * 2^52 times the grid of bin b, (C + x) - C rounds x to the grid
+     *
+     * Below the smallest subnormal the grid is 0 and the bin takes the exact remainder.
+     * @param b
+     * @return double
+     */
+    static double getBinShift(const int b) { return b * binWidth < -1074 ? 0 : std::ldexp(1.5, 52 + b * binWidth); }
+
+    /**
+     * @brief 2^50 times the grid of bin b, the sum of a bin is kept within half of it
+     *
+     * @param b
+     * @return double
+     */
+    static double getCarryUnit(const int b) { return std::ldexp(1.0, std::max(b * binWidth, -1074) + 50); }
+
+    /**
+     * @brief add the nFold bin sums of a block of terms to one component of a record
+     *
+     * @param value terms of the block, with stride
+     * @param m number of terms, at most blockSize
+     * @param stride
+     * @param bin one component of a record
+     */
+    static void depositBlock(const double *value, const int m, const int stride, double *bin) {
+        // 4 independent max, the latency of a single one dominates otherwise
+        double max0 = 0, max1 = 0, max2 = 0, max3 = 0;
+        double special = 0; // NaN if any term is Inf or NaN
+        const int m4 = m / 4;
+#pragma omp simd reduction(max : max0, max1, max2, max3) reduction(+ : special)
+        for (int i = 0; i < m4; i++) {
+            const double x0 = value[i * stride];
+            const double x1 = value[(i + m4) * stride];
+            const double x2 = value[(i + 2 * m4) * stride];
+            const double x3 = value[(i + 3 * m4) * stride];
+            max0 = std::max(max0, std::fabs(x0));
+            max1 = std::max(max1, std::fabs(x1));
+            max2 = std::max(max2, std::fabs(x2));
+            max3 = std::max(max3, std::fabs(x3));
+            special += (x0 * 0 + x1 * 0) + (x2 * 0 + x3 * 0);
+        }
+        for (int i = 4 * m4; i < m; i++) {
+            max0 = std::max(max0, std::fabs(value[i * stride]));
+            special += value[i * stride] * 0;
+        }
+        const double maxAbs = std::max(std::max(max0, max1), std::max(max2, max3));
+        if (maxAbs == 0 && !std::isnan(special)) {
+            return;
+        }
+
+        double block[binLength] = {0};
+        // 2^999 has the top bin 25, the first with an infinite 1.5 * 2^(52 + binWidth b)
+        if (std::isnan(special) || maxAbs >= 0x1p999) {
+            block[0] = specialBin;
+            for (int i = 0; i < m; i++) {
+                block[1] += value[i * stride];
+            }
+        } else {
+            // the smallest top bin with max|term| <= 2^(binWidth - 1) of its grid
+            // so each bin sum of the block is below 2^49 of its grid, and exact
+            const int top = static_cast<int>(std::ceil(double(std::ilogb(maxAbs) + 2 - binWidth) / binWidth));
+            static_assert(nFold == 3, "one accumulator per bin");
+            const double C0 = getBinShift(top);
+            const double C1 = getBinShift(top - 1);
+            const double C2 = getBinShift(top - 2);
+            double s0 = 0, s1 = 0, s2 = 0;
+            // the additions to each bin are exact, so the simd reduction does not change the result
+#pragma omp simd reduction(+ : s0, s1, s2)
+            for (int i = 0; i < m; i++) {
+                double x = value[i * stride];
+                double q = (C0 + x) - C0;
+                s0 += q;
+                x -= q;
+                q = (C1 + x) - C1;
+                s1 += q;
+                x -= q;
+                s2 += (C2 + x) - C2;
+            }
+            block[0] = top;
+            block[1] = s0;
+            block[3] = s1;
+            block[5] = s2;
+        }
+        mergeBin(block, bin);
+    }
+
+    /**
+     * @brief add the bins of in to inout, keeping the nFold bins below the larger top bin
+     *
+     * Exact, and therefore commutative and associative.
+     * Each bin sum is within 2^49 of its grid, so the sum of two is exact. The carry brings it back.
+     * @param in one component of a record
+     * @param inout one component of a record
+     */
+    static void mergeBin(const double *in, double *inout) {
+        const int topIn = in[0];
+        const int topOut = inout[0];
+        const int top = std::max(topIn, topOut);
+        double merged[2 * nFold];
+        for (int k = 0; k < nFold; k++) {
+            const int kIn = topIn - top + k;
+            const int kOut = topOut - top + k;
+            // bins above the top of a record are 0, bins below its last bin are dropped
+            const bool hasIn = kIn >= 0 && kIn < nFold;
+            const bool hasOut = kOut >= 0 && kOut < nFold;
+            double s = (hasIn ? in[1 + 2 * kIn] : 0) + (hasOut ? inout[1 + 2 * kOut] : 0);
+            double carry = (hasIn ? in[2 + 2 * kIn] : 0) + (hasOut ? inout[2 + 2 * kOut] : 0);
+            if (top != specialBin) {
+                const double unit = getCarryUnit(top - k);
+                const double c = std::nearbyint(s / unit);
+                s -= c * unit;
+                carry += c;
+            }
+            merged[2 * k] = s;
+            merged[2 * k + 1] = carry;
+        }
+        inout[0] = top;
+        std::copy(merged, merged + 2 * nFold, inout + 1);
+    }
+
+    static void mergeRecord(const double *in, double *inout, const int nComp) {
+        for (int c = 0; c < nComp; c++) {
+            mergeBin(in + c * binLength, inout + c * binLength);
+        }
+    }
+
+    static void mergeRecordOp(void *in, void *inout, int *len, MPI_Datatype *type) {
+        int size = 0;
+        MPI_Type_size(*type, &size);
+        const int recordLength = size / sizeof(double);
+        for (int r = 0; r < *len; r++) {
+            mergeRecord(static_cast<const double *>(in) + r * recordLength,
+                        static_cast<double *>(inout) + r * recordLength, recordLength / binLength);
+        }
+    }
+
+    /**
+     * @brief one record as a single MPI element, so that the reduction never splits it
+     *
+     * @param recordLength
+     * @return MPI_Datatype
+     */
+    static MPI_Datatype getRecordType(const int recordLength) {
+        static std::map<int, MPI_Datatype> recordType;
+        auto it = recordType.find(recordLength);
+        if (it == recordType.end()) {
+            MPI_Datatype type;
+            MPI_Type_contiguous(recordLength, MPI_DOUBLE, &type);
+            MPI_Type_commit(&type);
+            it = recordType.emplace(recordLength, type).first;
+        }
+        return it->second;
+    }
+
+    static MPI_Op getMergeOp() {
+        static MPI_Op op = [] {
+            MPI_Op merge;
+            MPI_Op_create(&mergeRecordOp, 1, &merge);
+            return merge;
+        }();
+        return op;
+    }
+};
+
+#endif
@@ -0,0 +1,154 @@
+#include "ReproSum.hpp"
+
+#include <algorithm>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <random>
+
+constexpr int nGlobal = 100003;
+
+// term g of the global list, wide range of magnitudes and cancellation
+double getTerm(int g) {
+    std::mt19937_64 gen(g);
+    std::uniform_real_distribution<double> dis(-1, 1);
+    const double x = dis(gen);
+    const int e = static_cast<int>(gen() % 61) - 30;
+    return std::ldexp(x, e);
+}
+
+bool sameBits(double a, double b) { return std::memcmp(&a, &b, sizeof(double)) == 0; }
+
+/**
+ * @brief sum all global terms distributed over the ranks of comm, with local order shuffled
+ *
+ * @param comm
+ * @param nThreads
+ * @param result sum and dot
+ */
+void sumOnComm(MPI_Comm comm, int nThreads, double *result) {
+    int rank = 0, nProcs = 1;
+    MPI_Comm_rank(comm, &rank);
+    MPI_Comm_size(comm, &nProcs);
+    const int begin = static_cast<long>(nGlobal) * rank / nProcs;
+    const int end = static_cast<long>(nGlobal) * (rank + 1) / nProcs;
+    std::vector<double> x;
+    for (int g = begin; g < end; g++) {
+        x.push_back(getTerm(g));
+    }
+    std::shuffle(x.begin(), x.end(), std::mt19937(rank + 7 * nProcs + 13 * nThreads));
+    std::vector<double> y(x.size());
+    for (size_t i = 0; i < x.size(); i++) {
+        y[i] = 1.0 / (1 + std::fabs(x[i])); // not symmetric in x
+    }
+
+    omp_set_num_threads(nThreads);
+    const int n = x.size();
+    result[0] = ReproSum::sum(n, [&](int i) { return x[i]; }, comm);
+    result[1] = ReproSum::dot(x.data(), y.data(), n, comm);
+}
+
+bool testRanks() {
+    int worldRank = 0, worldSize = 1;
+    MPI_Comm_rank(MPI_COMM_WORLD, &worldRank);
+    MPI_Comm_size(MPI_COMM_WORLD, &worldSize);
+    const int maxThreads = omp_get_max_threads();
+
+    // reference sum in long double on every rank
+    long double refSum = 0, absSum = 0;
+    for (int g = 0; g < nGlobal; g++) {
+        refSum += getTerm(g);
+        absSum += std::fabs(getTerm(g));
+    }
+
+    bool pass = true;
+    double first[2] = {0, 0};
+    bool hasFirst = false;
+    for (int size : {1, 2, 4}) {
+        if (size > worldSize) {
+            continue;
+        }
+        // split into groups of size ranks, the remaining ranks do not participate
+        const int nGroup = worldSize / size;
+        const int color = worldRank < nGroup * size ? worldRank / size : MPI_UNDEFINED;
+        MPI_Comm comm;
+        MPI_Comm_split(MPI_COMM_WORLD, color, worldRank, &comm);
+        if (comm == MPI_COMM_NULL) {
+            continue;
+        }
+        for (int nThreads : {1, maxThreads}) {
+            double result[2];
+            sumOnComm(comm, nThreads, result);
+            if (!hasFirst) {
+                std::copy(result, result + 2, first);
+                hasFirst = true;
+            }
+            if (!sameBits(result[0], first[0]) || !sameBits(result[1], first[1])) {
+                printf("%d ranks %d threads: %.17g %.17g differ from %.17g %.17g\n", size, nThreads, result[0],
+                       result[1], first[0], first[1]);
+                pass = false;
+            }
+        }
+        MPI_Comm_free(&comm);
+    }
+    omp_set_num_threads(maxThreads);
+
+    if (std::fabs(first[0] - static_cast<double>(refSum)) > 1e-14 * static_cast<double>(absSum)) {
+        printf("sum %.17g, reference %.17g\n", first[0], static_cast<double>(refSum));
+        pass = false;
+    }
+
+    int passLocal = pass, passGlobal = 0;
+    MPI_Allreduce(&passLocal, &passGlobal, 1, MPI_INT, MPI_MIN, MPI_COMM_WORLD);
+    return passGlobal;
+}
+
+bool testSpecial() {
+    // all zero, and a single Inf
+    const double zero = ReproSum::sum(10, [](int) { return 0.0; });
+    int rank = 0;
+    MPI_Comm_rank(MPI_COMM_WORLD, &rank);
+    const double inf = ReproSum::sum(rank == 0 ? 1 : 0, [](int) { return HUGE_VAL; });
+    return zero == 0 && std::isinf(inf);
+}
+
+// sums that need carries between blocks, subnormal terms, and a zero component
+bool testExact() {
+    int rank = 0, nProcs = 1;
+    MPI_Comm_rank(MPI_COMM_WORLD, &rank);
+    MPI_Comm_size(MPI_COMM_WORLD, &nProcs);
+    const int n = static_cast<long>(nGlobal) * (rank + 1) / nProcs - static_cast<long>(nGlobal) * rank / nProcs;
+    double result[3];
+    ReproSum::sum(
+        n, 3,
+        [](int, double *value) {
+            value[0] = 0.75;
+            value[1] = 0x1p-1070;
+            value[2] = 0;
+        },
+        result);
+    return result[0] == 0.75 * nGlobal && result[1] == nGlobal * 0x1p-1070 && result[2] == 0;
+}
+
+bool testSortedSum() {
+    std::vector<double> x;
+    for (int g = 0; g < 30; g++) {
+        x.push_back(getTerm(g));
+    }
+    std::vector<double> y = x;
+    std::reverse(y.begin(), y.end());
+    std::shuffle(x.begin(), x.end(), std::mt19937(1));
+    return sameBits(ReproSum::sortedSum(x.data(), x.size()), ReproSum::sortedSum(y.data(), y.size()));
+}
+
+int main(int argc, char **argv) {
+    MPI_Init(&argc, &argv);
+    const bool pass = testRanks() && testSpecial() && testExact() && testSortedSum();
+    int rank = 0;
+    MPI_Comm_rank(MPI_COMM_WORLD, &rank);
+    if (rank == 0) {
+        printf(pass ? "TestPassed\n" : "Error\n");
+    }
+    MPI_Finalize();
+    return 0;
+}
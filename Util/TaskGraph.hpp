@@ -0,0 +1,245 @@
+/**
+ * @file TaskGraph.hpp
+ * @brief A small dependency graph of master-only tasks and chunked parallel loops, executed in one parallel region
+ *
+ */
+#ifndef TASKGRAPH_HPP_
+#define TASKGRAPH_HPP_
+
+#include <algorithm>
+#include <atomic>
+#include <cassert>
+#include <functional>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <omp.h>
+
+/**
+ * @brief execute a dependency graph of tasks with openmp threads
+ *
+ * Two kinds of nodes:
+ *   master nodes run on thread 0 only, as MPI is only guaranteed to be callable from the thread that initialized it.
+ *   loop nodes are split into chunks, and any thread grabs the next chunk of any ready loop node.
+ * While thread 0 is inside a master node, e.g., waiting for MPI, the other threads work on ready loop chunks.
+ * Node bodies run inside a parallel region, so nested openmp constructs inside them run on one thread.
+ *
+ * Idle threads poll the ready nodes and yield between polls.
+ *
+ * run(false) executes the nodes one by one in the order they are added, each loop node as a separate
+ * fork-join parallel region, for comparison and debugging.
+ * Both modes record the idle thread time = nThreads * wall time - sum of time spent in node bodies.
+ */
+class TaskGraph {
+  public:
+    /**
+     * @brief body of a loop node, executing indices [begin,end) on thread threadId
+     *
+     */
+    using LoopBody = std::function<void(int begin, int end, int threadId)>;
+
+    TaskGraph() = default;
+    ~TaskGraph() = default;
+
+    /**
+     * @brief add a node executed by thread 0
+     *
+     * @param name
+     * @param body
+     * @param deps indices of nodes that must finish before this one, must be added before this node
+     * @return int index of this node
+     */
+    int addMaster(const std::string &name, const std::function<void()> &body, const std::vector<int> &deps = {}) {
+        Node node;
+        node.name = name;
+        node.masterBody = body;
+        node.nChunk = 1;
+        return addNode(node, deps);
+    }
+
+    /**
+     * @brief add a loop node over indices [0,n)
+     *
+     * @param name
+     * @param n number of indices
+     * @param chunk number of indices per chunk
+     * @param body
+     * @param deps indices of nodes that must finish before this one, must be added before this node
+     * @return int index of this node
+     */
+    int addLoop(const std::string &name, int n, int chunk, const LoopBody &body, const std::vector<int> &deps = {}) {
+        Node node;
+        node.name = name;
+        node.loopBody = body;
+        node.n = n;
+        node.chunk = std::max(chunk, 1);
+        node.nChunk = std::max((n + node.chunk - 1) / node.chunk, 1); // an empty loop is one empty chunk
+        return addNode(node, deps);
+    }
+
+    /**
+     * @brief execute all nodes, must be called outside of a parallel region
+     *
+     * @param overlap true for the dependency driven scheduler, false for fork-join in the order of addition
+     */
+    void run(bool overlap = true) {
+        const int nThreads = omp_get_max_threads();
+        busyTime.assign(nThreads, 0);
+        const double start = omp_get_wtime();
+        if (overlap) {
+            runOverlap(nThreads);
+        } else {
+            runForkJoin(nThreads);
+        }
+        wallTime = omp_get_wtime() - start;
+    }
+
+    /**
+     * @brief remove all nodes
+     *
+     */
+    void clear() { nodes.clear(); }
+
+    int getNodeNumber() const { return nodes.size(); }
+
+    /**
+     * @brief wall time of the last run()
+     *
+     * @return double seconds
+     */
+    double getWallTime() const { return wallTime; }
+
+    /**
+     * @brief total idle thread time of the last run()
+     *
+     * @return double thread-seconds
+     */
+    double getIdleTime() const {
+        double busy = 0;
+        for (auto t : busyTime) {
+            busy += t;
+        }
+        return std::max(wallTime * busyTime.size() - busy, 0.0);
+    }
+
+    /**
+     * @brief idle thread time / (nThreads * wall time) of the last run()
+     *
+     * @return double
+     */
+    double getIdleFraction() const {
+        return wallTime > 0 && !busyTime.empty() ? getIdleTime() / (wallTime * busyTime.size()) : 0;
+    }
+
+  private:
+    struct Node {
+        std::string name;
+        std::function<void()> masterBody; ///< set for master nodes
+        LoopBody loopBody;                ///< set for loop nodes
+        int n = 0;                        ///< number of indices of loop nodes
+        int chunk = 1;                    ///< indices per chunk
+        int nChunk = 1;                   ///< 1 for master nodes
+        std::vector<int> deps;            ///< nodes this one depends on
+        std::vector<int> next;            ///< nodes depending on this one
+    };
+
+    std::vector<Node> nodes;
+    std::vector<double> busyTime; ///< time spent in node bodies by each thread
+    double wallTime = 0;
+
+    int addNode(Node &node, const std::vector<int> &deps) {
+        const int index = nodes.size();
+        for (auto d : deps) {
+            assert(d >= 0 && d < index);
+            nodes[d].next.push_back(index);
+        }
+        node.deps = deps;
+        nodes.push_back(node);
+        return index;
+    }
+
+    void runChunk(const Node &node, int c, int threadId) {
+        const double start = omp_get_wtime();
+        if (node.masterBody) {
+            node.masterBody();
+        } else {
+            node.loopBody(c * node.chunk, std::min((c + 1) * node.chunk, node.n), threadId);
+        }
+        busyTime[threadId] += omp_get_wtime() - start;
+    }
+
+    void runForkJoin(const int nThreads) {
+        for (const auto &node : nodes) {
+            if (node.masterBody) {
+                runChunk(node, 0, 0);
+                continue;
+            }
+#pragma omp parallel num_threads(nThreads)
+            {
+                const int threadId = omp_get_thread_num();
+#pragma omp for schedule(static) // deterministic assignment of chunks to threads
+                for (int c = 0; c < node.nChunk; c++) {
+                    runChunk(node, c, threadId);
+                }
+            }
+        }
+    }
+
+    void runOverlap(const int nThreads) {
+        const int nNode = nodes.size();
+        std::vector<std::atomic<int>> depCount(nNode);   // unfinished dependencies
+        std::vector<std::atomic<int>> nextChunk(nNode);  // next chunk to grab
+        std::vector<std::atomic<int>> chunkCount(nNode); // unfinished chunks
+        for (int k = 0; k < nNode; k++) {
+            depCount[k] = nodes[k].deps.size();
+            nextChunk[k] = 0;
+            chunkCount[k] = nodes[k].nChunk;
+        }
+        std::atomic<int> nodeCount(nNode); // unfinished nodes
+
+        auto finishChunk = [&](int k) {
+            if (chunkCount[k].fetch_sub(1) == 1) {
+                for (auto d : nodes[k].next) {
+                    depCount[d]--;
+                }
+                nodeCount--;
+            }
+        };
+
+#pragma omp parallel num_threads(nThreads)
+        {
+            const int threadId = omp_get_thread_num();
+            while (nodeCount > 0) {
+                bool worked = false;
+                // thread 0 starts master nodes first, so that MPI communication begins as early as possible
+                if (threadId == 0) {
+                    for (int k = 0; k < nNode && !worked; k++) {
+                        if (nodes[k].masterBody && depCount[k] == 0 && nextChunk[k] == 0) {
+                            nextChunk[k] = 1;
+                            runChunk(nodes[k], 0, threadId);
+                            finishChunk(k);
+                            worked = true;
+                        }
+                    }
+                }
+                for (int k = 0; k < nNode && !worked; k++) {
+                    if (nodes[k].masterBody || depCount[k] > 0 || nextChunk[k] >= nodes[k].nChunk) {
+                        continue;
+                    }
+                    const int c = nextChunk[k]++;
+                    if (c < nodes[k].nChunk) {
+                        runChunk(nodes[k], c, threadId);
+                        finishChunk(k);
+                        worked = true;
+                    }
+                }
+                if (!worked) {
+                    std::this_thread::yield(); // nothing ready, give the core to thread 0 if oversubscribed
+                }
+            }
+        }
+    }
+};
+
+#endif
@@ -0,0 +1,63 @@
+#include "TaskGraph.hpp"
+
+#include <chrono>
+#include <cstdio>
+#include <thread>
+
+bool testGraph(bool overlap) {
+    const int n = 10000;
+    const int nThreads = omp_get_max_threads();
+    std::vector<int> a(n, 0), b(n, 0), c(n, 0);
+    std::vector<int> visit(n, 0);
+    int masterThread = -1;
+    int sum = 0;
+
+    TaskGraph graph;
+    // a and the master node are independent, b depends on a, c depends on b and the master node
+    const int nodeA = graph.addLoop("A", n, 100, [&](int begin, int end, int threadId) {
+        for (int i = begin; i < end; i++) {
+            a[i] = i;
+            visit[i]++;
+        }
+    });
+    const int nodeM = graph.addMaster("M", [&]() {
+        masterThread = omp_get_thread_num();
+        std::this_thread::sleep_for(std::chrono::milliseconds(20)); // pretend to wait for MPI
+        sum = 1;
+    });
+    const int nodeB = graph.addLoop(
+        "B", n, 37,
+        [&](int begin, int end, int threadId) {
+            for (int i = begin; i < end; i++) {
+                b[i] = a[n - 1 - i] + 1;
+            }
+        },
+        {nodeA});
+    graph.addLoop(
+        "C", n, 1000,
+        [&](int begin, int end, int threadId) {
+            for (int i = begin; i < end; i++) {
+                c[i] = b[i] + sum;
+            }
+        },
+        {nodeB, nodeM});
+    graph.addLoop("Empty", 0, 10, [&](int begin, int end, int threadId) {}, {nodeB});
+    graph.run(overlap);
+
+    bool pass = masterThread == 0;
+    for (int i = 0; i < n; i++) {
+        pass = pass && visit[i] == 1 && c[i] == n - 1 - i + 2;
+    }
+    printf("overlap %d, %d threads, wall %g s, idle fraction %g\n", overlap, nThreads, graph.getWallTime(),
+           graph.getIdleFraction());
+    return pass;
+}
+
+int main() {
+    if (testGraph(true) && testGraph(false)) {
+        printf("TestPassed\n");
+    } else {
+        printf("Error\n");
+    }
+    return 0;
+}
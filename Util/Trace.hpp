@@ -0,0 +1,266 @@
+/**
+ * @file Trace.hpp
+ * @brief Per-rank, per-thread timeline tracing in Chrome trace event format
+ *
+ */
+#ifndef TRACE_HPP_
+#define TRACE_HPP_
+
+#include <algorithm>
+#include <cstdio>
+#include <string>
+#include <vector>
+
+#include <mpi.h>
+#include <omp.h>
+
+/**
+ * @brief a timeline of begin/end events on each thread of each rank
+ *
+ * Each openmp thread writes only to its own ring buffer, so recording needs no lock.
+ * When a buffer is full the oldest events are overwritten.
+ * Event names must be string literals or otherwise outlive the trace.
+ * dump() writes a single Chrome trace event JSON file from rank 0, which can be opened by
+ * chrome://tracing or ui.perfetto.dev. pid is the mpi rank and tid is the openmp thread.
+ *
+ * MPI calls are attributed if Util/TraceMPI.cpp is linked, which intercepts collectives and waits through PMPI.
+ */
+class Trace {
+  public:
+    /**
+     * @brief one complete event
+     *
+     */
+    struct Event {
+        const char *name; ///< event name
+        const char *cat;  ///< event category
+        double begin;     ///< begin time in seconds since enable()
+        double end;       ///< end time in seconds since enable()
+        int arg;          ///< an integer argument, e.g., iteration count. -1 for none
+    };
+
+    /**
+     * @brief the per process trace
+     *
+     * @return Trace&
+     */
+    static Trace &instance() {
+        static Trace trace;
+        return trace;
+    }
+
+    /**
+     * @brief clear all buffers and start recording
+     *
+     * collective on MPI_COMM_WORLD, so that the time origin is roughly the same on all ranks
+     * @param capacity_ number of events kept on each thread
+     */
+    void enable(int capacity_ = 1 << 16) {
+        capacity = capacity_;
+        const int nThreads = omp_get_max_threads();
+        buffer.assign(nThreads, std::vector<Event>());
+        head.assign(nThreads, Counter());
+        for (auto &buf : buffer) {
+            buf.reserve(capacity);
+        }
+        MPI_Barrier(MPI_COMM_WORLD);
+        origin = MPI_Wtime();
+        enabled = true;
+    }
+
+    /**
+     * @brief stop recording, the buffers are kept for dump()
+     *
+     */
+    void disable() { enabled = false; }
+
+    bool isEnabled() const { return enabled; }
+
+    /**
+     * @brief current time relative to the time origin
+     *
+     * @return double seconds
+     */
+    double now() const { return MPI_Wtime() - origin; }
+
+    /**
+     * @brief record an event on the calling thread
+     *
+     * @param name
+     * @param cat
+     * @param begin from now()
+     * @param end from now()
+     * @param arg
+     */
+    void record(const char *name, const char *cat, double begin, double end, int arg = -1) {
+        const int tid = omp_get_thread_num();
+        if (!enabled || tid >= static_cast<int>(buffer.size())) {
+            return;
+        }
+        auto &buf = buffer[tid];
+        const long count = head[tid].count++;
+        if (buf.size() < capacity) {
+            buf.push_back(Event{name, cat, begin, end, arg});
+        } else {
+            buf[count % capacity] = Event{name, cat, begin, end, arg};
+        }
+    }
+
+    /**
+     * @brief number of events recorded on all threads of this rank, including overwritten ones
+     *
+     * @return long
+     */
+    long getEventCount() const {
+        long count = 0;
+        for (const auto &h : head) {
+            count += h.count;
+        }
+        return count;
+    }
+
+    /**
+     * @brief gather events from all ranks and write a JSON file from rank 0
+     *
+     * collective on MPI_COMM_WORLD. recording is disabled during dump().
+     * @param filename
+     */
+    void dump(const std::string &filename) {
+        const bool wasEnabled = enabled;
+        enabled = false;
+
+        int rank = 0, nProcs = 1;
+        MPI_Comm_rank(MPI_COMM_WORLD, &rank);
+        MPI_Comm_size(MPI_COMM_WORLD, &nProcs);
+
+        std::string local;
+        char line[512];
+        snprintf(line, sizeof(line),
+                 "{\"name\":\"process_name\",\"ph\":\"M\",\"pid\":%d,\"args\":{\"name\":\"rank %d\"}},\n", rank, rank);
+        local += line;
+        for (int t = 0; t < static_cast<int>(buffer.size()); t++) {
+            const auto &buf = buffer[t];
+            const int n = buf.size();
+            // oldest first
+            const int start = head[t].count > static_cast<long>(capacity) ? head[t].count % capacity : 0;
+            for (int k = 0; k < n; k++) {
+                const auto &e = buf[(start + k) % n];
+                int length = snprintf(line, sizeof(line),
+                                      "{\"name\":\"%s\",\"cat\":\"%s\",\"ph\":\"X\",\"ts\":%.3f,\"dur\":%.3f,"
+                                      "\"pid\":%d,\"tid\":%d",
+                                      e.name, e.cat, e.begin * 1e6, (e.end - e.begin) * 1e6, rank, t);
+                if (e.arg >= 0) {
+                    length += snprintf(line + length, sizeof(line) - length, ",\"args\":{\"n\":%d}", e.arg);
+                }
+                snprintf(line + length, sizeof(line) - length, "},\n");
+                local += line;
+            }
+        }
+
+        // remove the trailing ",\n" of the last event, the metadata event is always present
+        local.resize(local.size() - 2);
+
+        // send to rank 0 one rank at a time in chunks, the sizes may exceed the int count of MPI
+        constexpr long chunkSize = 1L << 30;
+        if (rank == 0) {
+            FILE *fp = fopen(filename.c_str(), "w");
+            if (fp == nullptr) {
+                printf("Trace: cannot open %s\n", filename.c_str());
+            } else {
+                fprintf(fp, "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n");
+                fwrite(local.data(), sizeof(char), local.size(), fp);
+            }
+            std::vector<char> chunk;
+            for (int r = 1; r < nProcs; r++) {
+                long remoteSize = 0;
+                MPI_Recv(&remoteSize, 1, MPI_LONG, r, 0, MPI_COMM_WORLD, MPI_STATUS_IGNORE);
+                if (fp != nullptr) {
+                    fprintf(fp, ",\n");
+                }
+                for (long offset = 0; offset < remoteSize; offset += chunkSize) {
+                    const int count = std::min(chunkSize, remoteSize - offset);
+                    chunk.resize(count);
+                    MPI_Recv(chunk.data(), count, MPI_CHAR, r, 1, MPI_COMM_WORLD, MPI_STATUS_IGNORE);
+                    if (fp != nullptr) {
+                        fwrite(chunk.data(), sizeof(char), count, fp);
+                    }
+                }
+            }
+            if (fp != nullptr) {
+                fprintf(fp, "\n]}\n");
+                fclose(fp);
+            }
+        } else {
+            long localSize = local.size();
+            MPI_Send(&localSize, 1, MPI_LONG, 0, 0, MPI_COMM_WORLD);
+            for (long offset = 0; offset < localSize; offset += chunkSize) {
+                const int count = std::min(chunkSize, localSize - offset);
+                MPI_Send(local.data() + offset, count, MPI_CHAR, 0, 1, MPI_COMM_WORLD);
+            }
+        }
+
+        enabled = wasEnabled;
+    }
+
+  private:
+    /**
+     * @brief event counter of each thread, padded to avoid false sharing
+     *
+     */
+    struct Counter {
+        long count = 0;
+        char pad[64 - sizeof(long)];
+    };
+
+    bool enabled = false;                   ///< if recording
+    size_t capacity = 0;                    ///< ring buffer size per thread
+    double origin = 0;                      ///< time origin, MPI_Wtime() at enable()
+    std::vector<std::vector<Event>> buffer; ///< ring buffer of each thread
+    std::vector<Counter> head;              ///< number of events recorded by each thread
+
+    Trace() = default;
+    ~Trace() = default;
+    Trace(const Trace &) = delete;
+    Trace &operator=(const Trace &) = delete;
+};
+
+/**
+ * @brief record an event from construction to destruction
+ *
+ * no-op if tracing is not enabled at construction
+ */
+class TraceScope {
+  public:
+    /**
+     * @brief Construct a new TraceScope object
+     *
+     * @param name_ must be a string literal
+     * @param cat_ must be a string literal
+     * @param arg_ an integer argument, -1 for none
+     */
+    explicit TraceScope(const char *name_, const char *cat_ = "SimToolbox", int arg_ = -1)
+        : name(name_), cat(cat_), arg(arg_) {
+        auto &trace = Trace::instance();
+        if (trace.isEnabled()) {
+            begin = trace.now();
+        }
+    }
+
+    ~TraceScope() {
+        auto &trace = Trace::instance();
+        if (begin >= 0 && trace.isEnabled()) {
+            trace.record(name, cat, begin, trace.now(), arg);
+        }
+    }
+
+    TraceScope(const TraceScope &) = delete;
+    TraceScope &operator=(const TraceScope &) = delete;
+
+  private:
+    const char *name;
+    const char *cat;
+    int arg;
+    double begin = -1;
+};
+
+#endif
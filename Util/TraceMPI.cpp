@@ -0,0 +1,140 @@
+/**
+ * @file TraceMPI.cpp
+ * @brief Attribute time spent in blocking MPI calls to the Trace timeline through the PMPI profiling interface
+ *
+ * Linking this file replaces the MPI entries below for the whole executable, including calls made inside
+ * Trilinos and FDPS. Each call forwards to PMPI_* and, if Trace is enabled, records an event of category MPI.
+ * Nonblocking calls return immediately and are not recorded, the waiting shows up in MPI_Wait*.
+ * Requires an MPI-3 library for the const-qualified signatures.
+ */
+
+#include "Trace.hpp"
+
+namespace {
+/**
+ * @brief call f and record its duration if tracing is enabled
+ *
+ * @tparam Func
+ * @param name must be a string literal
+ * @param f
+ * @return int the return value of f
+ */
+template <class Func>
+int traceCall(const char *name, Func &&f) {
+    auto &trace = Trace::instance();
+    if (!trace.isEnabled()) {
+        return f();
+    }
+    const double begin = trace.now();
+    const int error = f();
+    trace.record(name, "MPI", begin, trace.now());
+    return error;
+}
+} // namespace
+
+extern "C" {
+
+// collectives
+int MPI_Barrier(MPI_Comm comm) {
+    return traceCall("MPI_Barrier", [&]() { return PMPI_Barrier(comm); });
+}
+
+int MPI_Bcast(void *buffer, int count, MPI_Datatype datatype, int root, MPI_Comm comm) {
+    return traceCall("MPI_Bcast", [&]() { return PMPI_Bcast(buffer, count, datatype, root, comm); });
+}
+
+int MPI_Reduce(const void *sendbuf, void *recvbuf, int count, MPI_Datatype datatype, MPI_Op op, int root,
+               MPI_Comm comm) {
+    return traceCall("MPI_Reduce", [&]() { return PMPI_Reduce(sendbuf, recvbuf, count, datatype, op, root, comm); });
+}
+
+int MPI_Allreduce(const void *sendbuf, void *recvbuf, int count, MPI_Datatype datatype, MPI_Op op, MPI_Comm comm) {
+    return traceCall("MPI_Allreduce", [&]() { return PMPI_Allreduce(sendbuf, recvbuf, count, datatype, op, comm); });
+}
+
+int MPI_Scan(const void *sendbuf, void *recvbuf, int count, MPI_Datatype datatype, MPI_Op op, MPI_Comm comm) {
+    return traceCall("MPI_Scan", [&]() { return PMPI_Scan(sendbuf, recvbuf, count, datatype, op, comm); });
+}
+
+int MPI_Gather(const void *sendbuf, int sendcount, MPI_Datatype sendtype, void *recvbuf, int recvcount,
+               MPI_Datatype recvtype, int root, MPI_Comm comm) {
+    return traceCall("MPI_Gather", [&]() {
+        return PMPI_Gather(sendbuf, sendcount, sendtype, recvbuf, recvcount, recvtype, root, comm);
+    });
+}
+
+int MPI_Gatherv(const void *sendbuf, int sendcount, MPI_Datatype sendtype, void *recvbuf, const int recvcounts[],
+                const int displs[], MPI_Datatype recvtype, int root, MPI_Comm comm) {
+    return traceCall("MPI_Gatherv", [&]() {
+        return PMPI_Gatherv(sendbuf, sendcount, sendtype, recvbuf, recvcounts, displs, recvtype, root, comm);
+    });
+}
+
+int MPI_Allgather(const void *sendbuf, int sendcount, MPI_Datatype sendtype, void *recvbuf, int recvcount,
+                  MPI_Datatype recvtype, MPI_Comm comm) {
+    return traceCall("MPI_Allgather", [&]() {
+        return PMPI_Allgather(sendbuf, sendcount, sendtype, recvbuf, recvcount, recvtype, comm);
+    });
+}
+
+int MPI_Allgatherv(const void *sendbuf, int sendcount, MPI_Datatype sendtype, void *recvbuf, const int recvcounts[],
+                   const int displs[], MPI_Datatype recvtype, MPI_Comm comm) {
+    return traceCall("MPI_Allgatherv", [&]() {
+        return PMPI_Allgatherv(sendbuf, sendcount, sendtype, recvbuf, recvcounts, displs, recvtype, comm);
+    });
+}
+
+int MPI_Alltoall(const void *sendbuf, int sendcount, MPI_Datatype sendtype, void *recvbuf, int recvcount,
+                 MPI_Datatype recvtype, MPI_Comm comm) {
+    return traceCall("MPI_Alltoall", [&]() {
+        return PMPI_Alltoall(sendbuf, sendcount, sendtype, recvbuf, recvcount, recvtype, comm);
+    });
+}
+
+int MPI_Alltoallv(const void *sendbuf, const int sendcounts[], const int sdispls[], MPI_Datatype sendtype,
+                  void *recvbuf, const int recvcounts[], const int rdispls[], MPI_Datatype recvtype, MPI_Comm comm) {
+    return traceCall("MPI_Alltoallv", [&]() {
+        return PMPI_Alltoallv(sendbuf, sendcounts, sdispls, sendtype, recvbuf, recvcounts, rdispls, recvtype, comm);
+    });
+}
+
+// blocking point to point and completion of nonblocking calls, e.g., Tpetra Import/Export
+int MPI_Send(const void *buf, int count, MPI_Datatype datatype, int dest, int tag, MPI_Comm comm) {
+    return traceCall("MPI_Send", [&]() { return PMPI_Send(buf, count, datatype, dest, tag, comm); });
+}
+
+int MPI_Recv(void *buf, int count, MPI_Datatype datatype, int source, int tag, MPI_Comm comm, MPI_Status *status) {
+    return traceCall("MPI_Recv", [&]() { return PMPI_Recv(buf, count, datatype, source, tag, comm, status); });
+}
+
+int MPI_Sendrecv(const void *sendbuf, int sendcount, MPI_Datatype sendtype, int dest, int sendtag, void *recvbuf,
+                 int recvcount, MPI_Datatype recvtype, int source, int recvtag, MPI_Comm comm, MPI_Status *status) {
+    return traceCall("MPI_Sendrecv", [&]() {
+        return PMPI_Sendrecv(sendbuf, sendcount, sendtype, dest, sendtag, recvbuf, recvcount, recvtype, source,
+                             recvtag, comm, status);
+    });
+}
+
+int MPI_Probe(int source, int tag, MPI_Comm comm, MPI_Status *status) {
+    return traceCall("MPI_Probe", [&]() { return PMPI_Probe(source, tag, comm, status); });
+}
+
+int MPI_Wait(MPI_Request *request, MPI_Status *status) {
+    return traceCall("MPI_Wait", [&]() { return PMPI_Wait(request, status); });
+}
+
+int MPI_Waitall(int count, MPI_Request array_of_requests[], MPI_Status array_of_statuses[]) {
+    return traceCall("MPI_Waitall", [&]() { return PMPI_Waitall(count, array_of_requests, array_of_statuses); });
+}
+
+int MPI_Waitany(int count, MPI_Request array_of_requests[], int *index, MPI_Status *status) {
+    return traceCall("MPI_Waitany", [&]() { return PMPI_Waitany(count, array_of_requests, index, status); });
+}
+
+int MPI_Waitsome(int incount, MPI_Request array_of_requests[], int *outcount, int array_of_indices[],
+                 MPI_Status array_of_statuses[]) {
+    return traceCall("MPI_Waitsome", [&]() {
+        return PMPI_Waitsome(incount, array_of_requests, outcount, array_of_indices, array_of_statuses);
+    });
+}
+}
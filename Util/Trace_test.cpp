@@ -0,0 +1,90 @@
+#include "Trace.hpp"
+
+#include <cstdio>
+#include <fstream>
+#include <sstream>
+
+int countEvents(const std::string &filename, const std::string &pattern) {
+    std::ifstream file(filename);
+    std::stringstream ss;
+    ss << file.rdbuf();
+    const std::string content = ss.str();
+    int count = 0;
+    for (size_t pos = content.find(pattern); pos != std::string::npos; pos = content.find(pattern, pos + 1)) {
+        count++;
+    }
+    return count;
+}
+
+bool testRing() {
+    auto &trace = Trace::instance();
+    const int capacity = 8;
+    trace.enable(capacity);
+    const int nThreads = omp_get_max_threads();
+#pragma omp parallel
+    {
+        for (int i = 0; i < 20; i++) {
+            TraceScope scope("ring", "test", i);
+        }
+    }
+    trace.disable();
+    if (trace.getEventCount() != 20 * nThreads) {
+        printf("event count %ld, expected %d\n", trace.getEventCount(), 20 * nThreads);
+        return false;
+    }
+    trace.dump("Trace_test_ring.json");
+
+    int rank = 0, nProcs = 1;
+    MPI_Comm_rank(MPI_COMM_WORLD, &rank);
+    MPI_Comm_size(MPI_COMM_WORLD, &nProcs);
+    bool pass = true;
+    if (rank == 0) {
+        // only the latest capacity events on each thread are kept
+        const int nX = countEvents("Trace_test_ring.json", "\"ph\":\"X\"");
+        const int nLast = countEvents("Trace_test_ring.json", "\"n\":19}");
+        const int nFirst = countEvents("Trace_test_ring.json", "\"n\":11}");
+        pass = nX == capacity * nThreads * nProcs && nLast == nThreads * nProcs && nFirst == 0;
+        if (!pass) {
+            printf("dumped %d events, %d last, %d overwritten\n", nX, nLast, nFirst);
+        }
+    }
+    MPI_Bcast(&pass, 1, MPI_CXX_BOOL, 0, MPI_COMM_WORLD);
+    return pass;
+}
+
+bool testDisabled() {
+    auto &trace = Trace::instance();
+    trace.enable(16);
+    trace.disable();
+    {
+        TraceScope scope("disabled");
+    }
+    return trace.getEventCount() == 0;
+}
+
+bool testMPI() {
+    // each blocking MPI call is one event if TraceMPI.cpp is linked
+    auto &trace = Trace::instance();
+    trace.enable(16);
+    double local = 1, global = 0;
+    MPI_Allreduce(&local, &global, 1, MPI_DOUBLE, MPI_SUM, MPI_COMM_WORLD);
+    MPI_Barrier(MPI_COMM_WORLD);
+    trace.disable();
+#ifdef SIMTOOLBOX_TRACE_MPI
+    return trace.getEventCount() == 2;
+#else
+    return trace.getEventCount() == 0;
+#endif
+}
+
+int main(int argc, char **argv) {
+    MPI_Init(&argc, &argv);
+    const bool pass = testRing() && testDisabled() && testMPI();
+    int rank = 0;
+    MPI_Comm_rank(MPI_COMM_WORLD, &rank);
+    if (rank == 0) {
+        printf(pass ? "TestPassed\n" : "Error\n");
+    }
+    MPI_Finalize();
+    return 0;
+}